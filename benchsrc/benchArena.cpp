@@ -0,0 +1,174 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchArena.cpp - Arena compared with new and delete
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Two patterns are measured.  The first builds a structure out of many
+    small nodes for each of a number of requests, and then throws all of
+    it away, as a request handler building an index would.  The second
+    allocates a few scratch arrays of the size HashJoin uses for a
+    partition's hash table, fills them, and frees them, over and over.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "Arena.h"
+
+using namespace phoenix4cpp;
+
+#define N_REQUESTS 100
+#define N_NODES 100000
+#define N_SCRATCH 2000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Node
+{
+    Node *pNext;
+    unsigned long key;
+    char payload[16];
+};
+
+/* node sizes vary a little, as a real index's would */
+static size_t nodeBytes[N_NODES];
+
+static double benchNodesNew()
+{
+    const double start = now();
+    unsigned long sum = 0;
+    for(unsigned r = 0; r < N_REQUESTS; ++r)
+    {
+	Node *pHead = NULL;
+	for(size_t i = 0; i < N_NODES; ++i)
+	{
+	    Node *pNode = (Node *)new char[nodeBytes[i]];
+	    pNode->pNext = pHead;
+	    pNode->key = i;
+	    pHead = pNode;
+	}
+	for(Node *pNode = pHead; pNode; pNode = pNode->pNext)
+	    sum += pNode->key;
+	while(pHead)
+	{
+	    Node *pNode = pHead;
+	    pHead = pNode->pNext;
+	    delete[] (char *)pNode;
+	}
+    }
+    sink = sum;
+    return now() - start;
+}
+
+static double benchNodesArena(bool hugePages)
+{
+    Arena arena(2 << 20, hugePages);
+    const double start = now();
+    unsigned long sum = 0;
+    for(unsigned r = 0; r < N_REQUESTS; ++r)
+    {
+	ArenaScope scope(&arena);
+	Node *pHead = NULL;
+	for(size_t i = 0; i < N_NODES; ++i)
+	{
+	    Node *pNode = (Node *)arena.allocate(nodeBytes[i]);
+	    pNode->pNext = pHead;
+	    pNode->key = i;
+	    pHead = pNode;
+	}
+	for(Node *pNode = pHead; pNode; pNode = pNode->pNext)
+	    sum += pNode->key;
+    }
+    sink = sum;
+    return now() - start;
+}
+
+static double benchScratchNew()
+{
+    const double start = now();
+    unsigned long sum = 0;
+    for(unsigned r = 0; r < N_SCRATCH; ++r)
+    {
+	const size_t n = 4096 + random64() % 8192;
+	unsigned *pHead = new unsigned[2 * n];
+	unsigned *pNext = new unsigned[n];
+	memset(pHead, 0, 2 * n * sizeof(unsigned));
+	for(size_t i = 0; i < n; ++i)
+	{
+	    pNext[i] = pHead[i];
+	    pHead[i * 2] = (unsigned)i;
+	}
+	sum += pNext[n / 2] + pHead[n];
+	delete[] pHead;
+	delete[] pNext;
+    }
+    sink = sum;
+    return now() - start;
+}
+
+static double benchScratchArena()
+{
+    Arena *pArena = Arena::getThreadArena();
+    const double start = now();
+    unsigned long sum = 0;
+    for(unsigned r = 0; r < N_SCRATCH; ++r)
+    {
+	ArenaScope scope(pArena);
+	const size_t n = 4096 + random64() % 8192;
+	unsigned *pHead = pArena->allocateArray<unsigned>(2 * n);
+	unsigned *pNext = pArena->allocateArray<unsigned>(n);
+	memset(pHead, 0, 2 * n * sizeof(unsigned));
+	for(size_t i = 0; i < n; ++i)
+	{
+	    pNext[i] = pHead[i];
+	    pHead[i * 2] = (unsigned)i;
+	}
+	sum += pNext[n / 2] + pHead[n];
+    }
+    sink = sum;
+    return now() - start;
+}
+
+int main()
+{
+    for(size_t i = 0; i < N_NODES; ++i)
+	nodeBytes[i] = sizeof(Node) + (size_t)(random64() % 40);
+
+    printf("%d requests building %d nodes each\n", N_REQUESTS, N_NODES);
+    printf("  new/delete            %7.1f ms\n", benchNodesNew() * 1e3);
+    printf("  Arena                 %7.1f ms\n", benchNodesArena(false) * 1e3);
+    printf("  Arena (huge pages)    %7.1f ms\n", benchNodesArena(true) * 1e3);
+
+    printf("%d rounds of hash table scratch arrays\n", N_SCRATCH);
+    printf("  new/delete            %7.1f ms\n", benchScratchNew() * 1e3);
+    printf("  thread Arena          %7.1f ms\n", benchScratchArena() * 1e3);
+
+    return 0;
+}
@@ -0,0 +1,122 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchBloomFilter.cpp - false positive rate and lookup throughput for
+    BloomFilter.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Filters are sized so that they fit in the first or second level caches,
+    or are much larger than the last level cache.  Lookups are timed
+    separately for keys that are present and keys that are not, using both
+    a Hashable (which includes the cost of hashing the key) and a
+    precomputed hash value (which measures the filter itself).
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "BloomFilter.h"
+#include "HashValue.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+#define N_LOOKUPS 4000000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long hashOf(unsigned long k)
+{
+    HashValue hashValue;
+    HashableUnsignedLong key(k);
+    key.hash(&hashValue);
+    return hashValue.get64();
+}
+
+int main()
+{
+    printf("false positive rate, 1M keys\n");
+    printf("%12s %6s %12s %12s\n", "bits/item", "k", "measured",
+	   "classic");
+    static const unsigned bitsPerItem[] = {4, 6, 8, 10, 12, 16, 20};
+    for(size_t b = 0; b < sizeof(bitsPerItem) / sizeof(bitsPerItem[0]); ++b)
+    {
+	const unsigned long n = 1000000;
+	BloomFilter filter(n, bitsPerItem[b]);
+	for(unsigned long i = 0; i < n; ++i)
+	    filter.addHash(hashOf(i));
+
+	unsigned long falsePositives = 0;
+	for(unsigned long i = n; i < 5 * n; ++i)
+	    if (filter.mayContainHash(hashOf(i)))
+		++falsePositives;
+
+	/* what an unblocked filter with the same k and bits would give */
+	const double k = filter.getProbeCount();
+	const double classic = pow(1 - exp(-k / bitsPerItem[b]), k);
+	printf("%12u %6u %12.5f %12.5f\n", bitsPerItem[b],
+	       filter.getProbeCount(), falsePositives / (4.0 * n), classic);
+    }
+
+    printf("\nlookups, millions/s, 10 bits per item\n");
+    printf("%12s %12s %12s %12s %12s\n", "filter", "hit", "miss",
+	   "hit(hashed)", "miss(hashed)");
+    static const unsigned long items[] = {50000, 800000, 20000000};
+    unsigned long long *pHash = new unsigned long long[N_LOOKUPS];
+    for(size_t s = 0; s < sizeof(items) / sizeof(items[0]); ++s)
+    {
+	BloomFilter filter(items[s], 10);
+	for(unsigned long i = 0; i < items[s]; ++i)
+	    filter.addHash(hashOf(i));
+
+	double rate[4];
+	for(unsigned miss = 0; miss < 2; ++miss)
+	{
+	    const unsigned long base = miss ? items[s] : 0;
+	    unsigned long found = 0;
+
+	    /* include the cost of hashing */
+	    double start = now();
+	    for(unsigned long i = 0; i < N_LOOKUPS; ++i)
+	    {
+		HashableUnsignedLong key(base + (i * 7919) % items[s]);
+		found += filter.mayContain(&key);
+	    }
+	    rate[miss] = N_LOOKUPS / (now() - start) / 1e6;
+
+	    /* just the filter */
+	    for(unsigned long i = 0; i < N_LOOKUPS; ++i)
+		pHash[i] = hashOf(base + (i * 7919) % items[s]);
+	    start = now();
+	    for(unsigned long i = 0; i < N_LOOKUPS; ++i)
+		found += filter.mayContainHash(pHash[i]);
+	    rate[2 + miss] = N_LOOKUPS / (now() - start) / 1e6;
+
+	    if (!miss && (found != 2 * N_LOOKUPS))
+		printf("false negatives!\n");
+	}
+
+	char size[32];
+	snprintf(size, sizeof(size), "%luKB",
+		 (unsigned long)(filter.getSerializedSize() >> 10));
+	printf("%12s %12.1f %12.1f %12.1f %12.1f\n", size,
+	       rate[0], rate[1], rate[2], rate[3]);
+    }
+    delete[] pHash;
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchConcurrentHashMap.cpp - multi-threaded benchmarks for
+    ConcurrentHashMap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Each thread runs a mix of lookups and writes against a shared map for a
+    fixed amount of wall clock time.  Writes alternate the element stored
+    under a key between two preallocated elements, so the key set, and the
+    size of the map, stay fixed and nothing has to be reclaimed.
+
+    For comparison, the same workload is run against an IntrusiveHashTable
+    protected by a pthread_rwlock_t, which is what a client would otherwise
+    have to do.
+
+    Read scaling can only be near linear up to the number of available
+    processors; the processor count is printed with the results.
+
+    Usage:  benchConcurrentHashMap [maxThreads]
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "ConcurrentHashMap.h"
+#include "Comparator.h"
+#include "Hashable.h"
+#include "IntrusiveHash.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+struct Entry
+{
+    unsigned long key;
+    IntrusiveHashMembership membership;
+};
+
+typedef IntrusiveHashTable<Entry, offsetof(Entry, membership)> LockedTable;
+
+#define N_KEYS (1UL << 16)
+#define RUN_SECONDS 0.25
+
+static Entry entry[2][N_KEYS];
+static ComparatorUnsignedLong comparator;
+
+static ConcurrentHashMap<Entry> *pMap;
+static LockedTable *pLockedTable;
+static pthread_rwlock_t rwlock;
+
+/* which of the two elements is currently in the locked table */
+static unsigned char current[N_KEYS];
+
+static volatile bool stop;
+
+struct Worker
+{
+    pthread_t thread;
+    unsigned seed;
+    unsigned writePercent;
+    bool locked;
+    unsigned long operations;
+    unsigned long found;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void *workerThread(void *p)
+{
+    Worker *pWorker = (Worker *)p;
+    unsigned long operations = 0;
+    unsigned long found = 0;
+
+    while(!stop)
+    {
+	/* check the clock infrequently */
+	for(unsigned i = 0; i < 256; ++i, ++operations)
+	{
+	    unsigned r = rand_r(&pWorker->seed);
+	    unsigned long k = (r >> 8) % N_KEYS;
+	    HashableUnsignedLong key(k);
+	    unsigned percentile = (unsigned)rand_r(&pWorker->seed) % 100;
+	    bool write = percentile < pWorker->writePercent;
+
+	    if (!pWorker->locked)
+	    {
+		if (write)
+		    pMap->replace(&key, &entry[r & 1][k]);
+		else if (pMap->find(&key))
+		    ++found;
+		continue;
+	    }
+
+	    if (write)
+	    {
+		pthread_rwlock_wrlock(&rwlock);
+		pLockedTable->remove(&entry[current[k]][k]);
+		current[k] ^= 1;
+		pLockedTable->add(&entry[current[k]][k]);
+		pthread_rwlock_unlock(&rwlock);
+	    }
+	    else
+	    {
+		pthread_rwlock_rdlock(&rwlock);
+		if (pLockedTable->find(&key))
+		    ++found;
+		pthread_rwlock_unlock(&rwlock);
+	    }
+	}
+    }
+
+    pWorker->operations = operations;
+    pWorker->found = found;
+    return NULL;
+}
+
+static double run(unsigned nThreads, unsigned writePercent, bool locked)
+{
+    Worker *pWorker = new Worker[nThreads];
+
+    stop = false;
+    for(unsigned i = 0; i < nThreads; ++i)
+    {
+	pWorker[i].seed = i * 7919 + 1;
+	pWorker[i].writePercent = writePercent;
+	pWorker[i].locked = locked;
+	pthread_create(&pWorker[i].thread, NULL, workerThread, &pWorker[i]);
+    }
+
+    const double start = now();
+    usleep((useconds_t)(RUN_SECONDS * 1e6));
+    stop = true;
+
+    unsigned long operations = 0;
+    for(unsigned i = 0; i < nThreads; ++i)
+    {
+	pthread_join(pWorker[i].thread, NULL);
+	operations += pWorker[i].operations;
+    }
+    const double elapsed = now() - start;
+
+    delete[] pWorker;
+    return operations / elapsed / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned maxThreads = 64;
+    if (argc > 1)
+	maxThreads = (unsigned)atoi(argv[1]);
+
+    pMap = new ConcurrentHashMap<Entry>(
+	offsetof(Entry, key), &comparator, N_KEYS);
+    pLockedTable = new LockedTable(
+	offsetof(Entry, key), hashUnsignedLong, compareUnsignedLong, N_KEYS);
+    pthread_rwlock_init(&rwlock, NULL);
+
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+    {
+	entry[0][k].key = entry[1][k].key = k;
+	HashableUnsignedLong key(k);
+	pMap->insert(&key, &entry[0][k]);
+	pLockedTable->add(&entry[0][k]);
+    }
+
+    printf("%ld processors online, %lu keys, Mops/s total (per thread)\n",
+	   sysconf(_SC_NPROCESSORS_ONLN), N_KEYS);
+
+    static const unsigned writePercent[] = {1, 10, 50};
+    for(size_t w = 0; w < sizeof(writePercent) / sizeof(writePercent[0]);
+	++w)
+    {
+	printf("\nreads/writes %u/%u\n", 100 - writePercent[w],
+	       writePercent[w]);
+	printf("%8s %22s %22s\n", "threads", "ConcurrentHashMap",
+	       "rwlock+IntrusiveHash");
+	for(unsigned nThreads = 1; nThreads <= maxThreads; nThreads <<= 1)
+	{
+	    double concurrent = run(nThreads, writePercent[w], false);
+	    double locked = run(nThreads, writePercent[w], true);
+	    printf("%8u %12.2f (%7.2f) %12.2f (%7.2f)\n", nThreads,
+		   concurrent, concurrent / nThreads,
+		   locked, locked / nThreads);
+	}
+    }
+
+    /* the elements are static, so don't let the table delete them */
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+	pLockedTable->remove(&entry[current[k]][k]);
+    delete pLockedTable;
+    delete pMap;
+    pthread_rwlock_destroy(&rwlock);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchConsistentHash.cpp - routing throughput and load balance for
+    ConsistentHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Load imbalance is reported as the most loaded shard's keys over the
+    mean, and as the coefficient of variation across shards.  Movement is
+    the fraction of keys whose shard changes when one more shard is added;
+    the ideal is 1/(n + 1).
+
+    Throughput includes hashing the keys, which are HashableUnsignedLongs.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "ConsistentHash.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+#define N_KEYS 1000000
+
+static volatile unsigned long sink;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void balance(const unsigned long *pShard, unsigned long nShards,
+		    double *pMax, double *pCv)
+{
+    unsigned long *pLoad = new unsigned long[nShards];
+    for(unsigned long s = 0; s < nShards; ++s)
+	pLoad[s] = 0;
+    for(size_t i = 0; i < N_KEYS; ++i)
+	++pLoad[pShard[i]];
+
+    const double mean = (double)N_KEYS / nShards;
+    double maximum = 0;
+    double sumSquares = 0;
+    for(unsigned long s = 0; s < nShards; ++s)
+    {
+	if (pLoad[s] > maximum)
+	    maximum = pLoad[s];
+	sumSquares += (pLoad[s] - mean) * (pLoad[s] - mean);
+    }
+
+    *pMax = maximum / mean;
+    *pCv = sqrt(sumSquares / nShards) / mean;
+    delete[] pLoad;
+}
+
+static double moved(const unsigned long *pBefore, const unsigned long *pAfter)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < N_KEYS; ++i)
+	if (pBefore[i] != pAfter[i])
+	    ++n;
+    return (double)n / N_KEYS;
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    HashableUnsignedLong **ppKey = new HashableUnsignedLong *[N_KEYS];
+    for(size_t i = 0; i < N_KEYS; ++i)
+	ppKey[i] = new HashableUnsignedLong(((unsigned long)rand() << 20) ^ i);
+    const Hashable *const *ppK = (const Hashable *const *)ppKey;
+
+    unsigned long *pBefore = new unsigned long[N_KEYS];
+    unsigned long *pAfter = new unsigned long[N_KEYS];
+    unsigned *pShard = new unsigned[N_KEYS];
+
+    static const unsigned long shards[] = {16, 256, 4096};
+    static const unsigned points[] = {1, 16, 128, 1024};
+
+    printf("%-14s %6s %6s %9s %8s %8s %10s %10s\n", "scheme", "shards",
+	   "points", "max/mean", "cv", "moved", "Mkeys/s", "batch");
+    for(size_t s = 0; s < sizeof(shards) / sizeof(shards[0]); ++s)
+    {
+	const unsigned long n = shards[s];
+
+	jumpHashBatch(ppK, N_KEYS, (unsigned)n, pShard);
+	for(size_t i = 0; i < N_KEYS; ++i)
+	    pBefore[i] = pShard[i];
+	jumpHashBatch(ppK, N_KEYS, (unsigned)n + 1, pShard);
+	for(size_t i = 0; i < N_KEYS; ++i)
+	    pAfter[i] = pShard[i];
+
+	double maximum;
+	double cv;
+	balance(pBefore, n, &maximum, &cv);
+	const double jumpMoved = moved(pBefore, pAfter);
+
+	double start = now();
+	unsigned long acc = 0;
+	for(size_t i = 0; i < N_KEYS; ++i)
+	    acc += jumpHash(ppK[i], (unsigned)n);
+	double single = now() - start;
+	sink = acc;
+	start = now();
+	jumpHashBatch(ppK, N_KEYS, (unsigned)n, pShard);
+	double batch = now() - start;
+
+	printf("%-14s %6lu %6s %9.3f %8.4f %8.4f %10.1f %10.1f\n", "jump", n,
+	       "-", maximum, cv, jumpMoved, N_KEYS / single / 1e6,
+	       N_KEYS / batch / 1e6);
+
+	for(size_t p = 0; p < sizeof(points) / sizeof(points[0]); ++p)
+	{
+	    /* building rings much bigger than this takes a while */
+	    if (n * points[p] > (1UL << 20))
+		continue;
+
+	    HashRing ring(points[p]);
+	    for(unsigned long node = 0; node < n; ++node)
+		ring.addNode(node);
+
+	    ring.routeBatch(ppK, N_KEYS, pBefore);
+	    ring.addNode(n);
+	    ring.routeBatch(ppK, N_KEYS, pAfter);
+	    ring.removeNode(n);
+	    balance(pBefore, n, &maximum, &cv);
+	    const double ringMoved = moved(pBefore, pAfter);
+
+	    start = now();
+	    acc = 0;
+	    for(size_t i = 0; i < N_KEYS; ++i)
+		acc += ring.route(ppK[i]);
+	    single = now() - start;
+	    sink = acc;
+	    start = now();
+	    ring.routeBatch(ppK, N_KEYS, pAfter);
+	    batch = now() - start;
+
+	    printf("%-14s %6lu %6u %9.3f %8.4f %8.4f %10.1f %10.1f\n",
+		   "ring", n, points[p], maximum, cv, ringMoved,
+		   N_KEYS / single / 1e6, N_KEYS / batch / 1e6);
+	}
+    }
+
+    for(size_t i = 0; i < N_KEYS; ++i)
+	delete ppKey[i];
+    delete[] ppKey;
+    delete[] pBefore;
+    delete[] pAfter;
+    delete[] pShard;
+    return 0;
+}
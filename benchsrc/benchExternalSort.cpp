@@ -0,0 +1,141 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchExternalSort.cpp - sort a file larger than the memory allowed
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A file of 16 byte records with random 64 bit keys is written to
+    $TMPDIR (or /tmp), and then sorted with 256MB of memory, first with
+    buffered I/O and then with O_DIRECT.  The output is checked for order
+    and for having the same sum of keys as the input.  The size of the
+    file in megabytes can be given as an argument; it defaults to 2048.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <unistd.h>
+
+#include "ExternalSort.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+struct Record
+{
+    unsigned long key;
+    unsigned long value;
+};
+
+#define BATCH 65536
+
+static unsigned long writeInput(const char *pPath, size_t n)
+{
+    static Record batch[BATCH];
+    FILE *pFile = fopen(pPath, "wb");
+    unsigned long sum = 0;
+    for(size_t i = 0; i < n; i += BATCH)
+    {
+	const size_t k = n - i < BATCH ? n - i : BATCH;
+	for(size_t j = 0; j < k; ++j)
+	{
+	    batch[j].key = (unsigned long)random64();
+	    batch[j].value = i + j;
+	    sum += batch[j].key;
+	}
+	fwrite(batch, sizeof(Record), k, pFile);
+    }
+    fclose(pFile);
+    return sum;
+}
+
+static bool checkOutput(const char *pPath, size_t n, unsigned long sum)
+{
+    static Record batch[BATCH];
+    FILE *pFile = fopen(pPath, "rb");
+    if (!pFile)
+	return false;
+    unsigned long last = 0;
+    size_t total = 0;
+    size_t k;
+    while((k = fread(batch, sizeof(Record), BATCH, pFile)))
+    {
+	for(size_t j = 0; j < k; ++j)
+	{
+	    if (batch[j].key < last)
+	    {
+		fclose(pFile);
+		return false;
+	    }
+	    last = batch[j].key;
+	    sum -= last;
+	}
+	total += k;
+    }
+    fclose(pFile);
+    return (total == n) && !sum;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t megabytes = argc > 1 ? (size_t)atol(argv[1]) : 2048;
+    const size_t n = (megabytes << 20) / sizeof(Record);
+
+    const char *pDirectory = getenv("TMPDIR");
+    if (!pDirectory)
+	pDirectory = "/tmp";
+    char inPath[256];
+    char outPath[256];
+    snprintf(inPath, sizeof(inPath), "%s/benchExternalSort-in-%d",
+	     pDirectory, (int)getpid());
+    snprintf(outPath, sizeof(outPath), "%s/benchExternalSort-out-%d",
+	     pDirectory, (int)getpid());
+
+    printf("%lu records of %u bytes (%luMB), 256MB of memory\n",
+	   (unsigned long)n, (unsigned)sizeof(Record),
+	   (unsigned long)megabytes);
+    const unsigned long sum = writeInput(inPath, n);
+
+    for(unsigned direct = 0; direct < 2; ++direct)
+    {
+	ExternalSortOptions options;
+	options.directIo = direct != 0;
+	const double start = now();
+	const int error =
+	    externalSort<Record, unsigned long, offsetof(Record, key)>(
+		inPath, outPath, compareUnsignedLong, &options);
+	const double elapsed = now() - start;
+	const bool ok = !error && checkOutput(outPath, n, sum);
+	printf("  %-9s %8.1f s  %6.1f MB/s  %s\n",
+	       direct ? "O_DIRECT" : "buffered", elapsed,
+	       megabytes / elapsed, ok ? "ok" : "FAILED");
+    }
+
+    unlink(inPath);
+    unlink(outPath);
+    return 0;
+}
@@ -0,0 +1,218 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchHashJoin.cpp - hashJoin() and hashGroup() compared with sorting
+    and merging with qsort()
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The sort-merge join sorts copies of both inputs with qsort(), and then
+    walks them together, pairing up each run of equal keys on the left with
+    the matching run on the right.  Sort-based grouping sorts a copy and
+    reports each run.  The copies are made outside the timed region; the
+    hash versions don't need them, since they don't modify their inputs.
+
+    Every result is consumed by a trivial callback that accumulates a
+    checksum, so that both approaches can be checked against each other.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "HashJoin.h"
+#include "compare.h"
+#include "hash.h"
+#include "qsort.h"
+
+using namespace phoenix4cpp;
+
+#define MAX_THREADS 64
+
+struct Record
+{
+    unsigned long key;
+    unsigned long value;
+    char payload[16];
+};
+
+struct Totals
+{
+    /* one line per thread, to keep them from sharing */
+    unsigned long sum[MAX_THREADS][8];
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static void emitPair(Totals *pTotals, unsigned thread,
+		     const Record *pLeft, const Record *pRight)
+{
+    pTotals->sum[thread][0] += pLeft->value ^ pRight->value;
+}
+
+static void emitGroup(Totals *pTotals, unsigned thread,
+		      const Record *const *ppGroup, size_t nGroup)
+{
+    pTotals->sum[thread][0] += ppGroup[0]->key * nGroup;
+}
+
+static unsigned long total(const Totals *pTotals)
+{
+    unsigned long sum = 0;
+    for(unsigned t = 0; t < MAX_THREADS; ++t)
+	sum += pTotals->sum[t][0];
+    return sum;
+}
+
+static unsigned long sortMergeJoin(Record *pLeft, size_t nLeft,
+				   Record *pRight, size_t nRight)
+{
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	pLeft, nLeft, compareUnsignedLong);
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	pRight, nRight, compareUnsignedLong);
+
+    unsigned long sum = 0;
+    size_t i = 0;
+    size_t j = 0;
+    while((i < nLeft) && (j < nRight))
+    {
+	if (pLeft[i].key < pRight[j].key)
+	    ++i;
+	else if (pLeft[i].key > pRight[j].key)
+	    ++j;
+	else
+	{
+	    const unsigned long key = pLeft[i].key;
+	    size_t jEnd = j;
+	    while((jEnd < nRight) && (pRight[jEnd].key == key))
+		++jEnd;
+	    for(; (i < nLeft) && (pLeft[i].key == key); ++i)
+		for(size_t k = j; k < jEnd; ++k)
+		    sum += pLeft[i].value ^ pRight[k].value;
+	    j = jEnd;
+	}
+    }
+
+    return sum;
+}
+
+static unsigned long sortGroup(Record *pArray, size_t n)
+{
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	pArray, n, compareUnsignedLong);
+
+    unsigned long sum = 0;
+    for(size_t i = 0; i < n;)
+    {
+	size_t j = i + 1;
+	while((j < n) && (pArray[j].key == pArray[i].key))
+	    ++j;
+	sum += pArray[i].key * (j - i);
+	i = j;
+    }
+
+    return sum;
+}
+
+static void fill(Record *pRecord, size_t n, unsigned long nKeys)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+	pRecord[i].key = (unsigned long)(random64() % nKeys);
+	pRecord[i].value = (unsigned long)random64();
+    }
+}
+
+static void run(size_t nLeft, size_t nRight, unsigned long nKeys)
+{
+    Record *pLeft = new Record[nLeft];
+    Record *pRight = new Record[nRight];
+    Record *pLeftCopy = new Record[nLeft];
+    Record *pRightCopy = new Record[nRight];
+    fill(pLeft, nLeft, nKeys);
+    fill(pRight, nRight, nKeys);
+
+    printf("join %lu x %lu records, %lu distinct keys\n",
+	   (unsigned long)nLeft, (unsigned long)nRight, nKeys);
+
+    memcpy(pLeftCopy, pLeft, nLeft * sizeof(Record));
+    memcpy(pRightCopy, pRight, nRight * sizeof(Record));
+    double start = now();
+    const unsigned long expected =
+	sortMergeJoin(pLeftCopy, nLeft, pRightCopy, nRight);
+    printf("  %-24s %8.1f ms\n", "qsort + merge", (now() - start) * 1e3);
+
+    static const unsigned threads[] = {1, 2, 4, 8};
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+	static Totals totals;
+	memset(&totals, 0, sizeof(totals));
+	start = now();
+	hashJoin<Record, Record, unsigned long, Totals,
+	    offsetof(Record, key), offsetof(Record, key)>(
+		pLeft, nLeft, pRight, nRight, hashUnsignedLong,
+		compareUnsignedLong, emitPair, &totals, threads[t]);
+	const double elapsed = now() - start;
+	printf("  hashJoin, %u threads %8s %8.1f ms%s\n", threads[t], "",
+	       elapsed * 1e3, total(&totals) == expected ? "" : " MISMATCH");
+    }
+
+    printf("group %lu records, %lu distinct keys\n",
+	   (unsigned long)nRight, nKeys);
+    memcpy(pRightCopy, pRight, nRight * sizeof(Record));
+    start = now();
+    const unsigned long expectedGroups = sortGroup(pRightCopy, nRight);
+    printf("  %-24s %8.1f ms\n", "qsort + scan", (now() - start) * 1e3);
+
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+	static Totals totals;
+	memset(&totals, 0, sizeof(totals));
+	start = now();
+	hashGroup<Record, unsigned long, Totals, offsetof(Record, key)>(
+	    pRight, nRight, hashUnsignedLong, compareUnsignedLong, emitGroup,
+	    &totals, threads[t]);
+	const double elapsed = now() - start;
+	printf("  hashGroup, %u threads %7s %8.1f ms%s\n", threads[t], "",
+	       elapsed * 1e3,
+	       total(&totals) == expectedGroups ? "" : " MISMATCH");
+    }
+    printf("\n");
+
+    delete[] pLeft;
+    delete[] pRight;
+    delete[] pLeftCopy;
+    delete[] pRightCopy;
+}
+
+int main()
+{
+    /* a dimension table joined to a fact table, and a many to many join */
+    run(100000, 4000000, 100000);
+    run(1000000, 4000000, 4000000);
+
+    return 0;
+}
@@ -0,0 +1,385 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchHashValue.cpp - hash quality and speed benchmarks for HashValue.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Each hash backend is wrapped in a function that hashes a byte string and
+    returns the result widened to 64 bits.  HashValue is the library's hash;
+    the others are well known reference functions that are only here so that
+    there is something to compare the numbers against.
+
+    Quality measures:
+      stuck bits - the number of output bits that never change across the
+        sequential integer key set.
+      avalanche - flipping a single input bit should flip each output bit with
+        probability 1/2.  We report the mean and worst deviation from 1/2 over
+        all (input bit, output bit) pairs.
+      bit independence - for a single input bit flip, the flips of any two
+        output bits should be uncorrelated.  We report the worst absolute
+        correlation over all (input bit, output bit pair) triples.
+      chi-square - keys are distributed over a power-of-two bucket table,
+        using either the low bits (as a masking hash table would) or the high
+        bits of the output.  We report the statistic as a z-score; values
+        much beyond 3 mean the distribution is visibly non-uniform.
+
+    Speed is reported in MB/s across a range of input sizes.
+
+    Everything is seeded, so runs are repeatable.
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "HashValue.h"
+
+using namespace phoenix4cpp;
+
+typedef unsigned long long (*HashFunction)(const void *p, size_t length);
+
+struct Backend
+{
+    const char *pName;
+    HashFunction hashFunction;
+};
+
+static unsigned long long hashHashValue(const void *p, size_t length)
+{
+    HashValue hashValue;
+    hashValue.blend(p, length);
+    return hashValue.get64();
+}
+
+static unsigned long long hashFnv1a(const void *p, size_t length)
+{
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    for(const unsigned char *pC = (const unsigned char *)p; length;
+	++pC, --length)
+    {
+	h ^= *pC;
+	h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static inline unsigned long long fmix64(unsigned long long h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+static unsigned long long hashMultiplyMix(const void *p, size_t length)
+{
+    const unsigned char *pC = (const unsigned char *)p;
+    unsigned long long h = 0x9e3779b97f4a7c15ULL ^ length;
+    unsigned long long w;
+
+    for(; length >= sizeof(w); pC += sizeof(w), length -= sizeof(w))
+    {
+	memcpy(&w, pC, sizeof(w));
+	h = (h ^ fmix64(w)) * 0x9e3779b97f4a7c15ULL;
+	h = (h << 31) | (h >> 33);
+    }
+
+    if (length)
+    {
+	w = 0;
+	memcpy(&w, pC, length);
+	h ^= fmix64(w);
+    }
+
+    return fmix64(h);
+}
+
+static const Backend backends[] =
+{
+    {"HashValue", hashHashValue},
+    {"fnv1a64", hashFnv1a},
+    {"multiplymix", hashMultiplyMix},
+};
+
+#define N_BACKENDS (sizeof(backends) / sizeof(backends[0]))
+
+
+/*
+  Repeatable 64-bit pseudo-random numbers; rand() doesn't provide enough
+  bits.
+ */
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned stuckBits(const Backend *pBackend)
+{
+    unsigned long long allOr = 0;
+    unsigned long long allAnd = ~0ULL;
+
+    for(unsigned long i = 0; i < 65536; ++i)
+    {
+	unsigned long long h = (*pBackend->hashFunction)(&i, sizeof(i));
+	allOr |= h;
+	allAnd &= h;
+    }
+
+    unsigned long long varying = allOr & ~allAnd;
+    unsigned count = 0;
+    for(unsigned bit = 0; bit < 64; ++bit)
+	if (!(varying & (1ULL << bit)))
+	    ++count;
+    return count;
+}
+
+#define KEY_BITS 64
+#define AVALANCHE_SAMPLES 2000
+#define BIC_SAMPLES 500
+
+static void avalanche(const Backend *pBackend, double *pMean, double *pWorst)
+{
+    static unsigned flips[KEY_BITS][64];
+    memset(flips, 0, sizeof(flips));
+
+    for(unsigned s = 0; s < AVALANCHE_SAMPLES; ++s)
+    {
+	unsigned long long key = random64();
+	unsigned long long h = (*pBackend->hashFunction)(&key, sizeof(key));
+
+	for(unsigned i = 0; i < KEY_BITS; ++i)
+	{
+	    unsigned long long flipped = key ^ (1ULL << i);
+	    unsigned long long d =
+		h ^ (*pBackend->hashFunction)(&flipped, sizeof(flipped));
+	    for(unsigned j = 0; j < 64; ++j)
+		flips[i][j] += (unsigned)((d >> j) & 1);
+	}
+    }
+
+    double sum = 0;
+    double worst = 0;
+    for(unsigned i = 0; i < KEY_BITS; ++i)
+    {
+	for(unsigned j = 0; j < 64; ++j)
+	{
+	    double bias = fabs(
+		(double)flips[i][j] / AVALANCHE_SAMPLES - 0.5);
+	    sum += bias;
+	    if (bias > worst)
+		worst = bias;
+	}
+    }
+
+    *pMean = sum / (KEY_BITS * 64);
+    *pWorst = worst;
+}
+
+static double bitIndependence(const Backend *pBackend)
+{
+    static unsigned single[KEY_BITS][64];
+    static unsigned pair[KEY_BITS][64][64];
+    memset(single, 0, sizeof(single));
+    memset(pair, 0, sizeof(pair));
+
+    for(unsigned s = 0; s < BIC_SAMPLES; ++s)
+    {
+	unsigned long long key = random64();
+	unsigned long long h = (*pBackend->hashFunction)(&key, sizeof(key));
+
+	for(unsigned i = 0; i < KEY_BITS; ++i)
+	{
+	    unsigned long long flipped = key ^ (1ULL << i);
+	    unsigned long long d =
+		h ^ (*pBackend->hashFunction)(&flipped, sizeof(flipped));
+	    for(unsigned j = 0; j < 64; ++j)
+	    {
+		if (!((d >> j) & 1))
+		    continue;
+		++single[i][j];
+		for(unsigned k = j + 1; k < 64; ++k)
+		    pair[i][j][k] += (unsigned)((d >> k) & 1);
+	    }
+	}
+    }
+
+    /*
+      Pearson correlation of two 0/1 variables over BIC_SAMPLES trials.  An
+      output bit that never (or always) flips has no variance; we count that
+      as fully correlated, since it carries no information about the input.
+     */
+    double worst = 0;
+    for(unsigned i = 0; i < KEY_BITS; ++i)
+    {
+	for(unsigned j = 0; j < 64; ++j)
+	{
+	    double pj = (double)single[i][j] / BIC_SAMPLES;
+	    for(unsigned k = j + 1; k < 64; ++k)
+	    {
+		double pk = (double)single[i][k] / BIC_SAMPLES;
+		double variance = pj * (1 - pj) * pk * (1 - pk);
+		double r = 1;
+		if (variance > 0)
+		    r = fabs(((double)pair[i][j][k] / BIC_SAMPLES - pj * pk) /
+			     sqrt(variance));
+		if (r > worst)
+		    worst = r;
+	    }
+	}
+    }
+
+    return worst;
+}
+
+#define CHI_KEYS (1UL << 20)
+#define CHI_BUCKET_BITS 16
+#define CHI_BUCKETS (1UL << CHI_BUCKET_BITS)
+
+enum KeyShape
+{
+    SEQUENTIAL,
+    SPARSE,
+    STRING
+};
+
+static const char *const keyShapeNames[] =
+{
+    "sequential",
+    "sparse",
+    "string",
+};
+
+static void chiSquare(const Backend *pBackend, KeyShape shape,
+		      double *pLowZ, double *pHighZ)
+{
+    static unsigned low[CHI_BUCKETS];
+    static unsigned high[CHI_BUCKETS];
+    memset(low, 0, sizeof(low));
+    memset(high, 0, sizeof(high));
+
+    for(unsigned long i = 0; i < CHI_KEYS; ++i)
+    {
+	unsigned long long h;
+	if (shape == STRING)
+	{
+	    char buf[32];
+	    int length = snprintf(buf, sizeof(buf), "user%lu", i);
+	    h = (*pBackend->hashFunction)(buf, length);
+	}
+	else
+	{
+	    unsigned long key = (shape == SEQUENTIAL ? i : i << 16);
+	    h = (*pBackend->hashFunction)(&key, sizeof(key));
+	}
+
+	++low[h & (CHI_BUCKETS - 1)];
+	++high[h >> (64 - CHI_BUCKET_BITS)];
+    }
+
+    const double expected = (double)CHI_KEYS / CHI_BUCKETS;
+    const double df = CHI_BUCKETS - 1;
+    double lowChi = 0;
+    double highChi = 0;
+    for(unsigned long b = 0; b < CHI_BUCKETS; ++b)
+    {
+	lowChi += (low[b] - expected) * (low[b] - expected) / expected;
+	highChi += (high[b] - expected) * (high[b] - expected) / expected;
+    }
+
+    *pLowZ = (lowChi - df) / sqrt(2 * df);
+    *pHighZ = (highChi - df) / sqrt(2 * df);
+}
+
+static volatile unsigned long long sink;
+
+static double throughput(const Backend *pBackend, size_t length)
+{
+    static unsigned char buf[4096];
+    for(size_t i = 0; i < sizeof(buf); ++i)
+	buf[i] = (unsigned char)random64();
+
+    /* hash about 64MB per measurement, but at least some iterations */
+    size_t iterations = (64UL << 20) / length;
+    unsigned long long acc = 0;
+
+    double start = now();
+    for(size_t i = 0; i < iterations; ++i)
+    {
+	buf[0] = (unsigned char)i;
+	acc ^= (*pBackend->hashFunction)(buf, length);
+    }
+    double elapsed = now() - start;
+    sink = acc;
+
+    return (double)iterations * length / elapsed / (1 << 20);
+}
+
+int main()
+{
+    printf("%-12s %6s %10s %10s %10s\n",
+	   "backend", "stuck", "aval-mean", "aval-worst", "bic-worst");
+    for(size_t b = 0; b < N_BACKENDS; ++b)
+    {
+	double mean;
+	double worst;
+	avalanche(&backends[b], &mean, &worst);
+	printf("%-12s %6u %10.4f %10.4f %10.4f\n",
+	       backends[b].pName, stuckBits(&backends[b]), mean, worst,
+	       bitIndependence(&backends[b]));
+    }
+
+    printf("\nchi-square z-scores, %lu keys into %lu buckets\n",
+	   CHI_KEYS, CHI_BUCKETS);
+    printf("%-12s %-10s %12s %12s\n", "backend", "keys", "low-bits",
+	   "high-bits");
+    for(size_t b = 0; b < N_BACKENDS; ++b)
+    {
+	for(unsigned shape = SEQUENTIAL; shape <= STRING; ++shape)
+	{
+	    double lowZ;
+	    double highZ;
+	    chiSquare(&backends[b], (KeyShape)shape, &lowZ, &highZ);
+	    printf("%-12s %-10s %12.2f %12.2f\n", backends[b].pName,
+		   keyShapeNames[shape], lowZ, highZ);
+	}
+    }
+
+    static const size_t lengths[] = {4, 8, 16, 32, 64, 256, 1024, 4096};
+    printf("\nthroughput, MB/s\n");
+    printf("%-12s", "backend");
+    for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+	printf(" %8lu", (unsigned long)lengths[l]);
+    printf("\n");
+    for(size_t b = 0; b < N_BACKENDS; ++b)
+    {
+	printf("%-12s", backends[b].pName);
+	for(size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); ++l)
+	    printf(" %8.0f", throughput(&backends[b], lengths[l]));
+	printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchLockFreeLinked.cpp - multiple producer throughput of MpscQueue and
+    LockFreeStack, compared with a DoublyLinkedList under a mutex
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    For the queues, each producer pushes its own preallocated messages
+    while a single consumer pops until it has seen all of them; the time
+    is from starting the threads until the consumer is done.
+
+    For the stacks, every thread pops an element and pushes it back, over
+    and over, on a stack that starts with a few elements for each thread.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+
+#include "DoublyLinked.h"
+#include "LockFreeLinked.h"
+
+using namespace phoenix4cpp;
+
+#define N_MESSAGES 2000000
+#define N_STACK_OPS 2000000
+#define MAX_THREADS 8
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct Message
+{
+    unsigned long value;
+    LockFreeMembership link;
+    DoublyLinkedMembership listLink;
+};
+
+typedef MpscQueue<Message, offsetof(Message, link)> Queue;
+typedef LockFreeStack<Message, offsetof(Message, link)> Stack;
+typedef DoublyLinkedList<Message, offsetof(Message, listLink)> List;
+
+/* the existing approach:  a list and a mutex */
+struct LockedList
+{
+    pthread_mutex_t mutex;
+    List list;
+
+    LockedList()
+    {
+	pthread_mutex_init(&mutex, NULL);
+    }
+
+    ~LockedList()
+    {
+	/* the messages belong to the benchmark */
+	Message *pMessage;
+	while((pMessage = list.getFirst()))
+	    list.remove(pMessage);
+	pthread_mutex_destroy(&mutex);
+    }
+
+    void push(Message *pMessage)
+    {
+	pthread_mutex_lock(&mutex);
+	list.append(pMessage);
+	pthread_mutex_unlock(&mutex);
+    }
+
+    Message *pop()
+    {
+	pthread_mutex_lock(&mutex);
+	Message *pMessage = list.getFirst();
+	if (pMessage)
+	    list.remove(pMessage);
+	pthread_mutex_unlock(&mutex);
+	return pMessage;
+    }
+};
+
+template<class Q>
+struct Producer
+{
+    Q *pQueue;
+    Message *pMessage;
+    size_t n;
+};
+
+template<class Q>
+static void *produce(void *pArg)
+{
+    Producer<Q> *pProducer = (Producer<Q> *)pArg;
+    for(size_t i = 0; i < pProducer->n; ++i)
+	pProducer->pQueue->push(&pProducer->pMessage[i]);
+    return NULL;
+}
+
+template<class Q>
+static double benchQueue(unsigned nProducers, Message *pMessage)
+{
+    Q queue;
+    Producer<Q> producer[MAX_THREADS];
+    pthread_t thread[MAX_THREADS];
+    const size_t perProducer = N_MESSAGES / nProducers;
+
+    const double start = now();
+    for(unsigned p = 0; p < nProducers; ++p)
+    {
+	producer[p].pQueue = &queue;
+	producer[p].pMessage = pMessage + p * perProducer;
+	producer[p].n = perProducer;
+	pthread_create(&thread[p], NULL, produce<Q>, &producer[p]);
+    }
+
+    unsigned long sum = 0;
+    for(size_t received = 0; received < perProducer * nProducers;)
+    {
+	Message *pReceived = queue.pop();
+	if (pReceived)
+	{
+	    sum += pReceived->value;
+	    ++received;
+	}
+    }
+    const double elapsed = now() - start;
+
+    for(unsigned p = 0; p < nProducers; ++p)
+	pthread_join(thread[p], NULL);
+
+    if (sum != (unsigned long)perProducer * nProducers)
+	fprintf(stderr, "queue lost messages\n");
+    return perProducer * nProducers / elapsed / 1e6;
+}
+
+template<class S>
+struct Churner
+{
+    S *pStack;
+    size_t n;
+};
+
+template<class S>
+static void *churn(void *pArg)
+{
+    Churner<S> *pChurner = (Churner<S> *)pArg;
+    for(size_t i = 0; i < pChurner->n; ++i)
+    {
+	Message *pMessage = pChurner->pStack->pop();
+	if (pMessage)
+	    pChurner->pStack->push(pMessage);
+    }
+    return NULL;
+}
+
+template<class S>
+static double benchStack(unsigned nThreads, Message *pMessage)
+{
+    S stack;
+    for(unsigned i = 0; i < 4 * nThreads; ++i)
+	stack.push(&pMessage[i]);
+
+    Churner<S> churner[MAX_THREADS];
+    pthread_t thread[MAX_THREADS];
+    const size_t perThread = N_STACK_OPS / nThreads;
+
+    const double start = now();
+    for(unsigned t = 0; t < nThreads; ++t)
+    {
+	churner[t].pStack = &stack;
+	churner[t].n = perThread;
+	pthread_create(&thread[t], NULL, churn<S>, &churner[t]);
+    }
+    for(unsigned t = 0; t < nThreads; ++t)
+	pthread_join(thread[t], NULL);
+    const double elapsed = now() - start;
+
+    while(stack.pop())
+	;
+    return perThread * nThreads / elapsed / 1e6;
+}
+
+int main()
+{
+    Message *pMessage = new Message[N_MESSAGES];
+    for(size_t i = 0; i < N_MESSAGES; ++i)
+	pMessage[i].value = 1;
+
+    static const unsigned threads[] = {1, 2, 4, 8};
+    printf("million messages per second, %d messages\n", N_MESSAGES);
+    printf("  %-10s %12s %12s\n", "producers", "MpscQueue", "mutex+list");
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+	const double lockFree = benchQueue<Queue>(threads[t], pMessage);
+	const double locked = benchQueue<LockedList>(threads[t], pMessage);
+	printf("  %-10u %12.2f %12.2f\n", threads[t], lockFree, locked);
+    }
+
+    printf("million pop/push pairs per second\n");
+    printf("  %-10s %12s %12s\n", "threads", "LockFreeStack", "mutex+list");
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+	const double lockFree = benchStack<Stack>(threads[t], pMessage);
+	const double locked = benchStack<LockedList>(threads[t], pMessage);
+	printf("  %-10u %12.2f %12.2f\n", threads[t], lockFree, locked);
+    }
+
+    delete[] pMessage;
+    return 0;
+}
@@ -0,0 +1,197 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchLruCache.cpp - hit path latency and hit ratios for LruCache.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The hit path is timed by looking up keys that are all in the cache, in
+    a random order, for each policy, against a plain IntrusiveHashTable
+    lookup as the floor.  The sharded cache is timed the same way, with
+    its locking included.
+
+    Hit ratios are measured on a skewed workload, where key i is drawn
+    with probability roughly proportional to 1/i, mixed with occasional
+    scans of keys that are never seen again.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "Hashable.h"
+#include "IntrusiveHash.h"
+#include "LruCache.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+struct Entry
+{
+    unsigned long key;
+    unsigned long value;
+    LruCacheMembership membership;
+    IntrusiveHashMembership hashMembership;
+
+    Entry(unsigned long k):
+	key(k),
+	value(k)
+    {
+    }
+};
+
+typedef LruCache<Entry, offsetof(Entry, membership)> Cache;
+typedef ShardedLruCache<Entry, offsetof(Entry, membership)> Sharded;
+typedef IntrusiveHashTable<Entry, offsetof(Entry, hashMembership)> Table;
+
+static const char *const policyName[] = {"LRU", "CLOCK", "SIEVE"};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+static void visit(unsigned long *pSum, Entry *pEntry)
+{
+    *pSum += pEntry->value;
+}
+
+#define N_LOOKUPS 4000000
+
+static void benchHits(size_t nEntries)
+{
+    unsigned long *pKey = new unsigned long[N_LOOKUPS];
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	pKey[i] = random64() % nEntries;
+
+    printf("hits on %lu entries, ns per lookup\n", (unsigned long)nEntries);
+
+    {
+	Table table(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, nEntries);
+	for(unsigned long k = 0; k < nEntries; ++k)
+	    table.add(new Entry(k));
+
+	unsigned long sum = 0;
+	const double start = now();
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	{
+	    HashableUnsignedLong key(pKey[i]);
+	    sum += table.find(&key)->value;
+	}
+	const double elapsed = now() - start;
+	sink = sum;
+	printf("  %-28s %6.1f\n", "IntrusiveHashTable",
+	       elapsed * 1e9 / N_LOOKUPS);
+    }
+
+    for(int p = Cache::LRU; p <= Cache::SIEVE; ++p)
+    {
+	Cache cache(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, nEntries, (Cache::Policy)p);
+	for(unsigned long k = 0; k < nEntries; ++k)
+	    cache.insert(new Entry(k));
+
+	unsigned long sum = 0;
+	const double start = now();
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	{
+	    HashableUnsignedLong key(pKey[i]);
+	    sum += cache.find(&key)->value;
+	}
+	const double elapsed = now() - start;
+	sink = sum;
+	printf("  LruCache, %-18s %6.1f\n", policyName[p],
+	       elapsed * 1e9 / N_LOOKUPS);
+    }
+
+    for(int p = Cache::LRU; p <= Cache::SIEVE; ++p)
+    {
+	Sharded cache(offsetof(Entry, key), hashUnsignedLong,
+		      compareUnsignedLong, nEntries, (Cache::Policy)p, 16);
+	for(unsigned long k = 0; k < nEntries; ++k)
+	    cache.insert(new Entry(k));
+
+	unsigned long sum = 0;
+	const double start = now();
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	{
+	    HashableUnsignedLong key(pKey[i]);
+	    cache.find(&key, visit, &sum);
+	}
+	const double elapsed = now() - start;
+	sink = sum;
+	printf("  ShardedLruCache, %-11s %6.1f\n", policyName[p],
+	       elapsed * 1e9 / N_LOOKUPS);
+    }
+
+    delete[] pKey;
+}
+
+#define N_KEYS 1000000
+
+static unsigned long skewedKey()
+{
+    /* roughly 1/i, from the reciprocal of a uniform draw */
+    return N_KEYS / (1 + random64() % N_KEYS) - 1;
+}
+
+static void benchHitRatio(size_t capacity)
+{
+    printf("hit ratio, capacity %lu, %lu keys\n", (unsigned long)capacity,
+	   (unsigned long)N_KEYS);
+
+    for(int p = Cache::LRU; p <= Cache::SIEVE; ++p)
+    {
+	Cache cache(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, capacity, (Cache::Policy)p);
+
+	unsigned long scanKey = N_KEYS;
+	unsigned long hits = 0;
+	unsigned long lookups = 0;
+	for(unsigned long i = 0; i < N_LOOKUPS; ++i)
+	{
+	    /* every so often, a scan of one-time keys */
+	    const bool scan = (i % 100000) < 5000;
+	    const unsigned long k = scan ? scanKey++ : skewedKey();
+	    HashableUnsignedLong key(k);
+	    ++lookups;
+	    if (cache.find(&key))
+		++hits;
+	    else
+		cache.insert(new Entry(k));
+	}
+	printf("  %-28s %6.2f%%\n", policyName[p], hits * 100.0 / lookups);
+    }
+}
+
+int main()
+{
+    benchHits(10000);
+    benchHits(1000000);
+    benchHitRatio(1000);
+    benchHitRatio(10000);
+
+    return 0;
+}
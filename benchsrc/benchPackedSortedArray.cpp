@@ -0,0 +1,131 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchPackedSortedArray.cpp - PackedSortedArray compared with a plain
+      sorted array
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Sixteen million identifiers, with gaps averaging a thousand, are kept
+    both in a plain sorted array and in a PackedSortedArray.  The memory
+    used by each is reported, and then the time taken for a million
+    lookups, half of them for identifiers that are present, and for a scan
+    of all of the values.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "PackedSortedArray.h"
+#include "bsearch.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define N_VALUES (16 << 20)
+#define N_LOOKUPS (1 << 20)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+static unsigned long values[N_VALUES];
+static unsigned long lookups[N_LOOKUPS];
+
+int main()
+{
+    /* even identifiers are present, odd ones are not */
+    unsigned long id = 1000000;
+    for(size_t i = 0; i < N_VALUES; ++i)
+    {
+	values[i] = id;
+	id += 2 * (1 + random64() % 1000);
+    }
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	lookups[i] = values[random64() % N_VALUES] + (i & 1);
+
+    double start = now();
+    PackedSortedArray packed(values, N_VALUES);
+    const double build = now() - start;
+
+    printf("%d values, gaps averaging 1000\n", N_VALUES);
+    printf("  memory:  array %7.1f MB  packed %7.1f MB (%.1f bits each)"
+	   "  built in %.1f ms\n",
+	   N_VALUES * sizeof(unsigned long) / 1048576.0,
+	   packed.getBytes() / 1048576.0,
+	   packed.getBytes() * 8.0 / N_VALUES, build * 1e3);
+
+    start = now();
+    unsigned long found = 0;
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	found += bsearch<unsigned long, unsigned long, 0>(
+	    &lookups[i], values, N_VALUES, compareUnsignedLong) != NULL;
+    const double arrayLookup = now() - start;
+    sink = found;
+
+    start = now();
+    found = 0;
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	found += packed.contains(lookups[i]);
+    const double packedLookup = now() - start;
+    sink = found;
+
+    printf("  lookup:  array %7.1f ns  packed %7.1f ns\n",
+	   arrayLookup * 1e9 / N_LOOKUPS, packedLookup * 1e9 / N_LOOKUPS);
+
+    start = now();
+    unsigned long sum = 0;
+    for(size_t i = 0; i < N_VALUES; ++i)
+	sum += values[i];
+    const double arrayScan = now() - start;
+    sink = sum;
+
+    start = now();
+    sum = 0;
+    PackedSortedArrayCursor cursor(&packed);
+    unsigned long value;
+    while(cursor.next(&value))
+	sum += value;
+    const double cursorScan = now() - start;
+    sink = sum;
+
+    start = now();
+    sum = 0;
+    unsigned long block[PackedSortedArray::blockValues];
+    for(size_t b = 0; b < packed.getBlockCount(); ++b)
+    {
+	const size_t n = packed.decodeBlock(b, block);
+	for(size_t i = 0; i < n; ++i)
+	    sum += block[i];
+    }
+    const double blockScan = now() - start;
+    sink = sum;
+
+    printf("  scan:    array %7.2f ns  cursor %7.2f ns  decodeBlock %7.2f ns"
+	   "  per value\n", arrayScan * 1e9 / N_VALUES,
+	   cursorScan * 1e9 / N_VALUES, blockScan * 1e9 / N_VALUES);
+
+    return 0;
+}
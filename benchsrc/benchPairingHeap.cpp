@@ -0,0 +1,314 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchPairingHeap.cpp - PairingHeap and the 4-ary heap in heap.h compared
+    with std::priority_queue
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The first workload pushes a million random keys and pops them all.
+
+    The second is a scheduler:  a million tasks are queued, and then tasks
+    are picked at random to have their deadlines moved earlier, with a pop
+    after every few of those, until the queue is empty.  PairingHeap does
+    that with decreaseKey().  The array heaps can't find a task to move it,
+    so they push a new entry for it instead, and skip entries that are out
+    of date as they are popped; that is the usual way to use
+    std::priority_queue for this.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "PairingHeap.h"
+#include "compare.h"
+#include "heap.h"
+
+using namespace phoenix4cpp;
+
+#define N_TASKS 1000000
+#define N_DECREASES 4000000
+#define POP_EVERY 4
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Task
+{
+    unsigned long deadline;
+    bool queued;
+    PairingHeapMembership link;
+};
+
+typedef PairingHeap<Task, offsetof(Task, link)> Heap;
+
+/* an array heap entry; stale if it doesn't match its task any more */
+struct Entry
+{
+    unsigned long deadline;
+    Task *pTask;
+
+    bool operator>(const Entry &r) const
+    {
+	return deadline > r.deadline;
+    }
+};
+
+typedef std::priority_queue<Entry, std::vector<Entry>,
+			    std::greater<Entry> > StdQueue;
+
+/* the deadlines for both workloads, so that every queue sees the same */
+static unsigned long *pInitial;
+static unsigned *pPick;
+static unsigned long *pDecrease;
+
+static void reset(Task *pTask)
+{
+    for(size_t i = 0; i < N_TASKS; ++i)
+    {
+	pTask[i].deadline = pInitial[i];
+	pTask[i].queued = true;
+    }
+}
+
+static double pushPopPairing(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    Heap heap(offsetof(Task, deadline), compareUnsignedLong);
+    for(size_t i = 0; i < N_TASKS; ++i)
+	heap.push(&pTask[i]);
+    unsigned long sum = 0;
+    Task *pTop;
+    while((pTop = heap.pop()))
+	sum += pTop->deadline;
+    sink = sum;
+    return now() - start;
+}
+
+static double pushPopArray(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    Entry *pEntry = new Entry[N_TASKS];
+    for(size_t i = 0; i < N_TASKS; ++i)
+    {
+	pEntry[i].deadline = pTask[i].deadline;
+	pEntry[i].pTask = &pTask[i];
+	pushHeap<Entry, unsigned long, offsetof(Entry, deadline)>(
+	    pEntry, i + 1, compareUnsignedLong);
+    }
+    unsigned long sum = 0;
+    for(size_t n = N_TASKS; n; --n)
+    {
+	popHeap<Entry, unsigned long, offsetof(Entry, deadline)>(
+	    pEntry, n, compareUnsignedLong);
+	sum += pEntry[n - 1].deadline;
+    }
+    sink = sum;
+    delete[] pEntry;
+    return now() - start;
+}
+
+static double pushPopStd(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    StdQueue queue;
+    for(size_t i = 0; i < N_TASKS; ++i)
+    {
+	Entry entry;
+	entry.deadline = pTask[i].deadline;
+	entry.pTask = &pTask[i];
+	queue.push(entry);
+    }
+    unsigned long sum = 0;
+    while(!queue.empty())
+    {
+	sum += queue.top().deadline;
+	queue.pop();
+    }
+    sink = sum;
+    return now() - start;
+}
+
+/* move a task's deadline earlier; returns false if it isn't queued */
+static bool decrease(Task *pTask, size_t i)
+{
+    Task *pT = &pTask[pPick[i]];
+    if (!pT->queued)
+	return false;
+    pT->deadline -= pDecrease[i] % (pT->deadline + 1);
+    return true;
+}
+
+static double schedulePairing(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    Heap heap(offsetof(Task, deadline), compareUnsignedLong);
+    for(size_t i = 0; i < N_TASKS; ++i)
+	heap.push(&pTask[i]);
+
+    unsigned long sum = 0;
+    for(size_t i = 0; !heap.isEmpty(); ++i)
+    {
+	if ((i < N_DECREASES) && decrease(pTask, i))
+	    heap.decreaseKey(&pTask[pPick[i]]);
+	if ((i >= N_DECREASES) || !(i % POP_EVERY))
+	{
+	    Task *pTop = heap.pop();
+	    pTop->queued = false;
+	    sum += pTop->deadline;
+	}
+    }
+    sink = sum;
+    return now() - start;
+}
+
+static double scheduleArray(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    size_t capacity = N_TASKS + N_DECREASES;
+    Entry *pEntry = new Entry[capacity];
+    size_t n = 0;
+    for(; n < N_TASKS; ++n)
+    {
+	pEntry[n].deadline = pTask[n].deadline;
+	pEntry[n].pTask = &pTask[n];
+    }
+    makeHeap<Entry, unsigned long, offsetof(Entry, deadline)>(
+	pEntry, n, compareUnsignedLong);
+
+    unsigned long sum = 0;
+    for(size_t i = 0; n; ++i)
+    {
+	if ((i < N_DECREASES) && decrease(pTask, i))
+	{
+	    pEntry[n].deadline = pTask[pPick[i]].deadline;
+	    pEntry[n].pTask = &pTask[pPick[i]];
+	    ++n;
+	    pushHeap<Entry, unsigned long, offsetof(Entry, deadline)>(
+		pEntry, n, compareUnsignedLong);
+	}
+	if ((i >= N_DECREASES) || !(i % POP_EVERY))
+	{
+	    while(n)
+	    {
+		popHeap<Entry, unsigned long, offsetof(Entry, deadline)>(
+		    pEntry, n, compareUnsignedLong);
+		const Entry *pTop = &pEntry[--n];
+		if (pTop->pTask->queued &&
+		    (pTop->deadline == pTop->pTask->deadline))
+		{
+		    pTop->pTask->queued = false;
+		    sum += pTop->deadline;
+		    break;
+		}
+	    }
+	}
+    }
+    sink = sum;
+    delete[] pEntry;
+    return now() - start;
+}
+
+static double scheduleStd(Task *pTask)
+{
+    reset(pTask);
+    const double start = now();
+    std::vector<Entry> initial(N_TASKS);
+    for(size_t i = 0; i < N_TASKS; ++i)
+    {
+	initial[i].deadline = pTask[i].deadline;
+	initial[i].pTask = &pTask[i];
+    }
+    StdQueue queue(std::greater<Entry>(), initial);
+
+    unsigned long sum = 0;
+    for(size_t i = 0; !queue.empty(); ++i)
+    {
+	if ((i < N_DECREASES) && decrease(pTask, i))
+	{
+	    Entry entry;
+	    entry.deadline = pTask[pPick[i]].deadline;
+	    entry.pTask = &pTask[pPick[i]];
+	    queue.push(entry);
+	}
+	if ((i >= N_DECREASES) || !(i % POP_EVERY))
+	{
+	    while(!queue.empty())
+	    {
+		const Entry top = queue.top();
+		queue.pop();
+		if (top.pTask->queued && (top.deadline == top.pTask->deadline))
+		{
+		    top.pTask->queued = false;
+		    sum += top.deadline;
+		    break;
+		}
+	    }
+	}
+    }
+    sink = sum;
+    return now() - start;
+}
+
+int main()
+{
+    pInitial = new unsigned long[N_TASKS];
+    for(size_t i = 0; i < N_TASKS; ++i)
+	pInitial[i] = (unsigned long)(random64() % 1000000000);
+    pPick = new unsigned[N_DECREASES];
+    pDecrease = new unsigned long[N_DECREASES];
+    for(size_t i = 0; i < N_DECREASES; ++i)
+    {
+	pPick[i] = (unsigned)(random64() % N_TASKS);
+	pDecrease[i] = (unsigned long)random64();
+    }
+    Task *pTask = new Task[N_TASKS];
+
+    printf("push %d, then pop them all\n", N_TASKS);
+    printf("  PairingHeap          %8.1f ms\n", pushPopPairing(pTask) * 1e3);
+    printf("  heap.h 4-ary         %8.1f ms\n", pushPopArray(pTask) * 1e3);
+    printf("  std::priority_queue  %8.1f ms\n", pushPopStd(pTask) * 1e3);
+
+    printf("%d tasks, %d decrease-keys, a pop every %d\n",
+	   N_TASKS, N_DECREASES, POP_EVERY);
+    printf("  PairingHeap          %8.1f ms\n", schedulePairing(pTask) * 1e3);
+    printf("  heap.h 4-ary         %8.1f ms\n", scheduleArray(pTask) * 1e3);
+    printf("  std::priority_queue  %8.1f ms\n", scheduleStd(pTask) * 1e3);
+
+    delete[] pTask;
+    delete[] pDecrease;
+    delete[] pPick;
+    delete[] pInitial;
+    return 0;
+}
@@ -0,0 +1,149 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchPerfectHash.cpp - build time, size, and lookup speed for
+    PerfectHash.h, compared with bsearch()
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The same static table of (key, value) records is searched two ways:
+    sorted by key with bsearch(), and arranged so that each record is at the
+    position the perfect hash function gives its key, with one comparison
+    to confirm the match.  Both include the cost of the key lookup in the
+    table; the perfect hash lookups also include hashing the key.  Lookups
+    are in random order, for keys that are all present.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "HashValue.h"
+#include "Hashable.h"
+#include "PerfectHash.h"
+#include "bsearch.h"
+#include "compare.h"
+#include "qsort.h"
+
+using namespace phoenix4cpp;
+
+#define N_LOOKUPS 4000000
+
+struct Record
+{
+    unsigned long key;
+    unsigned long value;
+};
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static unsigned long long hashOf(unsigned long k)
+{
+    HashValue hashValue;
+    HashableUnsignedLong key(k);
+    key.hash(&hashValue);
+    return hashValue.get64();
+}
+
+static volatile unsigned long sink;
+
+static void run(size_t n)
+{
+    Record *pRecord = new Record[n];
+    unsigned long long *pHash = new unsigned long long[n];
+    for(size_t i = 0; i < n; ++i)
+    {
+	pRecord[i].key = (unsigned long)random64();
+	pRecord[i].value = i;
+	pHash[i] = hashOf(pRecord[i].key);
+    }
+
+    unsigned long *pProbe = new unsigned long[N_LOOKUPS];
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	pProbe[i] = pRecord[random64() % n].key;
+
+    static const unsigned threads[] = {1, 2, 4, 8};
+    PerfectHash ph;
+    for(size_t t = 0; t < sizeof(threads) / sizeof(threads[0]); ++t)
+    {
+	double start = now();
+	if (!ph.buildHashes(pHash, n, threads[t]))
+	{
+	    printf("build failed\n");
+	    exit(1);
+	}
+	printf("%10lu keys, %u threads: build %8.1f ms\n",
+	       (unsigned long)n, threads[t], (now() - start) * 1e3);
+    }
+    printf("%10lu keys: %.2f bits/key\n", (unsigned long)n,
+	   ph.getSerializedSize() * 8.0 / n);
+
+    /* arrange the records by perfect hash */
+    Record *pArranged = new Record[n];
+    for(size_t i = 0; i < n; ++i)
+	pArranged[ph.lookupHash(pHash[i])] = pRecord[i];
+
+    unsigned long acc = 0;
+    double start = now();
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+    {
+	HashableUnsignedLong key(pProbe[i]);
+	const Record *pR = &pArranged[ph.lookup(&key)];
+	if (pR->key == pProbe[i])
+	    acc += pR->value;
+    }
+    const double phTime = now() - start;
+    sink = acc;
+
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	pRecord, n, compareUnsignedLong);
+    acc = 0;
+    start = now();
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+    {
+	const Record *pR = bsearch<Record, unsigned long, offsetof(Record, key)>(
+	    &pProbe[i], pRecord, n, compareUnsignedLong);
+	acc += pR->value;
+    }
+    const double bsearchTime = now() - start;
+    sink = acc;
+
+    printf("%10lu keys: lookup ns, perfect hash %6.1f, bsearch %6.1f\n\n",
+	   (unsigned long)n, phTime * 1e9 / N_LOOKUPS,
+	   bsearchTime * 1e9 / N_LOOKUPS);
+
+    delete[] pArranged;
+    delete[] pProbe;
+    delete[] pHash;
+    delete[] pRecord;
+}
+
+int main()
+{
+    static const size_t counts[] = {10000, 1000000, 10000000};
+    for(size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+	run(counts[i]);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchRoaringBitmap.cpp - RoaringBitmap compared with sorted arrays
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Pairs of sets are drawn from three distributions:  sparse values spread
+    over the whole range of unsigned, a quarter of the values below 2^24,
+    and runs of up to a thousand values separated by gaps of up to a
+    thousand.  Each set is held as a sorted array and as a RoaringBitmap,
+    and the memory used by each is reported, before and after optimize().
+
+    Intersection and union are timed with setIntersection() and setUnion()
+    on the arrays, and with andWith() and orWith() on the bitmaps; the
+    bitmap times include making a copy of the first operand, since the
+    operations are done in place.  Lookups are timed against bsearch() on
+    the array, and rank() and select() are timed at random positions.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "RoaringBitmap.h"
+#include "bsearch.h"
+#include "compare.h"
+#include "setops.h"
+
+using namespace phoenix4cpp;
+
+#define N_MAX (8 << 20)
+#define N_LOOKUPS (1 << 20)
+#define N_RANKS (1 << 16)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+static unsigned a[N_MAX];
+static unsigned b[N_MAX];
+static unsigned out[2 * N_MAX];
+static unsigned lookups[N_LOOKUPS];
+
+/* @returns the number of values, in ascending order */
+static size_t makeSet(unsigned *pSet, int distribution)
+{
+    size_t n = 0;
+    if (distribution == 0)
+    {
+	/* a million values spread over everything */
+	unsigned v = 0;
+	for(; n < (1 << 20); ++n)
+	    pSet[n] = v += 1 + random64() % 8192;
+    }
+    else if (distribution == 1)
+    {
+	for(unsigned v = 0; v < (1 << 24); ++v)
+	{
+	    if (!(random64() & 3))
+		pSet[n++] = v;
+	}
+    }
+    else
+    {
+	for(unsigned v = 0; n < (4 << 20);)
+	{
+	    const unsigned length = 1 + random64() % 1000;
+	    for(unsigned i = 0; i < length; ++i)
+		pSet[n++] = v++;
+	    v += 1 + random64() % 1000;
+	}
+    }
+    return n;
+}
+
+/* @returns the time taken by one of the operations, in microseconds */
+static double timeArrays(const unsigned *pA, size_t nA, const unsigned *pB,
+			 size_t nB, bool isUnion)
+{
+    size_t repeats = 0;
+    unsigned long total = 0;
+    const double start = now();
+    double elapsed;
+    do
+    {
+	total += isUnion ? setUnion(pA, nA, pB, nB, out) :
+	    setIntersection(pA, nA, pB, nB, out);
+	++repeats;
+    } while((elapsed = now() - start) < 0.2);
+    sink = total;
+    return elapsed * 1e6 / repeats;
+}
+
+static double timeBitmaps(const RoaringBitmap *pA, const RoaringBitmap *pB,
+			  bool isUnion)
+{
+    size_t repeats = 0;
+    unsigned long total = 0;
+    const double start = now();
+    double elapsed;
+    do
+    {
+	RoaringBitmap result;
+	result.orWith(pA);
+	if (isUnion)
+	    result.orWith(pB);
+	else
+	    result.andWith(pB);
+	total += result.getContainerCount();
+	++repeats;
+    } while((elapsed = now() - start) < 0.2);
+    sink = total;
+    return elapsed * 1e6 / repeats;
+}
+
+int main()
+{
+    static const char *const pName[] =
+    {
+	"sparse", "dense", "runs"
+    };
+
+    for(int distribution = 0; distribution < 3; ++distribution)
+    {
+	const size_t nA = makeSet(a, distribution);
+	const size_t nB = makeSet(b, distribution);
+	RoaringBitmap bitmapA;
+	RoaringBitmap bitmapB;
+	bitmapA.addArray(a, nA);
+	bitmapB.addArray(b, nB);
+
+	printf("%s, %lu values, %lu containers\n", pName[distribution],
+	       (unsigned long)nA, (unsigned long)bitmapA.getContainerCount());
+	const size_t before = bitmapA.getBytes();
+	bitmapA.optimize();
+	bitmapB.optimize();
+	printf("  memory:  array %7.2f MB  bitmap %7.2f MB"
+	       "  optimized %7.2f MB  serialized %7.2f MB\n",
+	       nA * sizeof(unsigned) / 1048576.0, before / 1048576.0,
+	       bitmapA.getBytes() / 1048576.0,
+	       bitmapA.getSerializedSize() / 1048576.0);
+
+	printf("  and:     array %9.1f us  bitmap %9.1f us\n",
+	       timeArrays(a, nA, b, nB, false),
+	       timeBitmaps(&bitmapA, &bitmapB, false));
+	printf("  or:      array %9.1f us  bitmap %9.1f us\n",
+	       timeArrays(a, nA, b, nB, true),
+	       timeBitmaps(&bitmapA, &bitmapB, true));
+
+	/* half of the lookups are for values from the other set */
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	    lookups[i] = (i & 1) ? b[random64() % nB] : a[random64() % nA];
+	double start = now();
+	unsigned long found = 0;
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	    found += bsearch<unsigned, unsigned, 0>(
+		&lookups[i], a, nA, compareUnsigned) != NULL;
+	const double arrayLookup = now() - start;
+	sink = found;
+
+	start = now();
+	found = 0;
+	for(size_t i = 0; i < N_LOOKUPS; ++i)
+	    found += bitmapA.contains(lookups[i]);
+	const double bitmapLookup = now() - start;
+	sink = found;
+	printf("  lookup:  array %9.1f ns  bitmap %9.1f ns\n",
+	       arrayLookup * 1e9 / N_LOOKUPS, bitmapLookup * 1e9 / N_LOOKUPS);
+
+	start = now();
+	unsigned long total = 0;
+	for(size_t i = 0; i < N_RANKS; ++i)
+	    total += bitmapA.rank(lookups[i]);
+	const double rank = now() - start;
+
+	start = now();
+	unsigned value;
+	for(size_t i = 0; i < N_RANKS; ++i)
+	{
+	    bitmapA.select(random64() % nA, &value);
+	    total += value;
+	}
+	const double select = now() - start;
+	sink = total;
+	printf("  rank %9.1f ns  select %9.1f ns\n",
+	       rank * 1e9 / N_RANKS, select * 1e9 / N_RANKS);
+    }
+
+    return 0;
+}
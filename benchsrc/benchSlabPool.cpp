@@ -0,0 +1,138 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchSlabPool.cpp - SlabPool compared with new and delete
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Each thread keeps a window of live 48 byte objects, and repeatedly
+    frees a random one and allocates a replacement, so that the allocator
+    sees a steady mix of allocations and frees rather than one long run of
+    each.  The same is done with new and delete.
+
+    Times are for the whole run, so with more threads than CPUs they
+    include the cost of contending with the other threads rather than the
+    speedup of running in parallel.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <pthread.h>
+
+#include "SlabPool.h"
+
+using namespace phoenix4cpp;
+
+#define N_OPS 20000000
+#define WINDOW 1024
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile unsigned long sink;
+
+struct Object
+{
+    unsigned long word[6];
+};
+
+static SlabPool<Object> *pPool;
+static unsigned nThreads;
+
+static void *poolThread(void *pArg)
+{
+    unsigned long long state = 0x20380119deadbeefULL + (unsigned long)pArg;
+    Object *window[WINDOW];
+    for(size_t i = 0; i < WINDOW; ++i)
+	window[i] = pPool->create();
+
+    unsigned long sum = 0;
+    for(unsigned long i = N_OPS / nThreads; i; --i)
+    {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	const size_t j = (size_t)((state * 0x2545f4914f6cdd1dULL) >> 32) %
+	    WINDOW;
+	sum += window[j]->word[0];
+	pPool->destroy(window[j]);
+	window[j] = pPool->create();
+	window[j]->word[0] = i;
+    }
+
+    for(size_t i = 0; i < WINDOW; ++i)
+	pPool->destroy(window[i]);
+    sink = sum;
+    return NULL;
+}
+
+static void *newThread(void *pArg)
+{
+    unsigned long long state = 0x20380119deadbeefULL + (unsigned long)pArg;
+    Object *window[WINDOW];
+    for(size_t i = 0; i < WINDOW; ++i)
+	window[i] = new Object();
+
+    unsigned long sum = 0;
+    for(unsigned long i = N_OPS / nThreads; i; --i)
+    {
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+	const size_t j = (size_t)((state * 0x2545f4914f6cdd1dULL) >> 32) %
+	    WINDOW;
+	sum += window[j]->word[0];
+	delete window[j];
+	window[j] = new Object();
+	window[j]->word[0] = i;
+    }
+
+    for(size_t i = 0; i < WINDOW; ++i)
+	delete window[i];
+    sink = sum;
+    return NULL;
+}
+
+static double run(void *(*thread)(void *), unsigned n)
+{
+    pthread_t threads[16];
+    nThreads = n;
+    const double start = now();
+    for(unsigned long i = 0; i < n; ++i)
+	pthread_create(&threads[i], NULL, thread, (void *)i);
+    for(unsigned i = 0; i < n; ++i)
+	pthread_join(threads[i], NULL);
+    return now() - start;
+}
+
+int main()
+{
+    printf("%d frees and allocations of %u byte objects\n",
+	   N_OPS, (unsigned)sizeof(Object));
+    for(unsigned n = 1; n <= 4; n *= 4)
+    {
+	pPool = new SlabPool<Object>;
+	const double pool = run(poolThread, n);
+	const size_t nSlabs = pPool->getSlabCount();
+	const size_t slabBytes = pPool->getSlabBytes();
+	delete pPool;
+
+	const double plain = run(newThread, n);
+	printf("  %u thread(s)  SlabPool %7.1f ms (%lu slabs of %lu bytes)"
+	       "  new/delete %7.1f ms\n", n, pool * 1e3,
+	       (unsigned long)nSlabs, (unsigned long)slabBytes, plain * 1e3);
+    }
+
+    return 0;
+}
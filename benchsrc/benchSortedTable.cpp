@@ -0,0 +1,186 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchSortedTable.cpp - restarting from a SortedTable compared with
+      loading and sorting
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    This models a process that restarts and then serves lookups.  Four
+    million 16 byte records with random keys are saved two ways:  as a
+    plain array in arrival order, and as a SortedTable.  The cost of a
+    restart is then measured, from the file being evicted from the page
+    cache, to having answered a batch of lookups, half for keys that are
+    present and half for keys that are not.
+
+    The alternative reads the whole array, sorts it with qsort(), and
+    looks keys up with bsearch().  The table is opened, which maps it, and
+    looks keys up in place, with and without its Bloom filter.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "SortedTable.h"
+#include "bsearch.h"
+#include "compare.h"
+#include "hash.h"
+#include "qsort.h"
+
+using namespace phoenix4cpp;
+
+#define N_RECORDS (4 << 20)
+#define N_LOOKUPS 10000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Record
+{
+    unsigned long key;
+    unsigned long value;
+};
+
+typedef SortedTable<Record, unsigned long, offsetof(Record, key)>
+    RecordTable;
+
+static Record records[N_RECORDS];
+static unsigned long lookups[N_LOOKUPS];
+
+/* drop a file from the page cache, so that it has to be read again */
+static void evict(const char *pPath)
+{
+    const int fd = open(pPath, O_RDONLY);
+    if (fd < 0)
+	return;
+    fdatasync(fd);
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+}
+
+static double restartBySorting(const char *pPath)
+{
+    evict(pPath);
+    const double start = now();
+
+    FILE *pFile = fopen(pPath, "rb");
+    if (!pFile || (fread(records, sizeof(Record), N_RECORDS, pFile) !=
+		   N_RECORDS))
+    {
+	fprintf(stderr, "can't read %s\n", pPath);
+	exit(1);
+    }
+    fclose(pFile);
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	records, N_RECORDS, compareUnsignedLong);
+
+    unsigned long found = 0;
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	found += bsearch<Record, unsigned long, offsetof(Record, key)>(
+	    &lookups[i], records, N_RECORDS, compareUnsignedLong) != NULL;
+    sink = found;
+
+    return now() - start;
+}
+
+static double restartByMapping(const char *pPath, bool bloom)
+{
+    evict(pPath);
+    const double start = now();
+
+    RecordTable table(compareUnsignedLong, bloom ? hashUnsignedLong : NULL);
+    const int error = table.open(pPath);
+    if (error)
+    {
+	fprintf(stderr, "can't open %s: %s\n", pPath, strerror(error));
+	exit(1);
+    }
+
+    unsigned long found = 0;
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	found += table.find(&lookups[i]) != NULL;
+    sink = found;
+
+    return now() - start;
+}
+
+int main()
+{
+    const char *pDirectory = getenv("TMPDIR");
+    if (!pDirectory)
+	pDirectory = "/tmp";
+    char arrayPath[256];
+    char tablePath[256];
+    snprintf(arrayPath, sizeof(arrayPath), "%s/benchSortedTable-array-%d",
+	     pDirectory, (int)getpid());
+    snprintf(tablePath, sizeof(tablePath), "%s/benchSortedTable-table-%d",
+	     pDirectory, (int)getpid());
+
+    /* even keys are present, odd ones are not */
+    for(size_t i = 0; i < N_RECORDS; ++i)
+    {
+	records[i].key = (unsigned long)(random64() & ~1ULL);
+	records[i].value = i;
+    }
+    for(size_t i = 0; i < N_LOOKUPS; ++i)
+	lookups[i] = records[random64() % N_RECORDS].key | (i & 1);
+
+    FILE *pFile = fopen(arrayPath, "wb");
+    if (!pFile ||
+	(fwrite(records, sizeof(Record), N_RECORDS, pFile) != N_RECORDS))
+    {
+	fprintf(stderr, "can't write %s\n", arrayPath);
+	return 1;
+    }
+    fclose(pFile);
+
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	records, N_RECORDS, compareUnsignedLong);
+    const int error = RecordTable::write(tablePath, records, N_RECORDS,
+					 compareUnsignedLong, hashUnsignedLong);
+    if (error)
+    {
+	fprintf(stderr, "can't write %s: %s\n", tablePath, strerror(error));
+	return 1;
+    }
+
+    printf("%d records of %u bytes, %d lookups, half missing\n",
+	   N_RECORDS, (unsigned)sizeof(Record), N_LOOKUPS);
+    printf("  read + qsort + bsearch      %8.1f ms\n",
+	   restartBySorting(arrayPath) * 1e3);
+    printf("  SortedTable open + find     %8.1f ms\n",
+	   restartByMapping(tablePath, false) * 1e3);
+    printf("  ... with Bloom filter       %8.1f ms\n",
+	   restartByMapping(tablePath, true) * 1e3);
+
+    unlink(arrayPath);
+    unlink(tablePath);
+    return 0;
+}
@@ -0,0 +1,293 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchTimerWheel.cpp - TimerWheel compared with a binary heap timer queue
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The workload is connection timeouts:  every connection is armed with a
+    timeout up to 30000 ticks away, then randomly chosen connections see
+    activity and have their timeouts pushed back, some are closed and have
+    their timers cancelled, and finally time runs forward until all of the
+    remaining timers have fired.
+
+    The heap is the usual alternative:  an array-based binary min-heap of
+    pointers to timers, each of which records its position in the heap so
+    that it can be cancelled or moved in O(log n).
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "TimerWheel.h"
+
+using namespace phoenix4cpp;
+
+#define TIMEOUT 30000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Connection
+{
+    unsigned long id;
+    TimerWheelMembership timeout;
+};
+
+typedef TimerWheel<Connection, offsetof(Connection, timeout)> Wheel;
+
+static void expire(unsigned long *pSum, Connection *pConnection)
+{
+    *pSum += pConnection->id;
+}
+
+struct HeapTimer
+{
+    unsigned long long expiry;
+    size_t position;          /* in the heap; ~0 if not armed */
+    unsigned long id;
+};
+
+static const size_t notArmed = ~(size_t)0;
+
+class TimerHeap
+{
+public:
+    TimerHeap(size_t capacity):
+	ppHeap(new HeapTimer *[capacity]),
+	n(0)
+    {
+    }
+
+    ~TimerHeap()
+    {
+	delete[] ppHeap;
+    }
+
+    void arm(HeapTimer *pTimer, unsigned long long expiry)
+    {
+	if (pTimer->position != notArmed)
+	{
+	    const unsigned long long old = pTimer->expiry;
+	    pTimer->expiry = expiry;
+	    if (expiry < old)
+		up(pTimer->position);
+	    else
+		down(pTimer->position);
+	    return;
+	}
+
+	pTimer->expiry = expiry;
+	ppHeap[n] = pTimer;
+	pTimer->position = n;
+	up(n++);
+    }
+
+    void cancel(HeapTimer *pTimer)
+    {
+	const size_t i = pTimer->position;
+	pTimer->position = notArmed;
+	if (i == --n)
+	    return;
+
+	ppHeap[i] = ppHeap[n];
+	ppHeap[i]->position = i;
+	up(i);
+	down(ppHeap[i]->position);
+    }
+
+    HeapTimer *popExpired(unsigned long long now)
+    {
+	if (!n || (ppHeap[0]->expiry > now))
+	    return NULL;
+
+	HeapTimer *pTimer = ppHeap[0];
+	cancel(pTimer);
+	return pTimer;
+    }
+
+private:
+    void set(size_t i, HeapTimer *pTimer)
+    {
+	ppHeap[i] = pTimer;
+	pTimer->position = i;
+    }
+
+    void up(size_t i)
+    {
+	HeapTimer *pTimer = ppHeap[i];
+	while(i)
+	{
+	    const size_t parent = (i - 1) / 2;
+	    if (ppHeap[parent]->expiry <= pTimer->expiry)
+		break;
+	    set(i, ppHeap[parent]);
+	    i = parent;
+	}
+	set(i, pTimer);
+    }
+
+    void down(size_t i)
+    {
+	HeapTimer *pTimer = ppHeap[i];
+	for(;;)
+	{
+	    size_t child = 2 * i + 1;
+	    if (child >= n)
+		break;
+	    if ((child + 1 < n) &&
+		(ppHeap[child + 1]->expiry < ppHeap[child]->expiry))
+		++child;
+	    if (pTimer->expiry <= ppHeap[child]->expiry)
+		break;
+	    set(i, ppHeap[child]);
+	    i = child;
+	}
+	set(i, pTimer);
+    }
+
+    HeapTimer **ppHeap;
+    size_t n;
+};
+
+static void report(const char *pWhat, double elapsed, size_t n)
+{
+    printf("  %-28s %7.1f ns/op\n", pWhat, elapsed * 1e9 / n);
+}
+
+static void benchWheel(size_t n, const unsigned long *pVictim)
+{
+    Connection *pConnection = new Connection[n];
+    Wheel wheel;
+    unsigned long sum = 0;
+
+    printf("timer wheel, %lu timers\n", (unsigned long)n);
+
+    double start = now();
+    for(size_t i = 0; i < n; ++i)
+    {
+	pConnection[i].id = i;
+	wheel.arm(&pConnection[i], 1 + random64() % TIMEOUT);
+    }
+    report("arm", now() - start, n);
+
+    /* activity pushes timeouts back, as time moves slowly forward */
+    start = now();
+    unsigned long long t = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!(i % 1024))
+	    sum += wheel.advance(++t, expire, &sum);
+	wheel.arm(&pConnection[pVictim[i]], t + TIMEOUT);
+    }
+    report("rearm", now() - start, n);
+
+    start = now();
+    for(size_t i = 0; i < n / 2; ++i)
+	pConnection[pVictim[i]].timeout.remove();
+    report("cancel", now() - start, n / 2);
+
+    start = now();
+    const size_t nFired = wheel.advance(t + TIMEOUT + 1, expire, &sum);
+    report("expire", now() - start, nFired);
+
+    sink = sum;
+    delete[] pConnection;
+}
+
+static void benchHeap(size_t n, const unsigned long *pVictim)
+{
+    HeapTimer *pTimer = new HeapTimer[n];
+    TimerHeap heap(n);
+    unsigned long sum = 0;
+
+    printf("binary heap, %lu timers\n", (unsigned long)n);
+
+    double start = now();
+    for(size_t i = 0; i < n; ++i)
+    {
+	pTimer[i].id = i;
+	pTimer[i].position = notArmed;
+	heap.arm(&pTimer[i], 1 + random64() % TIMEOUT);
+    }
+    report("arm", now() - start, n);
+
+    start = now();
+    unsigned long long t = 0;
+    HeapTimer *pExpired;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!(i % 1024))
+	{
+	    ++t;
+	    while((pExpired = heap.popExpired(t)))
+		sum += pExpired->id;
+	}
+	heap.arm(&pTimer[pVictim[i]], t + TIMEOUT);
+    }
+    report("rearm", now() - start, n);
+
+    start = now();
+    for(size_t i = 0; i < n / 2; ++i)
+    {
+	if (pTimer[pVictim[i]].position != notArmed)
+	    heap.cancel(&pTimer[pVictim[i]]);
+    }
+    report("cancel", now() - start, n / 2);
+
+    start = now();
+    size_t nFired = 0;
+    while((pExpired = heap.popExpired(t + TIMEOUT + 1)))
+    {
+	sum += pExpired->id;
+	++nFired;
+    }
+    report("expire", now() - start, nFired);
+
+    sink = sum;
+    delete[] pTimer;
+}
+
+int main()
+{
+    static const size_t sizes[] = {1000000, 10000000};
+
+    for(size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s)
+    {
+	const size_t n = sizes[s];
+	unsigned long *pVictim = new unsigned long[n];
+	for(size_t i = 0; i < n; ++i)
+	    pVictim[i] = random64() % n;
+
+	benchWheel(n, pVictim);
+	benchHeap(n, pVictim);
+	printf("\n");
+
+	delete[] pVictim;
+    }
+
+    return 0;
+}
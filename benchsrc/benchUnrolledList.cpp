@@ -0,0 +1,158 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchUnrolledList.cpp - full scans of UnrolledList compared with
+    DoublyLinkedList
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Ten million 16 byte log records are appended to each list, and then the
+    lists are scanned from one end to the other, summing a field.
+
+    The DoublyLinkedList is built twice:  once with the records allocated
+    in the order they are appended, which is the best case, and once with
+    the allocation order shuffled, which is what a long running process's
+    heap looks like after records have come and gone for a while.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "DoublyLinked.h"
+#include "UnrolledList.h"
+
+using namespace phoenix4cpp;
+
+#define N_RECORDS 10000000
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Record
+{
+    unsigned long timestamp;
+    unsigned long value;
+};
+
+struct LinkedRecord
+{
+    Record record;
+    DoublyLinkedMembership link;
+};
+
+typedef DoublyLinkedList<LinkedRecord, offsetof(LinkedRecord, link)> List;
+
+static void benchUnrolled()
+{
+    UnrolledList<Record> list;
+    double start = now();
+    for(unsigned long i = 0; i < N_RECORDS; ++i)
+    {
+	Record record;
+	record.timestamp = i;
+	record.value = i & 0xff;
+	list.append(&record);
+    }
+    const double append = now() - start;
+
+    start = now();
+    unsigned long sum = 0;
+    for(const Record *pRecord = list.getFirst(); pRecord;
+	pRecord = list.getNext(pRecord))
+	sum += pRecord->value;
+    const double scan = now() - start;
+    sink = sum;
+
+    start = now();
+    sum = 0;
+    for(const UnrolledListChunk *pChunk = list.getFirstChunk(); pChunk;
+	pChunk = list.getNextChunk(pChunk))
+    {
+	size_t n;
+	const Record *pRun = list.getRun(pChunk, &n);
+	for(size_t i = 0; i < n; ++i)
+	    sum += pRun[i].value;
+    }
+    const double runScan = now() - start;
+    sink = sum;
+
+    printf("  UnrolledList                 append %7.1f ms  scan %7.1f ms"
+	   "  chunk scan %7.1f ms\n",
+	   append * 1e3, scan * 1e3, runScan * 1e3);
+}
+
+static void benchLinked(bool shuffled)
+{
+    /* appending includes allocating the records, but not shuffling them */
+    LinkedRecord **ppRecord = new LinkedRecord *[N_RECORDS];
+    double start = now();
+    for(unsigned long i = 0; i < N_RECORDS; ++i)
+	ppRecord[i] = new LinkedRecord;
+    const double allocate = now() - start;
+    if (shuffled)
+    {
+	for(unsigned long i = N_RECORDS - 1; i; --i)
+	{
+	    const unsigned long j = (unsigned long)(random64() % (i + 1));
+	    LinkedRecord *pT = ppRecord[i];
+	    ppRecord[i] = ppRecord[j];
+	    ppRecord[j] = pT;
+	}
+    }
+
+    List list;
+    start = now();
+    for(unsigned long i = 0; i < N_RECORDS; ++i)
+    {
+	ppRecord[i]->record.timestamp = i;
+	ppRecord[i]->record.value = i & 0xff;
+	list.append(ppRecord[i]);
+    }
+    const double append = now() - start + allocate;
+    delete[] ppRecord;
+
+    start = now();
+    unsigned long sum = 0;
+    for(const LinkedRecord *pRecord = list.getFirst(); pRecord;
+	pRecord = list.getNext(pRecord))
+	sum += pRecord->record.value;
+    const double scan = now() - start;
+    sink = sum;
+
+    printf("  DoublyLinkedList %s  append %7.1f ms  scan %7.1f ms\n",
+	   (shuffled ? "(shuffled)" : "(in order)"),
+	   append * 1e3, scan * 1e3);
+}
+
+int main()
+{
+    printf("%d records of %u bytes\n", N_RECORDS, (unsigned)sizeof(Record));
+    benchUnrolled();
+    benchLinked(false);
+    benchLinked(true);
+
+    return 0;
+}
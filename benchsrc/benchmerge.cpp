@@ -0,0 +1,110 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchmerge.cpp - kwayMerge() compared with sorting the concatenation
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Eight million 16 byte records with random keys are split into k
+    sorted arrays, for several values of k.  They are then merged with
+    kwayMerge(), and, as the alternative, copied into one array and sorted
+    with qsort().
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "merge.h"
+#include "qsort.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define N_RECORDS (8 << 20)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+struct Record
+{
+    unsigned long key;
+    unsigned long value;
+};
+
+static Record input[N_RECORDS];
+static Record output[N_RECORDS];
+
+static void bench(size_t k)
+{
+    const Record *ppArray[1024];
+    size_t n[1024];
+    const size_t each = N_RECORDS / k;
+    for(size_t i = 0; i < N_RECORDS; ++i)
+    {
+	input[i].key = (unsigned long)(random64() % (N_RECORDS / 2));
+	input[i].value = i;
+    }
+    for(size_t a = 0; a < k; ++a)
+    {
+	ppArray[a] = input + a * each;
+	n[a] = each;
+	qsort<Record, unsigned long, offsetof(Record, key)>(
+	    input + a * each, each, compareUnsignedLong);
+    }
+
+    double start = now();
+    size_t nOut = kwayMerge<Record, unsigned long, offsetof(Record, key)>(
+	ppArray, n, k, compareUnsignedLong, output);
+    const double merge = now() - start;
+    sink = nOut + output[nOut / 2].key;
+
+    start = now();
+    nOut = kwayMerge<Record, unsigned long, offsetof(Record, key)>(
+	ppArray, n, k, compareUnsignedLong, output, true);
+    const double unique = now() - start;
+    sink = nOut + output[nOut / 2].key;
+
+    start = now();
+    memcpy(output, input, k * each * sizeof(Record));
+    qsort<Record, unsigned long, offsetof(Record, key)>(
+	output, k * each, compareUnsignedLong);
+    const double sort = now() - start;
+    sink = output[N_RECORDS / 2].key;
+
+    printf("  k = %4lu  kwayMerge %7.1f ms  unique %7.1f ms (%lu kept)"
+	   "  qsort %7.1f ms\n", (unsigned long)k, merge * 1e3,
+	   unique * 1e3, (unsigned long)nOut, sort * 1e3);
+}
+
+int main()
+{
+    printf("%d records of %u bytes\n", N_RECORDS, (unsigned)sizeof(Record));
+    for(size_t k = 2; k <= 1024; k *= 8)
+	bench(k);
+
+    return 0;
+}
@@ -0,0 +1,163 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    benchsetops.cpp - set operations at a range of size ratios
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A large set of a million values, about a quarter of a universe of four
+    million, is combined with smaller sets drawn from the same universe,
+    at size ratios from 1:1 to 1:10000.  Intersection is timed with each
+    algorithm, and with a plain merge loop of the sort usually written by
+    hand, for both unsigned and unsigned long values; difference and union
+    are timed with the automatic choice and with the merge.  Times are in
+    microseconds per operation; each operation is repeated until it has
+    taken long enough to measure.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+
+#include "setops.h"
+
+using namespace phoenix4cpp;
+
+#define N_LARGE (1 << 20)
+#define UNIVERSE (4 << 20)
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static unsigned long long randomState = 0x20380119deadbeefULL;
+
+static unsigned long long random64()
+{
+    randomState ^= randomState >> 12;
+    randomState ^= randomState << 25;
+    randomState ^= randomState >> 27;
+    return randomState * 0x2545f4914f6cdd1dULL;
+}
+
+static volatile unsigned long sink;
+
+template<class V>
+static size_t handMerge(const V *pA, size_t nA, const V *pB, size_t nB,
+			V *pOut, SetAlgorithm)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t n = 0;
+    while((i < nA) && (j < nB))
+    {
+	if (pA[i] < pB[j])
+	    ++i;
+	else if (pB[j] < pA[i])
+	    ++j;
+	else
+	{
+	    pOut[n++] = pA[i];
+	    ++i;
+	    ++j;
+	}
+    }
+    return n;
+}
+
+/* a random subset of the universe of about n values, in order */
+template<class V>
+static size_t makeSet(V *pSet, size_t n)
+{
+    size_t count = 0;
+    for(size_t v = 0; v < UNIVERSE; ++v)
+    {
+	if (random64() % UNIVERSE < n)
+	    pSet[count++] = (V)v;
+    }
+    return count;
+}
+
+/* @returns microseconds per call */
+template<class V>
+static double time(size_t (*op)(const V *, size_t, const V *, size_t, V *,
+				SetAlgorithm),
+		   const V *pA, size_t nA, const V *pB, size_t nB, V *pOut,
+		   SetAlgorithm algorithm)
+{
+    size_t repeats = 0;
+    unsigned long total = 0;
+    const double start = now();
+    double elapsed;
+    do
+    {
+	total += (*op)(pA, nA, pB, nB, pOut, algorithm);
+	++repeats;
+    } while((elapsed = now() - start) < 0.05);
+    sink = total;
+    return elapsed * 1e6 / repeats;
+}
+
+template<class V>
+static void bench(const char *pType)
+{
+    static V large[2 * N_LARGE];
+    static V small[2 * N_LARGE];
+    static V out[4 * N_LARGE];
+    const size_t nLarge = makeSet(large, N_LARGE);
+
+    printf("%s intersection, %lu values in the large set, usec per call\n",
+	   pType, (unsigned long)nLarge);
+    printf("   ratio  by hand    merge     simd   gallop     auto\n");
+    for(size_t ratio = 1; ratio <= 10000; ratio *= 10)
+    {
+	const size_t nSmall = makeSet(small, N_LARGE / ratio);
+	printf("%8lu %8.1f %8.1f %8.1f %8.1f %8.1f\n", (unsigned long)ratio,
+	       time<V>(handMerge, large, nLarge, small, nSmall, out, SET_AUTO),
+	       time<V>(setIntersection, large, nLarge, small, nSmall, out,
+		       SET_MERGE),
+	       time<V>(setIntersection, large, nLarge, small, nSmall, out,
+		       SET_SIMD),
+	       time<V>(setIntersection, large, nLarge, small, nSmall, out,
+		       SET_GALLOP),
+	       time<V>(setIntersection, large, nLarge, small, nSmall, out,
+		       SET_AUTO));
+    }
+}
+
+int main()
+{
+    bench<unsigned>("unsigned");
+    bench<unsigned long>("unsigned long");
+
+    static unsigned large[2 * N_LARGE];
+    static unsigned small[2 * N_LARGE];
+    static unsigned out[4 * N_LARGE];
+    const size_t nLarge = makeSet(large, N_LARGE);
+    printf("unsigned difference and union, usec per call\n");
+    printf("   ratio  diff merge  diff auto union merge union auto\n");
+    for(size_t ratio = 1; ratio <= 10000; ratio *= 10)
+    {
+	const size_t nSmall = makeSet(small, N_LARGE / ratio);
+	printf("%8lu %11.1f %10.1f %11.1f %10.1f\n", (unsigned long)ratio,
+	       time<unsigned>(setDifference, large, nLarge, small, nSmall,
+			      out, SET_MERGE),
+	       time<unsigned>(setDifference, large, nLarge, small, nSmall,
+			      out, SET_AUTO),
+	       time<unsigned>(setUnion, large, nLarge, small, nSmall, out,
+			      SET_MERGE),
+	       time<unsigned>(setUnion, large, nLarge, small, nSmall, out,
+			      SET_AUTO));
+    }
+
+    return 0;
+}
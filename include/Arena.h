@@ -0,0 +1,258 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    Arena.h - Bump allocator with mark and rewind
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    An Arena hands out memory by advancing a pointer through a large
+    chunk obtained from the system, and getting another chunk when that
+    one is used up.  Nothing is freed individually.  Instead, mark()
+    records the arena's current position, and rewind() frees everything
+    allocated since the mark, all at once.  Destroying the arena frees
+    everything.  That suits scratch space for an operation, or all of the
+    structures built to serve one request, which can then be built without
+    a single call to free().
+
+    Destructors are not run, so only plain data should be kept in an
+    arena, or objects whose destructors don't need to be called.
+
+    Chunks come straight from mmap().  If huge pages are asked for, chunks
+    are a multiple of 2MB, and are mapped with MAP_HUGETLB if the system
+    has huge pages reserved, or aligned to 2MB and marked for transparent
+    huge pages otherwise, so that large scratch arrays don't take a TLB
+    miss every 4KB.  If neither is available, ordinary pages are used.
+
+    Allocations too big for a chunk get a chunk of their own.  When
+    rewind() frees chunks, it keeps one, so that a loop which marks,
+    allocates and rewinds doesn't map and unmap a chunk every time around.
+
+    An arena is not thread safe.  getThreadArena() provides an arena for
+    each thread, created on first use and destroyed when the thread exits;
+    library code uses these for scratch space, always rewinding to where
+    it started before it returns, so callers can use them too.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_ARENA_H
+#define PHOENIX4CPP_ARENA_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class ArenaChunk;
+
+    /*
+      A position in an arena, for rewinding to.  This is only meaningful
+      to the arena it came from.
+    */
+    class ArenaMark
+    {
+    private:
+	friend class Arena;
+
+	ArenaChunk *pChunk;
+	char *pNext;
+    };
+
+
+    class Arena
+    {
+    public:
+	/*
+	  Construct an arena.  No memory is obtained until the first
+	  allocation.
+
+	  @param chunkBytes the size of the chunks to get from the system;
+	    this is rounded up to a multiple of the page size
+	  @param hugePages use huge pages for chunks if they are available
+	*/
+	Arena(size_t chunkBytes = 1 << 20, bool hugePages = false);
+
+	/*
+	  Destroy the arena, and return all of its memory to the system.
+	*/
+	~Arena();
+
+	/*
+	  allocate()
+
+	  @param size the number of bytes required
+	  @param align the alignment required; a power of two no greater
+	    than the page size
+	  @returns memory for size bytes; this is not initialized
+	*/
+	void *allocate(size_t size, size_t align = sizeof(void *));
+
+	/*
+	  allocateArray()
+
+	  @params T the type of the array elements; only plain data
+	  @param n the number of elements
+	  @returns memory for n elements of type T; this is not initialized
+	*/
+	template<class T>
+	T *allocateArray(size_t n);
+
+	/*
+	  mark()
+
+	  @returns the arena's current position, for use with rewind()
+	*/
+	ArenaMark mark() const;
+
+	/*
+	  rewind()
+
+	  Free everything allocated since a mark was taken.  Marks taken
+	  since then become invalid.
+
+	  @param m the mark to go back to
+	*/
+	void rewind(const ArenaMark &m);
+
+	/*
+	  reset()
+
+	  Free everything in the arena, keeping one chunk for reuse.
+	*/
+	void reset();
+
+	/*
+	  getBytesUsed()
+
+	  @returns the number of bytes allocated since the arena was created
+	    or last reset, including any alignment padding
+	*/
+	size_t getBytesUsed() const;
+
+	/*
+	  getBytesMapped()
+
+	  @returns the number of bytes currently obtained from the system
+	*/
+	size_t getBytesMapped() const;
+
+	size_t getChunkBytes() const;
+
+	/*
+	  getThreadArena()
+
+	  @returns the calling thread's arena
+	*/
+	static Arena *getThreadArena();
+
+    private:
+	Arena(const Arena &);
+	Arena &operator=(const Arena &);
+
+	void *allocateSlow(size_t size, size_t align);
+	ArenaChunk *mapChunk(size_t bytes);
+	void unmapChunk(ArenaChunk *pChunk);
+	void popChunk();
+
+	char *pNext;
+	char *pEnd;
+	ArenaChunk *pCurrent;
+	/* kept by popChunk() for reuse */
+	ArenaChunk *pSpare;
+	size_t bytesMapped;
+	size_t chunkBytes;
+	bool hugePages;
+    };
+
+
+    /*
+      Mark an arena on construction, and rewind it on destruction, so that
+      scratch space is freed however a scope is left.
+    */
+    class ArenaScope
+    {
+    public:
+	ArenaScope(Arena *pArena);
+	~ArenaScope();
+
+    private:
+	ArenaScope(const ArenaScope &);
+	ArenaScope &operator=(const ArenaScope &);
+
+	Arena *pArena;
+	ArenaMark m;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline void *Arena::allocate(size_t size, size_t align)
+    {
+	char *p = (char *)(((size_t)pNext + align - 1) & ~(align - 1));
+	if ((size_t)(pEnd - pNext) < size + (size_t)(p - pNext))
+	    return allocateSlow(size, align);
+
+	pNext = p + size;
+	return p;
+    }
+
+    template<class T>
+    inline T *Arena::allocateArray(size_t n)
+    {
+	const size_t align = __alignof__(T) > sizeof(void *) ?
+	    __alignof__(T) : sizeof(void *);
+	return (T *)allocate(n * sizeof(T), align);
+    }
+
+    inline ArenaMark Arena::mark() const
+    {
+	ArenaMark m;
+	m.pChunk = pCurrent;
+	m.pNext = pNext;
+	return m;
+    }
+
+    inline void Arena::rewind(const ArenaMark &m)
+    {
+	while(pCurrent != m.pChunk)
+	    popChunk();
+	pNext = m.pNext;
+    }
+
+    inline size_t Arena::getBytesMapped() const
+    {
+	return bytesMapped;
+    }
+
+    inline size_t Arena::getChunkBytes() const
+    {
+	return chunkBytes;
+    }
+
+
+    inline ArenaScope::ArenaScope(Arena *pA):
+	pArena(pA),
+	m(pA->mark())
+    {
+    }
+
+    inline ArenaScope::~ArenaScope()
+    {
+	pArena->rewind(m);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_ARENA_H */
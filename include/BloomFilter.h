@@ -0,0 +1,160 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    BloomFilter.h - cache-line-blocked Bloom filter for Hashable keys
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A Bloom filter answers "definitely not present" or "may be present," in
+    a small fraction of the space the keys themselves would take.  It is
+    meant as a cheap negative check in front of something expensive, such as
+    a search of an on-disk table.
+
+    This is a blocked filter:  the bit array is divided into 512-bit blocks,
+    each the size of a cache line, and all of a key's probes fall in one
+    block.  A lookup therefore costs at most one cache miss, at the price of
+    a slightly higher false positive rate than a classic filter with the same
+    number of bits.  The block and all k probe positions are derived from a
+    single HashValue computation by double hashing, and the probes are
+    combined into a block-sized mask that is tested or set with SIMD
+    instructions where they are available.
+
+    The filter can be serialized to a flat buffer.  The buffer starts with a
+    64 byte header, followed by the blocks, so if the buffer is page aligned
+    (as it is in a memory-mapped file), the blocks are cache line aligned.  A
+    filter can be attached to such a buffer in place, without copying it.
+    Header fields are in native byte order; a buffer from a machine with a
+    different byte order is rejected by attach().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_BLOOMFILTER_H
+#define PHOENIX4CPP_BLOOMFILTER_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Hashable;
+
+    class BloomFilter
+    {
+    public:
+	/*
+	  Construct an empty filter.
+
+	  @param expectedItems the number of keys the filter is sized for
+	  @param bitsPerItem the number of filter bits to allocate per key;
+	    10 gives a false positive rate of about 1%
+	*/
+	BloomFilter(size_t expectedItems, unsigned bitsPerItem = 10);
+
+	/*
+	  Construct a filter with no blocks, for use with attach().  Nothing
+	  is ever reported as present.
+	*/
+	BloomFilter();
+
+	~BloomFilter();
+
+	/*
+	  add()
+
+	  Add a key to the filter.  This may not be used on an attached
+	  filter.
+
+	  @param pKey the key
+	*/
+	void add(const Hashable *pKey);
+
+	/*
+	  mayContain()
+
+	  @param pKey the key
+	  @returns false if the key has definitely not been added, true if it
+	    may have been
+	*/
+	bool mayContain(const Hashable *pKey) const;
+
+	/*
+	  Variants of the above for callers that already have the key's
+	  HashValue::get64().
+	*/
+	void addHash(unsigned long long hashValue);
+	bool mayContainHash(unsigned long long hashValue) const;
+
+	unsigned getProbeCount() const;
+	size_t getBlockCount() const;
+
+	/*
+	  getSerializedSize()
+
+	  @returns the number of bytes serialize() will write
+	*/
+	size_t getSerializedSize() const;
+
+	/*
+	  serialize()
+
+	  @param pBuffer where to write the filter; it must be at least
+	    getSerializedSize() bytes long
+	*/
+	void serialize(void *pBuffer) const;
+
+	/*
+	  attach()
+
+	  Use a serialized filter in place.  Any filter previously held is
+	  released.  The buffer is not copied, and must outlive the filter,
+	  or the next attach().
+
+	  @param pBuffer the serialized filter; this should be 64 byte
+	    aligned for best performance
+	  @param length the length of the buffer
+	  @returns true if the buffer holds a valid filter, false otherwise,
+	    in which case the filter is left empty
+	*/
+	bool attach(const void *pBuffer, size_t length);
+
+    private:
+	BloomFilter(const BloomFilter &);
+	BloomFilter &operator=(const BloomFilter &);
+
+	void release();
+
+	unsigned long long *pBlocks;
+	size_t nBlocks;
+	unsigned k;
+	bool owned;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline unsigned BloomFilter::getProbeCount() const
+    {
+	return k;
+    }
+
+    inline size_t BloomFilter::getBlockCount() const
+    {
+	return nBlocks;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_BLOOMFILTER_H */
@@ -0,0 +1,251 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ConcurrentHashMap.h - hash map for read-mostly multi-threaded lookups
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    The map holds pointers to client elements, each of which contains its
+    key at a fixed offset, as for bsearch() and qsort().  Keys are hashed
+    with a Hashable, and compared with a Comparator, which is handed the
+    Hashable's raw pointer and a pointer to the key in the element.
+
+    Readers never block and never write to shared memory other than their
+    own epoch record:  they walk the bucket chains with acquire loads, and
+    writers only ever publish fully initialized nodes with release stores.
+
+    Writers are serialized per stripe with a mutex.  Each bucket belongs to
+    exactly one stripe, however many buckets there are, so writers on
+    different stripes proceed in parallel.  Growing the table takes all of
+    the stripe locks, builds a new table alongside the old one, and
+    publishes it; readers that are still in the old table see it unchanged.
+
+    Unlinked nodes and old tables are reclaimed with an EpochManager (see
+    Epoch.h).  The elements themselves belong to the caller.  An element
+    returned by find() is only guaranteed to be safe to use if it is never
+    freed, or if the caller holds an EpochGuard on getEpochManager() across
+    the find() and the use, and removed elements are passed to retire()
+    rather than being freed directly.
+
+    Templates are used, but only for type safety.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_CONCURRENTHASHMAP_H
+#define PHOENIX4CPP_CONCURRENTHASHMAP_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+#ifndef PHOENIX4CPP_EPOCH_H
+#include "Epoch.h"
+#endif
+
+namespace phoenix4cpp
+{
+    class Comparator;
+    class Hashable;
+
+    struct ConcurrentHashNode;
+    struct ConcurrentHashTable;
+    struct ConcurrentHashStripe;
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of ConcurrentHashMap.  See that class for usage.
+    */
+    class ConcurrentHashBase
+    {
+    public:
+	/*
+	  getCount()
+
+	  @returns the number of elements in the map; this is only a snapshot
+	    if there are concurrent writers
+	*/
+	size_t getCount() const;
+
+	EpochManager *getEpochManager();
+
+    protected:
+	ConcurrentHashBase(size_t keyOffset, const Comparator *pComparator,
+			   size_t nBuckets, unsigned nStripes);
+	~ConcurrentHashBase();
+
+	void *find(const Hashable *pKey);
+	void *insert(const Hashable *pKey, void *pElement);
+	void *replace(const Hashable *pKey, void *pElement);
+	void *remove(const Hashable *pKey);
+
+    private:
+	ConcurrentHashBase(const ConcurrentHashBase &);
+	ConcurrentHashBase &operator=(const ConcurrentHashBase &);
+
+	void *findNode(const ConcurrentHashTable *pTable,
+		       unsigned long hashValue, const void *pKey) const;
+	ConcurrentHashStripe *lockStripe(unsigned long hashValue);
+	void *update(const Hashable *pKey, void *pElement, bool overwrite);
+	void grow(const ConcurrentHashTable *pTable);
+
+	ConcurrentHashTable *pTable;
+	ConcurrentHashStripe *pStripe;
+	unsigned nStripes;
+	unsigned stripeShift;
+
+	size_t keyOffset;
+	const Comparator *pComparator;
+
+	EpochManager epochManager;
+    };
+
+
+    template<class element>
+    class ConcurrentHashMap :
+	public ConcurrentHashBase
+    {
+    public:
+	/*
+	  Construct an empty map.
+
+	  @param keyOffset offset of the key within an element
+	  @param pComparator comparator for keys; this must outlive the map
+	  @param nBuckets initial number of buckets, rounded up to a power of
+	    two
+	  @param nStripes the number of writer locks, rounded up to a power of
+	    two
+	*/
+	ConcurrentHashMap(size_t keyOffset, const Comparator *pComparator,
+			  size_t nBuckets = 1024, unsigned nStripes = 64);
+
+	/*
+	  The map does not own its elements, so they are not deleted.
+	*/
+	~ConcurrentHashMap();
+
+	/*
+	  find()
+
+	  @param pKey the key to look for
+	  @returns the element with a matching key, or NULL
+	*/
+	element *find(const Hashable *pKey);
+
+	/*
+	  insert()
+
+	  Add an element if there isn't already one with the same key.
+
+	  @param pKey the element's key
+	  @param pElement the element to add
+	  @returns NULL if the element was added, otherwise the element that
+	    already has that key
+	*/
+	element *insert(const Hashable *pKey, element *pElement);
+
+	/*
+	  replace()
+
+	  Add an element, replacing any element with the same key.
+
+	  @param pKey the element's key
+	  @param pElement the element to add
+	  @returns the element that was replaced, or NULL
+	*/
+	element *replace(const Hashable *pKey, element *pElement);
+
+	/*
+	  remove()
+
+	  @param pKey the key of the element to remove
+	  @returns the element that was removed, or NULL
+	*/
+	element *remove(const Hashable *pKey);
+
+	/*
+	  retire()
+
+	  Reclaim an element that was returned by replace() or remove() once
+	  no reader can still be using it.
+
+	  @param pElement the element
+	  @param reclaim function that will reclaim the element
+	*/
+	void retire(element *pElement, void (*reclaim)(element *pElement));
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline EpochManager *ConcurrentHashBase::getEpochManager()
+    {
+	return &epochManager;
+    }
+
+    template<class element>
+    inline ConcurrentHashMap<element>::ConcurrentHashMap(
+	size_t keyOffset, const Comparator *pComparator, size_t nBuckets,
+	unsigned nStripes):
+	ConcurrentHashBase(keyOffset, pComparator, nBuckets, nStripes)
+    {
+    }
+
+    template<class element>
+    inline ConcurrentHashMap<element>::~ConcurrentHashMap()
+    {
+    }
+
+    template<class element>
+    inline element *ConcurrentHashMap<element>::find(const Hashable *pKey)
+    {
+	return (element *)ConcurrentHashBase::find(pKey);
+    }
+
+    template<class element>
+    inline element *ConcurrentHashMap<element>::insert(
+	const Hashable *pKey, element *pElement)
+    {
+	return (element *)ConcurrentHashBase::insert(pKey, (void *)pElement);
+    }
+
+    template<class element>
+    inline element *ConcurrentHashMap<element>::replace(
+	const Hashable *pKey, element *pElement)
+    {
+	return (element *)ConcurrentHashBase::replace(pKey, (void *)pElement);
+    }
+
+    template<class element>
+    inline element *ConcurrentHashMap<element>::remove(const Hashable *pKey)
+    {
+	return (element *)ConcurrentHashBase::remove(pKey);
+    }
+
+    template<class element>
+    inline void ConcurrentHashMap<element>::retire(
+	element *pElement, void (*reclaim)(element *pElement))
+    {
+	getEpochManager()->retire(
+	    (void *)pElement, (void (*)(void *))reclaim);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_CONCURRENTHASHMAP_H */
@@ -0,0 +1,195 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ConsistentHash.h - route Hashable keys to shards
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    Two ways of assigning keys to shards so that changing the number of
+    shards moves as few keys as possible.
+
+    jumpHash() is Lamping and Veach's jump consistent hash (2014).  It needs
+    no memory at all, and spreads keys almost perfectly evenly, but the
+    shards are numbered [0, nShards), and can only be added or removed at
+    the end.  Growing from n to n + 1 shards moves 1/(n + 1) of the keys,
+    all to the new shard.
+
+    HashRing is a classic consistent hashing ring with virtual nodes.  Each
+    node is identified by a caller-chosen number, and is placed at a number
+    of points on the ring; a key belongs to the node that owns the first
+    point at or after the key's hash, found with lowerBound().  Any node can
+    be added or removed, and only the keys on its arcs move.  The load is
+    less even than with jumpHash(); more points per node even it out, at the
+    cost of a bigger ring.  Nodes can be given more points than others to
+    take more of the load.
+
+    Both have batch variants, which hash all of the keys first, so that the
+    lookups run back to back.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_CONSISTENTHASH_H
+#define PHOENIX4CPP_CONSISTENTHASH_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Hashable;
+
+    /*
+      jumpHash()
+
+      Find a key's shard with jump consistent hashing.
+
+      @param pKey the key
+      @param nShards the number of shards; must be at least one
+      @returns the shard number, in [0, nShards)
+    */
+    unsigned jumpHash(const Hashable *pKey, unsigned nShards);
+
+    /*
+      jumpHash()
+
+      Variant of the above for callers that already have the key's
+      HashValue::get64().
+    */
+    unsigned jumpHash(unsigned long long hashValue, unsigned nShards);
+
+    /*
+      jumpHashBatch()
+
+      Find the shards for a number of keys.
+
+      @param ppKeys pointers to the keys
+      @param n the number of keys
+      @param nShards the number of shards; must be at least one
+      @param pShards where to put the shard numbers, in the same order as
+        the keys
+    */
+    void jumpHashBatch(const Hashable *const *ppKeys, size_t n,
+		       unsigned nShards, unsigned *pShards);
+
+
+    struct HashRingPoint;
+
+    class HashRing
+    {
+    public:
+	/*
+	  Construct an empty ring.
+
+	  @param pointsPerNode the default number of points for each node
+	*/
+	HashRing(unsigned pointsPerNode = 128);
+	~HashRing();
+
+	/*
+	  addNode()
+
+	  @param node the node's number; this must not be noNode
+	  @param nPoints the number of points to place the node at; 0 means
+	    the default given to the constructor
+	  @returns true if the node was added, false if it was already there
+	*/
+	bool addNode(unsigned long node, unsigned nPoints = 0);
+
+	/*
+	  removeNode()
+
+	  @param node the node's number
+	  @returns true if the node was removed, false if it wasn't there
+	*/
+	bool removeNode(unsigned long node);
+
+	/*
+	  route()
+
+	  @param pKey the key
+	  @returns the number of the node that owns the key, or noNode if
+	    the ring is empty
+	*/
+	unsigned long route(const Hashable *pKey) const;
+
+	/*
+	  routeHash()
+
+	  Variant of route() for callers that already have the key's
+	  HashValue::get().
+	*/
+	unsigned long routeHash(unsigned long hashValue) const;
+
+	/*
+	  routeBatch()
+
+	  Route a number of keys.
+
+	  @param ppKeys pointers to the keys
+	  @param n the number of keys
+	  @param pNodes where to put the node numbers, in the same order as
+	    the keys
+	*/
+	void routeBatch(const Hashable *const *ppKeys, size_t n,
+			unsigned long *pNodes) const;
+
+	static const unsigned long noNode = ~0UL;
+
+	/*
+	  getNodeCount()
+
+	  @returns the number of nodes on the ring
+	*/
+	size_t getNodeCount() const;
+
+	/*
+	  getPointCount()
+
+	  @returns the number of points on the ring, for all nodes
+	*/
+	size_t getPointCount() const;
+
+    private:
+	HashRing(const HashRing &);
+	HashRing &operator=(const HashRing &);
+
+	bool hasNode(unsigned long node) const;
+
+	unsigned pointsPerNode;
+	size_t nNodes;
+
+	/* the points, sorted by hash value */
+	HashRingPoint *pPoint;
+	size_t nPoints;
+	size_t capacity;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t HashRing::getNodeCount() const
+    {
+	return nNodes;
+    }
+
+    inline size_t HashRing::getPointCount() const
+    {
+	return nPoints;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_CONSISTENTHASH_H */
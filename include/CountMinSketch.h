@@ -0,0 +1,244 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    CountMinSketch.h - approximate per-key frequencies for Hashable keys
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A count-min sketch keeps depth rows of width counters.  Each key maps
+    to one counter in every row, and its estimated frequency is the smallest
+    of those.  Estimates never undercount; with probability 1 - (1/2)^depth
+    they overcount by no more than about 2/width of the total of all counts.
+
+    Updates are conservative:  only the counters that are below the key's
+    new estimate are raised, which gives noticeably smaller overcounts than
+    incrementing every row.
+
+    A sketch may only be modified by one thread at a time.  To count from
+    several threads without contention, give each thread its own sketch,
+    and attach() it to a CountMinSketchFolder.  The threads add to their
+    own sketches without locks, and fold() adds whatever they have
+    counted since the last fold into the folder's combined sketch; it may
+    be called from any thread, while the others carry on counting.  Merged
+    and folded sketches are still upper bounds.
+
+    See HeavyHitters.h for finding the most frequent keys.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_COUNTMINSKETCH_H
+#define PHOENIX4CPP_COUNTMINSKETCH_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Hashable;
+    struct CountMinSketchAttached;
+
+    class CountMinSketch
+    {
+    public:
+	/*
+	  Construct an empty sketch.
+
+	  @param width the number of counters per row; this is rounded up to
+	    a power of two, and is at least 16
+	  @param depth the number of rows; this is clamped to [1, 16]
+	*/
+	CountMinSketch(size_t width = 2048, unsigned depth = 4);
+	~CountMinSketch();
+
+	/*
+	  add()
+
+	  Count occurrences of a key.
+
+	  @param pKey the key
+	  @param count the number of occurrences
+	  @returns the key's new estimated frequency
+	*/
+	unsigned long add(const Hashable *pKey, unsigned long count = 1);
+
+	/*
+	  estimate()
+
+	  @param pKey the key
+	  @returns the key's estimated frequency; this is never less than the
+	    true frequency
+	*/
+	unsigned long estimate(const Hashable *pKey) const;
+
+	/*
+	  Variants of the above for callers that already have the key's
+	  HashValue::get64().
+	*/
+	unsigned long addHash(unsigned long long hashValue,
+			      unsigned long count = 1);
+	unsigned long estimateHash(unsigned long long hashValue) const;
+
+	/*
+	  merge()
+
+	  Add another sketch's counts into this one.  Neither sketch may be
+	  attached to a CountMinSketchFolder.
+
+	  @param pOther the sketch to merge in
+	  @returns true on success, false if the dimensions are different
+	*/
+	bool merge(const CountMinSketch *pOther);
+
+	/*
+	  clear()
+
+	  Set all counts back to zero.  The sketch may not be attached to a
+	  CountMinSketchFolder.
+	*/
+	void clear();
+
+	/*
+	  getTotal()
+
+	  @returns the sum of all counts added, including merged ones
+	*/
+	unsigned long getTotal() const;
+
+	size_t getWidth() const;
+	unsigned getDepth() const;
+
+    private:
+	CountMinSketch(const CountMinSketch &);
+	CountMinSketch &operator=(const CountMinSketch &);
+
+	friend class CountMinSketchFolder;
+
+	unsigned long *pCounters;
+	size_t width;
+	unsigned widthBits;
+	unsigned depth;
+	unsigned long total;
+    };
+
+    /*
+      Combines the counts of per-thread sketches, while they are being
+      added to.
+    */
+    class CountMinSketchFolder
+    {
+    public:
+	/*
+	  Construct a folder with an empty combined sketch.
+
+	  @param width the number of counters per row, as for CountMinSketch
+	  @param depth the number of rows, as for CountMinSketch
+	*/
+	CountMinSketchFolder(size_t width = 2048, unsigned depth = 4);
+
+	/*
+	  Forget any sketches still attached, without folding them.
+	*/
+	~CountMinSketchFolder();
+
+	/*
+	  attach()
+
+	  Start folding a sketch's counts into the combined sketch.  Counts
+	  the sketch already has are included in the next fold.  Until it is
+	  detached, the sketch may only be added to, by one thread.
+
+	  @param pSketch the sketch
+	  @returns true on success, false if its dimensions are different
+	*/
+	bool attach(CountMinSketch *pSketch);
+
+	/*
+	  detach()
+
+	  Fold whatever a sketch has counted since the last fold, and stop
+	  folding it.  The sketch's thread must have stopped adding to it.
+
+	  @param pSketch the sketch, which must be attached
+	*/
+	void detach(CountMinSketch *pSketch);
+
+	/*
+	  fold()
+
+	  Add what every attached sketch has counted since the last fold to
+	  the combined sketch.  This may be called from any thread, at any
+	  time.
+	*/
+	void fold();
+
+	/*
+	  These are as for CountMinSketch, using the combined sketch as of
+	  the last fold.
+	*/
+	unsigned long estimate(const Hashable *pKey) const;
+	unsigned long estimateHash(unsigned long long hashValue) const;
+	unsigned long getTotal() const;
+
+	size_t getWidth() const;
+	unsigned getDepth() const;
+
+    private:
+	CountMinSketchFolder(const CountMinSketchFolder &);
+	CountMinSketchFolder &operator=(const CountMinSketchFolder &);
+
+	void foldOne(CountMinSketchAttached *pAttached);
+
+	mutable pthread_mutex_t mutex;
+	CountMinSketch combined;
+	CountMinSketchAttached *pAttached;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline unsigned long CountMinSketch::getTotal() const
+    {
+	return total;
+    }
+
+    inline size_t CountMinSketch::getWidth() const
+    {
+	return width;
+    }
+
+    inline unsigned CountMinSketch::getDepth() const
+    {
+	return depth;
+    }
+
+    inline size_t CountMinSketchFolder::getWidth() const
+    {
+	return combined.getWidth();
+    }
+
+    inline unsigned CountMinSketchFolder::getDepth() const
+    {
+	return combined.getDepth();
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_COUNTMINSKETCH_H */
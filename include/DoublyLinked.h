@@ -85,7 +85,39 @@ namespace phoenix4cpp
 	DoublyLinkedBase *getNext(const DoublyLinkedBase *pList) const;
 	DoublyLinkedBase *getPrevious(const DoublyLinkedBase *pList) const;
 
+	/*
+	  spliceBefore()
+
+	  Unlink the run of links from pFirst to pLast, inclusive, from
+	  wherever they are, and link them in before this one.  This must not
+	  be in the run.
+	*/
+	void spliceBefore(DoublyLinkedBase *pFirst, DoublyLinkedBase *pLast);
+
+	/*
+	  swapList()
+
+	  Exchange the contents of two list heads.
+	*/
+	void swapList(DoublyLinkedBase *pOther);
+
+	/*
+	  sortList()
+
+	  Stable sort of the list with this as its head.
+
+	  @param keyDisplacement the distance from a link to its element's key
+	  @param cmp comparison function for keys
+	*/
+	void sortList(ptrdiff_t keyDisplacement,
+		      int (*cmp)(const void *pl, const void *pr));
+
     private:
+	static DoublyLinkedBase *merge(
+	    DoublyLinkedBase *pLeft, DoublyLinkedBase *pRight,
+	    ptrdiff_t keyDisplacement,
+	    int (*cmp)(const void *pl, const void *pr));
+
 	DoublyLinkedBase *pNext;
 	DoublyLinkedBase *pPrevious;
     };
@@ -98,6 +130,13 @@ namespace phoenix4cpp
 	~DoublyLinkedMembership();
 
 	void remove();
+
+	/*
+	  isMember()
+
+	  @returns true if this membership is currently on a list
+	*/
+	bool isMember() const;
     };
 
 
@@ -123,6 +162,72 @@ namespace phoenix4cpp
 
 	bool isEmpty() const;
 
+	/*
+	  splice()
+
+	  Move all of the elements of another list into this one, in O(1).
+	  The other list is left empty.
+
+	  @param pBefore the element of this list to put them before, or NULL
+	    to put them at the end
+	  @param pOther the list to take the elements from
+	*/
+	void splice(element *pBefore, DoublyLinkedList *pOther);
+
+	/*
+	  splice()
+
+	  Move a run of elements from another list into this one, in O(1).
+	  The other list may be this list, as long as pBefore is not in the
+	  run.
+
+	  @param pBefore the element of this list to put them before, or NULL
+	    to put them at the end
+	  @param pOther the list the elements are on
+	  @param pFirst the first element of the run
+	  @param pLast the last element of the run; this may be pFirst, but
+	    must not come before it on pOther
+	*/
+	void splice(element *pBefore, DoublyLinkedList *pOther,
+		    element *pFirst, element *pLast);
+
+	/*
+	  swap()
+
+	  Exchange the contents of this list with another, in O(1).
+
+	  @param pOther the other list
+	*/
+	void swap(DoublyLinkedList *pOther);
+
+	/*
+	  sort()
+
+	  Sort the list in place with a stable bottom-up merge sort.  Keys are
+	  addressed as for qsort().  No memory is allocated.
+
+	  @params K the type of the key
+	  @param keyOffset offset of the key within an element
+	  @param cmp comparison function for keys; see compare.h for candidate
+	    functions
+	*/
+	template<class K>
+	void sort(size_t keyOffset, int (*cmp)(const K *pl, const K *pr));
+
+	/*
+	  clear()
+
+	  Remove every element from the list, handing each to a callback
+	  instead of deleting it, as the destructor would.  This can be used
+	  to return elements to a pool; see SlabPool::dispose().
+
+	  @params C the type of the callback's context
+	  @param release called for each element after it has been removed
+	  @param pContext passed to release
+	*/
+	template<class C>
+	void clear(void (*release)(C *pContext, element *pElement), C *pContext);
+
     private:
 	static element *toElement(const DoublyLinkedBase *pBase);
 	static DoublyLinkedBase *toBase(const element *pElement);
@@ -187,6 +292,46 @@ namespace phoenix4cpp
 	return (pPrevious == pList ? NULL : pPrevious);
     }
 
+    inline void DoublyLinkedBase::spliceBefore(
+	DoublyLinkedBase *pFirst, DoublyLinkedBase *pLast)
+    {
+	// close the gap the run leaves behind
+	pFirst->pPrevious->pNext = pLast->pNext;
+	pLast->pNext->pPrevious = pFirst->pPrevious;
+
+	// link the run in before this
+	pFirst->pPrevious = pPrevious;
+	pLast->pNext = this;
+	pPrevious->pNext = pFirst;
+	pPrevious = pLast;
+    }
+
+    inline void DoublyLinkedBase::swapList(DoublyLinkedBase *pOther)
+    {
+	DoublyLinkedBase *pMine = getNext(this);
+	DoublyLinkedBase *pMineLast = pPrevious;
+	DoublyLinkedBase *pTheirs = pOther->getNext(pOther);
+	DoublyLinkedBase *pTheirsLast = pOther->pPrevious;
+
+	initialize();
+	if (pTheirs)
+	{
+	    pNext = pTheirs;
+	    pPrevious = pTheirsLast;
+	    pTheirs->pPrevious = this;
+	    pTheirsLast->pNext = this;
+	}
+
+	pOther->initialize();
+	if (pMine)
+	{
+	    pOther->pNext = pMine;
+	    pOther->pPrevious = pMineLast;
+	    pMine->pPrevious = pOther;
+	    pMineLast->pNext = pOther;
+	}
+    }
+
     inline DoublyLinkedMembership::DoublyLinkedMembership()
     {
 	initialize();
@@ -203,6 +348,11 @@ namespace phoenix4cpp
 	initialize();
     }
 
+    inline bool DoublyLinkedMembership::isMember() const
+    {
+	return DoublyLinkedBase::getNext(this) != NULL;
+    }
+
 
     template<class element, size_t offset>
     inline DoublyLinkedList<element, offset>::DoublyLinkedList()
@@ -218,6 +368,19 @@ namespace phoenix4cpp
 	    delete pElement;
     }
 
+    template<class element, size_t offset>
+    template<class C>
+    inline void DoublyLinkedList<element, offset>::clear(
+	void (*release)(C *pContext, element *pElement), C *pContext)
+    {
+	element *pElement;
+	while((pElement = getFirst()))
+	{
+	    remove(pElement);
+	    (*release)(pContext, pElement);
+	}
+    }
+
     template<class element, size_t offset>
     inline void DoublyLinkedList<element, offset>::prepend(element *pElement)
     {
@@ -276,6 +439,51 @@ namespace phoenix4cpp
 	return NULL;
     }
 
+    template<class element, size_t offset>
+    inline bool DoublyLinkedList<element, offset>::isEmpty() const
+    {
+	return !DoublyLinkedBase::getNext(this);
+    }
+
+    template<class element, size_t offset>
+    inline void DoublyLinkedList<element, offset>::splice(
+	element *pBefore, DoublyLinkedList *pOther)
+    {
+	DoublyLinkedBase *pFirst = pOther->DoublyLinkedBase::getNext(pOther);
+	if (!pFirst)
+	    return;
+
+	DoublyLinkedBase *pLast = pOther->DoublyLinkedBase::getPrevious(pOther);
+	DoublyLinkedBase *pTo = (pBefore ? toBase(pBefore) : this);
+	pTo->spliceBefore(pFirst, pLast);
+    }
+
+    template<class element, size_t offset>
+    inline void DoublyLinkedList<element, offset>::splice(
+	element *pBefore, DoublyLinkedList *pOther,
+	element *pFirst, element *pLast)
+    {
+	DoublyLinkedBase *pTo = (pBefore ? toBase(pBefore) : this);
+	pTo->spliceBefore(toBase(pFirst), toBase(pLast));
+    }
+
+    template<class element, size_t offset>
+    inline void DoublyLinkedList<element, offset>::swap(
+	DoublyLinkedList *pOther)
+    {
+	swapList(pOther);
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline void DoublyLinkedList<element, offset>::sort(
+	size_t keyOffset, int (*cmp)(const K *pl, const K *pr))
+    {
+	/* as for qsort(), the template only provides type safety */
+	sortList((ptrdiff_t)keyOffset - (ptrdiff_t)offset,
+		 (int (*)(const void *, const void *))cmp);
+    }
+
     template<class element, size_t offset>
     inline void DoublyLinkedList<element, offset>::addAfter(
 	element *pNew, element *pWhich)
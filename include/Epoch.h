@@ -0,0 +1,144 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    Epoch.h - epoch-based memory reclamation for lock-free readers
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    Lock-free readers may still be looking at an object after a writer has
+    unlinked it from a shared structure, so the writer can't free it right
+    away.  Instead, readers announce themselves by entering the current epoch
+    for the duration of each read-side critical section, and writers retire
+    unlinked objects rather than freeing them.  A global epoch counter is
+    advanced whenever every active reader has caught up with it; an object
+    retired during epoch e is reclaimed once the global epoch reaches e + 2,
+    at which point no reader can still hold a reference to it.
+
+    Each thread that uses an EpochManager is given a record the first time it
+    enters or retires anything, and the record is released when the thread
+    exits, so there is no explicit registration.  enter() and exit() nest, so
+    a data structure can protect its own operations while callers protect
+    longer sections that use the results.  All managers share a single
+    pthread key, so there can be any number of them.
+
+    This uses pthreads and the gcc __atomic builtins.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_EPOCH_H
+#define PHOENIX4CPP_EPOCH_H
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+namespace phoenix4cpp
+{
+    struct EpochRecord;
+    struct EpochRetired;
+
+    class EpochManager
+    {
+    public:
+	EpochManager();
+
+	/*
+	  Reclaim everything that is still waiting.  No thread may be using
+	  the manager or any structure protected by it.
+	*/
+	~EpochManager();
+
+	/*
+	  enter()
+
+	  Begin a read-side critical section on the calling thread.  Objects
+	  reachable from shared structures will not be reclaimed until the
+	  matching exit().  Calls may be nested.
+	*/
+	void enter();
+
+	/*
+	  exit()
+
+	  End a read-side critical section begun with enter().
+	*/
+	void exit();
+
+	/*
+	  retire()
+
+	  Arrange for an object that has been unlinked from all shared
+	  structures to be reclaimed once no reader can still reference it.
+
+	  @param p pointer to the object
+	  @param reclaim function to call to reclaim the object
+	*/
+	void retire(void *p, void (*reclaim)(void *p));
+
+    private:
+	EpochManager(const EpochManager &);
+	EpochManager &operator=(const EpochManager &);
+
+	EpochRecord *getRecord();
+	bool tryAdvance();
+	void collect(EpochRecord *pRecord);
+	void collectOrphans();
+
+	static void createKey();
+	static void threadExit(void *pRecords);
+
+	/* tells this manager's records apart from any earlier one's */
+	unsigned long id;
+	unsigned long globalEpoch;
+	EpochRecord *pRecords;
+
+	/* retired objects left behind by threads that have exited */
+	pthread_mutex_t orphanMutex;
+	EpochRetired *pOrphans;
+    };
+
+    /*
+      Convenience for scoping a read-side critical section.
+    */
+    class EpochGuard
+    {
+    public:
+	EpochGuard(EpochManager *pEpochManager);
+	~EpochGuard();
+
+    private:
+	EpochGuard(const EpochGuard &);
+	EpochGuard &operator=(const EpochGuard &);
+
+	EpochManager *pEpochManager;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline EpochGuard::EpochGuard(EpochManager *pManager):
+	pEpochManager(pManager)
+    {
+	pEpochManager->enter();
+    }
+
+    inline EpochGuard::~EpochGuard()
+    {
+	pEpochManager->exit();
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_EPOCH_H */
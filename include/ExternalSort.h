@@ -0,0 +1,135 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ExternalSort.h - sort a file of fixed size records that may not fit in
+    memory
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    Records are addressed the same way as for qsort() and bsearch(), with
+    a key at a fixed offset within each record, so the same comparison
+    functions (see compare.h) can be used.  A file is simply records one
+    after the other, with no header.
+
+    The input is read a memory-load at a time, each load is sorted with
+    qsort(), and written out as a run to a temporary file.  The runs are
+    then merged with a loser tree, which takes about log2(k) comparisons
+    per record to merge k runs.  If there are more runs than there is
+    memory to buffer at once, groups of them are merged into longer runs
+    first.  Temporary files are unlinked as soon as they are created, so
+    nothing is left behind if the process dies.
+
+    All reads and writes are of large aligned blocks, sequential within
+    each file, and are done by background threads, so that reading the
+    next load overlaps sorting the current one, and reading ahead in each
+    run overlaps merging.  With directIo, files are opened with O_DIRECT,
+    which bypasses the page cache; that keeps a sort from evicting
+    everything else that is cached, and saves copying every block.  File
+    systems that don't support O_DIRECT (such as tmpfs) fall back to
+    ordinary I/O.
+
+    The sort is not stable.  The input and output may be the same file.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_EXTERNALSORT_H
+#define PHOENIX4CPP_EXTERNALSORT_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+/*
+  Tuning for externalSort().  The defaults are set by the constructor, so
+  only the ones that matter need to be changed.
+*/
+class ExternalSortOptions
+{
+public:
+    ExternalSortOptions();
+
+    /* memory to use for sorting and buffering; default 256MB */
+    size_t memoryBytes;
+
+    /*
+      the size of each read and write while merging, rounded up to a
+      multiple of 4KB; default 1MB
+    */
+    size_t blockBytes;
+
+    /*
+      where to put temporary files; the default, NULL, uses $TMPDIR, or
+      /tmp if that isn't set
+    */
+    const char *pTempDirectory;
+
+    /* open files with O_DIRECT; default false */
+    bool directIo;
+};
+
+/*
+  externalSort() - sort a file of records
+
+  @param pInPath the file to sort; its size must be a multiple of size
+  @param pOutPath the file to write the sorted records to; this is created
+    if it doesn't exist, and replaced if it does
+  @param size size of a record
+  @param keyOffset offset of the key within a record
+  @param cmp comparison function used to compare keys; returns a value less
+    than zero if (*pl < *pr), zero if (*pl == *pr), or a value greater than zero
+    if (*pl > *pr); see compare.h for candidate functions
+  @param pOptions tuning options, or NULL for the defaults
+  @returns zero on success, or an errno value describing the first error
+    encountered; EINVAL if the input is not a whole number of records
+*/
+int externalSort(const char *pInPath, const char *pOutPath,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 const ExternalSortOptions *pOptions = NULL);
+
+/*
+  externalSort() - type-safe external sort
+
+  See the description of the type-unsafe externalSort() above.
+
+  @params T the type of the records
+  @params K the type of the key
+  @params keyOffset offset of the key within a record
+*/
+template<class T, class K, size_t keyOffset>
+int externalSort(const char *pInPath, const char *pOutPath,
+		 int (*cmp)(const K *pl, const K *pr),
+		 const ExternalSortOptions *pOptions = NULL);
+
+} // namespace phoenix4cpp
+
+
+/* ========================= PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+template<class T, class K, size_t keyOffset>
+inline int externalSort(const char *pInPath, const char *pOutPath,
+			int (*cmp)(const K *pl, const K *pr),
+			const ExternalSortOptions *pOptions)
+{
+    /* as for qsort(), this only provides type safety */
+    return externalSort(pInPath, pOutPath, sizeof(T), keyOffset,
+			(int (*)(const void *, const void *))cmp, pOptions);
+}
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_EXTERNALSORT_H */
@@ -0,0 +1,189 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HashJoin.h - hash join and group-by over arrays of records
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    These operate on arrays of fixed size records with a key at a fixed
+    offset, addressed the same way as for qsort() and bsearch(), so the
+    same hash functions (see hash.h) and comparison functions (see
+    compare.h) can be used for any of them.  The comparison function is
+    only used for equality here.
+
+    Both inputs are radix partitioned on the top bits of each key's
+    HashValue::get64(), with enough partitions that each partition's hash
+    table fits in the second level cache.  Each partition then gets a flat
+    chained hash table, built from the smaller side for a join.  Partitions
+    are processed by a number of threads, which take them from a shared
+    counter, as are the hashing and partitioning passes before that.
+
+    Results are delivered to a callback.  With more than one thread, the
+    callback is called concurrently from all of them, so it is passed the
+    number of the calling thread, in [0, nThreads), which can be used to
+    keep separate output for each.  The order in which results are
+    delivered is unspecified.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_HASHJOIN_H
+#define PHOENIX4CPP_HASHJOIN_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+
+class HashValue;
+
+/*
+  hashJoin() - equi-join two arrays of records
+
+  hashJoin() finds every pair of records, one from each array, with equal
+  keys, and passes each pair to the callback.
+
+  @param pLeft pointer to the base of the left array
+  @param nLeft the number of records in the left array
+  @param leftSize the size of a left record
+  @param leftKeyOffset offset of the key within a left record
+  @param pRight pointer to the base of the right array
+  @param nRight the number of records in the right array
+  @param rightSize the size of a right record
+  @param rightKeyOffset offset of the key within a right record
+  @param hash hash function for keys; see hash.h for candidate functions
+  @param cmp comparison function for keys; called with the left key first,
+    and returns zero if they are equal; see compare.h for candidate functions
+  @param emit callback for each matching pair of records
+  @param pContext passed to the callback
+  @param nThreads the number of threads to use, at most 64
+*/
+void hashJoin(const void *pLeft, size_t nLeft, size_t leftSize,
+	      size_t leftKeyOffset,
+	      const void *pRight, size_t nRight, size_t rightSize,
+	      size_t rightKeyOffset,
+	      void (*hash)(HashValue *pHashValue, const void *pKey),
+	      int (*cmp)(const void *pl, const void *pr),
+	      void (*emit)(void *pContext, unsigned thread,
+			   const void *pLeft, const void *pRight),
+	      void *pContext, unsigned nThreads = 1);
+
+/*
+  hashJoin() - type-safe equi-join
+
+  See the description of the type-unsafe hashJoin() above.
+
+  @params L the type of the left records
+  @params R the type of the right records
+  @params K the type of the key
+  @params C the type of the callback's context
+  @params leftKeyOffset offset of the key within a left record
+  @params rightKeyOffset offset of the key within a right record
+*/
+template<class L, class R, class K, class C,
+	 size_t leftKeyOffset, size_t rightKeyOffset>
+void hashJoin(const L *pLeft, size_t nLeft, const R *pRight, size_t nRight,
+	      void (*hash)(HashValue *pHashValue, const K *pKey),
+	      int (*cmp)(const K *pl, const K *pr),
+	      void (*emit)(C *pContext, unsigned thread,
+			   const L *pLeft, const R *pRight),
+	      C *pContext, unsigned nThreads = 1);
+
+/*
+  hashGroup() - group an array of records by key
+
+  hashGroup() finds the distinct keys in an array, and passes each group of
+  records with the same key to the callback.  The records of a group are in
+  the same order they are in the array.
+
+  @param pArray pointer to the base of the array
+  @param n the number of records in the array
+  @param size the size of a record
+  @param keyOffset offset of the key within a record
+  @param hash hash function for keys; see hash.h for candidate functions
+  @param cmp comparison function for keys; returns zero if they are equal;
+    see compare.h for candidate functions
+  @param emit callback for each group, with an array of pointers to the
+    group's records, which is only valid for the duration of the call
+  @param pContext passed to the callback
+  @param nThreads the number of threads to use, at most 64
+*/
+void hashGroup(const void *pArray, size_t n, size_t size, size_t keyOffset,
+	       void (*hash)(HashValue *pHashValue, const void *pKey),
+	       int (*cmp)(const void *pl, const void *pr),
+	       void (*emit)(void *pContext, unsigned thread,
+			    const void *const *ppGroup, size_t nGroup),
+	       void *pContext, unsigned nThreads = 1);
+
+/*
+  hashGroup() - type-safe group by
+
+  See the description of the type-unsafe hashGroup() above.
+
+  @params T the type of the records
+  @params K the type of the key
+  @params C the type of the callback's context
+  @params keyOffset offset of the key within a record
+*/
+template<class T, class K, class C, size_t keyOffset>
+void hashGroup(const T *pArray, size_t n,
+	       void (*hash)(HashValue *pHashValue, const K *pKey),
+	       int (*cmp)(const K *pl, const K *pr),
+	       void (*emit)(C *pContext, unsigned thread,
+			    const T *const *ppGroup, size_t nGroup),
+	       C *pContext, unsigned nThreads = 1);
+
+} // namespace phoenix4cpp
+
+
+/* ========================= PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+template<class L, class R, class K, class C,
+	 size_t leftKeyOffset, size_t rightKeyOffset>
+inline void hashJoin(const L *pLeft, size_t nLeft,
+		     const R *pRight, size_t nRight,
+		     void (*hash)(HashValue *pHashValue, const K *pKey),
+		     int (*cmp)(const K *pl, const K *pr),
+		     void (*emit)(C *pContext, unsigned thread,
+				  const L *pLeft, const R *pRight),
+		     C *pContext, unsigned nThreads)
+{
+    /* as for qsort(), this only provides type safety */
+    hashJoin((const void *)pLeft, nLeft, sizeof(L), leftKeyOffset,
+	     (const void *)pRight, nRight, sizeof(R), rightKeyOffset,
+	     (void (*)(HashValue *, const void *))hash,
+	     (int (*)(const void *, const void *))cmp,
+	     (void (*)(void *, unsigned, const void *, const void *))emit,
+	     (void *)pContext, nThreads);
+}
+
+template<class T, class K, class C, size_t keyOffset>
+inline void hashGroup(const T *pArray, size_t n,
+		      void (*hash)(HashValue *pHashValue, const K *pKey),
+		      int (*cmp)(const K *pl, const K *pr),
+		      void (*emit)(C *pContext, unsigned thread,
+				   const T *const *ppGroup, size_t nGroup),
+		      C *pContext, unsigned nThreads)
+{
+    /* as for qsort(), this only provides type safety */
+    hashGroup((const void *)pArray, n, sizeof(T), keyOffset,
+	      (void (*)(HashValue *, const void *))hash,
+	      (int (*)(const void *, const void *))cmp,
+	      (void (*)(void *, unsigned, const void *const *, size_t))emit,
+	      (void *)pContext, nThreads);
+}
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_HASHJOIN_H */
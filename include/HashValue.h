@@ -16,6 +16,13 @@
     is easy to combine values for concatenated keys; the HashValue provides
     methods for blending in data.  Those methods can be used any number of times
     on a single HashValue to compute a hash for a composite.
+
+    The accumulator is 64 bits wide on all platforms.  Blending only rotates
+    and xors, so the accumulated bits are not well mixed; get() and get64()
+    run the accumulator through a finalizer (the one from MurmurHash3) so
+    that every bit of the result depends on every bit blended in.  This
+    matters for consumers that use a subset of the bits, such as the top bits
+    for a register index in HyperLogLog, or the low bits for a bucket mask.
  */
 
 #pragma once
@@ -36,8 +43,21 @@ namespace phoenix4cpp
     public:
 	HashValue();
 
+	/**
+	  Get the hash value.
+
+	  @returns the hash value, truncated to the size of an unsigned long
+	 */
 	unsigned long get() const;
 
+	/**
+	  Get the full 64-bit hash value, regardless of the size of an
+	  unsigned long.
+
+	  @returns the hash value
+	 */
+	unsigned long long get64() const;
+
 	/**
 	  Blend the given value into the accumulated hash value.
 
@@ -66,7 +86,7 @@ namespace phoenix4cpp
 
 	void rotate();
 
-	unsigned long value;
+	unsigned long long value;
     };
 
 }
@@ -82,9 +102,20 @@ namespace phoenix4cpp
     {
     }
 
+    inline unsigned long long HashValue::get64() const
+    {
+	unsigned long long h = value;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+    }
+
     inline unsigned long HashValue::get() const
     {
-	return value;
+	return (unsigned long)get64();
     }
 
 }
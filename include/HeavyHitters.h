@@ -0,0 +1,201 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HeavyHitters.h - most frequent Hashable keys in bounded memory
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This is the space-saving algorithm of Metwally, Agrawal and El Abbadi
+    (2005).  A fixed number of keys are monitored, each with a count.  A key
+    that is not being monitored replaces the one with the smallest count,
+    and inherits that count as its possible overestimate (its error).  Any
+    key that occurs more than getTotal() / capacity times is guaranteed to
+    be monitored, and for every monitored key
+
+	count - error <= true frequency <= count
+
+    Keys are hashed with a Hashable, and compared with a Comparator, which
+    is handed the Hashable's raw pointer and a pointer to the tracker's copy
+    of the key.  The tracker copies keySize bytes from the raw pointer when
+    it starts monitoring a key; for HashableUnsignedLong, that is the value,
+    and for HashableString it is the string pointer, so such strings must
+    outlive the tracker (or be interned).
+
+    A tracker may only be modified by one thread at a time.  Per-thread
+    trackers can be combined with merge(), which follows the mergeable
+    summaries construction of Agarwal et al. (2012), and keeps the same
+    guarantees over the combined stream.  Unlike CountMinSketch, there is
+    no folder that reads trackers while they are being added to:  a key's
+    slot can be taken over by another key, so there is no difference to
+    fold.  Instead, each thread should periodically merge() its tracker
+    into a shared one under a lock, and then clear() its own.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_HEAVYHITTERS_H
+#define PHOENIX4CPP_HEAVYHITTERS_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Comparator;
+    class Hashable;
+
+    struct HeavyHittersSlot;
+
+    class HeavyHitters
+    {
+    public:
+	/*
+	  A monitored key.  pKey points to the tracker's copy of the key's
+	  raw value, and is only valid until the tracker is next modified.
+	*/
+	struct Entry
+	{
+	    const void *pKey;
+	    unsigned long count;
+	    unsigned long error;
+	};
+
+	/*
+	  Construct an empty tracker.
+
+	  @param capacity the number of keys to monitor
+	  @param keySize the number of bytes of a key's raw value to keep
+	  @param pComparator comparator for keys' raw values; this must
+	    outlive the tracker
+	*/
+	HeavyHitters(size_t capacity, size_t keySize,
+		     const Comparator *pComparator);
+	~HeavyHitters();
+
+	/*
+	  add()
+
+	  Count occurrences of a key.
+
+	  @param pKey the key
+	  @param count the number of occurrences
+	*/
+	void add(const Hashable *pKey, unsigned long count = 1);
+
+	/*
+	  find()
+
+	  @param pKey the key
+	  @param pEntry where to put the key's count and error, if it is
+	    being monitored
+	  @returns true if the key is being monitored, false otherwise
+	*/
+	bool find(const Hashable *pKey, Entry *pEntry) const;
+
+	/*
+	  getTop()
+
+	  Get the most frequent keys, most frequent first.
+
+	  @param pEntries where to put the entries
+	  @param n the maximum number of entries to return
+	  @returns the number of entries returned
+	*/
+	size_t getTop(Entry *pEntries, size_t n) const;
+
+	/*
+	  merge()
+
+	  Fold another tracker's counts into this one.
+
+	  @param pOther the tracker to merge in
+	  @returns true on success, false if the key sizes are different
+	*/
+	bool merge(const HeavyHitters *pOther);
+
+	/*
+	  clear()
+
+	  Forget all keys and counts.
+	*/
+	void clear();
+
+	size_t getCapacity() const;
+
+	/*
+	  getCount()
+
+	  @returns the number of keys being monitored
+	*/
+	size_t getCount() const;
+
+	/*
+	  getTotal()
+
+	  @returns the sum of all counts added, including merged ones
+	*/
+	unsigned long getTotal() const;
+
+    private:
+	HeavyHitters(const HeavyHitters &);
+	HeavyHitters &operator=(const HeavyHitters &);
+
+	size_t findSlot(unsigned long long hashValue, const void *pKey) const;
+	unsigned long getMinimum() const;
+	void indexInsert(size_t slot);
+	void indexRemove(size_t slot);
+	void heapSet(size_t position, size_t slot);
+	void siftUp(size_t position);
+	void siftDown(size_t position);
+
+	size_t capacity;
+	size_t keySize;
+	const Comparator *pComparator;
+
+	size_t nUsed;
+	unsigned long total;
+
+	HeavyHittersSlot *pSlot;
+	unsigned char *pKeys;
+
+	/* min-heap of slot numbers, ordered by count */
+	size_t *pHeap;
+
+	/* open addressing index of slot numbers plus one, by hash value */
+	size_t *pIndex;
+	unsigned indexBits;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t HeavyHitters::getCapacity() const
+    {
+	return capacity;
+    }
+
+    inline size_t HeavyHitters::getCount() const
+    {
+	return nUsed;
+    }
+
+    inline unsigned long HeavyHitters::getTotal() const
+    {
+	return total;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_HEAVYHITTERS_H */
@@ -0,0 +1,186 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HyperLogLog.h - cardinality estimation sketch for Hashable keys
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A HyperLogLog estimates the number of distinct keys it has seen in a
+    fixed amount of space, with a relative standard error of about
+    1.04/sqrt(2^precision); the default precision of 14 gives about 0.8%
+    using 16KB.  Sketches with the same precision can be merged, so distinct
+    counts can be kept per shard and combined afterwards.
+
+    This follows HLL++ (Heule, Nunkesser and Hall, 2013) in using the 64-bit
+    HashValue::get64(), and in starting out with a sparse representation
+    that records (index, rank) pairs at a higher precision of 25 bits.  That
+    is much smaller and much more accurate than the dense registers while
+    the number of distinct keys is small.  The sketch switches to dense
+    registers once the sparse list would be bigger than they are.
+
+    For the dense registers, this uses the estimator from Ertl, "New
+    cardinality estimation algorithms for HyperLogLog sketches" (2017),
+    rather than the empirically derived bias correction tables of HLL++.  It
+    is unbiased over the full range of cardinalities without needing any
+    tables.
+
+    Dense registers are merged with SIMD byte-wise maximum instructions
+    where they are available.
+
+    The serialized form is portable:  header fields are little-endian, sparse
+    sketches are stored as variable length deltas between sorted entries,
+    and dense registers are packed into 6 bits each.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_HYPERLOGLOG_H
+#define PHOENIX4CPP_HYPERLOGLOG_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Hashable;
+
+    class HyperLogLog
+    {
+    public:
+	/*
+	  Construct an empty sketch.
+
+	  @param precision the number of hash bits used to select a register;
+	    this is clamped to [4, 18]
+	*/
+	HyperLogLog(unsigned precision = 14);
+	~HyperLogLog();
+
+	/*
+	  add()
+
+	  Count a key.
+
+	  @param pKey the key
+	*/
+	void add(const Hashable *pKey);
+
+	/*
+	  addHash()
+
+	  Count a key, given its HashValue::get64().
+
+	  @param hashValue the key's hash value
+	*/
+	void addHash(unsigned long long hashValue);
+
+	/*
+	  estimate()
+
+	  @returns the estimated number of distinct keys added
+	*/
+	double estimate() const;
+
+	/*
+	  merge()
+
+	  Fold another sketch into this one, so that this one estimates the
+	  number of distinct keys added to either.
+
+	  @param pOther the sketch to merge in
+	  @returns true on success, false if the precisions are different
+	*/
+	bool merge(const HyperLogLog *pOther);
+
+	/*
+	  clear()
+
+	  Forget everything, and return to the sparse representation.
+	*/
+	void clear();
+
+	unsigned getPrecision() const;
+	bool isSparse() const;
+
+	/*
+	  getSerializedSize()
+
+	  @returns the number of bytes serialize() will write
+	*/
+	size_t getSerializedSize() const;
+
+	/*
+	  serialize()
+
+	  @param pBuffer where to write the sketch; it must be at least
+	    getSerializedSize() bytes long
+	*/
+	void serialize(void *pBuffer) const;
+
+	/*
+	  deserialize()
+
+	  Replace the contents of this sketch, including its precision, with
+	  a serialized one.
+
+	  @param pBuffer the serialized sketch
+	  @param length the length of the buffer
+	  @returns true on success, false if the buffer does not hold a valid
+	    sketch, in which case this sketch is left empty
+	*/
+	bool deserialize(const void *pBuffer, size_t length);
+
+    private:
+	HyperLogLog(const HyperLogLog &);
+	HyperLogLog &operator=(const HyperLogLog &);
+
+	void addSparse(unsigned entry);
+	void flush() const;
+	void toDense();
+	void mergeSparseEntry(unsigned entry);
+
+	unsigned precision;
+
+	/* dense registers, one byte each; NULL while sparse */
+	unsigned char *pRegisters;
+
+	/*
+	  The sparse list is sorted and has unique indexes; new entries are
+	  collected in an unsorted buffer, and folded into the list when it
+	  fills up, or before the list is used.  Folding doesn't change what
+	  the sketch represents, so it's done on const sketches too.
+	*/
+	mutable unsigned *pSparse;
+	mutable size_t nSparse;
+	mutable unsigned *pPending;
+	mutable size_t nPending;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline unsigned HyperLogLog::getPrecision() const
+    {
+	return precision;
+    }
+
+    inline bool HyperLogLog::isSparse() const
+    {
+	return !pRegisters;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_HYPERLOGLOG_H */
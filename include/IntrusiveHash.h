@@ -0,0 +1,314 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    IntrusiveHash.h - Intrusive hash table class
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This follows the same model as DoublyLinked.h.  The membership structure
+    is embedded in a client data structure that is to belong to a hash table,
+    and the table finds it using the offset template parameter.  The table
+    never allocates anything on behalf of an element; the only allocation is
+    the bucket array, which is a power of two in size.
+
+    Each membership caches the full hash value of its element's key.  Chains
+    are checked against the cached value before calling the comparison
+    function, and growing the table relinks the existing memberships into a
+    new bucket array without rehashing any keys or moving any elements.
+
+    Keys are addressed the same way as for bsearch() and qsort():  a key
+    offset within the element, and a pair of functions from compare.h and
+    hash.h.  Lookups take a Hashable, so any of the utility classes in
+    Hashable.h can be used to search the table for a local value.
+
+    Templates are used, but only for type safety.  All of the work is done by
+    IntrusiveHashBase, which operates on (void *).
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_INTRUSIVEHASH_H
+#define PHOENIX4CPP_INTRUSIVEHASH_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class HashValue;
+    class Hashable;
+
+    /*
+      Embed one of these in any element that is to belong to an
+      IntrusiveHashTable.  An element may only belong to one table via a given
+      membership at a time, and must be removed from the table before it is
+      destroyed.
+    */
+    class IntrusiveHashMembership
+    {
+    public:
+	IntrusiveHashMembership();
+
+	/*
+	  isMember()
+
+	  @returns true if this membership is currently in a table
+	*/
+	bool isMember() const;
+
+    private:
+	friend class IntrusiveHashBase;
+
+	/*
+	  The next membership on the same chain, or NULL at the end of the
+	  chain.  As with DoublyLinkedBase::initialize(), a membership that is
+	  not in a table points to itself.
+	*/
+	IntrusiveHashMembership *pNext;
+	unsigned long hashValue;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of IntrusiveHashTable.  See that class for usage.
+    */
+    class IntrusiveHashBase
+    {
+    public:
+	size_t getCount() const;
+	bool isEmpty() const;
+	size_t getBucketCount() const;
+
+	/*
+	  resize()
+
+	  Relink all the elements into a new bucket array.  Elements are not
+	  moved, and keys are not rehashed.  This happens automatically as the
+	  table grows, but can be used to presize a table that is about to be
+	  loaded, or to shrink one after many removals.
+
+	  @param nBuckets the new number of buckets; this is rounded up to a
+	    power of two
+	*/
+	void resize(size_t nBuckets);
+
+    protected:
+	IntrusiveHashBase(size_t membershipOffset, size_t keyOffset,
+			  void (*hash)(HashValue *pHashValue, const void *pKey),
+			  int (*cmp)(const void *pl, const void *pr),
+			  size_t nBuckets);
+	~IntrusiveHashBase();
+
+	void add(void *pElement);
+	void add(void *pElement, unsigned long hashValue);
+	void remove(void *pElement);
+	void *find(const Hashable *pKey) const;
+	void *find(unsigned long hashValue, const void *pKey) const;
+	void *findNext(const Hashable *pKey, const void *pElement) const;
+
+	void *getFirst() const;
+	void *getNext(const void *pElement) const;
+
+    private:
+	IntrusiveHashBase(const IntrusiveHashBase &);
+	IntrusiveHashBase &operator=(const IntrusiveHashBase &);
+
+	size_t bucketIndex(unsigned long hashValue) const;
+	IntrusiveHashMembership *toMembership(const void *pElement) const;
+	void *toElement(const IntrusiveHashMembership *pMembership) const;
+	void *findFrom(const IntrusiveHashMembership *pMembership,
+		       unsigned long hashValue, const void *pKey) const;
+	void *firstFrom(size_t bucket) const;
+
+	IntrusiveHashMembership **ppBucket;
+	unsigned shift;   /* bits to shift a scrambled hash to get a bucket */
+	size_t nBuckets;
+	size_t count;
+
+	size_t membershipOffset;
+	size_t keyOffset;
+	void (*hash)(HashValue *pHashValue, const void *pKey);
+	int (*cmp)(const void *pl, const void *pr);
+    };
+
+
+    template<class element, size_t offset>
+    class IntrusiveHashTable :
+	public IntrusiveHashBase
+    {
+    public:
+	/*
+	  Construct an empty table.
+
+	  @params K the type of the key
+	  @param keyOffset offset of the key within an element
+	  @param hash hash function for keys; see hash.h for candidate
+	    functions; it must blend in the same values as the Hashable used
+	    for lookups
+	  @param cmp comparison function for keys; see compare.h for candidate
+	    functions
+	  @param nBuckets initial number of buckets, rounded up to a power of
+	    two
+	*/
+	template<class K>
+	IntrusiveHashTable(size_t keyOffset,
+			   void (*hash)(HashValue *pHashValue, const K *pKey),
+			   int (*cmp)(const K *pl, const K *pr),
+			   size_t nBuckets = 16);
+
+	/*
+	  Like DoublyLinkedList, the table owns its elements; any that are
+	  still in the table are deleted.
+	*/
+	~IntrusiveHashTable();
+
+	/*
+	  add()
+
+	  Add an element to the table.  Duplicate keys are not checked for;
+	  use find() first if that matters.
+	*/
+	void add(element *pElement);
+	void remove(element *pElement);
+
+	/*
+	  find()
+
+	  @param pKey the key to look for
+	  @returns an element with a matching key, or NULL
+	*/
+	element *find(const Hashable *pKey) const;
+
+	/*
+	  findNext()
+
+	  Iterate over elements with duplicate keys.
+
+	  @param pKey the key to look for
+	  @param pElement an element previously returned by find() or
+	    findNext() with the same key
+	  @returns the next element with a matching key, or NULL
+	*/
+	element *findNext(const Hashable *pKey, const element *pElement) const;
+
+	/*
+	  Iterate over all of the elements in the table, in no particular
+	  order.  The table must not be modified during the iteration.
+	*/
+	element *getFirst() const;
+	element *getNext(const element *pElement) const;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline IntrusiveHashMembership::IntrusiveHashMembership():
+	pNext(this),
+	hashValue(0)
+    {
+    }
+
+    inline bool IntrusiveHashMembership::isMember() const
+    {
+	return pNext != this;
+    }
+
+    inline size_t IntrusiveHashBase::getCount() const
+    {
+	return count;
+    }
+
+    inline bool IntrusiveHashBase::isEmpty() const
+    {
+	return !count;
+    }
+
+    inline size_t IntrusiveHashBase::getBucketCount() const
+    {
+	return nBuckets;
+    }
+
+
+    template<class element, size_t offset>
+    template<class K>
+    inline IntrusiveHashTable<element, offset>::IntrusiveHashTable(
+	size_t keyOffset, void (*hash)(HashValue *pHashValue, const K *pKey),
+	int (*cmp)(const K *pl, const K *pr), size_t nBuckets):
+	IntrusiveHashBase(
+	    offset, keyOffset,
+	    (void (*)(HashValue *, const void *))hash,
+	    (int (*)(const void *, const void *))cmp, nBuckets)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline IntrusiveHashTable<element, offset>::~IntrusiveHashTable()
+    {
+	element *pNext;
+	for(element *pElement = getFirst(); pElement; pElement = pNext)
+	{
+	    pNext = getNext(pElement);
+	    remove(pElement);
+	    delete pElement;
+	}
+    }
+
+    template<class element, size_t offset>
+    inline void IntrusiveHashTable<element, offset>::add(element *pElement)
+    {
+	IntrusiveHashBase::add((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline void IntrusiveHashTable<element, offset>::remove(element *pElement)
+    {
+	IntrusiveHashBase::remove((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveHashTable<element, offset>::find(
+	const Hashable *pKey) const
+    {
+	return (element *)IntrusiveHashBase::find(pKey);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveHashTable<element, offset>::findNext(
+	const Hashable *pKey, const element *pElement) const
+    {
+	return (element *)IntrusiveHashBase::findNext(
+	    pKey, (const void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveHashTable<element, offset>::getFirst() const
+    {
+	return (element *)IntrusiveHashBase::getFirst();
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveHashTable<element, offset>::getNext(
+	const element *pElement) const
+    {
+	return (element *)IntrusiveHashBase::getNext((const void *)pElement);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_INTRUSIVEHASH_H */
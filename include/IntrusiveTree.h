@@ -0,0 +1,367 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    IntrusiveTree.h - Intrusive red-black tree class
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This follows the same model as DoublyLinked.h and IntrusiveHash.h.  The
+    membership structure is embedded in a client data structure that is to
+    belong to a tree, and the tree finds it using the offset template
+    parameter.  The tree never allocates anything, so elements can be
+    inserted and removed in O(log n) time without any heap traffic.
+
+    Keys are addressed the same way as for bsearch() and qsort():  a key
+    offset within the element, and a comparison function from compare.h.
+    Duplicate keys are allowed; they are kept in the order in which they
+    were inserted.  Use insertUnique() to get set or map semantics instead.
+
+    Removing an element that is already in hand needs no search.  Red-black
+    trees need at most three rotations to rebalance after a removal, and
+    the recoloring that goes up the tree is O(1) amortized, so the cost of
+    remove() doesn't depend on the size of the tree in the long run.
+
+    Templates are used, but only for type safety.  All of the work is done
+    by IntrusiveTreeBase, which operates on (void *).
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_INTRUSIVETREE_H
+#define PHOENIX4CPP_INTRUSIVETREE_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+
+    /*
+      Embed one of these in any element that is to belong to an
+      IntrusiveTree.  An element may only belong to one tree via a given
+      membership at a time, and must be removed from the tree before it is
+      destroyed.
+    */
+    class IntrusiveTreeMembership
+    {
+    public:
+	IntrusiveTreeMembership();
+
+	/*
+	  isMember()
+
+	  @returns true if this membership is currently in a tree
+	*/
+	bool isMember() const;
+
+    private:
+	friend class IntrusiveTreeBase;
+
+	/*
+	  The root's parent is NULL.  As with IntrusiveHashMembership, a
+	  membership that is not in a tree points to itself.
+	*/
+	IntrusiveTreeMembership *pParent;
+	IntrusiveTreeMembership *pLeft;
+	IntrusiveTreeMembership *pRight;
+	bool red;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of IntrusiveTree.  See that class for usage.
+    */
+    class IntrusiveTreeBase
+    {
+    public:
+	size_t getCount() const;
+	bool isEmpty() const;
+
+	/*
+	  verify()
+
+	  Check the ordering of the keys and all of the red-black tree
+	  invariants.  This visits every element, and is meant for tests.
+
+	  @returns true if the tree is consistent
+	*/
+	bool verify() const;
+
+    protected:
+	IntrusiveTreeBase(size_t membershipOffset, size_t keyOffset,
+			  int (*cmp)(const void *pl, const void *pr));
+
+	void insert(void *pElement);
+	void *insertUnique(void *pElement);
+	void remove(void *pElement);
+	void *find(const void *pKey) const;
+	void *lowerBound(const void *pKey) const;
+	void *upperBound(const void *pKey) const;
+
+	void *getFirst() const;
+	void *getLast() const;
+	void *getNext(const void *pElement) const;
+	void *getPrevious(const void *pElement) const;
+
+    private:
+	IntrusiveTreeBase(const IntrusiveTreeBase &);
+	IntrusiveTreeBase &operator=(const IntrusiveTreeBase &);
+
+	static bool isRed(const IntrusiveTreeMembership *pM);
+	static IntrusiveTreeMembership *leftmost(IntrusiveTreeMembership *pM);
+	static IntrusiveTreeMembership *rightmost(IntrusiveTreeMembership *pM);
+	IntrusiveTreeMembership *toMembership(const void *pElement) const;
+	void *toElement(const IntrusiveTreeMembership *pMembership) const;
+	const void *getKey(const IntrusiveTreeMembership *pMembership) const;
+	void link(IntrusiveTreeMembership *pM,
+		  IntrusiveTreeMembership *pParent,
+		  IntrusiveTreeMembership **ppLink);
+	void replaceChild(IntrusiveTreeMembership *pParent,
+			  IntrusiveTreeMembership *pOld,
+			  IntrusiveTreeMembership *pNew);
+	void rotateLeft(IntrusiveTreeMembership *pM);
+	void rotateRight(IntrusiveTreeMembership *pM);
+	void insertFixup(IntrusiveTreeMembership *pM);
+	void removeFixup(IntrusiveTreeMembership *pM,
+			 IntrusiveTreeMembership *pParent);
+	size_t verifySubtree(const IntrusiveTreeMembership *pM,
+			     size_t *pCount) const;
+
+	IntrusiveTreeMembership *pRoot;
+	size_t count;
+
+	size_t membershipOffset;
+	size_t keyOffset;
+	int (*cmp)(const void *pl, const void *pr);
+    };
+
+
+    template<class element, size_t offset>
+    class IntrusiveTree :
+	public IntrusiveTreeBase
+    {
+    public:
+	/*
+	  Construct an empty tree.
+
+	  @params K the type of the key
+	  @param keyOffset offset of the key within an element
+	  @param cmp comparison function for keys; see compare.h for candidate
+	    functions
+	*/
+	template<class K>
+	IntrusiveTree(size_t keyOffset, int (*cmp)(const K *pl, const K *pr));
+
+	/*
+	  Like DoublyLinkedList, the tree owns its elements; any that are
+	  still in the tree are deleted.
+	*/
+	~IntrusiveTree();
+
+	/*
+	  insert()
+
+	  Add an element to the tree.  If there are already elements with the
+	  same key, the new one goes after them.
+	*/
+	void insert(element *pElement);
+
+	/*
+	  insertUnique()
+
+	  Add an element to the tree, unless there is already one with the
+	  same key.
+
+	  @param pElement the element to add
+	  @returns NULL if pElement was added, or else the element already in
+	    the tree with the same key; pElement is left alone in that case
+	*/
+	element *insertUnique(element *pElement);
+
+	/*
+	  remove()
+
+	  Remove an element from the tree.  This doesn't search for the
+	  element, or delete it.
+	*/
+	void remove(element *pElement);
+
+	/*
+	  find()
+
+	  @params K the type of the key
+	  @param pKey the key to look for
+	  @returns an element with a matching key, or NULL; if the key appears
+	    more than once, this may be any of the matching elements
+	*/
+	template<class K>
+	element *find(const K *pKey) const;
+
+	/*
+	  lowerBound()
+
+	  @params K the type of the key
+	  @param pKey the key to look for
+	  @returns the first element whose key is not less than *pKey, or NULL
+	    if there is none
+	*/
+	template<class K>
+	element *lowerBound(const K *pKey) const;
+
+	/*
+	  upperBound()
+
+	  @params K the type of the key
+	  @param pKey the key to look for
+	  @returns the first element whose key is greater than *pKey, or NULL
+	    if there is none
+	*/
+	template<class K>
+	element *upperBound(const K *pKey) const;
+
+	/*
+	  Iterate over the elements in key order, in either direction.  An
+	  element that is returned may be removed before moving on from it, as
+	  long as the next one is found first.  Each step is O(1) amortized.
+	*/
+	element *getFirst() const;
+	element *getLast() const;
+	element *getNext(const element *pElement) const;
+	element *getPrevious(const element *pElement) const;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline IntrusiveTreeMembership::IntrusiveTreeMembership():
+	pParent(this),
+	pLeft(NULL),
+	pRight(NULL),
+	red(false)
+    {
+    }
+
+    inline bool IntrusiveTreeMembership::isMember() const
+    {
+	return pParent != this;
+    }
+
+    inline size_t IntrusiveTreeBase::getCount() const
+    {
+	return count;
+    }
+
+    inline bool IntrusiveTreeBase::isEmpty() const
+    {
+	return !count;
+    }
+
+
+    template<class element, size_t offset>
+    template<class K>
+    inline IntrusiveTree<element, offset>::IntrusiveTree(
+	size_t keyOffset, int (*cmp)(const K *pl, const K *pr)):
+	IntrusiveTreeBase(
+	    offset, keyOffset, (int (*)(const void *, const void *))cmp)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline IntrusiveTree<element, offset>::~IntrusiveTree()
+    {
+	element *pElement;
+	while((pElement = getFirst()))
+	{
+	    remove(pElement);
+	    delete pElement;
+	}
+    }
+
+    template<class element, size_t offset>
+    inline void IntrusiveTree<element, offset>::insert(element *pElement)
+    {
+	IntrusiveTreeBase::insert((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveTree<element, offset>::insertUnique(
+	element *pElement)
+    {
+	return (element *)IntrusiveTreeBase::insertUnique((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline void IntrusiveTree<element, offset>::remove(element *pElement)
+    {
+	IntrusiveTreeBase::remove((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline element *IntrusiveTree<element, offset>::find(const K *pKey) const
+    {
+	return (element *)IntrusiveTreeBase::find((const void *)pKey);
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline element *IntrusiveTree<element, offset>::lowerBound(
+	const K *pKey) const
+    {
+	return (element *)IntrusiveTreeBase::lowerBound((const void *)pKey);
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline element *IntrusiveTree<element, offset>::upperBound(
+	const K *pKey) const
+    {
+	return (element *)IntrusiveTreeBase::upperBound((const void *)pKey);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveTree<element, offset>::getFirst() const
+    {
+	return (element *)IntrusiveTreeBase::getFirst();
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveTree<element, offset>::getLast() const
+    {
+	return (element *)IntrusiveTreeBase::getLast();
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveTree<element, offset>::getNext(
+	const element *pElement) const
+    {
+	return (element *)IntrusiveTreeBase::getNext((const void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *IntrusiveTree<element, offset>::getPrevious(
+	const element *pElement) const
+    {
+	return (element *)IntrusiveTreeBase::getPrevious(
+	    (const void *)pElement);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_INTRUSIVETREE_H */
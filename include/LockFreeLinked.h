@@ -0,0 +1,275 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    LockFreeLinked.h - Lock-free intrusive MPSC queue and stack
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    These follow the same model as DoublyLinked.h.  A LockFreeMembership
+    is embedded in a client data structure that is to be passed between
+    threads, and the containers find it using the offset template
+    parameter.  Neither container allocates anything.
+
+    MpscQueue is Dmitry Vyukov's intrusive multiple producer, single
+    consumer queue.  Any number of threads may push() at once, with a
+    single atomic exchange each, but only one thread at a time may pop().
+    The queue is not linearizable:  a producer that has been preempted in
+    the middle of a push() hides elements pushed after its own from the
+    consumer until it resumes, so pop() may return NULL while the queue is
+    not empty.  Consumers that wait for elements should treat NULL as
+    "try again later", not as "empty".
+
+    LockFreeStack is a Treiber stack.  To protect against ABA, where a pop
+    sees the same element on top before and after other threads have
+    popped and pushed it again, the top is a tagged pointer:  a
+    modification count is kept in the top 16 bits of the pointer, which
+    assumes that user space addresses fit in 48 bits, as they do on
+    x86-64 and AArch64 with 4 level page tables.  A pop() reads the next
+    link of an element that another thread may have just popped, so
+    elements that are pushed on a stack must not be returned to the
+    operating system while any thread might be popping from it; recycling
+    them through a pool is fine.
+
+    Neither container owns its elements, and they are not deleted.
+
+    Templates are used, but only for type safety.  All of the work is done
+    by MpscQueueBase and LockFreeStackBase, which operate on memberships.
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_LOCKFREELINKED_H
+#define PHOENIX4CPP_LOCKFREELINKED_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+
+    /*
+      Embed one of these in any element that is to go on an MpscQueue or a
+      LockFreeStack.  An element may only be on one container via a given
+      membership at a time.
+    */
+    class LockFreeMembership
+    {
+    public:
+	LockFreeMembership();
+
+    private:
+	friend class MpscQueueBase;
+	friend class LockFreeStackBase;
+
+	LockFreeMembership *pNext;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of MpscQueue.  See that class for usage.
+    */
+    class MpscQueueBase
+    {
+    public:
+	/*
+	  isEmpty()
+
+	  May only be called by the consumer.  This has the same caveat as
+	  pop(): it may return true while a push() is in progress.
+
+	  @returns true if there is nothing for the consumer to pop()
+	*/
+	bool isEmpty() const;
+
+    protected:
+	MpscQueueBase();
+
+	void push(LockFreeMembership *pM);
+	LockFreeMembership *pop();
+
+    private:
+	MpscQueueBase(const MpscQueueBase &);
+	MpscQueueBase &operator=(const MpscQueueBase &);
+
+	/*
+	  The producers' end, and the consumer's end, kept on separate cache
+	  lines so that they don't slow each other down.
+	*/
+	LockFreeMembership *pHead;
+	char padHead[64 - sizeof(LockFreeMembership *)];
+	LockFreeMembership *pTail;
+	LockFreeMembership stub;
+	char padTail[64 - 2 * sizeof(LockFreeMembership *)];
+    };
+
+
+    template<class element, size_t offset>
+    class MpscQueue :
+	public MpscQueueBase
+    {
+    public:
+	MpscQueue();
+
+	/*
+	  push()
+
+	  Add an element at the end of the queue.  Any thread may call this.
+
+	  @param pElement the element to add
+	*/
+	void push(element *pElement);
+
+	/*
+	  pop()
+
+	  Remove the element at the front of the queue.  Only one thread at a
+	  time may call this.
+
+	  @returns the element, or NULL if there is none available; see the
+	    notes above
+	*/
+	element *pop();
+
+    private:
+	static element *toElement(LockFreeMembership *pM);
+    };
+
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of LockFreeStack.  See that class for usage.
+    */
+    class LockFreeStackBase
+    {
+    public:
+	/*
+	  isEmpty()
+
+	  @returns true if the stack is empty; this is only a snapshot if
+	    other threads are using the stack
+	*/
+	bool isEmpty() const;
+
+    protected:
+	LockFreeStackBase();
+
+	void push(LockFreeMembership *pM);
+	LockFreeMembership *pop();
+
+    private:
+	LockFreeStackBase(const LockFreeStackBase &);
+	LockFreeStackBase &operator=(const LockFreeStackBase &);
+
+	/* the top membership's address, tagged with a modification count */
+	unsigned long long top;
+    };
+
+
+    template<class element, size_t offset>
+    class LockFreeStack :
+	public LockFreeStackBase
+    {
+    public:
+	LockFreeStack();
+
+	/*
+	  push()
+
+	  Push an element onto the stack.  Any thread may call this.
+
+	  @param pElement the element to push
+	*/
+	void push(element *pElement);
+
+	/*
+	  pop()
+
+	  Pop the element on top of the stack.  Any thread may call this.
+
+	  @returns the element, or NULL if the stack is empty
+	*/
+	element *pop();
+
+    private:
+	static element *toElement(LockFreeMembership *pM);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline LockFreeMembership::LockFreeMembership():
+	pNext(NULL)
+    {
+    }
+
+
+    template<class element, size_t offset>
+    inline MpscQueue<element, offset>::MpscQueue()
+    {
+    }
+
+    template<class element, size_t offset>
+    inline void MpscQueue<element, offset>::push(element *pElement)
+    {
+	MpscQueueBase::push(
+	    (LockFreeMembership *)(((char *)pElement) + offset));
+    }
+
+    template<class element, size_t offset>
+    inline element *MpscQueue<element, offset>::pop()
+    {
+	return toElement(MpscQueueBase::pop());
+    }
+
+    template<class element, size_t offset>
+    inline element *MpscQueue<element, offset>::toElement(
+	LockFreeMembership *pM)
+    {
+	return (pM ? (element *)(((char *)pM) - offset) : NULL);
+    }
+
+
+    template<class element, size_t offset>
+    inline LockFreeStack<element, offset>::LockFreeStack()
+    {
+    }
+
+    template<class element, size_t offset>
+    inline void LockFreeStack<element, offset>::push(element *pElement)
+    {
+	LockFreeStackBase::push(
+	    (LockFreeMembership *)(((char *)pElement) + offset));
+    }
+
+    template<class element, size_t offset>
+    inline element *LockFreeStack<element, offset>::pop()
+    {
+	return toElement(LockFreeStackBase::pop());
+    }
+
+    template<class element, size_t offset>
+    inline element *LockFreeStack<element, offset>::toElement(
+	LockFreeMembership *pM)
+    {
+	return (pM ? (element *)(((char *)pM) - offset) : NULL);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_LOCKFREELINKED_H */
@@ -0,0 +1,625 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    LruCache.h - Intrusive bounded cache with LRU, CLOCK, or SIEVE eviction
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This follows the same model as DoublyLinked.h and IntrusiveHash.h.  An
+    LruCacheMembership is embedded in each client element, and holds both
+    the element's hash table membership and its place in the eviction
+    order, so neither a hit nor an insertion allocates anything.  The only
+    allocation is the hash table's bucket array.
+
+    Each element has a charge, which is counted against the cache's
+    capacity.  With a charge of one per element the capacity is a count of
+    elements; with a charge of the element's size, it is a number of bytes.
+
+    There are three eviction policies.  LRU moves an element to the front
+    of the list on every hit.  CLOCK and SIEVE only set a flag in the
+    element on a hit, which is cheaper, and which lets ShardedLruCache
+    serve hits under a shared lock; the list is only rearranged when an
+    element is evicted.  CLOCK sweeps a hand around the elements as a ring,
+    giving referenced elements a second chance.  SIEVE (Zhang et al.,
+    "SIEVE is Simpler than LRU", NSDI 2024) keeps elements in insertion
+    order, and sweeps its hand from the oldest towards the newest, so that
+    elements that survive a sweep aren't moved, and new elements that
+    aren't hit are evicted quickly.
+
+    Evicted elements are passed to a callback; if there isn't one, the
+    cache owns its elements, and deletes them, as DoublyLinkedList does.
+
+    Templates are used, but only for type safety.  All of the work is done by
+    LruCacheBase and ShardedLruCacheBase, which operate on (void *).
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_LRUCACHE_H
+#define PHOENIX4CPP_LRUCACHE_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+#ifndef PHOENIX4CPP_DOUBLYLINKED_H
+#include "DoublyLinked.h"
+#endif
+
+#ifndef PHOENIX4CPP_INTRUSIVEHASH_H
+#include "IntrusiveHash.h"
+#endif
+
+namespace phoenix4cpp
+{
+    class HashValue;
+    class Hashable;
+
+    /*
+      Embed one of these in any element that is to belong to an LruCache or
+      ShardedLruCache.  An element may only belong to one cache via a given
+      membership at a time.
+    */
+    class LruCacheMembership
+    {
+    public:
+	LruCacheMembership();
+
+	/*
+	  isMember()
+
+	  @returns true if this membership is currently in a cache
+	*/
+	bool isMember() const;
+
+    private:
+	friend class LruCacheBase;
+
+	IntrusiveHashMembership hashMembership;
+	DoublyLinkedMembership listMembership;
+	size_t charge;
+	unsigned char referenced; /* hit since the hand passed; CLOCK, SIEVE */
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of LruCache.  See that class for usage.
+    */
+    class LruCacheBase :
+	private IntrusiveHashBase
+    {
+    public:
+	enum Policy
+	{
+	    LRU,
+	    CLOCK,
+	    SIEVE
+	};
+
+	/*
+	  getCount()
+
+	  @returns the number of elements in the cache
+	*/
+	size_t getCount() const;
+
+	/*
+	  getCharge()
+
+	  @returns the sum of the charges of the elements in the cache
+	*/
+	size_t getCharge() const;
+
+	size_t getCapacity() const;
+	Policy getPolicy() const;
+
+	/*
+	  setCapacity()
+
+	  Change the capacity, evicting elements if the cache is now over it.
+
+	  @param capacity the new capacity
+	*/
+	void setCapacity(size_t capacity);
+
+	/*
+	  clear()
+
+	  Evict all of the elements.
+	*/
+	void clear();
+
+    protected:
+	LruCacheBase(size_t membershipOffset, size_t keyOffset,
+		     void (*hash)(HashValue *pHashValue, const void *pKey),
+		     int (*cmp)(const void *pl, const void *pr),
+		     size_t capacity, Policy policy,
+		     void (*evict)(void *pContext, void *pElement),
+		     void *pContext);
+	~LruCacheBase();
+
+	void *find(const Hashable *pKey);
+	void *find(unsigned long hashValue, const void *pKey);
+	void *peek(const Hashable *pKey) const;
+	void insert(void *pElement, size_t charge);
+	void insert(void *pElement, size_t charge, unsigned long hashValue);
+	void remove(void *pElement);
+
+	void *getFirst() const;
+	void *getNext(const void *pElement) const;
+
+    private:
+	friend class ShardedLruCacheBase;
+
+	LruCacheBase(const LruCacheBase &);
+	LruCacheBase &operator=(const LruCacheBase &);
+
+	LruCacheMembership *toMembership(const void *pElement) const;
+	void *toElement(const LruCacheMembership *pMembership) const;
+	void *hit(void *pElement);
+	void unlink(LruCacheMembership *pM);
+	void evictOne();
+	void evictOver(size_t limit);
+
+	/*
+	  For LRU, the most recently used element is first.  For CLOCK, the
+	  list is treated as a ring, and new elements go just behind the hand.
+	  For SIEVE, the newest element is first, and the hand moves from the
+	  last element towards the first.
+	*/
+	DoublyLinkedList<LruCacheMembership,
+			 offsetof(LruCacheMembership, listMembership)> list;
+	LruCacheMembership *pHand; /* next to be considered; NULL to restart */
+
+	size_t membershipOffset;
+	size_t keyOffset;
+	void (*hash)(HashValue *pHashValue, const void *pKey);
+	size_t capacity;
+	size_t totalCharge;
+	Policy policy;
+	void (*evict)(void *pContext, void *pElement);
+	void *pContext;
+    };
+
+
+    template<class element, size_t offset>
+    class LruCache :
+	public LruCacheBase
+    {
+    public:
+	/*
+	  Construct an empty cache.
+
+	  @params K the type of the key
+	  @param keyOffset offset of the key within an element
+	  @param hash hash function for keys; see hash.h for candidate
+	    functions; it must blend in the same values as the Hashable used
+	    for lookups
+	  @param cmp comparison function for keys; see compare.h for candidate
+	    functions
+	  @param capacity the most that the charges of the elements in the
+	    cache may add up to
+	  @param policy the eviction policy
+	  @param evict called with each element as it is evicted, after it has
+	    been removed from the cache; it must not use the cache; if this is
+	    NULL, evicted elements are just dropped
+	  @param pContext passed to evict
+	*/
+	template<class K, class C>
+	LruCache(size_t keyOffset,
+		 void (*hash)(HashValue *pHashValue, const K *pKey),
+		 int (*cmp)(const K *pl, const K *pr),
+		 size_t capacity, Policy policy,
+		 void (*evict)(C *pContext, element *pElement), C *pContext);
+
+	/*
+	  Construct an empty cache that owns its elements, and deletes them
+	  when they are evicted.
+	*/
+	template<class K>
+	LruCache(size_t keyOffset,
+		 void (*hash)(HashValue *pHashValue, const K *pKey),
+		 int (*cmp)(const K *pl, const K *pr),
+		 size_t capacity, Policy policy = LRU);
+
+	/*
+	  Any elements still in the cache are evicted.
+	*/
+	~LruCache();
+
+	/*
+	  find()
+
+	  Look up an element, and record a hit on it.
+
+	  @param pKey the key to look for
+	  @returns the element with a matching key, or NULL
+	*/
+	element *find(const Hashable *pKey);
+
+	/*
+	  peek()
+
+	  Look up an element without recording a hit on it.
+
+	  @param pKey the key to look for
+	  @returns the element with a matching key, or NULL
+	*/
+	element *peek(const Hashable *pKey) const;
+
+	/*
+	  insert()
+
+	  Add an element to the cache, and then evict elements until the
+	  total charge is within the capacity.  Any element already in the
+	  cache with the same key is evicted first.  The new element is the
+	  last candidate for eviction.  If its charge is more than the
+	  capacity, it is evicted straight away, and other elements are left
+	  alone.
+
+	  Inserting an element that is already in the cache isn't an eviction;
+	  it changes the element's charge, and treats it as newly inserted.
+
+	  @param pElement the element to add
+	  @param charge the element's charge against the capacity
+	*/
+	void insert(element *pElement, size_t charge = 1);
+
+	/*
+	  remove()
+
+	  Remove an element from the cache without evicting it; the caller
+	  becomes responsible for it.
+
+	  @param pElement the element, which must be in this cache
+	*/
+	void remove(element *pElement);
+
+	/*
+	  Iterate over the elements in the cache; for LRU, this is from the
+	  most to the least recently used.  The cache must not be modified
+	  during the iteration.
+	*/
+	element *getFirst() const;
+	element *getNext(const element *pElement) const;
+
+    private:
+	static void deleteElement(void *pContext, void *pElement);
+    };
+
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of ShardedLruCache.  See that class for usage.
+    */
+    class ShardedLruCacheBase
+    {
+    public:
+	size_t getCount() const;
+	size_t getCharge() const;
+	void clear();
+
+    protected:
+	ShardedLruCacheBase(size_t membershipOffset, size_t keyOffset,
+			    void (*hash)(HashValue *pHashValue,
+					 const void *pKey),
+			    int (*cmp)(const void *pl, const void *pr),
+			    size_t capacity, LruCacheBase::Policy policy,
+			    void (*evict)(void *pContext, void *pElement),
+			    void *pContext, unsigned nShards);
+	~ShardedLruCacheBase();
+
+	bool find(const Hashable *pKey,
+		  void (*visit)(void *pContext, void *pElement),
+		  void *pContext);
+	void insert(void *pElement, size_t charge);
+	bool erase(const Hashable *pKey);
+
+    private:
+	ShardedLruCacheBase(const ShardedLruCacheBase &);
+	ShardedLruCacheBase &operator=(const ShardedLruCacheBase &);
+
+	struct Shard;
+	Shard *getShard(unsigned long hashValue) const;
+
+	Shard **ppShard;
+	unsigned nShards;
+	unsigned shardShift;
+	size_t keyOffset;
+	void (*hash)(HashValue *pHashValue, const void *pKey);
+    };
+
+
+    /*
+      A cache that can be used by many threads at once.
+
+      The elements are divided among a number of independent LruCaches by
+      the hash values of their keys, each with its own lock and an equal
+      share of the capacity.  For CLOCK and SIEVE, hits take the shard's
+      lock shared, so they don't contend with each other.
+
+      Because another thread could evict an element as soon as its shard is
+      unlocked, elements are never returned; find() passes the element to a
+      callback while the shard is locked instead.
+    */
+    template<class element, size_t offset>
+    class ShardedLruCache :
+	public ShardedLruCacheBase
+    {
+    public:
+	/*
+	  Construct an empty cache.
+
+	  The parameters are as for LruCache, with the addition of:
+
+	  @param nShards the number of shards, rounded up to a power of two
+
+	  The evict callback is called with a shard locked, so it must not
+	  use the cache.
+	*/
+	template<class K, class C>
+	ShardedLruCache(size_t keyOffset,
+			void (*hash)(HashValue *pHashValue, const K *pKey),
+			int (*cmp)(const K *pl, const K *pr),
+			size_t capacity, LruCacheBase::Policy policy,
+			void (*evict)(C *pContext, element *pElement),
+			C *pContext, unsigned nShards = 16);
+
+	/*
+	  Construct an empty cache that owns its elements, and deletes them
+	  when they are evicted.
+	*/
+	template<class K>
+	ShardedLruCache(size_t keyOffset,
+			void (*hash)(HashValue *pHashValue, const K *pKey),
+			int (*cmp)(const K *pl, const K *pr),
+			size_t capacity,
+			LruCacheBase::Policy policy = LruCacheBase::LRU,
+			unsigned nShards = 16);
+
+	/*
+	  Any elements still in the cache are evicted.
+	*/
+	~ShardedLruCache();
+
+	/*
+	  find()
+
+	  Look up an element, record a hit on it, and pass it to a callback.
+
+	  @param pKey the key to look for
+	  @param visit called with the element while its shard is locked;
+	    for CLOCK and SIEVE, other threads may be visiting it at the same
+	    time, so it must not modify the element
+	  @param pContext passed to visit
+	  @returns true if the element was found
+	*/
+	template<class C>
+	bool find(const Hashable *pKey,
+		  void (*visit)(C *pContext, element *pElement), C *pContext);
+
+	/*
+	  insert()
+
+	  As for LruCache::insert().
+	*/
+	void insert(element *pElement, size_t charge = 1);
+
+	/*
+	  erase()
+
+	  Evict the element with the given key.
+
+	  @param pKey the key to look for
+	  @returns true if an element was evicted
+	*/
+	bool erase(const Hashable *pKey);
+
+    private:
+	static void deleteElement(void *pContext, void *pElement);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline LruCacheMembership::LruCacheMembership():
+	charge(0),
+	referenced(0)
+    {
+    }
+
+    inline bool LruCacheMembership::isMember() const
+    {
+	return hashMembership.isMember();
+    }
+
+    inline size_t LruCacheBase::getCount() const
+    {
+	return IntrusiveHashBase::getCount();
+    }
+
+    inline size_t LruCacheBase::getCharge() const
+    {
+	return totalCharge;
+    }
+
+    inline size_t LruCacheBase::getCapacity() const
+    {
+	return capacity;
+    }
+
+    inline LruCacheBase::Policy LruCacheBase::getPolicy() const
+    {
+	return policy;
+    }
+
+
+    template<class element, size_t offset>
+    template<class K, class C>
+    inline LruCache<element, offset>::LruCache(
+	size_t keyOffset, void (*hash)(HashValue *pHashValue, const K *pKey),
+	int (*cmp)(const K *pl, const K *pr), size_t capacity, Policy policy,
+	void (*evict)(C *pContext, element *pElement), C *pContext):
+	LruCacheBase(
+	    offset, keyOffset,
+	    (void (*)(HashValue *, const void *))hash,
+	    (int (*)(const void *, const void *))cmp, capacity, policy,
+	    (void (*)(void *, void *))evict, (void *)pContext)
+    {
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline LruCache<element, offset>::LruCache(
+	size_t keyOffset, void (*hash)(HashValue *pHashValue, const K *pKey),
+	int (*cmp)(const K *pl, const K *pr), size_t capacity, Policy policy):
+	LruCacheBase(
+	    offset, keyOffset,
+	    (void (*)(HashValue *, const void *))hash,
+	    (int (*)(const void *, const void *))cmp, capacity, policy,
+	    deleteElement, NULL)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline LruCache<element, offset>::~LruCache()
+    {
+	clear();
+    }
+
+    template<class element, size_t offset>
+    inline element *LruCache<element, offset>::find(const Hashable *pKey)
+    {
+	return (element *)LruCacheBase::find(pKey);
+    }
+
+    template<class element, size_t offset>
+    inline element *LruCache<element, offset>::peek(
+	const Hashable *pKey) const
+    {
+	return (element *)LruCacheBase::peek(pKey);
+    }
+
+    template<class element, size_t offset>
+    inline void LruCache<element, offset>::insert(
+	element *pElement, size_t charge)
+    {
+	LruCacheBase::insert((void *)pElement, charge);
+    }
+
+    template<class element, size_t offset>
+    inline void LruCache<element, offset>::remove(element *pElement)
+    {
+	LruCacheBase::remove((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *LruCache<element, offset>::getFirst() const
+    {
+	return (element *)LruCacheBase::getFirst();
+    }
+
+    template<class element, size_t offset>
+    inline element *LruCache<element, offset>::getNext(
+	const element *pElement) const
+    {
+	return (element *)LruCacheBase::getNext((const void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    void LruCache<element, offset>::deleteElement(
+	void *pContext, void *pElement)
+    {
+	delete (element *)pElement;
+    }
+
+
+    template<class element, size_t offset>
+    template<class K, class C>
+    inline ShardedLruCache<element, offset>::ShardedLruCache(
+	size_t keyOffset, void (*hash)(HashValue *pHashValue, const K *pKey),
+	int (*cmp)(const K *pl, const K *pr), size_t capacity,
+	LruCacheBase::Policy policy,
+	void (*evict)(C *pContext, element *pElement), C *pContext,
+	unsigned nShards):
+	ShardedLruCacheBase(
+	    offset, keyOffset,
+	    (void (*)(HashValue *, const void *))hash,
+	    (int (*)(const void *, const void *))cmp, capacity, policy,
+	    (void (*)(void *, void *))evict, (void *)pContext, nShards)
+    {
+    }
+
+    template<class element, size_t offset>
+    template<class K>
+    inline ShardedLruCache<element, offset>::ShardedLruCache(
+	size_t keyOffset, void (*hash)(HashValue *pHashValue, const K *pKey),
+	int (*cmp)(const K *pl, const K *pr), size_t capacity,
+	LruCacheBase::Policy policy, unsigned nShards):
+	ShardedLruCacheBase(
+	    offset, keyOffset,
+	    (void (*)(HashValue *, const void *))hash,
+	    (int (*)(const void *, const void *))cmp, capacity, policy,
+	    deleteElement, NULL, nShards)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline ShardedLruCache<element, offset>::~ShardedLruCache()
+    {
+	clear();
+    }
+
+    template<class element, size_t offset>
+    template<class C>
+    inline bool ShardedLruCache<element, offset>::find(
+	const Hashable *pKey, void (*visit)(C *pContext, element *pElement),
+	C *pContext)
+    {
+	return ShardedLruCacheBase::find(
+	    pKey, (void (*)(void *, void *))visit, (void *)pContext);
+    }
+
+    template<class element, size_t offset>
+    inline void ShardedLruCache<element, offset>::insert(
+	element *pElement, size_t charge)
+    {
+	ShardedLruCacheBase::insert((void *)pElement, charge);
+    }
+
+    template<class element, size_t offset>
+    inline bool ShardedLruCache<element, offset>::erase(const Hashable *pKey)
+    {
+	return ShardedLruCacheBase::erase(pKey);
+    }
+
+    template<class element, size_t offset>
+    void ShardedLruCache<element, offset>::deleteElement(
+	void *pContext, void *pElement)
+    {
+	delete (element *)pElement;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_LRUCACHE_H */
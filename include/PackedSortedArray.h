@@ -0,0 +1,253 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PackedSortedArray.h - Compressed sorted array of unsigned longs
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A sorted array of identifiers takes eight bytes per entry, but the
+    differences between neighbouring entries are usually much smaller
+    than that.  PackedSortedArray stores the values in blocks of 128,
+    each block holding the differences (deltas) from one value to the
+    next, packed with just as many bits each as the block's largest delta
+    needs.  Identifiers that are about a thousand apart take a little over
+    ten bits each, instead of 64.
+
+    The first value of each block is kept in a separate skip table, which
+    is an ordinary sorted array, so a search does a lowerBound() (see
+    bsearch.h) on the skip table to find the block, decodes just that
+    block, and searches it.  Nothing else is decompressed.  Where SSE2 is
+    available, a block is decoded two values at a time.
+
+    The array is immutable once built.  Duplicate values are allowed.
+
+    Iteration is done with a PackedSortedArrayCursor, which decodes a
+    block at a time into a buffer, and which can also skip ahead to the
+    first value not less than a given one, using the skip table to jump
+    over whole blocks without decoding them.  That makes it suitable for
+    intersecting arrays.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_PACKEDSORTEDARRAY_H
+#define PHOENIX4CPP_PACKEDSORTEDARRAY_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class PackedSortedArray
+    {
+    public:
+	/* the number of values in a block */
+	static const size_t blockValues = 128;
+
+	/*
+	  Construct an array by compressing a sorted one.
+
+	  @param pValues the values, in ascending order; duplicates are
+	    allowed; if they are not in order, the results are undefined
+	  @param n the number of values
+	*/
+	PackedSortedArray(const unsigned long *pValues, size_t n);
+
+	~PackedSortedArray();
+
+	size_t getCount() const;
+	size_t getBlockCount() const;
+
+	/*
+	  getBytes()
+
+	  @returns the number of bytes of memory used, including the skip
+	    table
+	*/
+	size_t getBytes() const;
+
+	/*
+	  get()
+
+	  @param i the position of the value, in [0, getCount())
+	  @returns the value
+	*/
+	unsigned long get(size_t i) const;
+
+	/*
+	  lowerBound()
+
+	  Find the first value that is not less than the one given.
+
+	  @param value the value to look for
+	  @param pFound if not NULL, and there is such a value, it is
+	    returned here
+	  @returns the position of the first value not less than the one
+	    given, or getCount() if there is none
+	*/
+	size_t lowerBound(unsigned long value,
+			  unsigned long *pFound = NULL) const;
+
+	/*
+	  contains()
+
+	  @param value the value to look for
+	  @returns true if the array contains the value
+	*/
+	bool contains(unsigned long value) const;
+
+	/*
+	  decodeBlock()
+
+	  Decompress one block.
+
+	  @param block the block, in [0, getBlockCount())
+	  @param pOut where to put the values; this must have room for
+	    blockValues of them
+	  @returns the number of values in the block; this is blockValues
+	    except for the last block
+	*/
+	size_t decodeBlock(size_t block, unsigned long *pOut) const;
+
+    private:
+	PackedSortedArray(const PackedSortedArray &);
+	PackedSortedArray &operator=(const PackedSortedArray &);
+
+	friend class PackedSortedArrayCursor;
+
+	size_t findBlock(size_t firstBlock, unsigned long value) const;
+
+	size_t count;
+	size_t nBlocks;
+	/* the first value of each block */
+	unsigned long *pFirst;
+	/*
+	  Where each block's packed deltas start in pWords, plus one more
+	  entry for the end; a block with deltas of b bits takes 2 * b words.
+	*/
+	size_t *pOffset;
+	unsigned long *pWords;
+    };
+
+    /*
+      Iterates over a PackedSortedArray in order.  The array must outlive
+      the cursor.
+    */
+    class PackedSortedArrayCursor
+    {
+    public:
+	/*
+	  Construct a cursor positioned before the first value.
+
+	  @param pArray the array to iterate over
+	*/
+	PackedSortedArrayCursor(const PackedSortedArray *pArray);
+
+	/*
+	  next()
+
+	  @param pValue where to return the next value
+	  @returns false if there are no more values, true otherwise
+	*/
+	bool next(unsigned long *pValue);
+
+	/*
+	  seek()
+
+	  Move forward to the next value that is not less than the one given,
+	  and return it, as for next().  The cursor never moves backwards; if
+	  the next value is already large enough, this is the same as next().
+
+	  @param value the value to skip to
+	  @param pValue where to return the value found
+	  @returns false if there are no more values, true otherwise
+	*/
+	bool seek(unsigned long value, unsigned long *pValue);
+
+	/*
+	  getPosition()
+
+	  @returns the position in the array of the value that next() would
+	    return
+	*/
+	size_t getPosition() const;
+
+    private:
+	PackedSortedArrayCursor(const PackedSortedArrayCursor &);
+	PackedSortedArrayCursor &operator=(const PackedSortedArrayCursor &);
+
+	void load(size_t block);
+
+	const PackedSortedArray *pArray;
+	/* the block after the one in the buffer */
+	size_t nextBlock;
+	/* the next value to return from the buffer, and the number there */
+	size_t slot;
+	size_t nValues;
+	unsigned long values[PackedSortedArray::blockValues];
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t PackedSortedArray::getCount() const
+    {
+	return count;
+    }
+
+    inline size_t PackedSortedArray::getBlockCount() const
+    {
+	return nBlocks;
+    }
+
+    inline bool PackedSortedArray::contains(unsigned long value) const
+    {
+	unsigned long found;
+	return (lowerBound(value, &found) < count) && (found == value);
+    }
+
+    inline void PackedSortedArrayCursor::load(size_t block)
+    {
+	nValues = pArray->decodeBlock(block, values);
+	nextBlock = block + 1;
+	slot = 0;
+    }
+
+    inline bool PackedSortedArrayCursor::next(unsigned long *pValue)
+    {
+	if (slot == nValues)
+	{
+	    if (nextBlock >= pArray->nBlocks)
+		return false;
+	    load(nextBlock);
+	}
+
+	*pValue = values[slot++];
+	return true;
+    }
+
+    inline size_t PackedSortedArrayCursor::getPosition() const
+    {
+	if (slot < nValues)
+	    return (nextBlock - 1) * PackedSortedArray::blockValues + slot;
+
+	/* the buffer has been used up, so it's the start of the next block */
+	const size_t position = nextBlock * PackedSortedArray::blockValues;
+	return position < pArray->count ? position : pArray->count;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_PACKEDSORTEDARRAY_H */
@@ -0,0 +1,262 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PairingHeap.h - Intrusive pairing heap priority queue
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This follows the same model as DoublyLinked.h.  A PairingHeapMembership
+    is embedded in each client element that is to be queued, and the heap
+    finds it using the offset template parameter.  The heap never allocates
+    anything.  The element with the smallest key is at the top.
+
+    Keys are addressed the same way as for bsearch() and qsort():  a key
+    offset within the element, and a comparison function from compare.h.
+
+    A pairing heap is a tree in which each node's key is no greater than
+    its children's.  push() and decreaseKey() are O(1):  they just compare
+    the top with one other tree and put the larger under the smaller.  pop()
+    is O(log n) amortized; it pairs up the top's children and merges the
+    pairs.  Because elements are found through their memberships, there is
+    no need to search for an element whose key has changed, which is what
+    makes decrease-key cheap compared to an array heap (see heap.h).
+
+    The heap does not own its elements, and they are not deleted; they are
+    usually owned by something else, such as a scheduler's table of tasks.
+    An element must be removed from the heap before it is destroyed.
+
+    Templates are used, but only for type safety.  All of the work is done
+    by PairingHeapBase, which operates on (void *).
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_PAIRINGHEAP_H
+#define PHOENIX4CPP_PAIRINGHEAP_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+
+    /*
+      Embed one of these in any element that is to belong to a PairingHeap.
+      An element may only belong to one heap via a given membership at a
+      time.
+    */
+    class PairingHeapMembership
+    {
+    public:
+	PairingHeapMembership();
+
+	/*
+	  isMember()
+
+	  @returns true if this membership is currently in a heap
+	*/
+	bool isMember() const;
+
+    private:
+	friend class PairingHeapBase;
+
+	/*
+	  Each node's children are on a doubly linked list.  pPrevious
+	  points to the previous sibling, or to the parent for the first
+	  child, and is NULL for the top.  As with IntrusiveHashMembership, a
+	  membership that is not in a heap points to itself.
+	*/
+	PairingHeapMembership *pChild;
+	PairingHeapMembership *pNext;
+	PairingHeapMembership *pPrevious;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of PairingHeap.  See that class for usage.
+    */
+    class PairingHeapBase
+    {
+    public:
+	size_t getCount() const;
+	bool isEmpty() const;
+
+    protected:
+	PairingHeapBase(size_t membershipOffset, size_t keyOffset,
+			int (*cmp)(const void *pl, const void *pr));
+
+	void push(void *pElement);
+	void *getTop() const;
+	void *pop();
+	void decreaseKey(void *pElement);
+	void remove(void *pElement);
+
+    private:
+	PairingHeapBase(const PairingHeapBase &);
+	PairingHeapBase &operator=(const PairingHeapBase &);
+
+	PairingHeapMembership *toMembership(const void *pElement) const;
+	void *toElement(const PairingHeapMembership *pMembership) const;
+	bool isLess(const PairingHeapMembership *pl,
+		    const PairingHeapMembership *pr) const;
+	PairingHeapMembership *meld(PairingHeapMembership *pA,
+				    PairingHeapMembership *pB) const;
+	PairingHeapMembership *mergePairs(PairingHeapMembership *pFirst) const;
+	static void detach(PairingHeapMembership *pM);
+
+	PairingHeapMembership *pTop;
+	size_t count;
+
+	size_t membershipOffset;
+	size_t keyOffset;
+	int (*cmp)(const void *pl, const void *pr);
+    };
+
+
+    template<class element, size_t offset>
+    class PairingHeap :
+	public PairingHeapBase
+    {
+    public:
+	/*
+	  Construct an empty heap.
+
+	  @params K the type of the key
+	  @param keyOffset offset of the key within an element
+	  @param cmp comparison function for keys; see compare.h for candidate
+	    functions
+	*/
+	template<class K>
+	PairingHeap(size_t keyOffset, int (*cmp)(const K *pl, const K *pr));
+
+	/*
+	  push()
+
+	  Add an element to the heap.
+
+	  @param pElement the element to add
+	*/
+	void push(element *pElement);
+
+	/*
+	  getTop()
+
+	  @returns the element with the smallest key, or NULL if the heap is
+	    empty
+	*/
+	element *getTop() const;
+
+	/*
+	  pop()
+
+	  Remove the element with the smallest key.
+
+	  @returns the element removed, or NULL if the heap is empty
+	*/
+	element *pop();
+
+	/*
+	  decreaseKey()
+
+	  Reposition an element after its key has been made smaller.  The key
+	  must not be made larger; to do that, remove() the element, change
+	  the key, and push() it again.
+
+	  @param pElement the element whose key has been decreased
+	*/
+	void decreaseKey(element *pElement);
+
+	/*
+	  remove()
+
+	  Remove an element from anywhere in the heap.
+
+	  @param pElement the element to remove
+	*/
+	void remove(element *pElement);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline PairingHeapMembership::PairingHeapMembership():
+	pChild(NULL),
+	pNext(NULL),
+	pPrevious(this)
+    {
+    }
+
+    inline bool PairingHeapMembership::isMember() const
+    {
+	return pPrevious != this;
+    }
+
+    inline size_t PairingHeapBase::getCount() const
+    {
+	return count;
+    }
+
+    inline bool PairingHeapBase::isEmpty() const
+    {
+	return !count;
+    }
+
+
+    template<class element, size_t offset>
+    template<class K>
+    inline PairingHeap<element, offset>::PairingHeap(
+	size_t keyOffset, int (*cmp)(const K *pl, const K *pr)):
+	PairingHeapBase(
+	    offset, keyOffset, (int (*)(const void *, const void *))cmp)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline void PairingHeap<element, offset>::push(element *pElement)
+    {
+	PairingHeapBase::push((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline element *PairingHeap<element, offset>::getTop() const
+    {
+	return (element *)PairingHeapBase::getTop();
+    }
+
+    template<class element, size_t offset>
+    inline element *PairingHeap<element, offset>::pop()
+    {
+	return (element *)PairingHeapBase::pop();
+    }
+
+    template<class element, size_t offset>
+    inline void PairingHeap<element, offset>::decreaseKey(element *pElement)
+    {
+	PairingHeapBase::decreaseKey((void *)pElement);
+    }
+
+    template<class element, size_t offset>
+    inline void PairingHeap<element, offset>::remove(element *pElement)
+    {
+	PairingHeapBase::remove((void *)pElement);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_PAIRINGHEAP_H */
@@ -0,0 +1,184 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PerfectHash.h - minimal perfect hash functions for static key sets
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A minimal perfect hash function maps each of a fixed set of n keys to a
+    distinct number in [0, n).  It doesn't store the keys, so it is very
+    small (a little over 3 bits per key here), but it maps keys that are not in
+    the set to arbitrary numbers.  The usual way to use one is as an
+    alternative to bsearch() over a sorted static array:  instead of
+    sorting the array, store each element at the position lookup() gives
+    for its key, and then a search is one lookup() and one key comparison,
+    rather than log2(n) comparisons spread all over the array.
+
+    The construction is the one from BBHash (Limasset et al., 2017).  There
+    is a series of levels, each a bit array with one bit per remaining key.
+    At each level, every remaining key hashes to one bit; keys that have a
+    bit to themselves set it, and the rest go on to the next level.  A key's
+    number is the count of set bits before its own, which is found with a
+    table of precomputed counts.  A lookup touches about 1.6 levels on
+    average.
+
+    Keys are hashed once, with HashValue::get64(), and that is rehashed with
+    a different seed for each level.  Keys with the same 64-bit hash can't
+    be separated, so build() fails if there are duplicate keys, or (very
+    rarely) two keys with colliding hashes.
+
+    Levels can be built in parallel with several threads.
+
+    The function is held in a single flat buffer, which starts with a 64
+    byte header, and can be written out with serialize() and later used in
+    place with attach(), as with BloomFilter.  Header fields are in native
+    byte order; a buffer from a machine with a different byte order is
+    rejected by attach().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_PERFECTHASH_H
+#define PHOENIX4CPP_PERFECTHASH_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    class Hashable;
+
+    struct PerfectHashHeader;
+
+    class PerfectHash
+    {
+    public:
+	/*
+	  Construct an empty function, for use with build() or attach().
+	*/
+	PerfectHash();
+	~PerfectHash();
+
+	/*
+	  build()
+
+	  Build a function for a set of keys.  Any function previously held
+	  is released.
+
+	  @param ppKeys pointers to the keys
+	  @param n the number of keys
+	  @param nThreads the number of threads to build with
+	  @returns true on success, false if the keys' hashes are not all
+	    distinct, in which case the function is left empty
+	*/
+	bool build(const Hashable *const *ppKeys, size_t n,
+		   unsigned nThreads = 1);
+
+	/*
+	  buildHashes()
+
+	  Variant of build() for callers that already have the keys'
+	  HashValue::get64().
+	*/
+	bool buildHashes(const unsigned long long *pHashValues, size_t n,
+			 unsigned nThreads = 1);
+
+	/*
+	  lookup()
+
+	  @param pKey the key
+	  @returns the key's number in [0, getCount()) if it was in the set
+	    the function was built for; otherwise, either notFound, or an
+	    arbitrary number in [0, getCount())
+	*/
+	size_t lookup(const Hashable *pKey) const;
+
+	/*
+	  lookupHash()
+
+	  Variant of lookup() for callers that already have the key's
+	  HashValue::get64().
+	*/
+	size_t lookupHash(unsigned long long hashValue) const;
+
+	static const size_t notFound = ~(size_t)0;
+
+	/*
+	  getCount()
+
+	  @returns the number of keys the function was built for
+	*/
+	size_t getCount() const;
+
+	/*
+	  getSerializedSize()
+
+	  @returns the number of bytes serialize() will write; this is also
+	    the memory used by the function
+	*/
+	size_t getSerializedSize() const;
+
+	/*
+	  serialize()
+
+	  @param pBuffer where to write the function; it must be at least
+	    getSerializedSize() bytes long
+	*/
+	void serialize(void *pBuffer) const;
+
+	/*
+	  attach()
+
+	  Use a serialized function in place.  Any function previously held
+	  is released.  The buffer is not copied, and must outlive the
+	  function, or the next attach() or build().
+
+	  @param pBuffer the serialized function; this should be 64 byte
+	    aligned for best performance
+	  @param length the length of the buffer
+	  @returns true if the buffer holds a valid function, false
+	    otherwise, in which case the function is left empty
+	*/
+	bool attach(const void *pBuffer, size_t length);
+
+    private:
+	PerfectHash(const PerfectHash &);
+	PerfectHash &operator=(const PerfectHash &);
+
+	void release();
+	void setBuffer(const PerfectHashHeader *pHeader);
+
+	const PerfectHashHeader *pHeader;
+	bool owned;
+
+	/* pointers into the buffer; see the implementation for the layout */
+	const unsigned long long *pLevelStart;
+	const unsigned long long *pBits;
+	const unsigned long long *pRank;
+	unsigned nLevels;
+	size_t nKeys;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t PerfectHash::getCount() const
+    {
+	return nKeys;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_PERFECTHASH_H */
@@ -0,0 +1,272 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    RoaringBitmap.h - Compressed bitmap of unsigned values
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A sorted array of unsigned values takes four bytes per value no matter
+    how the values are distributed, and a plain bitmap takes a bit for
+    every possible value whether it is present or not.  A RoaringBitmap
+    divides the values into chunks of 65536 by their high 16 bits, and
+    stores each chunk that has any values in whichever container suits
+    it:
+
+      array     the low 16 bits of each value, sorted; two bytes per value,
+                for chunks with at most 4096 values
+      bitmap    a bit for each of the 65536 possible values; 8KB, for
+                chunks with more than 4096 values
+      run       a list of runs of consecutive values, as a start and a
+                length; four bytes per run, for chunks that are mostly
+                runs
+
+    Arrays and bitmaps are chosen automatically as values are added and
+    removed.  Run containers are only made by optimize(), which converts
+    each container to whichever of the three is smallest; operations that
+    modify a run container expand it again first.
+
+    Intersection (AND), union (OR), symmetric difference (XOR) and
+    difference (ANDNOT) work a chunk at a time.  Chunks only in one of
+    the bitmaps are kept or dropped whole.  Two bitmap containers are
+    combined a word at a time, using SSE2 where it is available; arrays
+    are merged, and an array and a bitmap are combined by probing or
+    setting bits of the bitmap for each value of the array.
+
+    rank() and select() add up the cardinalities of the containers before
+    the one holding the answer, and then count within that one, using
+    popcounts for a bitmap; their time depends on the number of
+    containers, rather than the number of values.
+
+    Values can be added from, and extracted to, sorted arrays such as
+    those produced by qsort() with compareUnsigned() (see compare.h).
+
+    A bitmap can be serialized to a flat buffer.  The format uses fixed
+    sizes and little-endian byte order throughout, with every container
+    8 byte aligned, so it doesn't depend on the compiler or the machine's
+    word size.  A bitmap can be attached to such a buffer, for example a
+    mapped file, without copying its containers; only a small directory
+    of the containers is built.  Attaching is only possible on a
+    little-endian machine.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_ROARINGBITMAP_H
+#define PHOENIX4CPP_ROARINGBITMAP_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    /* defined in RoaringBitmap.cpp */
+    struct RoaringContainer;
+
+    class RoaringBitmap
+    {
+    public:
+	/*
+	  Construct an empty bitmap.
+	*/
+	RoaringBitmap();
+
+	~RoaringBitmap();
+
+	/*
+	  The functions down to optimize() modify the bitmap, and may not be
+	  used on an attached bitmap.  To get a modifiable copy of an
+	  attached bitmap, orWith() it into an empty one.
+	*/
+
+	/*
+	  add()
+
+	  @param value the value to add
+	  @returns true if the value was added, false if it was already
+	    present
+	*/
+	bool add(unsigned value);
+
+	/*
+	  addArray()
+
+	  Add a number of values.
+
+	  @param pValues the values to add, in ascending order; duplicates
+	    are allowed
+	  @param n the number of values
+	*/
+	void addArray(const unsigned *pValues, size_t n);
+
+	/*
+	  remove()
+
+	  @param value the value to remove
+	  @returns true if the value was removed, false if it wasn't present
+	*/
+	bool remove(unsigned value);
+
+	/*
+	  clear()
+
+	  Remove all of the values.  This may also be used on an attached
+	  bitmap, to detach it.
+	*/
+	void clear();
+
+	/*
+	  Replace the bitmap with its intersection, union, symmetric difference
+	  or difference with another one.
+
+	  @param pOther the other bitmap; this may be attached
+	*/
+	void andWith(const RoaringBitmap *pOther);
+	void orWith(const RoaringBitmap *pOther);
+	void xorWith(const RoaringBitmap *pOther);
+	void andNotWith(const RoaringBitmap *pOther);
+
+	/*
+	  optimize()
+
+	  Convert each container to the type that takes the least memory, and
+	  release any unused space in arrays.  This is worth doing when a
+	  bitmap is finished, particularly before serializing it.
+	*/
+	void optimize();
+
+	/*
+	  contains()
+
+	  @param value the value to look for
+	  @returns true if the value is present
+	*/
+	bool contains(unsigned value) const;
+
+	/*
+	  getCount()
+
+	  @returns the number of values present
+	*/
+	size_t getCount() const;
+
+	bool isEmpty() const;
+
+	/*
+	  rank()
+
+	  @param value a value
+	  @returns the number of values present that are not greater than
+	    value
+	*/
+	size_t rank(unsigned value) const;
+
+	/*
+	  select()
+
+	  @param i a position, counting from zero
+	  @param pValue where to return the i-th smallest value
+	  @returns true if there is such a value, false if there are no more
+	    than i values present
+	*/
+	bool select(size_t i, unsigned *pValue) const;
+
+	/*
+	  toArray()
+
+	  @param pValues where to put the values, in ascending order; this
+	    must have room for getCount() values
+	  @returns the number of values written
+	*/
+	size_t toArray(unsigned *pValues) const;
+
+	/*
+	  getContainerCount()
+
+	  @returns the number of chunks that have values
+	*/
+	size_t getContainerCount() const;
+
+	/*
+	  getBytes()
+
+	  @returns the number of bytes of memory used by the containers and
+	    their directory; for an attached bitmap, this is only the
+	    directory
+	*/
+	size_t getBytes() const;
+
+	/*
+	  getSerializedSize()
+
+	  @returns the number of bytes serialize() will write
+	*/
+	size_t getSerializedSize() const;
+
+	/*
+	  serialize()
+
+	  @param pBuffer where to write the bitmap; it must be at least
+	    getSerializedSize() bytes long, and should be 8 byte aligned
+	*/
+	void serialize(void *pBuffer) const;
+
+	/*
+	  attach()
+
+	  Use a serialized bitmap in place.  Any values previously held are
+	  released.  The buffer is not copied, and must outlive the bitmap,
+	  or the next attach() or clear().
+
+	  The buffer is checked well enough that a damaged one can't lead to
+	  memory outside it being used; this reads the bitmap and run
+	  containers once.
+
+	  @param pBuffer the serialized bitmap; this must be 8 byte aligned
+	  @param length the length of the buffer
+	  @returns true if the buffer holds a valid bitmap, false otherwise,
+	    in which case the bitmap is left empty
+	*/
+	bool attach(const void *pBuffer, size_t length);
+
+    private:
+	RoaringBitmap(const RoaringBitmap &);
+	RoaringBitmap &operator=(const RoaringBitmap &);
+
+	size_t findContainer(unsigned short key) const;
+	RoaringContainer *getContainer(unsigned short key, bool create);
+	void removeContainer(size_t i);
+	void combineWith(const RoaringBitmap *pOther, unsigned op);
+
+	RoaringContainer *pContainers;
+	size_t nContainers;
+	size_t capacity;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t RoaringBitmap::getContainerCount() const
+    {
+	return nContainers;
+    }
+
+    inline bool RoaringBitmap::isEmpty() const
+    {
+	return !nContainers;
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_ROARINGBITMAP_H */
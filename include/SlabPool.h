@@ -0,0 +1,300 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    SlabPool.h - Fixed size object pool with per-thread caches
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A SlabPool hands out memory for objects of a single type.  Memory is
+    obtained from the system a slab at a time, where a slab is a page or a
+    few pages, and is carved up into objects.  Free objects are threaded
+    together through their own first words, so the pool keeps no
+    bookkeeping of its own for them.
+
+    Each thread that uses a pool gets its own cache of free objects, so
+    allocating and releasing objects normally takes no locks and touches
+    no shared cache lines.  When a thread's cache runs dry, it takes a
+    whole batch of objects from the pool's global depot (or carves a new
+    slab); when it has collected two batches' worth, it gives one back.
+    Objects may be released by a different thread than the one that
+    allocated them; they go into the releasing thread's cache.  When a
+    thread exits, its cache goes back to the depot.
+
+    Memory is not returned to the system until the pool is destroyed, and
+    the pool does not run any destructors then, so all objects should have
+    been destroyed first.  The pool must outlive the threads that use it,
+    or they must stop using it before it is destroyed.  Each pool uses a
+    pthread key, of which there are a limited number (PTHREAD_KEYS_MAX).
+
+    Objects are aligned as their type requires, and to at least the size
+    of a pointer, and are at least two pointers in size.
+
+    Objects that belong to a DoublyLinkedList, IntrusiveTree or
+    IntrusiveHashTable are deleted by the container's destructor.  To have
+    them go back to a pool instead, give the element class its own
+    operator new and operator delete that use a pool:
+
+	class Item
+	{
+	public:
+	    static void *operator new(size_t size)
+	    {
+		return pool.allocate();
+	    }
+
+	    static void operator delete(void *p)
+	    {
+		pool.release(p);
+	    }
+
+	    static SlabPool<Item> pool;
+	    ...
+	};
+
+    Alternatively, DoublyLinkedList::clear() can be used with dispose(),
+    below, to empty a list into a pool before it is destroyed.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_SLABPOOL_H
+#define PHOENIX4CPP_SLABPOOL_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+namespace phoenix4cpp
+{
+    class SlabPoolFree;
+    class SlabPoolCache;
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of SlabPool.  See that class for usage.
+    */
+    class SlabPoolBase
+    {
+    public:
+	/*
+	  allocate()
+
+	  @returns memory for one object; this is not initialized
+	*/
+	void *allocate();
+
+	/*
+	  release()
+
+	  Return memory obtained from allocate() to the pool.  If it held an
+	  object, the object must have been destroyed already.
+
+	  @param p the memory to return
+	*/
+	void release(void *p);
+
+	/*
+	  flush()
+
+	  Return all of the calling thread's cached objects to the depot, where
+	  other threads can get them.
+	*/
+	void flush();
+
+	size_t getObjectSize() const;
+	size_t getSlabBytes() const;
+
+	/*
+	  getSlabCount()
+
+	  @returns the number of slabs allocated from the system so far
+	*/
+	size_t getSlabCount() const;
+
+    protected:
+	SlabPoolBase(size_t objectSize, size_t alignment, size_t batchSize);
+	~SlabPoolBase();
+
+    private:
+	SlabPoolBase(const SlabPoolBase &);
+	SlabPoolBase &operator=(const SlabPoolBase &);
+
+	friend class SlabPoolCache;
+
+	SlabPoolCache *getCache();
+	SlabPoolCache *newCache();
+	void refill(SlabPoolCache *pCache);
+	void giveBack(SlabPoolCache *pCache, size_t n);
+	void pushBatch(SlabPoolFree *pFirst);
+	static void threadExit(void *pCache);
+
+	pthread_key_t key;
+	pthread_mutex_t mutex;
+
+	/* full batches, linked through their first objects */
+	SlabPoolFree *pDepot;
+	/* slabs, linked through their first words */
+	void *pSlabs;
+	size_t nSlabs;
+	/* every thread's cache, so that they can be freed with the pool */
+	SlabPoolCache *pCaches;
+
+	size_t objectSize;
+	size_t batchSize;
+	size_t slabBytes;
+	/* where the first object starts in a slab, after the slab link */
+	size_t firstOffset;
+    };
+
+
+    template<class T>
+    class SlabPool :
+	public SlabPoolBase
+    {
+    public:
+	/*
+	  Construct a pool for objects of type T.  Throws std::bad_alloc if
+	  there are no pthread keys left.
+
+	  @param batchSize the number of objects moved between a thread's
+	    cache and the depot at a time
+	*/
+	SlabPool(size_t batchSize = 32);
+
+	/*
+	  create()
+
+	  @returns a new default-constructed object
+	*/
+	T *create();
+
+	/*
+	  destroy()
+
+	  Destroy an object, and return its memory to the pool.
+
+	  @param pObject the object to destroy
+	*/
+	void destroy(T *pObject);
+
+	/*
+	  dispose()
+
+	  destroy(), in a form that can be used as a callback, such as with
+	  DoublyLinkedList::clear().
+
+	  @param pPool the pool the object came from
+	  @param pObject the object to destroy
+	*/
+	static void dispose(SlabPool *pPool, T *pObject);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    /* the first words of a free object */
+    class SlabPoolFree
+    {
+    public:
+	SlabPoolFree *pNext;
+	SlabPoolFree *pNextBatch;   /* only used in the depot */
+    };
+
+    class SlabPoolCache
+    {
+    public:
+	SlabPoolBase *pPool;
+	SlabPoolFree *pFree;
+	size_t count;
+	SlabPoolCache *pNextCache;
+	SlabPoolCache *pPreviousCache;
+    };
+
+    inline SlabPoolCache *SlabPoolBase::getCache()
+    {
+	SlabPoolCache *pCache = (SlabPoolCache *)pthread_getspecific(key);
+	return (pCache ? pCache : newCache());
+    }
+
+    inline void *SlabPoolBase::allocate()
+    {
+	SlabPoolCache *const pCache = getCache();
+	if (!pCache->pFree)
+	    refill(pCache);
+
+	SlabPoolFree *const pFree = pCache->pFree;
+	pCache->pFree = pFree->pNext;
+	--pCache->count;
+	return pFree;
+    }
+
+    inline void SlabPoolBase::release(void *p)
+    {
+	SlabPoolCache *const pCache = getCache();
+	SlabPoolFree *const pFree = (SlabPoolFree *)p;
+	pFree->pNext = pCache->pFree;
+	pCache->pFree = pFree;
+	if (++pCache->count >= 2 * batchSize)
+	    giveBack(pCache, batchSize);
+    }
+
+    inline size_t SlabPoolBase::getObjectSize() const
+    {
+	return objectSize;
+    }
+
+    inline size_t SlabPoolBase::getSlabBytes() const
+    {
+	return slabBytes;
+    }
+
+
+    template<class T>
+    inline SlabPool<T>::SlabPool(size_t batchSize):
+	SlabPoolBase(sizeof(T), __alignof__(T), batchSize)
+    {
+    }
+
+    template<class T>
+    inline T *SlabPool<T>::create()
+    {
+	return new(allocate()) T();
+    }
+
+    template<class T>
+    inline void SlabPool<T>::destroy(T *pObject)
+    {
+	pObject->~T();
+	release(pObject);
+    }
+
+    template<class T>
+    inline void SlabPool<T>::dispose(SlabPool *pPool, T *pObject)
+    {
+	pPool->destroy(pObject);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_SLABPOOL_H */
@@ -0,0 +1,325 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    SortedTable.h - Immutable sorted table file, searched in place with mmap
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A sorted table is a file holding an array of fixed size records,
+    sorted by a key at a fixed offset, as for qsort() and bsearch(), in a
+    form that can be searched where it lies.  Opening a table maps it into
+    memory; there is no loading or sorting, and records are returned as
+    pointers into the mapping, so a process that restarts pays only for
+    the page faults of the records it actually touches.
+
+    The file starts with a one page header, which records the record size,
+    key offset and key size, and where everything else is.  Records
+    follow in blocks:  each block holds as many whole records as fit in
+    the block size, padded out to a multiple of the page size, so records
+    never straddle pages.  After the blocks is a sparse index, holding a
+    copy of the first key of each block, which is small enough to stay
+    resident.  A lookup does a lowerBound() on the index to find the
+    block, and then another within the block, so it touches one page of
+    records.
+
+    If a hash function is given when the table is written, a Bloom filter
+    of the keys follows the index (see BloomFilter.h), and find() consults
+    it first, so looking up a key that isn't there usually costs no record
+    page at all.
+
+    Tables are written once, to a temporary file that is renamed into
+    place, so a reader never sees a partially written table.  The header
+    is in native byte order, and a table from a machine with a different
+    byte order, or with a different record layout than the reader
+    expects, is rejected by open().
+
+    Templates are used, but only for type safety.  All of the work is done
+    by SortedTableBase, which operates on (void *).
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_SORTEDTABLE_H
+#define PHOENIX4CPP_SORTEDTABLE_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_BLOOMFILTER_H
+#include "BloomFilter.h"
+#endif
+
+namespace phoenix4cpp
+{
+    class HashValue;
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of SortedTable.  See that class for usage.
+    */
+    class SortedTableBase
+    {
+    public:
+	/*
+	  close()
+
+	  Unmap the table.  Pointers to its records are no longer valid.
+	*/
+	void close();
+
+	bool isOpen() const;
+	size_t getCount() const;
+	size_t getRecordSize() const;
+	size_t getKeyOffset() const;
+	size_t getKeySize() const;
+	bool hasBloomFilter() const;
+
+    protected:
+	SortedTableBase(int (*cmp)(const void *pl, const void *pr),
+			void (*hash)(HashValue *pHashValue, const void *pKey));
+	~SortedTableBase();
+
+	static int write(const char *pPath, const void *pArray, size_t n,
+			 size_t size, size_t keyOffset, size_t keySize,
+			 int (*cmp)(const void *pl, const void *pr),
+			 void (*hash)(HashValue *pHashValue, const void *pKey),
+			 unsigned bitsPerKey, size_t blockBytes);
+
+	int open(const char *pPath, size_t size, size_t keyOffset,
+		 size_t keySize);
+	const void *find(const void *pKey) const;
+	const void *lowerBound(const void *pKey) const;
+	const void *getRecord(size_t i) const;
+	const void *getFirst() const;
+	const void *getNext(const void *pRecord) const;
+
+    private:
+	SortedTableBase(const SortedTableBase &);
+	SortedTableBase &operator=(const SortedTableBase &);
+
+	int (*cmp)(const void *pl, const void *pr);
+	void (*hash)(HashValue *pHashValue, const void *pKey);
+
+	void *pMap;
+	size_t mapBytes;
+	const char *pData;
+	const char *pIndex;
+	size_t indexStride;
+	size_t nRecords;
+	size_t nBlocks;
+	size_t recordsPerBlock;
+	size_t blockBytes;
+	size_t recordSize;
+	size_t recordKeyOffset;
+	size_t recordKeySize;
+	BloomFilter bloomFilter;
+	bool useBloomFilter;
+    };
+
+
+    template<class T, class K, size_t keyOffset>
+    class SortedTable :
+	public SortedTableBase
+    {
+    public:
+	/*
+	  Construct a reader.  The table must be open()ed before it can be
+	  used.
+
+	  @param cmp comparison function for keys; this must be the same one
+	    the table was written with
+	  @param hash hash function for keys, needed to use the table's Bloom
+	    filter; this must be the same one the table was written with;
+	    see hash.h for candidate functions
+	*/
+	SortedTable(int (*cmp)(const K *pl, const K *pr),
+		    void (*hash)(HashValue *pHashValue, const K *pKey) = NULL);
+
+	/*
+	  write()
+
+	  Write a table.
+
+	  @param pPath the file to write; this is replaced if it exists
+	  @param pArray the records, sorted by key
+	  @param n the number of records
+	  @param cmp comparison function for keys
+	  @param hash hash function for keys; if this is not NULL, the table
+	    gets a Bloom filter
+	  @param bitsPerKey the size of the Bloom filter; 10 gives a false
+	    positive rate of about 1%
+	  @param blockBytes the size of a block of records; this is rounded up
+	    to a multiple of the page size
+	  @returns zero on success, EINVAL if the records are not sorted, or an
+	    errno value from writing the file
+	*/
+	static int write(const char *pPath, const T *pArray, size_t n,
+			 int (*cmp)(const K *pl, const K *pr),
+			 void (*hash)(HashValue *pHashValue, const K *pKey) =
+			 NULL,
+			 unsigned bitsPerKey = 10, size_t blockBytes = 4096);
+
+	/*
+	  open()
+
+	  Map a table written by write().  Any table already open is closed.
+
+	  @param pPath the file to open
+	  @returns zero on success, EINVAL if the file is not a table of this
+	    type of record and key, or an errno value from mapping the file
+	*/
+	int open(const char *pPath);
+
+	/*
+	  find()
+
+	  @param pKey the key to look for
+	  @returns the first record with the key, or NULL if there is none
+	*/
+	const T *find(const K *pKey) const;
+
+	/*
+	  lowerBound()
+
+	  @param pKey the key to look for
+	  @returns the first record whose key is not less than pKey, or NULL
+	    if there is none
+	*/
+	const T *lowerBound(const K *pKey) const;
+
+	/*
+	  getRecord()
+
+	  @param i the position of the record, in [0, getCount())
+	  @returns the record
+	*/
+	const T *getRecord(size_t i) const;
+
+	/*
+	  Walk the records in order.  These return NULL at the end.
+	*/
+	const T *getFirst() const;
+	const T *getNext(const T *pRecord) const;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline bool SortedTableBase::isOpen() const
+    {
+	return pMap != NULL;
+    }
+
+    inline size_t SortedTableBase::getCount() const
+    {
+	return nRecords;
+    }
+
+    inline size_t SortedTableBase::getRecordSize() const
+    {
+	return recordSize;
+    }
+
+    inline size_t SortedTableBase::getKeyOffset() const
+    {
+	return recordKeyOffset;
+    }
+
+    inline size_t SortedTableBase::getKeySize() const
+    {
+	return recordKeySize;
+    }
+
+    inline bool SortedTableBase::hasBloomFilter() const
+    {
+	return useBloomFilter;
+    }
+
+    inline const void *SortedTableBase::getRecord(size_t i) const
+    {
+	return pData + (i / recordsPerBlock) * blockBytes +
+	    (i % recordsPerBlock) * recordSize;
+    }
+
+    inline const void *SortedTableBase::getFirst() const
+    {
+	return nRecords ? pData : NULL;
+    }
+
+
+    template<class T, class K, size_t keyOffset>
+    inline SortedTable<T, K, keyOffset>::SortedTable(
+	int (*cmp)(const K *pl, const K *pr),
+	void (*hash)(HashValue *pHashValue, const K *pKey)):
+	SortedTableBase((int (*)(const void *, const void *))cmp,
+			(void (*)(HashValue *, const void *))hash)
+    {
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline int SortedTable<T, K, keyOffset>::write(
+	const char *pPath, const T *pArray, size_t n,
+	int (*cmp)(const K *pl, const K *pr),
+	void (*hash)(HashValue *pHashValue, const K *pKey),
+	unsigned bitsPerKey, size_t blockBytes)
+    {
+	/* as for qsort(), the template only provides type safety */
+	return SortedTableBase::write(
+	    pPath, pArray, n, sizeof(T), keyOffset, sizeof(K),
+	    (int (*)(const void *, const void *))cmp,
+	    (void (*)(HashValue *, const void *))hash, bitsPerKey, blockBytes);
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline int SortedTable<T, K, keyOffset>::open(const char *pPath)
+    {
+	return SortedTableBase::open(pPath, sizeof(T), keyOffset, sizeof(K));
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline const T *SortedTable<T, K, keyOffset>::find(const K *pKey) const
+    {
+	return (const T *)SortedTableBase::find(pKey);
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline const T *SortedTable<T, K, keyOffset>::lowerBound(
+	const K *pKey) const
+    {
+	return (const T *)SortedTableBase::lowerBound(pKey);
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline const T *SortedTable<T, K, keyOffset>::getRecord(size_t i) const
+    {
+	return (const T *)SortedTableBase::getRecord(i);
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline const T *SortedTable<T, K, keyOffset>::getFirst() const
+    {
+	return (const T *)SortedTableBase::getFirst();
+    }
+
+    template<class T, class K, size_t keyOffset>
+    inline const T *SortedTable<T, K, keyOffset>::getNext(
+	const T *pRecord) const
+    {
+	return (const T *)SortedTableBase::getNext(pRecord);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_SORTEDTABLE_H */
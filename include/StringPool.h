@@ -0,0 +1,133 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    StringPool.h - string interning with stable IDs
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    A StringPool keeps one copy of each distinct string interned in it, and
+    gives each one a small integer ID.  IDs are assigned densely from zero,
+    in the order strings are first interned, so they can also be used as
+    array indexes.  After strings are interned, they can be compared with
+    compareUnsignedLong() on their IDs, and hashed with hashUnsignedLong(),
+    so it is no longer necessary to hash or compare the characters; two
+    IDs are equal if and only if the strings are.
+
+    The pointer returned by getString() is also stable, and unique to the
+    string, so interned strings can be compared for equality by pointer as
+    well.  Strings live until the pool is destroyed.  Note that the order
+    of IDs and pointers is unrelated to the strings' lexical order, so they
+    can't be used for sorting strings.
+
+    Interning is thread-safe.  The strings are divided among a number of
+    shards by hash, each with its own lock, hash table, and arena for the
+    characters, so threads interning different strings rarely contend.
+    getString() takes no locks.  Any ID below getCount() may be passed to
+    getString(), even while other threads are interning strings.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_STRINGPOOL_H
+#define PHOENIX4CPP_STRINGPOOL_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+    struct StringPoolShard;
+
+    class StringPool
+    {
+    public:
+	/*
+	  Construct an empty pool.
+
+	  @param nShards the number of shards; this is rounded up to a power
+	    of two
+	*/
+	StringPool(unsigned nShards = 16);
+	~StringPool();
+
+	/*
+	  intern()
+
+	  Add a string to the pool, if it isn't already there.
+
+	  @param pS the string; this is copied if it is new
+	  @returns the string's ID
+	*/
+	unsigned long intern(const char *pS);
+
+	/*
+	  find()
+
+	  @param pS the string
+	  @returns the string's ID if it has been interned, notFound otherwise
+	*/
+	unsigned long find(const char *pS) const;
+
+	static const unsigned long notFound = ~0UL;
+
+	/*
+	  getString()
+
+	  @param id a string's ID, as returned by intern() or find()
+	  @returns the pool's copy of the string
+	*/
+	const char *getString(unsigned long id) const;
+
+	/*
+	  getCount()
+
+	  @returns the number of distinct strings interned; the strings for
+	    all of the IDs below this are available from getString()
+	*/
+	unsigned long getCount() const;
+
+    private:
+	StringPool(const StringPool &);
+	StringPool &operator=(const StringPool &);
+
+	StringPoolShard *getShard(unsigned long long hashValue) const;
+	const char **getSlot(unsigned long id);
+
+	StringPoolShard *pShard;
+	unsigned shardBits;
+
+	/*
+	  The strings by ID.  Chunk i holds (firstChunkSize << i) IDs; chunks
+	  are allocated as they are needed, and never move.
+	*/
+	static const unsigned maxChunks = 48;
+	const char **ppChunk[maxChunks];
+
+	unsigned long nextId;
+	/* every ID below this has its string stored */
+	unsigned long nPublished;
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline unsigned long StringPool::getCount() const
+    {
+	return __atomic_load_n(&nPublished, __ATOMIC_ACQUIRE);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_STRINGPOOL_H */
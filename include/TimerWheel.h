@@ -0,0 +1,246 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    TimerWheel.h - Hierarchical timing wheel of intrusive timers
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    This follows the same model as DoublyLinked.h.  A TimerWheelMembership,
+    which is a DoublyLinkedMembership with an expiry time, is embedded in
+    each client element that is to be timed, and the wheel's slots are
+    DoublyLinkedLists of them.  Arming a timer links it onto a slot, and
+    cancelling it is just DoublyLinkedMembership::remove(), so both are
+    O(1), and nothing is allocated.  Destroying an element also cancels its
+    timer, as with any other DoublyLinkedMembership.
+
+    Time is measured in ticks, in whatever unit the client chooses.  There
+    are eight levels of 256 slots each, one for each byte of a 64 bit
+    time.  A timer goes on the level of the most significant byte in which
+    its expiry time differs from the current time, in the slot for that
+    byte of its expiry time.  When the current time reaches the start of a
+    slot's range, the timers in it are moved down to lower levels, and when
+    it reaches a level 0 slot, the timers in it fire.  Each timer is moved
+    at most seven times in its life, so the cost of cascading is amortized
+    over the ticks that pass while it is armed.
+
+    Because cancellation doesn't involve the wheel, the wheel does not know
+    how many timers are armed.
+
+    Templates are used, but only for type safety.  All of the work is done by
+    TimerWheelBase, which operates on (void *).
+
+    In order to use this package with gcc, you must compile with the
+    -Wno-invalid-offsetof option to prevent complaints about the use of
+    offsetof().
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_TIMERWHEEL_H
+#define PHOENIX4CPP_TIMERWHEEL_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_DOUBLYLINKED_H
+#include "DoublyLinked.h"
+#endif
+
+namespace phoenix4cpp
+{
+
+    /*
+      Embed one of these in any element that is to be timed by a
+      TimerWheel.  The timer is cancelled with remove(), and isMember() is
+      true while it is armed.
+    */
+    class TimerWheelMembership :
+	public DoublyLinkedMembership
+    {
+    public:
+	TimerWheelMembership();
+
+	/*
+	  getExpiry()
+
+	  @returns the time the timer was last armed to expire at; timers
+	    armed for times that had already passed have the time they will
+	    actually fire at
+	*/
+	unsigned long long getExpiry() const;
+
+    private:
+	friend class TimerWheelBase;
+
+	unsigned long long expiry;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of TimerWheel.  See that class for usage.
+    */
+    class TimerWheelBase
+    {
+    public:
+	/*
+	  getNow()
+
+	  @returns the wheel's current time
+	*/
+	unsigned long long getNow() const;
+
+	/*
+	  cancelAll()
+
+	  Cancel all of the armed timers.
+	*/
+	void cancelAll();
+
+    protected:
+	TimerWheelBase(size_t membershipOffset, unsigned long long now);
+	~TimerWheelBase();
+
+	void arm(void *pElement, unsigned long long expiry);
+	size_t advance(unsigned long long now,
+		       void (*fire)(void *pContext, void *pElement),
+		       void *pContext);
+
+    private:
+	TimerWheelBase(const TimerWheelBase &);
+	TimerWheelBase &operator=(const TimerWheelBase &);
+
+	typedef DoublyLinkedList<TimerWheelMembership, 0> Slot;
+
+	enum
+	{
+	    slotBits = 8,
+	    nSlots = 1 << slotBits,
+	    nLevels = 64 / slotBits
+	};
+
+	TimerWheelMembership *toMembership(const void *pElement) const;
+	void *toElement(const TimerWheelMembership *pMembership) const;
+	void place(TimerWheelMembership *pM);
+	void cascade(unsigned level);
+	unsigned long long nextEvent() const;
+
+	Slot slot[nLevels][nSlots];
+	unsigned long long now;
+	size_t membershipOffset;
+    };
+
+
+    template<class element, size_t offset>
+    class TimerWheel :
+	public TimerWheelBase
+    {
+    public:
+	/*
+	  Construct an empty wheel.
+
+	  @param now the wheel's starting time
+	*/
+	TimerWheel(unsigned long long now = 0);
+
+	/*
+	  The wheel does not own its elements, so they are not deleted; any
+	  timers that are still armed are cancelled.
+	*/
+	~TimerWheel();
+
+	/*
+	  arm()
+
+	  Arm an element's timer, cancelling it first if it is already armed.
+	  A timer armed for a time that is not after the current time will
+	  fire on the next tick.
+
+	  @param pElement the element
+	  @param expiry the time at which the timer is to fire
+	*/
+	void arm(element *pElement, unsigned long long expiry);
+
+	/*
+	  advance()
+
+	  Move the current time forward, firing every timer that expires on
+	  the way, in order of expiry.  Each timer is cancelled before it is
+	  passed to the callback, which may arm or cancel any timer,
+	  including the one that fired.  Ticks on which no timer fires or
+	  cascades are skipped, at the cost of looking through at most 256
+	  slots on each level for the next occupied one.
+
+	  @param now the new time; if this is not after the current time,
+	    nothing happens
+	  @param fire callback for each timer that fires
+	  @param pContext passed to the callback
+	  @returns the number of timers that fired
+	*/
+	template<class C>
+	size_t advance(unsigned long long now,
+		       void (*fire)(C *pContext, element *pElement),
+		       C *pContext);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline TimerWheelMembership::TimerWheelMembership():
+	expiry(0)
+    {
+    }
+
+    inline unsigned long long TimerWheelMembership::getExpiry() const
+    {
+	return expiry;
+    }
+
+    inline unsigned long long TimerWheelBase::getNow() const
+    {
+	return now;
+    }
+
+
+    template<class element, size_t offset>
+    inline TimerWheel<element, offset>::TimerWheel(unsigned long long now):
+	TimerWheelBase(offset, now)
+    {
+    }
+
+    template<class element, size_t offset>
+    inline TimerWheel<element, offset>::~TimerWheel()
+    {
+    }
+
+    template<class element, size_t offset>
+    inline void TimerWheel<element, offset>::arm(
+	element *pElement, unsigned long long expiry)
+    {
+	TimerWheelBase::arm((void *)pElement, expiry);
+    }
+
+    template<class element, size_t offset>
+    template<class C>
+    inline size_t TimerWheel<element, offset>::advance(
+	unsigned long long now, void (*fire)(C *pContext, element *pElement),
+	C *pContext)
+    {
+	return TimerWheelBase::advance(
+	    now, (void (*)(void *, void *))fire, (void *)pContext);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_TIMERWHEEL_H */
@@ -0,0 +1,367 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    UnrolledList.h - Unrolled list of fixed size elements stored in chunks
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    DoublyLinkedList links elements wherever they happen to have been
+    allocated, so walking a long list costs a dependent load, and often a
+    cache miss, per element.  UnrolledList instead copies elements into
+    chunks that are a power of two bytes in size, and links the chunks.
+    A walk only follows a pointer once per chunk, reads memory
+    sequentially, and prefetches the next chunk when it enters one, so it
+    runs at close to the speed of an array scan.  That suits append-heavy
+    uses such as logs, which are written at the end, scanned from one end
+    to the other, and trimmed in bulk.
+
+    Elements are copied in and moved with memcpy(), so they must be plain
+    data (pointers to other objects are fine); no constructors or
+    destructors are run.  Elements don't move while they are in the list
+    unless removeIf() is called, which compacts it, so pointers to them
+    are good until then, or until they are removed.
+
+    Chunks are allocated aligned to their size.  That lets getNext() find
+    the chunk an element is in from the element's address, without the
+    element or the caller having to keep track of it.
+
+    Templates are used, but only for type safety.  All of the work is done
+    by UnrolledListBase, which operates on (void *).
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_UNROLLEDLIST_H
+#define PHOENIX4CPP_UNROLLEDLIST_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+namespace phoenix4cpp
+{
+
+    /*
+      The header at the start of each chunk.  Elements follow it, and the
+      ones in use are those from begin up to end.
+    */
+    class UnrolledListChunk
+    {
+    private:
+	friend class UnrolledListBase;
+
+	UnrolledListChunk *pNext;
+	UnrolledListChunk *pPrevious;
+	size_t begin;
+	size_t end;
+    };
+
+    /*
+      This class is an implementation artifact that contains the untyped
+      implementation of UnrolledList.  See that class for usage.
+    */
+    class UnrolledListBase
+    {
+    public:
+	size_t getCount() const;
+	bool isEmpty() const;
+
+	/*
+	  getChunkBytes()
+
+	  @returns the size of a chunk, including its header
+	*/
+	size_t getChunkBytes() const;
+
+	/*
+	  getChunkCapacity()
+
+	  @returns the number of elements that fit in a chunk
+	*/
+	size_t getChunkCapacity() const;
+
+	/*
+	  clear()
+
+	  Remove all of the elements, and free all of the chunks.
+	*/
+	void clear();
+
+	/*
+	  removeFirst()
+
+	  Remove elements from the front of the list.  Chunks that are
+	  emptied are freed without looking at their elements, so this is
+	  O(n / chunk capacity).
+
+	  @param n the number of elements to remove; if this is more than the
+	    list holds, the list is emptied
+	*/
+	void removeFirst(size_t n);
+
+	/*
+	  Iterate over the list a chunk at a time.  getNextChunk() prefetches
+	  the chunk after the one it returns.  An element run is a contiguous
+	  array of elements.
+	*/
+	const UnrolledListChunk *getFirstChunk() const;
+	const UnrolledListChunk *getNextChunk(
+	    const UnrolledListChunk *pChunk) const;
+
+    protected:
+	UnrolledListBase(size_t elementSize, size_t chunkBytes);
+	~UnrolledListBase();
+
+	void *append(const void *pElement);
+	void *getFirst() const;
+	void *getLast() const;
+	void *getNext(const void *pElement) const;
+	void *getPrevious(const void *pElement) const;
+	void *getRun(const UnrolledListChunk *pChunk, size_t *pCount) const;
+	size_t removeIf(bool (*remove)(void *pContext, const void *pElement),
+			void *pContext);
+
+    private:
+	UnrolledListBase(const UnrolledListBase &);
+	UnrolledListBase &operator=(const UnrolledListBase &);
+
+	char *getSlots(const UnrolledListChunk *pChunk) const;
+	UnrolledListChunk *getChunk(const void *pElement) const;
+	UnrolledListChunk *newChunk();
+	void freeChunk(UnrolledListChunk *pChunk);
+
+	UnrolledListChunk *pHead;
+	UnrolledListChunk *pTail;
+	size_t count;
+
+	size_t elementSize;
+	size_t chunkBytes;
+	size_t capacity;
+    };
+
+
+    template<class element>
+    class UnrolledList :
+	public UnrolledListBase
+    {
+    public:
+	/*
+	  Construct an empty list.
+
+	  @param chunkBytes the size of each chunk; this is rounded up to a
+	    power of two, and to at least enough for four elements and the
+	    chunk header
+	*/
+	UnrolledList(size_t chunkBytes = 4096);
+
+	/*
+	  append()
+
+	  Copy an element onto the end of the list.
+
+	  @param pElement the element to copy
+	  @returns the copy in the list
+	*/
+	element *append(const element *pElement);
+
+	/*
+	  Iterate over the elements in order, in either direction.
+	*/
+	element *getFirst() const;
+	element *getLast() const;
+	element *getNext(const element *pElement) const;
+	element *getPrevious(const element *pElement) const;
+
+	/*
+	  getRun()
+
+	  Get the elements in a chunk from getFirstChunk() or getNextChunk().
+
+	  @param pChunk the chunk
+	  @param pCount where to return the number of elements in the run
+	  @returns the first element of the run
+	*/
+	element *getRun(const UnrolledListChunk *pChunk, size_t *pCount) const;
+
+	/*
+	  removeIf()
+
+	  Remove all of the elements that satisfy a predicate.  The ones that
+	  remain keep their order, and are packed into as few chunks as
+	  possible; chunks that are no longer needed are freed.  This moves
+	  elements, so any pointers to them are invalid afterwards.
+
+	  @param remove the predicate; returns true if the element should be
+	    removed
+	  @param pContext passed to the predicate
+	  @returns the number of elements removed
+	*/
+	template<class C>
+	size_t removeIf(bool (*remove)(C *pContext, const element *pElement),
+			C *pContext);
+    };
+
+} // namespace phoenix4cpp
+
+
+/* ======================== PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+    inline size_t UnrolledListBase::getCount() const
+    {
+	return count;
+    }
+
+    inline bool UnrolledListBase::isEmpty() const
+    {
+	return !count;
+    }
+
+    inline size_t UnrolledListBase::getChunkBytes() const
+    {
+	return chunkBytes;
+    }
+
+    inline size_t UnrolledListBase::getChunkCapacity() const
+    {
+	return capacity;
+    }
+
+    inline const UnrolledListChunk *UnrolledListBase::getFirstChunk() const
+    {
+	return pHead;
+    }
+
+    inline const UnrolledListChunk *UnrolledListBase::getNextChunk(
+	const UnrolledListChunk *pChunk) const
+    {
+	const UnrolledListChunk *pNext = pChunk->pNext;
+	if (pNext && pNext->pNext)
+	    __builtin_prefetch(pNext->pNext);
+	return pNext;
+    }
+
+    inline char *UnrolledListBase::getSlots(
+	const UnrolledListChunk *pChunk) const
+    {
+	/* the header is 32 bytes, which leaves the slots 16 byte aligned */
+	return ((char *)pChunk) + sizeof(UnrolledListChunk);
+    }
+
+    inline UnrolledListChunk *UnrolledListBase::getChunk(
+	const void *pElement) const
+    {
+	return (UnrolledListChunk *)(
+	    ((size_t)pElement) & ~(chunkBytes - 1));
+    }
+
+    inline void *UnrolledListBase::getFirst() const
+    {
+	return (pHead ? getSlots(pHead) + pHead->begin * elementSize : NULL);
+    }
+
+    inline void *UnrolledListBase::getLast() const
+    {
+	return (pTail ? getSlots(pTail) + (pTail->end - 1) * elementSize :
+		NULL);
+    }
+
+    inline void *UnrolledListBase::getNext(const void *pElement) const
+    {
+	const UnrolledListChunk *pChunk = getChunk(pElement);
+	const char *pNext = ((const char *)pElement) + elementSize;
+	if (pNext < getSlots(pChunk) + pChunk->end * elementSize)
+	    return (void *)pNext;
+
+	const UnrolledListChunk *pNextChunk = getNextChunk(pChunk);
+	return (pNextChunk ?
+		getSlots(pNextChunk) + pNextChunk->begin * elementSize : NULL);
+    }
+
+    inline void *UnrolledListBase::getPrevious(const void *pElement) const
+    {
+	const UnrolledListChunk *pChunk = getChunk(pElement);
+	const char *pSlots = getSlots(pChunk);
+	if (((const char *)pElement) > pSlots + pChunk->begin * elementSize)
+	    return (void *)(((const char *)pElement) - elementSize);
+
+	const UnrolledListChunk *pPrevious = pChunk->pPrevious;
+	return (pPrevious ?
+		getSlots(pPrevious) + (pPrevious->end - 1) * elementSize :
+		NULL);
+    }
+
+    inline void *UnrolledListBase::getRun(
+	const UnrolledListChunk *pChunk, size_t *pCount) const
+    {
+	*pCount = pChunk->end - pChunk->begin;
+	return getSlots(pChunk) + pChunk->begin * elementSize;
+    }
+
+
+    template<class element>
+    inline UnrolledList<element>::UnrolledList(size_t chunkBytes):
+	UnrolledListBase(sizeof(element), chunkBytes)
+    {
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::append(const element *pElement)
+    {
+	return (element *)UnrolledListBase::append((const void *)pElement);
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::getFirst() const
+    {
+	return (element *)UnrolledListBase::getFirst();
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::getLast() const
+    {
+	return (element *)UnrolledListBase::getLast();
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::getNext(
+	const element *pElement) const
+    {
+	return (element *)UnrolledListBase::getNext((const void *)pElement);
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::getPrevious(
+	const element *pElement) const
+    {
+	return (element *)UnrolledListBase::getPrevious(
+	    (const void *)pElement);
+    }
+
+    template<class element>
+    inline element *UnrolledList<element>::getRun(
+	const UnrolledListChunk *pChunk, size_t *pCount) const
+    {
+	return (element *)UnrolledListBase::getRun(pChunk, pCount);
+    }
+
+    template<class element>
+    template<class C>
+    inline size_t UnrolledList<element>::removeIf(
+	bool (*remove)(C *pContext, const element *pElement), C *pContext)
+    {
+	return UnrolledListBase::removeIf(
+	    (bool (*)(void *, const void *))remove, (void *)pContext);
+    }
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_UNROLLEDLIST_H */
@@ -79,6 +79,34 @@ template<class T, class K, size_t keyOffset>
 const T *bsearch(const K *pKey, const T *pArray, size_t n,
 		 int (*cmp)(const K *pk1, const K *pk2));
 
+/*
+  lowerBound() - find where a key belongs in a sorted array
+
+  lowerBound() finds the first array element whose key is not less than the
+  specified key.  If the key appears more than once, this is the first of the
+  matching elements; if it does not appear, this is where it would be
+  inserted to keep the array sorted.  This is useful for range scans, and for
+  searches for the nearest key, such as on a consistent hashing ring.
+
+  The parameters are the same as for bsearch().
+
+  @returns pointer to the first array element whose key is not less than the
+    key searched for; if there is none, this is a pointer to the element
+    just past the end of the array
+*/
+void *lowerBound(const void *pKey, const void *pArray, size_t n, size_t size,
+		 size_t keyOffset, int (*cmp)(const void *pl, const void *pr));
+
+/*
+  lowerBound() - type-safe lower bound search
+
+  See the description of the type-unsafe lowerBound() above, and the
+  type-safe bsearch() for the parameters.
+*/
+template<class T, class K, size_t keyOffset>
+const T *lowerBound(const K *pKey, const T *pArray, size_t n,
+		    int (*cmp)(const K *pk1, const K *pk2));
+
 } // namespace phoenix4cpp
 
 
@@ -101,6 +129,16 @@ inline const T *bsearch(const K *pKey, const T *pArray, size_t n,
 	keyOffset, (int (*)(const void *, const void *))cmp);
 }
 
+template<class T, class K, size_t keyOffset>
+inline const T *lowerBound(const K *pKey, const T *pArray, size_t n,
+			   int (*cmp)(const K *pl, const K *pr))
+{
+    /* see bsearch() above */
+    return (const T *)lowerBound(
+	(const void *)pKey, (const void *)pArray, n, sizeof(T),
+	keyOffset, (int (*)(const void *, const void *))cmp);
+}
+
 } // namespace phoenix4cpp
 
 #endif /* PHOENIX4CPP_BSEARCH_H */
@@ -27,6 +27,19 @@ namespace phoenix4cpp
 {
 class HashValue;
 
+/**
+  Blend a value into a hash value accumulator.
+
+  These are the hashing counterparts of the comparison functions in compare.h,
+  and take the same pointer arguments; e.g. hashCharStar() hashes the same
+  string that compareCharStar() compares.  Each produces the same hash as the
+  matching utility class in Hashable.h, so elements hashed with one can be
+  looked up with the other.
+
+  @param pHashValue the hash value accumulator
+  @param p pointer to the value to hash
+ */
+void hashCharStar(HashValue *pHashValue, const char *const *pps);
 void hashUnsignedLong(HashValue *pHashValue, const unsigned long *pul);
 
 } // namespace phoenix4cpp
@@ -0,0 +1,128 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    heap.h - 4-ary implicit heaps with offsets
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    These functions maintain a priority queue in an array that belongs to
+    the caller, in the same way that qsort() sorts one.  The element with
+    the smallest key is at the front of the array.
+
+    Each node has four children instead of two.  That halves the depth of
+    the heap, and the four children are next to each other, usually in the
+    same cache line or two, so a pop touches half as many cache lines as it
+    would in a binary heap, for a few more comparisons.  Elements are moved
+    into a hole rather than being swapped, so each level costs one copy
+    instead of three.
+
+    The heap doesn't keep track of where elements are, so there is no
+    decrease-key operation.  Callers that need one can push the element
+    again and skip stale copies as they are popped, or use PairingHeap.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_HEAP_H
+#define PHOENIX4CPP_HEAP_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+/*
+  makeHeap() - arrange an array into a heap
+
+  This takes O(n) time, which is faster than pushing the elements one at a
+  time.
+
+  @param pArray pointer to base of array
+  @param n number of items in the array
+  @param size size of an array element
+  @param keyOffset offset of the key within an array element
+  @param cmp comparison function used to compare keys; returns a value less
+    than zero if (*pl < *pr), zero if (*pl == *pr), or a value greater than zero
+    if (*pl > *pr); see compare.h for candidate functions
+*/
+void makeHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	      int (*cmp)(const void *pl, const void *pr));
+
+/*
+  pushHeap() - add an element to a heap
+
+  The first (n - 1) elements of the array must already be a heap, and the
+  new element must have been stored after them, at pArray[n - 1].
+
+  The other parameters are the same as for makeHeap().
+
+  @param n the number of elements, including the new one
+*/
+void pushHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	      int (*cmp)(const void *pl, const void *pr));
+
+/*
+  popHeap() - remove the smallest element from a heap
+
+  The smallest element is moved to pArray[n - 1], and the first (n - 1)
+  elements are rearranged into a heap.
+
+  The other parameters are the same as for makeHeap().
+
+  @param n the number of elements in the heap; this must not be zero
+*/
+void popHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	     int (*cmp)(const void *pl, const void *pr));
+
+/*
+  Type-safe versions of the above; see qsort() for the template parameters.
+*/
+template<class T, class K, size_t keyOffset>
+void makeHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr));
+template<class T, class K, size_t keyOffset>
+void pushHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr));
+template<class T, class K, size_t keyOffset>
+void popHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr));
+
+} // namespace phoenix4cpp
+
+
+/* ========================= PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+/* see qsort() in qsort.h */
+template<class T, class K, size_t keyOffset>
+inline void makeHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr))
+{
+    makeHeap((void *)pArray, n, sizeof(T), keyOffset,
+	     (int (*)(const void *, const void *))cmp);
+}
+
+template<class T, class K, size_t keyOffset>
+inline void pushHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr))
+{
+    pushHeap((void *)pArray, n, sizeof(T), keyOffset,
+	     (int (*)(const void *, const void *))cmp);
+}
+
+template<class T, class K, size_t keyOffset>
+inline void popHeap(T *pArray, size_t n, int (*cmp)(const K *pl, const K *pr))
+{
+    popHeap((void *)pArray, n, sizeof(T), keyOffset,
+	    (int (*)(const void *, const void *))cmp);
+}
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_HEAP_H */
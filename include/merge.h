@@ -0,0 +1,287 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    merge.h - k-way merge of sorted arrays with offsets
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    kwayMerge() merges any number of arrays that are already sorted, such
+    as log segments or the results of several threads, in a single pass.
+    That is much cheaper than sorting their concatenation with qsort():  a
+    merge takes about log2(k) comparisons per record for k arrays, where a
+    sort takes about log2(n).  Records are addressed as for qsort(), with a
+    key at a fixed offset, so the same comparison functions (see
+    compare.h) can be used.
+
+    The merge is done with a loser tree (a tournament tree that keeps the
+    loser of each match at its node, and the overall winner at the top).
+    After the winning record is taken, only the matches on the path from
+    its array's leaf to the top are replayed, each against a stored loser,
+    so each record costs exactly one comparison per level.  A binary heap
+    needs about twice as many, because each level compares two children
+    and then the winner against the element sinking down.
+
+    The merge is stable:  records with equal keys come out in the order of
+    the arrays they came from, and in their order within each array.  With
+    de-duplication, only the first record of each group of equal keys is
+    kept, which is the one from the lowest numbered array; if arrays are
+    ordered newest first, as for log-structured segments, that is the
+    newest version of each key.
+
+    LoserTree is available directly for merging from other sources, such
+    as files; see ExternalSort.cpp.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_MERGE_H
+#define PHOENIX4CPP_MERGE_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+class Arena;
+
+/*
+  kwayMerge() - merge sorted arrays into an array
+
+  @param ppArray pointers to the bases of the arrays to merge
+  @param pN the number of records in each array
+  @param k the number of arrays
+  @param size size of a record
+  @param keyOffset offset of the key within a record
+  @param cmp comparison function used to compare keys; returns a value less
+    than zero if (*pl < *pr), zero if (*pl == *pr), or a value greater than zero
+    if (*pl > *pr); see compare.h for candidate functions
+  @param pOut where to put the merged records; this must have room for all
+    of them, and must not overlap any of the inputs
+  @param unique if true, only the first record with each key is kept
+  @returns the number of records written to pOut
+*/
+size_t kwayMerge(const void *const *ppArray, const size_t *pN, size_t k,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 void *pOut, bool unique = false);
+
+/*
+  kwayMerge() - merge sorted arrays into a callback
+
+  As above, except that each merged record is passed to a callback as it
+  is found, rather than being copied.
+
+  @param emit called with each merged record, in order
+  @param pContext passed to the callback
+  @returns the number of records passed to the callback
+*/
+size_t kwayMerge(const void *const *ppArray, const size_t *pN, size_t k,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 void (*emit)(void *pContext, const void *pRecord),
+		 void *pContext, bool unique = false);
+
+/*
+  kwayMerge() - type-safe merge into an array
+
+  See the description of the type-unsafe kwayMerge() above.
+
+  @params T the type of the records
+  @params K the type of the key
+  @params keyOffset offset of the key within a record
+*/
+template<class T, class K, size_t keyOffset>
+size_t kwayMerge(const T *const *ppArray, const size_t *pN, size_t k,
+		 int (*cmp)(const K *pl, const K *pr),
+		 T *pOut, bool unique = false);
+
+/*
+  kwayMerge() - type-safe merge into a callback
+
+  See the description of the type-unsafe kwayMerge() above.
+
+  @params T the type of the records
+  @params K the type of the key
+  @params C the type of the callback's context
+  @params keyOffset offset of the key within a record
+*/
+template<class T, class K, class C, size_t keyOffset>
+size_t kwayMerge(const T *const *ppArray, const size_t *pN, size_t k,
+		 int (*cmp)(const K *pl, const K *pr),
+		 void (*emit)(C *pContext, const T *pRecord),
+		 C *pContext, bool unique = false);
+
+
+/*
+  A loser tree over k sources, each of which supplies records in order.
+  The tree holds a pointer to each source's current record, or NULL when
+  the source has run out.
+
+  Usage:  set() each source's first record, then start().  Then, as long
+  as getWinnerRecord() is not NULL, use that record, and then advance()
+  with the next record from the same source, getWinner().
+
+  Records must stay where they are until they have been advanced past.
+*/
+class LoserTree
+{
+public:
+    /*
+      @param k the number of sources
+      @param keyOffset offset of the key within a record
+      @param cmp comparison function for keys
+      @param pArena if not NULL, the tree's memory is allocated from this,
+        and not freed by the destructor
+    */
+    LoserTree(size_t k, size_t keyOffset,
+	      int (*cmp)(const void *pl, const void *pr),
+	      Arena *pArena = NULL);
+    ~LoserTree();
+
+    /*
+      set()
+
+      Set a source's first record.
+
+      @param i the source
+      @param pRecord its first record, or NULL if it has none
+    */
+    void set(size_t i, const void *pRecord);
+
+    /*
+      start()
+
+      Play the initial tournament, after all of the sources have been set.
+    */
+    void start();
+
+    /*
+      getWinner()
+
+      @returns the number of the source with the smallest record
+    */
+    size_t getWinner() const;
+
+    /*
+      getWinnerRecord()
+
+      @returns the smallest record, or NULL if all sources have run out
+    */
+    const void *getWinnerRecord() const;
+
+    /*
+      advance()
+
+      Replace the winning record with the next one from the same source,
+      and find the new winner.
+
+      @param pNext the source's next record, or NULL if it has run out
+    */
+    void advance(const void *pNext);
+
+private:
+    LoserTree(const LoserTree &);
+    LoserTree &operator=(const LoserTree &);
+
+    bool beats(size_t a, size_t b) const;
+    size_t play(size_t node);
+
+    /* a power of two, at least the number of sources */
+    size_t nLeaves;
+    size_t keyOffset;
+    int (*cmp)(const void *pl, const void *pr);
+    /* the winner, then the loser at each internal node */
+    size_t *pNode;
+    /* each leaf's current record */
+    const char **ppRecord;
+    bool ownMemory;
+};
+
+} // namespace phoenix4cpp
+
+
+/* ========================= PRIVATE IMPLEMENTATION ========================= */
+
+namespace phoenix4cpp
+{
+
+template<class T, class K, size_t keyOffset>
+inline size_t kwayMerge(const T *const *ppArray, const size_t *pN, size_t k,
+			int (*cmp)(const K *pl, const K *pr),
+			T *pOut, bool unique)
+{
+    /* as for qsort(), this only provides type safety */
+    return kwayMerge((const void *const *)ppArray, pN, k, sizeof(T),
+		     keyOffset, (int (*)(const void *, const void *))cmp,
+		     (void *)pOut, unique);
+}
+
+template<class T, class K, class C, size_t keyOffset>
+inline size_t kwayMerge(const T *const *ppArray, const size_t *pN, size_t k,
+			int (*cmp)(const K *pl, const K *pr),
+			void (*emit)(C *pContext, const T *pRecord),
+			C *pContext, bool unique)
+{
+    /* as for qsort(), this only provides type safety */
+    return kwayMerge((const void *const *)ppArray, pN, k, sizeof(T),
+		     keyOffset, (int (*)(const void *, const void *))cmp,
+		     (void (*)(void *, const void *))emit, (void *)pContext,
+		     unique);
+}
+
+inline void LoserTree::set(size_t i, const void *pRecord)
+{
+    ppRecord[i] = (const char *)pRecord;
+}
+
+inline size_t LoserTree::getWinner() const
+{
+    return pNode[0];
+}
+
+inline const void *LoserTree::getWinnerRecord() const
+{
+    return ppRecord[pNode[0]];
+}
+
+inline bool LoserTree::beats(size_t a, size_t b) const
+{
+    const char *pA = ppRecord[a];
+    const char *pB = ppRecord[b];
+    if (!pA)
+	return false;
+    if (!pB)
+	return true;
+
+    const int c = (*cmp)(pA + keyOffset, pB + keyOffset);
+    return (c < 0) || (!c && (a < b));
+}
+
+inline void LoserTree::advance(const void *pNext)
+{
+    size_t winner = pNode[0];
+    ppRecord[winner] = (const char *)pNext;
+    for(size_t node = (winner + nLeaves) >> 1; node; node >>= 1)
+    {
+	if (beats(pNode[node], winner))
+	{
+	    const size_t loser = winner;
+	    winner = pNode[node];
+	    pNode[node] = loser;
+	}
+    }
+    pNode[0] = winner;
+}
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_MERGE_H */
@@ -0,0 +1,141 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    setops.h - intersection, union and difference of sorted arrays
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  NOTES
+    These operate on sets of unsigned or unsigned long values held as
+    arrays in ascending order, such as the output of qsort() with
+    compareUnsigned() or compareUnsignedLong() (see compare.h), and produce
+    their results in the same form.  Each set must not contain duplicates.
+
+    The usual way to intersect two sorted arrays is a merge loop, which
+    takes a comparison and an unpredictable branch for every element of
+    both.  That is a poor choice in two common cases.
+
+    When the sets are of similar size, the merge is done a block of values
+    at a time:  with SSE2, a block from each set (four unsigned values, or
+    two unsigned longs) is compared all against all, with the second
+    block rotated through each position, and whichever block has the
+    smaller last value is advanced.  This does more comparisons, but they
+    are done in parallel, and there is only one branch per block.
+
+    When one set is much smaller than the other, each value of the small
+    set is found in the large one by galloping:  probing forward from the
+    last position found at distances 1, 2, 4, ..., until a value that is
+    not smaller is passed, and then doing a binary search over the last
+    step.  This takes time proportional to the size of the small set
+    times the log of the ratio of the sizes, rather than to the size of
+    the large set.
+
+    By default, the algorithm is chosen automatically by the ratio of the
+    sizes; it can also be chosen explicitly, mainly for benchmarking.
+    Union only has the merge and galloping algorithms; it copies runs from
+    the large set with memcpy() while galloping.
+
+    setIntersectionN() intersects any number of sets, smallest first, so
+    that the running result shrinks as quickly as possible, and later,
+    larger, sets are galloped through.
+ */
+
+#pragma once
+
+#ifndef PHOENIX4CPP_SETOPS_H
+#define PHOENIX4CPP_SETOPS_H
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+enum SetAlgorithm
+{
+    SET_AUTO, /* choose by the ratio of the set sizes */
+    SET_MERGE, /* a scalar merge loop */
+    SET_SIMD, /* a block merge, using SSE2 where available */
+    SET_GALLOP /* galloping search of the larger set */
+};
+
+/*
+  setIntersection() - find the values that are in both of two sets
+
+  @param pA the first set
+  @param nA the number of values in the first set
+  @param pB the second set
+  @param nB the number of values in the second set
+  @param pOut where to put the values in both; this must have room for the
+    smaller of nA and nB values; it may be the same as pA
+  @param algorithm the algorithm to use
+  @returns the number of values written to pOut
+*/
+size_t setIntersection(const unsigned *pA, size_t nA,
+		       const unsigned *pB, size_t nB, unsigned *pOut,
+		       SetAlgorithm algorithm = SET_AUTO);
+size_t setIntersection(const unsigned long *pA, size_t nA,
+		       const unsigned long *pB, size_t nB,
+		       unsigned long *pOut, SetAlgorithm algorithm = SET_AUTO);
+
+/*
+  setDifference() - find the values that are in one set but not another
+
+  The parameters are as for setIntersection(), except as follows.
+
+  @param pOut where to put the values that are in the first set, but not
+    in the second; this must have room for nA values; it may be the same
+    as pA
+  @returns the number of values written to pOut
+*/
+size_t setDifference(const unsigned *pA, size_t nA,
+		     const unsigned *pB, size_t nB, unsigned *pOut,
+		     SetAlgorithm algorithm = SET_AUTO);
+size_t setDifference(const unsigned long *pA, size_t nA,
+		     const unsigned long *pB, size_t nB,
+		     unsigned long *pOut, SetAlgorithm algorithm = SET_AUTO);
+
+/*
+  setUnion() - find the values that are in either of two sets
+
+  The parameters are as for setIntersection(), except as follows.  SET_SIMD
+  is treated as SET_MERGE.
+
+  @param pOut where to put the values that are in either set; this must
+    have room for nA + nB values, and must not overlap either set
+  @returns the number of values written to pOut
+*/
+size_t setUnion(const unsigned *pA, size_t nA,
+		const unsigned *pB, size_t nB, unsigned *pOut,
+		SetAlgorithm algorithm = SET_AUTO);
+size_t setUnion(const unsigned long *pA, size_t nA,
+		const unsigned long *pB, size_t nB, unsigned long *pOut,
+		SetAlgorithm algorithm = SET_AUTO);
+
+/*
+  setIntersectionN() - find the values that are in all of a number of sets
+
+  @param ppSet pointers to the sets
+  @param pN the number of values in each set
+  @param k the number of sets
+  @param pOut where to put the values in all of the sets; this must have
+    room for as many values as the smallest set has, and must not overlap
+    any of the sets
+  @returns the number of values written to pOut; if k is zero, this is
+    zero
+*/
+size_t setIntersectionN(const unsigned *const *ppSet, const size_t *pN,
+			size_t k, unsigned *pOut);
+size_t setIntersectionN(const unsigned long *const *ppSet, const size_t *pN,
+			size_t k, unsigned long *pOut);
+
+} // namespace phoenix4cpp
+
+#endif /* PHOENIX4CPP_SETOPS_H */
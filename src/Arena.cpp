@@ -0,0 +1,265 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    Arena.cpp - see ../include/Arena.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Chunks are kept on a stack, newest first; allocation only ever
+    happens in the newest one.  When a new chunk is pushed, the position
+    reached in the one below it is saved in that chunk's header, so that
+    popping back to it can carry on from there, and so that the bytes used
+    can be totalled.  A mark is just the current chunk and position, and
+    rewinding pops chunks until the marked one is current again.
+
+    If the system has no huge pages reserved, the first MAP_HUGETLB
+    mapping fails, and that is remembered for the whole process so that
+    every chunk after that doesn't try again.
+ */
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+#ifndef PHOENIX4CPP_SYS_MMAN_H
+#include <sys/mman.h>
+#define PHOENIX4CPP_SYS_MMAN_H
+#endif
+
+#ifndef PHOENIX4CPP_UNISTD_H
+#include <unistd.h>
+#define PHOENIX4CPP_UNISTD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    class ArenaChunk
+    {
+    public:
+	ArenaChunk *pPrevious;
+	size_t bytes;
+	/* how far allocation had got when a newer chunk was pushed */
+	char *pTop;
+    };
+
+    /* allocations start this far into a chunk */
+    static const size_t chunkHeaderBytes = 32;
+
+    static const size_t hugePageBytes = 2 << 20;
+
+    static bool noHugeTlb = false;
+
+    static pthread_once_t threadArenaOnce = PTHREAD_ONCE_INIT;
+    static pthread_key_t threadArenaKey;
+
+    static void deleteThreadArena(void *pArena)
+    {
+	delete (Arena *)pArena;
+    }
+
+    static void createThreadArenaKey()
+    {
+	pthread_key_create(&threadArenaKey, deleteThreadArena);
+    }
+
+    static inline char *chunkStart(ArenaChunk *pChunk)
+    {
+	return ((char *)pChunk) + chunkHeaderBytes;
+    }
+
+    static inline char *chunkEnd(ArenaChunk *pChunk)
+    {
+	return ((char *)pChunk) + pChunk->bytes;
+    }
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline void Arena::unmapChunk(ArenaChunk *pChunk)
+    {
+	bytesMapped -= pChunk->bytes;
+	munmap(pChunk, pChunk->bytes);
+    }
+
+    void Arena::popChunk()
+    {
+	ArenaChunk *const pChunk = pCurrent;
+	pCurrent = pChunk->pPrevious;
+	if (!pSpare && (pChunk->bytes == chunkBytes))
+	    pSpare = pChunk;
+	else
+	    unmapChunk(pChunk);
+
+	if (pCurrent)
+	{
+	    pNext = pCurrent->pTop;
+	    pEnd = chunkEnd(pCurrent);
+	}
+	else
+	{
+	    pNext = NULL;
+	    pEnd = NULL;
+	}
+    }
+
+    ArenaChunk *Arena::mapChunk(size_t bytes)
+    {
+	void *p = MAP_FAILED;
+	if (hugePages)
+	{
+#ifdef MAP_HUGETLB
+	    if (!__atomic_load_n(&noHugeTlb, __ATOMIC_RELAXED))
+	    {
+		p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (p == MAP_FAILED)
+		    __atomic_store_n(&noHugeTlb, true, __ATOMIC_RELAXED);
+	    }
+#endif
+#ifdef MADV_HUGEPAGE
+	    if (p == MAP_FAILED)
+	    {
+		/*
+		  Transparent huge pages need 2MB alignment, so map an extra
+		  2MB and trim off what's outside the aligned range.
+		*/
+		void *pWide = mmap(NULL, bytes + hugePageBytes,
+				   PROT_READ | PROT_WRITE,
+				   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (pWide != MAP_FAILED)
+		{
+		    char *pLow = (char *)pWide;
+		    char *pAligned = (char *)(((size_t)pLow + hugePageBytes - 1) &
+					      ~(hugePageBytes - 1));
+		    if (pAligned != pLow)
+			munmap(pLow, pAligned - pLow);
+		    const size_t tail = hugePageBytes - (pAligned - pLow);
+		    if (tail)
+			munmap(pAligned + bytes, tail);
+		    madvise(pAligned, bytes, MADV_HUGEPAGE);
+		    p = pAligned;
+		}
+	    }
+#endif
+	}
+
+	if (p == MAP_FAILED)
+	{
+	    p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	    if (p == MAP_FAILED)
+		throw std::bad_alloc();
+	}
+
+	bytesMapped += bytes;
+	ArenaChunk *pChunk = (ArenaChunk *)p;
+	pChunk->bytes = bytes;
+	return pChunk;
+    }
+
+    Arena::Arena(size_t cBytes, bool huge):
+	pNext(NULL),
+	pEnd(NULL),
+	pCurrent(NULL),
+	pSpare(NULL),
+	bytesMapped(0),
+	chunkBytes(cBytes),
+	hugePages(huge)
+    {
+	const size_t unit = hugePages ? hugePageBytes :
+	    (size_t)sysconf(_SC_PAGESIZE);
+	if (chunkBytes < unit)
+	    chunkBytes = unit;
+	chunkBytes = (chunkBytes + unit - 1) & ~(unit - 1);
+    }
+
+    Arena::~Arena()
+    {
+	while(pCurrent)
+	    popChunk();
+	if (pSpare)
+	    unmapChunk(pSpare);
+    }
+
+    void *Arena::allocateSlow(size_t size, size_t align)
+    {
+	/* anything too big for a chunk gets one of its own */
+	size_t bytes = chunkBytes;
+	const size_t need = chunkHeaderBytes + align + size;
+	if (need > chunkBytes)
+	{
+	    const size_t unit = hugePages ? hugePageBytes :
+		(size_t)sysconf(_SC_PAGESIZE);
+	    bytes = (need + unit - 1) & ~(unit - 1);
+	}
+
+	ArenaChunk *pChunk;
+	if (pSpare && (bytes == chunkBytes))
+	{
+	    pChunk = pSpare;
+	    pSpare = NULL;
+	}
+	else
+	    pChunk = mapChunk(bytes);
+
+	if (pCurrent)
+	    pCurrent->pTop = pNext;
+	pChunk->pPrevious = pCurrent;
+	pCurrent = pChunk;
+	pNext = chunkStart(pChunk);
+	pEnd = chunkEnd(pChunk);
+
+	char *p = (char *)(((size_t)pNext + align - 1) & ~(align - 1));
+	pNext = p + size;
+	return p;
+    }
+
+    void Arena::reset()
+    {
+	while(pCurrent)
+	    popChunk();
+    }
+
+    size_t Arena::getBytesUsed() const
+    {
+	if (!pCurrent)
+	    return 0;
+
+	size_t used = pNext - chunkStart(pCurrent);
+	for(ArenaChunk *pChunk = pCurrent->pPrevious; pChunk;
+	    pChunk = pChunk->pPrevious)
+	    used += pChunk->pTop - chunkStart(pChunk);
+	return used;
+    }
+
+    Arena *Arena::getThreadArena()
+    {
+	pthread_once(&threadArenaOnce, createThreadArenaKey);
+	Arena *pArena = (Arena *)pthread_getspecific(threadArenaKey);
+	if (!pArena)
+	{
+	    pArena = new Arena(hugePageBytes, true);
+	    pthread_setspecific(threadArenaKey, pArena);
+	}
+	return pArena;
+    }
+
+} // namespace phoenix4cpp
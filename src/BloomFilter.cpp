@@ -0,0 +1,262 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    BloomFilter.cpp - see ../include/BloomFilter.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The filter uses the 64-bit HashValue::get64().  The top 32 bits pick the
+    block, by multiplying and keeping the high half, so the number of blocks
+    need not be a power of two.  The low 32 bits are the start of the probe
+    sequence, and a second multiply provides the (odd) stride; the top 9
+    bits of each element of the sequence give a bit position in the block.
+
+    Each block is handled as eight 64-bit words.  The probes are gathered
+    into a mask, and then the whole mask is or-ed into, or tested against,
+    the block at once.
+ */
+
+#ifndef PHOENIX4CPP_BLOOMFILTER_H
+#include "BloomFilter.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /* a block is one 64 byte cache line */
+    static const size_t blockWords = 8;
+    static const size_t blockBytes = blockWords * sizeof(unsigned long long);
+    static const unsigned maxProbes = 16;
+
+    struct BloomFilterHeader
+    {
+	unsigned magic;
+	unsigned version;
+	unsigned k;
+	unsigned reserved;
+	unsigned long long nBlocks;
+
+	/* pad the header so that the blocks following it are aligned */
+	char pad[blockBytes - 4 * sizeof(unsigned) -
+		 sizeof(unsigned long long)];
+    };
+
+    static const unsigned bloomMagic = 0x50344246;  /* "P4BF" */
+
+    /*
+      Version 1 filters were built from HashValue::get() with a private
+      finalizer, before HashValue had a 64-bit accumulator; those aren't
+      compatible with the current hash.
+     */
+    static const unsigned bloomVersion = 2;
+
+    /*
+      Work out which block a hash value belongs in, and build the mask of
+      the bits it sets in that block.
+     */
+    static inline size_t bloomProbe(
+	unsigned long long h, size_t nBlocks, unsigned k,
+	unsigned long long *pMask)
+    {
+	const size_t block = (size_t)(((h >> 32) * nBlocks) >> 32);
+
+	unsigned x = (unsigned)h;
+	const unsigned stride =
+	    (unsigned)((h * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+
+	for(size_t i = 0; i < blockWords; ++i)
+	    pMask[i] = 0;
+	for(unsigned i = 0; i < k; ++i, x += stride)
+	{
+	    const unsigned bit = x >> 23;
+	    pMask[bit >> 6] |= 1ULL << (bit & 63);
+	}
+
+	return block;
+    }
+
+    BloomFilter::BloomFilter(size_t expectedItems, unsigned bitsPerItem):
+	pBlocks(NULL),
+	nBlocks(0),
+	k(0),
+	owned(true)
+    {
+	if (!expectedItems)
+	    expectedItems = 1;
+	if (!bitsPerItem)
+	    bitsPerItem = 1;
+
+	/* the optimal number of probes is bitsPerItem * ln(2) */
+	k = (bitsPerItem * 693 + 500) / 1000;
+	if (k < 1)
+	    k = 1;
+	if (k > maxProbes)
+	    k = maxProbes;
+
+	nBlocks = (expectedItems * bitsPerItem + blockBytes * 8 - 1) /
+	    (blockBytes * 8);
+
+	void *p;
+	if (posix_memalign(&p, blockBytes, nBlocks * blockBytes))
+	    throw std::bad_alloc();
+	memset(p, 0, nBlocks * blockBytes);
+	pBlocks = (unsigned long long *)p;
+    }
+
+    BloomFilter::BloomFilter():
+	pBlocks(NULL),
+	nBlocks(0),
+	k(0),
+	owned(false)
+    {
+    }
+
+    BloomFilter::~BloomFilter()
+    {
+	release();
+    }
+
+    void BloomFilter::release()
+    {
+	if (owned)
+	    free(pBlocks);
+
+	pBlocks = NULL;
+	nBlocks = 0;
+	k = 0;
+	owned = false;
+    }
+
+    void BloomFilter::addHash(unsigned long long hashValue)
+    {
+	unsigned long long mask[blockWords];
+	unsigned long long *pBlock =
+	    pBlocks + bloomProbe(hashValue, nBlocks, k, mask) * blockWords;
+
+#ifdef __SSE2__
+	for(size_t i = 0; i < blockWords; i += 2)
+	{
+	    __m128i b = _mm_load_si128((const __m128i *)(pBlock + i));
+	    __m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+	    _mm_store_si128((__m128i *)(pBlock + i), _mm_or_si128(b, m));
+	}
+#else
+	for(size_t i = 0; i < blockWords; ++i)
+	    pBlock[i] |= mask[i];
+#endif
+    }
+
+    bool BloomFilter::mayContainHash(unsigned long long hashValue) const
+    {
+	if (!nBlocks)
+	    return false;
+
+	unsigned long long mask[blockWords];
+	const unsigned long long *pBlock =
+	    pBlocks + bloomProbe(hashValue, nBlocks, k, mask) * blockWords;
+
+	/* look for any bit that is in the mask, but not in the block */
+#ifdef __SSE2__
+	__m128i missing = _mm_setzero_si128();
+	for(size_t i = 0; i < blockWords; i += 2)
+	{
+	    __m128i b = _mm_loadu_si128((const __m128i *)(pBlock + i));
+	    __m128i m = _mm_loadu_si128((const __m128i *)(mask + i));
+	    missing = _mm_or_si128(missing, _mm_andnot_si128(b, m));
+	}
+	return _mm_movemask_epi8(
+	    _mm_cmpeq_epi8(missing, _mm_setzero_si128())) == 0xffff;
+#else
+	unsigned long long missing = 0;
+	for(size_t i = 0; i < blockWords; ++i)
+	    missing |= mask[i] & ~pBlock[i];
+	return !missing;
+#endif
+    }
+
+    void BloomFilter::add(const Hashable *pKey)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	addHash(hashValue.get64());
+    }
+
+    bool BloomFilter::mayContain(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return mayContainHash(hashValue.get64());
+    }
+
+    size_t BloomFilter::getSerializedSize() const
+    {
+	return sizeof(BloomFilterHeader) + nBlocks * blockBytes;
+    }
+
+    void BloomFilter::serialize(void *pBuffer) const
+    {
+	BloomFilterHeader *pHeader = (BloomFilterHeader *)pBuffer;
+	memset(pHeader, 0, sizeof(BloomFilterHeader));
+	pHeader->magic = bloomMagic;
+	pHeader->version = bloomVersion;
+	pHeader->k = k;
+	pHeader->nBlocks = nBlocks;
+
+	memcpy(pHeader + 1, pBlocks, nBlocks * blockBytes);
+    }
+
+    bool BloomFilter::attach(const void *pBuffer, size_t length)
+    {
+	release();
+
+	if (length < sizeof(BloomFilterHeader))
+	    return false;
+
+	const BloomFilterHeader *pHeader = (const BloomFilterHeader *)pBuffer;
+	if ((pHeader->magic != bloomMagic) ||
+	    (pHeader->version != bloomVersion) ||
+	    !pHeader->k || (pHeader->k > maxProbes) ||
+	    (pHeader->nBlocks >
+	     (length - sizeof(BloomFilterHeader)) / blockBytes))
+	    return false;
+
+	pBlocks = (unsigned long long *)(pHeader + 1);
+	nBlocks = (size_t)pHeader->nBlocks;
+	k = pHeader->k;
+	return true;
+    }
+
+} // namespace phoenix4cpp
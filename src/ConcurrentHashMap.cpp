@@ -0,0 +1,363 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ConcurrentHashMap.cpp - see ../include/ConcurrentHashMap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Hash values are scrambled by Fibonacci hashing (see IntrusiveHash.cpp),
+    and the top bits of the result select both the stripe and the bucket.
+    There are never fewer buckets than stripes, so a bucket's index always
+    begins with its stripe's index, and the bucket-to-stripe mapping stays
+    valid as the table grows.
+
+    Chains are singly linked.  A node's fields are never changed once it
+    has been published, so a reader holding a node that has just been
+    unlinked can still follow it to the rest of the chain; replacing an
+    element publishes a new node in place of the old one.
+
+    When the table grows, its nodes are copied into the new table, because
+    readers may still be walking the old chains.  The old table, with all of
+    its nodes, is then retired as a single object.
+ */
+
+#ifndef PHOENIX4CPP_CONCURRENTHASHMAP_H
+#include "ConcurrentHashMap.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARATOR_H
+#include "Comparator.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    struct ConcurrentHashNode
+    {
+	ConcurrentHashNode *pNext;
+	unsigned long hashValue;
+	void *pElement;
+    };
+
+    struct ConcurrentHashTable
+    {
+	size_t nBuckets;
+	unsigned shift;
+	ConcurrentHashNode *apBucket[1];  /* actually nBuckets long */
+    };
+
+    struct ConcurrentHashStripe
+    {
+	pthread_mutex_t mutex;
+	size_t count;
+
+	/* keep stripes on separate cache lines */
+	char pad[64];
+    };
+
+    static const unsigned long fibonacciMultiplier =
+	(sizeof(unsigned long) > 4 ?
+	 (unsigned long)0x9e3779b97f4a7c15ULL : 0x9e3779b9UL);
+
+    static const unsigned bitsPerLong = sizeof(unsigned long) * 8;
+
+    /* average chain length at which the table is grown */
+    static const size_t maxLoad = 2;
+
+    /* the smallest table we'll use, so that the shift is always in range */
+    static const unsigned minBucketBits = 3;
+
+    static inline unsigned long scramble(unsigned long hashValue)
+    {
+	return hashValue * fibonacciMultiplier;
+    }
+
+    static inline unsigned log2Ceiling(size_t n)
+    {
+	unsigned bits = 0;
+	while((((size_t)1) << bits) < n)
+	    ++bits;
+	return bits;
+    }
+
+    static ConcurrentHashTable *newTable(unsigned bits)
+    {
+	const size_t nBuckets = ((size_t)1) << bits;
+	ConcurrentHashTable *pTable = (ConcurrentHashTable *)malloc(
+	    sizeof(ConcurrentHashTable) +
+	    (nBuckets - 1) * sizeof(ConcurrentHashNode *));
+	pTable->nBuckets = nBuckets;
+	pTable->shift = bitsPerLong - bits;
+	for(size_t i = 0; i < nBuckets; ++i)
+	    pTable->apBucket[i] = NULL;
+
+	return pTable;
+    }
+
+    static void freeNode(void *pNode)
+    {
+	delete (ConcurrentHashNode *)pNode;
+    }
+
+    static void freeTable(void *p)
+    {
+	ConcurrentHashTable *pTable = (ConcurrentHashTable *)p;
+	for(size_t i = 0; i < pTable->nBuckets; ++i)
+	{
+	    ConcurrentHashNode *pNext;
+	    for(ConcurrentHashNode *pNode = pTable->apBucket[i]; pNode;
+		pNode = pNext)
+	    {
+		pNext = pNode->pNext;
+		delete pNode;
+	    }
+	}
+
+	free(pTable);
+    }
+
+    ConcurrentHashBase::ConcurrentHashBase(
+	size_t kOffset, const Comparator *pC, size_t nBuckets,
+	unsigned n):
+	keyOffset(kOffset),
+	pComparator(pC)
+    {
+	unsigned stripeBits = log2Ceiling(n ? n : 1);
+	nStripes = 1U << stripeBits;
+	stripeShift = bitsPerLong - stripeBits;
+
+	pStripe = new ConcurrentHashStripe[nStripes];
+	for(unsigned i = 0; i < nStripes; ++i)
+	{
+	    pthread_mutex_init(&pStripe[i].mutex, NULL);
+	    pStripe[i].count = 0;
+	}
+
+	unsigned bucketBits = log2Ceiling(nBuckets);
+	if (bucketBits < stripeBits)
+	    bucketBits = stripeBits;
+	if (bucketBits < minBucketBits)
+	    bucketBits = minBucketBits;
+	pTable = newTable(bucketBits);
+    }
+
+    ConcurrentHashBase::~ConcurrentHashBase()
+    {
+	/* anything retired is reclaimed when the epochManager goes */
+	freeTable(pTable);
+
+	for(unsigned i = 0; i < nStripes; ++i)
+	    pthread_mutex_destroy(&pStripe[i].mutex);
+	delete[] pStripe;
+    }
+
+    size_t ConcurrentHashBase::getCount() const
+    {
+	size_t count = 0;
+	for(unsigned i = 0; i < nStripes; ++i)
+	    count += __atomic_load_n(&pStripe[i].count, __ATOMIC_RELAXED);
+
+	return count;
+    }
+
+    inline void *ConcurrentHashBase::findNode(
+	const ConcurrentHashTable *pT, unsigned long hashValue,
+	const void *pKey) const
+    {
+	const size_t bucket = scramble(hashValue) >> pT->shift;
+	for(const ConcurrentHashNode *pNode =
+		__atomic_load_n(&pT->apBucket[bucket], __ATOMIC_ACQUIRE);
+	    pNode; pNode = __atomic_load_n(&pNode->pNext, __ATOMIC_ACQUIRE))
+	{
+	    if ((pNode->hashValue == hashValue) &&
+		!pComparator->compare(
+		    pKey, ((const char *)pNode->pElement) + keyOffset))
+		return pNode->pElement;
+	}
+
+	return NULL;
+    }
+
+    void *ConcurrentHashBase::find(const Hashable *pKey)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+
+	EpochGuard epochGuard(&epochManager);
+	return findNode(__atomic_load_n(&pTable, __ATOMIC_ACQUIRE),
+			hashValue.get(), pKey->getRawPointer());
+    }
+
+    inline ConcurrentHashStripe *ConcurrentHashBase::lockStripe(
+	unsigned long hashValue)
+    {
+	ConcurrentHashStripe *pS =
+	    &pStripe[stripeShift < bitsPerLong ?
+		     scramble(hashValue) >> stripeShift : 0];
+	pthread_mutex_lock(&pS->mutex);
+	return pS;
+    }
+
+    void *ConcurrentHashBase::update(
+	const Hashable *pKey, void *pElement, bool overwrite)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	const unsigned long h = hashValue.get();
+	const void *const pRawKey = pKey->getRawPointer();
+
+	/*
+	  The table can't be changed while we hold any stripe lock, so we
+	  don't need to protect ourselves from growth.
+	 */
+	ConcurrentHashStripe *pS = lockStripe(h);
+	ConcurrentHashTable *pT = pTable;
+	ConcurrentHashNode **ppHead = &pT->apBucket[scramble(h) >> pT->shift];
+
+	for(ConcurrentHashNode **ppLink = ppHead, *pNode = *ppLink; pNode;
+	    ppLink = &pNode->pNext, pNode = pNode->pNext)
+	{
+	    if ((pNode->hashValue != h) ||
+		pComparator->compare(
+		    pRawKey, ((const char *)pNode->pElement) + keyOffset))
+		continue;
+
+	    void *pOld = pNode->pElement;
+	    if (overwrite)
+	    {
+		ConcurrentHashNode *pNew = new ConcurrentHashNode;
+		pNew->pNext = pNode->pNext;
+		pNew->hashValue = h;
+		pNew->pElement = pElement;
+		__atomic_store_n(ppLink, pNew, __ATOMIC_RELEASE);
+	    }
+
+	    pthread_mutex_unlock(&pS->mutex);
+	    if (overwrite)
+		epochManager.retire(pNode, freeNode);
+	    return pOld;
+	}
+
+	/* there's no such key yet, so add it at the head of the chain */
+	ConcurrentHashNode *pNew = new ConcurrentHashNode;
+	pNew->pNext = *ppHead;
+	pNew->hashValue = h;
+	pNew->pElement = pElement;
+	__atomic_store_n(ppHead, pNew, __ATOMIC_RELEASE);
+
+	/*
+	  Once we let go of the lock, the table could be grown and retired out
+	  from under us, so decide whether it needs to grow first.  grow()
+	  only uses the pointer to see if the table is still current.
+	 */
+	const bool full = __atomic_add_fetch(&pS->count, 1, __ATOMIC_RELAXED) >
+	    maxLoad * (pT->nBuckets / nStripes);
+	pthread_mutex_unlock(&pS->mutex);
+
+	if (full)
+	    grow(pT);
+	return NULL;
+    }
+
+    void *ConcurrentHashBase::insert(const Hashable *pKey, void *pElement)
+    {
+	return update(pKey, pElement, false);
+    }
+
+    void *ConcurrentHashBase::replace(const Hashable *pKey, void *pElement)
+    {
+	return update(pKey, pElement, true);
+    }
+
+    void *ConcurrentHashBase::remove(const Hashable *pKey)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	const unsigned long h = hashValue.get();
+	const void *const pRawKey = pKey->getRawPointer();
+
+	ConcurrentHashStripe *pS = lockStripe(h);
+	ConcurrentHashTable *pT = pTable;
+	ConcurrentHashNode **ppLink = &pT->apBucket[scramble(h) >> pT->shift];
+
+	for(ConcurrentHashNode *pNode = *ppLink; pNode;
+	    ppLink = &pNode->pNext, pNode = pNode->pNext)
+	{
+	    if ((pNode->hashValue != h) ||
+		pComparator->compare(
+		    pRawKey, ((const char *)pNode->pElement) + keyOffset))
+		continue;
+
+	    /* readers that already have the node can still follow it */
+	    __atomic_store_n(ppLink, pNode->pNext, __ATOMIC_RELEASE);
+	    __atomic_sub_fetch(&pS->count, 1, __ATOMIC_RELAXED);
+	    pthread_mutex_unlock(&pS->mutex);
+
+	    void *pOld = pNode->pElement;
+	    epochManager.retire(pNode, freeNode);
+	    return pOld;
+	}
+
+	pthread_mutex_unlock(&pS->mutex);
+	return NULL;
+    }
+
+    void ConcurrentHashBase::grow(const ConcurrentHashTable *pOld)
+    {
+	/* always lock the stripes in the same order */
+	for(unsigned i = 0; i < nStripes; ++i)
+	    pthread_mutex_lock(&pStripe[i].mutex);
+
+	/* someone else may have beaten us to it */
+	if (pTable != pOld)
+	{
+	    for(unsigned i = 0; i < nStripes; ++i)
+		pthread_mutex_unlock(&pStripe[i].mutex);
+	    return;
+	}
+
+	ConcurrentHashTable *pNewTable =
+	    newTable(bitsPerLong - pOld->shift + 1);
+	for(size_t i = 0; i < pOld->nBuckets; ++i)
+	{
+	    for(const ConcurrentHashNode *pNode = pOld->apBucket[i]; pNode;
+		pNode = pNode->pNext)
+	    {
+		ConcurrentHashNode **ppHead = &pNewTable->apBucket[
+		    scramble(pNode->hashValue) >> pNewTable->shift];
+		ConcurrentHashNode *pNew = new ConcurrentHashNode;
+		pNew->pNext = *ppHead;
+		pNew->hashValue = pNode->hashValue;
+		pNew->pElement = pNode->pElement;
+		*ppHead = pNew;
+	    }
+	}
+
+	__atomic_store_n(&pTable, pNewTable, __ATOMIC_RELEASE);
+
+	for(unsigned i = 0; i < nStripes; ++i)
+	    pthread_mutex_unlock(&pStripe[i].mutex);
+
+	epochManager.retire((void *)pOld, freeTable);
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,241 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ConsistentHash.cpp - see ../include/ConsistentHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    jumpHash() follows the reference code from the paper:  a linear
+    congruential generator seeded with the key decides where the key jumps
+    to next, and the last jump that lands below nShards is the answer.
+
+    A ring point's hash is a HashValue of the node number and the point's
+    replica number.  The points are kept in an array sorted by hash; adding
+    a node sorts its points, and merges them in, and removing one compacts
+    the array.  These are rare compared to routing.
+
+    The batch routines hash the keys in chunks into a local array before
+    doing any lookups.
+ */
+
+#ifndef PHOENIX4CPP_CONSISTENTHASH_H
+#include "ConsistentHash.h"
+#endif
+
+#ifndef PHOENIX4CPP_BSEARCH_H
+#include "bsearch.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARE_H
+#include "compare.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_QSORT_H
+#include "qsort.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const size_t batchChunk = 256;
+
+    unsigned jumpHash(unsigned long long key, unsigned nShards)
+    {
+	long long b = -1;
+	long long j = 0;
+	while(j < nShards)
+	{
+	    b = j;
+	    key = key * 2862933555777941757ULL + 1;
+	    j = (long long)((b + 1) *
+			    ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+	}
+
+	return (unsigned)b;
+    }
+
+    unsigned jumpHash(const Hashable *pKey, unsigned nShards)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return jumpHash(hashValue.get64(), nShards);
+    }
+
+    void jumpHashBatch(const Hashable *const *ppKeys, size_t n,
+		       unsigned nShards, unsigned *pShards)
+    {
+	unsigned long long hashValue[batchChunk];
+	while(n)
+	{
+	    const size_t chunk = n < batchChunk ? n : batchChunk;
+	    for(size_t i = 0; i < chunk; ++i)
+	    {
+		HashValue h;
+		ppKeys[i]->hash(&h);
+		hashValue[i] = h.get64();
+	    }
+	    for(size_t i = 0; i < chunk; ++i)
+		pShards[i] = jumpHash(hashValue[i], nShards);
+
+	    ppKeys += chunk;
+	    pShards += chunk;
+	    n -= chunk;
+	}
+    }
+
+
+    struct HashRingPoint
+    {
+	unsigned long hashValue;
+	unsigned long node;
+    };
+
+    HashRing::HashRing(unsigned p):
+	pointsPerNode(p ? p : 1),
+	nNodes(0),
+	pPoint(NULL),
+	nPoints(0),
+	capacity(0)
+    {
+    }
+
+    HashRing::~HashRing()
+    {
+	delete[] pPoint;
+    }
+
+    bool HashRing::hasNode(unsigned long node) const
+    {
+	for(size_t i = 0; i < nPoints; ++i)
+	{
+	    if (pPoint[i].node == node)
+		return true;
+	}
+
+	return false;
+    }
+
+    bool HashRing::addNode(unsigned long node, unsigned n)
+    {
+	if (hasNode(node))
+	    return false;
+
+	if (!n)
+	    n = pointsPerNode;
+
+	if (nPoints + n > capacity)
+	{
+	    capacity = (nPoints + n) * 2;
+	    HashRingPoint *pNew = new HashRingPoint[capacity];
+	    for(size_t i = 0; i < nPoints; ++i)
+		pNew[i] = pPoint[i];
+	    delete[] pPoint;
+	    pPoint = pNew;
+	}
+
+	/* sort the new points by themselves, and merge them in from the end */
+	HashRingPoint *pNew = new HashRingPoint[n];
+	for(unsigned long replica = 0; replica < n; ++replica)
+	{
+	    HashValue hashValue;
+	    hashValue.blend(node);
+	    hashValue.blend(replica);
+	    pNew[replica].hashValue = hashValue.get();
+	    pNew[replica].node = node;
+	}
+	qsort<HashRingPoint, unsigned long, offsetof(HashRingPoint, hashValue)>(
+	    pNew, n, compareUnsignedLong);
+
+	size_t i = nPoints;
+	size_t j = n;
+	nPoints += n;
+	for(size_t k = nPoints; j; --k)
+	{
+	    if (i && (pPoint[i - 1].hashValue > pNew[j - 1].hashValue))
+		pPoint[k - 1] = pPoint[--i];
+	    else
+		pPoint[k - 1] = pNew[--j];
+	}
+	delete[] pNew;
+
+	++nNodes;
+	return true;
+    }
+
+    bool HashRing::removeNode(unsigned long node)
+    {
+	size_t nKept = 0;
+	for(size_t i = 0; i < nPoints; ++i)
+	{
+	    if (pPoint[i].node != node)
+		pPoint[nKept++] = pPoint[i];
+	}
+
+	if (nKept == nPoints)
+	    return false;
+
+	nPoints = nKept;
+	--nNodes;
+	return true;
+    }
+
+    unsigned long HashRing::routeHash(unsigned long hashValue) const
+    {
+	if (!nPoints)
+	    return noNode;
+
+	const HashRingPoint *pFound =
+	    lowerBound<HashRingPoint, unsigned long,
+		offsetof(HashRingPoint, hashValue)>(
+		    &hashValue, pPoint, nPoints, compareUnsignedLong);
+
+	/* past the last point, the ring wraps around to the first */
+	if (pFound == pPoint + nPoints)
+	    pFound = pPoint;
+	return pFound->node;
+    }
+
+    unsigned long HashRing::route(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return routeHash(hashValue.get());
+    }
+
+    void HashRing::routeBatch(const Hashable *const *ppKeys, size_t n,
+			      unsigned long *pNodes) const
+    {
+	unsigned long hashValue[batchChunk];
+	while(n)
+	{
+	    const size_t chunk = n < batchChunk ? n : batchChunk;
+	    for(size_t i = 0; i < chunk; ++i)
+	    {
+		HashValue h;
+		ppKeys[i]->hash(&h);
+		hashValue[i] = h.get();
+	    }
+	    for(size_t i = 0; i < chunk; ++i)
+		pNodes[i] = routeHash(hashValue[i]);
+
+	    ppKeys += chunk;
+	    pNodes += chunk;
+	    n -= chunk;
+	}
+    }
+
+} // namespace phoenix4cpp
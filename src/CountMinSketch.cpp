@@ -0,0 +1,285 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    CountMinSketch.cpp - see ../include/CountMinSketch.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The counters for all rows are in one array, row by row.  The column in
+    each row comes from the 64-bit HashValue::get64() by double hashing:
+    row i uses the top bits of h + i * g, where g is h with its halves
+    swapped (and made odd).  Keys that collide in one row because their top
+    bits are equal differ in g, and so go their separate ways in the other
+    rows.
+
+    A sketch's counters only ever go up while it is attached to a
+    CountMinSketchFolder, so the folder keeps a copy of each one's
+    counters as of the last fold, and adds the differences.  The combined
+    sketch is then the sum of the attached ones, as merge() would make
+    it.  The owning thread updates its counters with relaxed atomic
+    stores, and the folder reads them with relaxed atomic loads, so
+    neither waits for the other; a fold may see some of an add() and not
+    the rest, and the remainder is picked up by the next one.  The mutex
+    only protects the folder's own state.
+ */
+
+#ifndef PHOENIX4CPP_COUNTMINSKETCH_H
+#include "CountMinSketch.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const size_t minWidth = 16;
+    static const unsigned maxDepth = 16;
+
+    static inline unsigned long long rowStride(unsigned long long h)
+    {
+	return ((h >> 32) | (h << 32)) | 1;
+    }
+
+    CountMinSketch::CountMinSketch(size_t w, unsigned d):
+	pCounters(NULL),
+	width(minWidth),
+	widthBits(4),
+	depth(d),
+	total(0)
+    {
+	while(width < w)
+	{
+	    width <<= 1;
+	    ++widthBits;
+	}
+
+	if (depth < 1)
+	    depth = 1;
+	if (depth > maxDepth)
+	    depth = maxDepth;
+
+	pCounters = new unsigned long[width * depth];
+	clear();
+    }
+
+    CountMinSketch::~CountMinSketch()
+    {
+	delete[] pCounters;
+    }
+
+    void CountMinSketch::clear()
+    {
+	memset(pCounters, 0, width * depth * sizeof(unsigned long));
+	total = 0;
+    }
+
+    unsigned long CountMinSketch::addHash(
+	unsigned long long h, unsigned long count)
+    {
+	unsigned long *pCounter[maxDepth];
+	const unsigned long long stride = rowStride(h);
+	unsigned long minimum = ~0UL;
+
+	unsigned long long x = h;
+	for(unsigned i = 0; i < depth; ++i, x += stride)
+	{
+	    pCounter[i] = pCounters + i * width + (size_t)(x >> (64 - widthBits));
+	    if (*pCounter[i] < minimum)
+		minimum = *pCounter[i];
+	}
+
+	/*
+	  Conservative update:  only raise the counters that are too small.
+	  The stores are atomic in case a CountMinSketchFolder is reading.
+	*/
+	const unsigned long updated = minimum + count;
+	for(unsigned i = 0; i < depth; ++i)
+	{
+	    if (*pCounter[i] < updated)
+		__atomic_store_n(pCounter[i], updated, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&total, total + count, __ATOMIC_RELAXED);
+	return updated;
+    }
+
+    unsigned long CountMinSketch::estimateHash(unsigned long long h) const
+    {
+	const unsigned long long stride = rowStride(h);
+	unsigned long minimum = ~0UL;
+
+	unsigned long long x = h;
+	for(unsigned i = 0; i < depth; ++i, x += stride)
+	{
+	    const unsigned long c =
+		pCounters[i * width + (size_t)(x >> (64 - widthBits))];
+	    if (c < minimum)
+		minimum = c;
+	}
+
+	return minimum;
+    }
+
+    unsigned long CountMinSketch::add(const Hashable *pKey, unsigned long count)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return addHash(hashValue.get64(), count);
+    }
+
+    unsigned long CountMinSketch::estimate(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return estimateHash(hashValue.get64());
+    }
+
+    bool CountMinSketch::merge(const CountMinSketch *pOther)
+    {
+	if ((pOther->width != width) || (pOther->depth != depth))
+	    return false;
+
+	const size_t n = width * depth;
+	for(size_t i = 0; i < n; ++i)
+	    pCounters[i] += pOther->pCounters[i];
+	total += pOther->total;
+
+	return true;
+    }
+
+
+    struct CountMinSketchAttached
+    {
+	CountMinSketchAttached *pNext;
+	const CountMinSketch *pSketch;
+
+	/* the sketch's counters and total as of the last fold */
+	unsigned long *pFolded;
+	unsigned long foldedTotal;
+    };
+
+    CountMinSketchFolder::CountMinSketchFolder(size_t width, unsigned depth):
+	combined(width, depth),
+	pAttached(NULL)
+    {
+	pthread_mutex_init(&mutex, NULL);
+    }
+
+    CountMinSketchFolder::~CountMinSketchFolder()
+    {
+	CountMinSketchAttached *pNext;
+	for(CountMinSketchAttached *pA = pAttached; pA; pA = pNext)
+	{
+	    pNext = pA->pNext;
+	    delete[] pA->pFolded;
+	    delete pA;
+	}
+
+	pthread_mutex_destroy(&mutex);
+    }
+
+    bool CountMinSketchFolder::attach(CountMinSketch *pSketch)
+    {
+	if ((pSketch->width != combined.width) ||
+	    (pSketch->depth != combined.depth))
+	    return false;
+
+	const size_t n = combined.width * combined.depth;
+	CountMinSketchAttached *pA = new CountMinSketchAttached;
+	pA->pSketch = pSketch;
+	pA->pFolded = new unsigned long[n];
+	memset(pA->pFolded, 0, n * sizeof(unsigned long));
+	pA->foldedTotal = 0;
+
+	pthread_mutex_lock(&mutex);
+	pA->pNext = pAttached;
+	pAttached = pA;
+	pthread_mutex_unlock(&mutex);
+
+	return true;
+    }
+
+    void CountMinSketchFolder::foldOne(CountMinSketchAttached *pA)
+    {
+	const size_t n = combined.width * combined.depth;
+	const unsigned long *const pCounters = pA->pSketch->pCounters;
+	for(size_t i = 0; i < n; ++i)
+	{
+	    const unsigned long c =
+		__atomic_load_n(&pCounters[i], __ATOMIC_RELAXED);
+	    combined.pCounters[i] += c - pA->pFolded[i];
+	    pA->pFolded[i] = c;
+	}
+
+	const unsigned long total =
+	    __atomic_load_n(&pA->pSketch->total, __ATOMIC_RELAXED);
+	combined.total += total - pA->foldedTotal;
+	pA->foldedTotal = total;
+    }
+
+    void CountMinSketchFolder::detach(CountMinSketch *pSketch)
+    {
+	pthread_mutex_lock(&mutex);
+	CountMinSketchAttached **ppLink = &pAttached;
+	while((*ppLink)->pSketch != pSketch)
+	    ppLink = &(*ppLink)->pNext;
+
+	CountMinSketchAttached *const pA = *ppLink;
+	foldOne(pA);
+	*ppLink = pA->pNext;
+	pthread_mutex_unlock(&mutex);
+
+	delete[] pA->pFolded;
+	delete pA;
+    }
+
+    void CountMinSketchFolder::fold()
+    {
+	pthread_mutex_lock(&mutex);
+	for(CountMinSketchAttached *pA = pAttached; pA; pA = pA->pNext)
+	    foldOne(pA);
+	pthread_mutex_unlock(&mutex);
+    }
+
+    unsigned long CountMinSketchFolder::estimate(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return estimateHash(hashValue.get64());
+    }
+
+    unsigned long CountMinSketchFolder::estimateHash(
+	unsigned long long hashValue) const
+    {
+	pthread_mutex_lock(&mutex);
+	const unsigned long estimate = combined.estimateHash(hashValue);
+	pthread_mutex_unlock(&mutex);
+	return estimate;
+    }
+
+    unsigned long CountMinSketchFolder::getTotal() const
+    {
+	pthread_mutex_lock(&mutex);
+	const unsigned long total = combined.total;
+	pthread_mutex_unlock(&mutex);
+	return total;
+    }
+
+} // namespace phoenix4cpp
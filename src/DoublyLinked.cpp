@@ -33,4 +33,94 @@ namespace phoenix4cpp
 	return true;
     }
 
+    /*
+      Merge two null-terminated runs, linked through pNext only.  Ties go
+      to the left run, which holds the earlier elements, so the merge is
+      stable.
+    */
+    DoublyLinkedBase *DoublyLinkedBase::merge(
+	DoublyLinkedBase *pLeft, DoublyLinkedBase *pRight,
+	ptrdiff_t keyDisplacement, int (*cmp)(const void *pl, const void *pr))
+    {
+	DoublyLinkedBase *pHead;
+	DoublyLinkedBase **ppTail = &pHead;
+
+	while(pLeft && pRight)
+	{
+	    if ((*cmp)(((const char *)pLeft) + keyDisplacement,
+		       ((const char *)pRight) + keyDisplacement) <= 0)
+	    {
+		*ppTail = pLeft;
+		pLeft = pLeft->pNext;
+	    }
+	    else
+	    {
+		*ppTail = pRight;
+		pRight = pRight->pNext;
+	    }
+	    ppTail = &(*ppTail)->pNext;
+	}
+	*ppTail = (pLeft ? pLeft : pRight);
+
+	return pHead;
+    }
+
+    void DoublyLinkedBase::sortList(
+	ptrdiff_t keyDisplacement, int (*cmp)(const void *pl, const void *pr))
+    {
+	if ((pNext == this) || (pNext == pPrevious))
+	    return;
+
+	/*
+	  Bottom-up merge sort.  pending[i] is either empty or a sorted run of
+	  2^i elements; each element is merged in like a carry propagating
+	  through a binary counter.  A list can't have more elements than
+	  there are addresses, so there can't be more runs than address bits.
+	  Higher runs hold earlier elements, so they go on the left.
+	*/
+	DoublyLinkedBase *apPending[sizeof(void *) * 8];
+	unsigned nPending = 0;
+
+	pPrevious->pNext = NULL;
+	DoublyLinkedBase *pNextLink;
+	for(DoublyLinkedBase *pLink = pNext; pLink; pLink = pNextLink)
+	{
+	    pNextLink = pLink->pNext;
+	    pLink->pNext = NULL;
+
+	    DoublyLinkedBase *pCarry = pLink;
+	    unsigned i;
+	    for(i = 0; (i < nPending) && apPending[i]; ++i)
+	    {
+		pCarry = merge(apPending[i], pCarry, keyDisplacement, cmp);
+		apPending[i] = NULL;
+	    }
+	    if (i == nPending)
+		++nPending;
+	    apPending[i] = pCarry;
+	}
+
+	DoublyLinkedBase *pSorted = NULL;
+	for(unsigned i = 0; i < nPending; ++i)
+	{
+	    if (apPending[i])
+	    {
+		pSorted = (pSorted ?
+			   merge(apPending[i], pSorted, keyDisplacement, cmp) :
+			   apPending[i]);
+	    }
+	}
+
+	/* restore the previous links, and close the ring through the head */
+	DoublyLinkedBase *pPrev = this;
+	for(DoublyLinkedBase *pLink = pSorted; pLink; pLink = pLink->pNext)
+	{
+	    pPrev->pNext = pLink;
+	    pLink->pPrevious = pPrev;
+	    pPrev = pLink;
+	}
+	pPrev->pNext = this;
+	pPrevious = pPrev;
+    }
+
 } // namespace phoenix4cpp
@@ -0,0 +1,416 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    Epoch.cpp - see ../include/Epoch.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A record's state word holds the epoch it entered shifted left one bit,
+    with the low bit set while the thread is inside a critical section.  The
+    records are kept on a list that only ever grows (by a lock-free push);
+    when a thread exits, its record is marked unowned so that a later thread
+    can claim it, and anything it had retired is moved to the orphan list.
+
+    Each record keeps its own list of retired objects, in retirement order,
+    so only the owning thread touches it.  Every so many retirements, the
+    owner tries to advance the global epoch and reclaims whatever has become
+    safe.
+
+    All managers share one pthread key, whose value is a list of the
+    records the thread owns, one per manager, most recently used first.
+    Records are matched by the manager's id rather than its address, since
+    a new manager may be created where an old one was.  A manager that is
+    destroyed while threads still own its records can't reach into those
+    threads, so it leaves the records to them, marked with a NULL manager;
+    a thread frees such records when it exits, or the next time it looks
+    for a record it doesn't have.  epochMutex keeps the two apart.
+ */
+
+#ifndef PHOENIX4CPP_EPOCH_H
+#include "Epoch.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDDEF_H
+#include <cstddef>
+#define PHOENIX4CPP_CSTDDEF_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    struct EpochRetired
+    {
+	EpochRetired *pNext;
+	void *p;
+	void (*reclaim)(void *p);
+	unsigned long epoch;
+    };
+
+    struct EpochRecord
+    {
+	unsigned long state;  /* (epoch << 1) | active */
+	unsigned nesting;
+	int owned;
+	EpochRecord *pNext;
+	/* NULL once the manager has been destroyed; see epochMutex */
+	EpochManager *pManager;
+	unsigned long managerId;
+
+	/* the next record owned by the same thread */
+	EpochRecord *pThreadNext;
+
+	/* retired objects, oldest first */
+	EpochRetired *pRetiredHead;
+	EpochRetired *pRetiredTail;
+	unsigned nRetired;
+
+	/* keep records on separate cache lines */
+	char pad[64];
+    };
+
+    /* how many retirements between attempts to reclaim */
+    static const unsigned collectInterval = 64;
+
+    static pthread_once_t epochOnce = PTHREAD_ONCE_INIT;
+    static pthread_key_t epochKey;
+    static int epochKeyError;
+
+    /* protects the manager of records that are owned by threads */
+    static pthread_mutex_t epochMutex = PTHREAD_MUTEX_INITIALIZER;
+
+    static unsigned long nextManagerId;
+
+    void EpochManager::createKey()
+    {
+	epochKeyError = pthread_key_create(&epochKey, threadExit);
+    }
+
+    EpochManager::EpochManager():
+	id(__atomic_add_fetch(&nextManagerId, 1, __ATOMIC_RELAXED)),
+	globalEpoch(0),
+	pRecords(NULL),
+	pOrphans(NULL)
+    {
+	pthread_once(&epochOnce, createKey);
+	if (epochKeyError)
+	    throw std::bad_alloc();
+	pthread_mutex_init(&orphanMutex, NULL);
+    }
+
+    static void reclaimList(EpochRetired *pRetired)
+    {
+	EpochRetired *pNext;
+	for(; pRetired; pRetired = pNext)
+	{
+	    pNext = pRetired->pNext;
+	    (*pRetired->reclaim)(pRetired->p);
+	    delete pRetired;
+	}
+    }
+
+    EpochManager::~EpochManager()
+    {
+	/*
+	  Records still owned by threads are left for them to free; the
+	  rest are collected on a list of our own, through pThreadNext,
+	  which unowned records don't use.
+	*/
+	EpochRecord *pUnowned = NULL;
+	pthread_mutex_lock(&epochMutex);
+	for(EpochRecord *pRecord = pRecords; pRecord; pRecord = pRecord->pNext)
+	{
+	    if (pRecord->pRetiredHead)
+	    {
+		pRecord->pRetiredTail->pNext = pOrphans;
+		pOrphans = pRecord->pRetiredHead;
+		pRecord->pRetiredHead = NULL;
+		pRecord->pRetiredTail = NULL;
+	    }
+
+	    if (pRecord->owned)
+		pRecord->pManager = NULL;
+	    else
+	    {
+		pRecord->pThreadNext = pUnowned;
+		pUnowned = pRecord;
+	    }
+	}
+	pthread_mutex_unlock(&epochMutex);
+
+	EpochRecord *pNext;
+	for(EpochRecord *pRecord = pUnowned; pRecord; pRecord = pNext)
+	{
+	    pNext = pRecord->pThreadNext;
+	    delete pRecord;
+	}
+
+	reclaimList(pOrphans);
+	pthread_mutex_destroy(&orphanMutex);
+    }
+
+    /*
+      These functions are private; we declare them first so that they can
+      be inlined in this file.
+     */
+    static inline EpochRecord *findRecord(unsigned long id)
+    {
+	EpochRecord *const pFirst =
+	    (EpochRecord *)pthread_getspecific(epochKey);
+	if (!pFirst || (pFirst->managerId == id))
+	    return pFirst;
+
+	/* move the record to the front, so it is found first next time */
+	for(EpochRecord *pPrevious = pFirst; pPrevious->pThreadNext;
+	    pPrevious = pPrevious->pThreadNext)
+	{
+	    EpochRecord *const pRecord = pPrevious->pThreadNext;
+	    if (pRecord->managerId == id)
+	    {
+		pPrevious->pThreadNext = pRecord->pThreadNext;
+		pRecord->pThreadNext = pFirst;
+		pthread_setspecific(epochKey, pRecord);
+		return pRecord;
+	    }
+	}
+
+	return NULL;
+    }
+
+    EpochRecord *EpochManager::getRecord()
+    {
+	EpochRecord *pRecord = findRecord(id);
+	if (pRecord)
+	    return pRecord;
+
+	/* free any records left to us by managers that have been destroyed */
+	EpochRecord *pFirst = (EpochRecord *)pthread_getspecific(epochKey);
+	pthread_mutex_lock(&epochMutex);
+	for(EpochRecord **ppLink = &pFirst; *ppLink;)
+	{
+	    EpochRecord *const pOld = *ppLink;
+	    if (pOld->pManager)
+		ppLink = &pOld->pThreadNext;
+	    else
+	    {
+		*ppLink = pOld->pThreadNext;
+		delete pOld;
+	    }
+	}
+	pthread_mutex_unlock(&epochMutex);
+
+	/* try to reuse a record given up by a thread that has exited */
+	for(pRecord = __atomic_load_n(&pRecords, __ATOMIC_ACQUIRE); pRecord;
+	    pRecord = pRecord->pNext)
+	{
+	    int unowned = 0;
+	    if (__atomic_compare_exchange_n(
+		    &pRecord->owned, &unowned, 1, false,
+		    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+		break;
+	}
+
+	if (!pRecord)
+	{
+	    pRecord = new EpochRecord;
+	    pRecord->state = 0;
+	    pRecord->nesting = 0;
+	    pRecord->owned = 1;
+	    pRecord->pManager = this;
+	    pRecord->managerId = id;
+	    pRecord->pRetiredHead = NULL;
+	    pRecord->pRetiredTail = NULL;
+	    pRecord->nRetired = 0;
+
+	    pRecord->pNext = __atomic_load_n(&pRecords, __ATOMIC_RELAXED);
+	    while(!__atomic_compare_exchange_n(
+		      &pRecords, &pRecord->pNext, pRecord, true,
+		      __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	}
+
+	pRecord->pThreadNext = pFirst;
+	pthread_setspecific(epochKey, pRecord);
+	return pRecord;
+    }
+
+    void EpochManager::threadExit(void *p)
+    {
+	EpochRecord *pNext;
+	pthread_mutex_lock(&epochMutex);
+	for(EpochRecord *pRecord = (EpochRecord *)p; pRecord; pRecord = pNext)
+	{
+	    pNext = pRecord->pThreadNext;
+	    EpochManager *const pManager = pRecord->pManager;
+	    if (!pManager)
+	    {
+		delete pRecord;
+		continue;
+	    }
+
+	    /* hand anything still waiting over to the manager */
+	    if (pRecord->pRetiredHead)
+	    {
+		pthread_mutex_lock(&pManager->orphanMutex);
+		pRecord->pRetiredTail->pNext = pManager->pOrphans;
+		__atomic_store_n(&pManager->pOrphans, pRecord->pRetiredHead,
+				 __ATOMIC_RELAXED);
+		pthread_mutex_unlock(&pManager->orphanMutex);
+
+		pRecord->pRetiredHead = NULL;
+		pRecord->pRetiredTail = NULL;
+		pRecord->nRetired = 0;
+	    }
+
+	    pRecord->nesting = 0;
+	    __atomic_store_n(&pRecord->state, 0, __ATOMIC_RELEASE);
+	    __atomic_store_n(&pRecord->owned, 0, __ATOMIC_RELEASE);
+	}
+	pthread_mutex_unlock(&epochMutex);
+    }
+
+    void EpochManager::enter()
+    {
+	EpochRecord *pRecord = getRecord();
+	if (pRecord->nesting++)
+	    return;
+
+	/*
+	  Publish the epoch we're entering, and make sure that's visible
+	  before we read anything from the protected structures.  If the
+	  global epoch moved while we were doing that, catch up with it.
+	 */
+	unsigned long epoch = __atomic_load_n(&globalEpoch, __ATOMIC_RELAXED);
+	for(;;)
+	{
+	    __atomic_store_n(&pRecord->state, (epoch << 1) | 1,
+			     __ATOMIC_RELAXED);
+	    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+	    unsigned long current =
+		__atomic_load_n(&globalEpoch, __ATOMIC_RELAXED);
+	    if (current == epoch)
+		break;
+	    epoch = current;
+	}
+    }
+
+    void EpochManager::exit()
+    {
+	EpochRecord *pRecord = findRecord(id);
+	if (--pRecord->nesting)
+	    return;
+
+	__atomic_store_n(&pRecord->state, 0, __ATOMIC_RELEASE);
+    }
+
+    bool EpochManager::tryAdvance()
+    {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	unsigned long epoch = __atomic_load_n(&globalEpoch, __ATOMIC_RELAXED);
+
+	for(EpochRecord *pRecord = __atomic_load_n(&pRecords, __ATOMIC_ACQUIRE);
+	    pRecord; pRecord = pRecord->pNext)
+	{
+	    unsigned long state =
+		__atomic_load_n(&pRecord->state, __ATOMIC_ACQUIRE);
+	    if ((state & 1) && ((state >> 1) != epoch))
+		return false;
+	}
+
+	__atomic_compare_exchange_n(&globalEpoch, &epoch, epoch + 1, false,
+				    __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+	return true;
+    }
+
+    void EpochManager::collect(EpochRecord *pRecord)
+    {
+	const unsigned long epoch =
+	    __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+
+	/* the list is in retirement order, so stop at the first unsafe one */
+	EpochRetired *pRetired;
+	while((pRetired = pRecord->pRetiredHead) &&
+	      (pRetired->epoch + 2 <= epoch))
+	{
+	    pRecord->pRetiredHead = pRetired->pNext;
+	    --pRecord->nRetired;
+	    (*pRetired->reclaim)(pRetired->p);
+	    delete pRetired;
+	}
+
+	if (!pRecord->pRetiredHead)
+	    pRecord->pRetiredTail = NULL;
+    }
+
+    void EpochManager::collectOrphans()
+    {
+	if (!__atomic_load_n(&pOrphans, __ATOMIC_RELAXED))
+	    return;
+	if (pthread_mutex_trylock(&orphanMutex))
+	    return;
+
+	/*
+	  Orphans aren't in any particular order, so go through all of them.
+	 */
+	const unsigned long epoch =
+	    __atomic_load_n(&globalEpoch, __ATOMIC_ACQUIRE);
+	EpochRetired *pReady = NULL;
+	for(EpochRetired **ppLink = &pOrphans; *ppLink;)
+	{
+	    EpochRetired *pRetired = *ppLink;
+	    if (pRetired->epoch + 2 <= epoch)
+	    {
+		__atomic_store_n(ppLink, pRetired->pNext, __ATOMIC_RELAXED);
+		pRetired->pNext = pReady;
+		pReady = pRetired;
+	    }
+	    else
+		ppLink = &pRetired->pNext;
+	}
+
+	pthread_mutex_unlock(&orphanMutex);
+	reclaimList(pReady);
+    }
+
+    void EpochManager::retire(void *p, void (*reclaim)(void *p))
+    {
+	EpochRecord *pRecord = getRecord();
+
+	EpochRetired *pRetired = new EpochRetired;
+	pRetired->pNext = NULL;
+	pRetired->p = p;
+	pRetired->reclaim = reclaim;
+
+	/*
+	  The object has already been unlinked; make sure that is ordered
+	  before we read the epoch it is retired in.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	pRetired->epoch = __atomic_load_n(&globalEpoch, __ATOMIC_RELAXED);
+
+	if (pRecord->pRetiredTail)
+	    pRecord->pRetiredTail->pNext = pRetired;
+	else
+	    pRecord->pRetiredHead = pRetired;
+	pRecord->pRetiredTail = pRetired;
+
+	if (++pRecord->nRetired % collectInterval)
+	    return;
+
+	tryAdvance();
+	collect(pRecord);
+	collectOrphans();
+    }
+
+} // namespace phoenix4cpp
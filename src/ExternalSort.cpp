@@ -0,0 +1,782 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    ExternalSort.cpp - see ../include/ExternalSort.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Reads and writes are queued to a pair of I/O threads, which do each
+    one with pread() or pwrite() and mark it done; the sorting thread only
+    waits for a request when it needs the buffer back.  Two threads are
+    enough for a read and a write to be in flight at the same time.
+
+    Run generation alternates between two load buffers.  Once a load has
+    been read, the next one is queued, and the current one is sorted and
+    copied out through a writer.  Loads are read in aligned pieces, so a
+    record can be split between two loads; the part at the end of one is
+    copied to just in front of where the next one is read, and the sort
+    starts from there.  If the whole input fits in one load, it is written
+    straight to the output.
+
+    Writers and readers each have two blocks, one being filled or drained
+    by the sorting thread while the other is being written or read.  A
+    reader copies a record that is split between its blocks into a
+    separate buffer, so that records handed out are always contiguous.
+    The last block of a file is padded out to alignment, as O_DIRECT
+    requires; the output is then truncated to its real length.
+
+    Runs are merged with a LoserTree (see merge.h), which hands out the
+    current record of each run's reader.
+
+    All memory comes from an Arena for the duration of the call.
+ */
+
+#ifndef PHOENIX4CPP_EXTERNALSORT_H
+#include "ExternalSort.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_MERGE_H
+#include "merge.h"
+#endif
+
+#ifndef PHOENIX4CPP_QSORT_H
+#include "qsort.h"
+#endif
+
+#ifndef PHOENIX4CPP_CERRNO_H
+#include <cerrno>
+#define PHOENIX4CPP_CERRNO_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTDIO_H
+#include <cstdio>
+#define PHOENIX4CPP_CSTDIO_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_FCNTL_H
+#include <fcntl.h>
+#define PHOENIX4CPP_FCNTL_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+#ifndef PHOENIX4CPP_SYS_STAT_H
+#include <sys/stat.h>
+#define PHOENIX4CPP_SYS_STAT_H
+#endif
+
+#ifndef PHOENIX4CPP_UNISTD_H
+#include <unistd.h>
+#define PHOENIX4CPP_UNISTD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+/* alignment of O_DIRECT buffers, offsets and lengths */
+static const size_t ioAlign = 4096;
+
+static const unsigned nIoThreads = 2;
+
+/* more runs than this at once needs too many file descriptors */
+static const size_t maxFanIn = 512;
+
+ExternalSortOptions::ExternalSortOptions():
+    memoryBytes(256 << 20),
+    blockBytes(1 << 20),
+    pTempDirectory(NULL),
+    directIo(false)
+{
+}
+
+struct SortIo
+{
+    SortIo *pNext;
+    int fd;
+    char *pBuffer;
+    size_t bytes;
+    off_t offset;
+    bool write;
+    bool done;
+    size_t transferred;
+};
+
+struct SortRun
+{
+    int fd;
+    size_t bytes;
+};
+
+struct SortWriter
+{
+    int fd;
+    char *pBlock[2];
+    SortIo io[2];
+    unsigned current;
+    size_t used;
+    off_t offset;
+    size_t total;
+};
+
+struct SortReader
+{
+    int fd;
+    size_t fileBytes;
+    char *pBlock[2];
+    SortIo io[2];
+    unsigned current;
+    off_t nextOffset;
+    const char *pRecord;
+    const char *pPos;
+    const char *pEnd;
+    char *pStraddle;
+};
+
+struct SortShared
+{
+    size_t size;
+    size_t keyOffset;
+    int (*cmp)(const void *pl, const void *pr);
+    size_t blockBytes;
+    size_t memoryBytes;
+    bool directIo;
+    const char *pTempDirectory;
+
+    Arena *pArena;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t queued;
+    pthread_cond_t finished;
+    SortIo *pHead;
+    SortIo *pTail;
+    bool stopping;
+    pthread_t thread[nIoThreads];
+
+    /* the first error encountered */
+    int error;
+};
+
+static inline size_t alignUp(size_t n, size_t align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+static void setError(SortShared *pShared, int error)
+{
+    pthread_mutex_lock(&pShared->mutex);
+    if (!pShared->error)
+	pShared->error = error;
+    pthread_mutex_unlock(&pShared->mutex);
+}
+
+static int getError(SortShared *pShared)
+{
+    pthread_mutex_lock(&pShared->mutex);
+    const int error = pShared->error;
+    pthread_mutex_unlock(&pShared->mutex);
+    return error;
+}
+
+static void perform(SortShared *pShared, SortIo *pIo)
+{
+    /* reads stop short at the end of the file */
+    size_t done = 0;
+    while(done < pIo->bytes)
+    {
+	const ssize_t n = pIo->write ?
+	    pwrite(pIo->fd, pIo->pBuffer + done, pIo->bytes - done,
+		   pIo->offset + done) :
+	    pread(pIo->fd, pIo->pBuffer + done, pIo->bytes - done,
+		  pIo->offset + done);
+	if (n < 0)
+	{
+	    if (errno == EINTR)
+		continue;
+	    setError(pShared, errno);
+	    break;
+	}
+	if (!n)
+	{
+	    if (pIo->write)
+		setError(pShared, EIO);
+	    break;
+	}
+	done += n;
+    }
+    pIo->transferred = done;
+}
+
+static void *ioThread(void *pArg)
+{
+    SortShared *pShared = (SortShared *)pArg;
+    pthread_mutex_lock(&pShared->mutex);
+    for(;;)
+    {
+	while(!pShared->pHead && !pShared->stopping)
+	    pthread_cond_wait(&pShared->queued, &pShared->mutex);
+	SortIo *pIo = pShared->pHead;
+	if (!pIo)
+	    break;
+	if (!(pShared->pHead = pIo->pNext))
+	    pShared->pTail = NULL;
+	pthread_mutex_unlock(&pShared->mutex);
+
+	perform(pShared, pIo);
+
+	pthread_mutex_lock(&pShared->mutex);
+	pIo->done = true;
+	pthread_cond_broadcast(&pShared->finished);
+    }
+    pthread_mutex_unlock(&pShared->mutex);
+    return NULL;
+}
+
+static void submit(SortShared *pShared, SortIo *pIo, int fd, char *pBuffer,
+		   size_t bytes, off_t offset, bool write)
+{
+    pIo->pNext = NULL;
+    pIo->fd = fd;
+    pIo->pBuffer = pBuffer;
+    pIo->bytes = bytes;
+    pIo->offset = offset;
+    pIo->write = write;
+    pIo->done = false;
+    pIo->transferred = 0;
+
+    pthread_mutex_lock(&pShared->mutex);
+    if (pShared->pTail)
+	pShared->pTail->pNext = pIo;
+    else
+	pShared->pHead = pIo;
+    pShared->pTail = pIo;
+    pthread_cond_signal(&pShared->queued);
+    pthread_mutex_unlock(&pShared->mutex);
+}
+
+static void waitIo(SortShared *pShared, SortIo *pIo)
+{
+    pthread_mutex_lock(&pShared->mutex);
+    while(!pIo->done)
+	pthread_cond_wait(&pShared->finished, &pShared->mutex);
+    pthread_mutex_unlock(&pShared->mutex);
+}
+
+static int openFile(SortShared *pShared, const char *pPath, int flags)
+{
+    int fd = -1;
+#ifdef O_DIRECT
+    if (pShared->directIo)
+	fd = open(pPath, flags | O_DIRECT, 0666);
+    if ((fd < 0) && pShared->directIo && (errno != EINVAL))
+    {
+	setError(pShared, errno);
+	return -1;
+    }
+#endif
+    if (fd < 0)
+	fd = open(pPath, flags, 0666);
+    if (fd < 0)
+	setError(pShared, errno);
+    return fd;
+}
+
+static int openTemp(SortShared *pShared)
+{
+    const char *pDirectory = pShared->pTempDirectory;
+    if (!pDirectory)
+	pDirectory = getenv("TMPDIR");
+    if (!pDirectory)
+	pDirectory = "/tmp";
+
+    const size_t length = strlen(pDirectory) + 32;
+    char *pPath = (char *)pShared->pArena->allocate(length);
+    snprintf(pPath, length, "%s/externalSortXXXXXX", pDirectory);
+    const int fd = mkstemp(pPath);
+    if (fd < 0)
+    {
+	setError(pShared, errno);
+	return -1;
+    }
+    unlink(pPath);
+
+#ifdef O_DIRECT
+    /* failure here just means buffered I/O */
+    if (pShared->directIo)
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT);
+#endif
+    return fd;
+}
+
+static void initWriter(SortShared *pShared, SortWriter *pWriter)
+{
+    for(unsigned i = 0; i < 2; ++i)
+    {
+	pWriter->pBlock[i] = (char *)pShared->pArena->allocate(
+	    pShared->blockBytes, ioAlign);
+	pWriter->io[i].done = true;
+    }
+    pWriter->fd = -1;
+}
+
+static void startWriter(SortWriter *pWriter, int fd)
+{
+    pWriter->fd = fd;
+    pWriter->current = 0;
+    pWriter->used = 0;
+    pWriter->offset = 0;
+    pWriter->total = 0;
+}
+
+static void flushBlock(SortShared *pShared, SortWriter *pWriter, size_t bytes)
+{
+    const unsigned current = pWriter->current;
+    submit(pShared, &pWriter->io[current], pWriter->fd,
+	   pWriter->pBlock[current], bytes, pWriter->offset, true);
+    pWriter->offset += bytes;
+    pWriter->current = current ^ 1;
+    pWriter->used = 0;
+    waitIo(pShared, &pWriter->io[current ^ 1]);
+}
+
+static void put(SortShared *pShared, SortWriter *pWriter,
+		const char *p, size_t n)
+{
+    pWriter->total += n;
+    const size_t blockBytes = pShared->blockBytes;
+    while(n)
+    {
+	size_t k = blockBytes - pWriter->used;
+	if (k > n)
+	    k = n;
+	memcpy(pWriter->pBlock[pWriter->current] + pWriter->used, p, k);
+	pWriter->used += k;
+	p += k;
+	n -= k;
+	if (pWriter->used == blockBytes)
+	    flushBlock(pShared, pWriter, blockBytes);
+    }
+}
+
+/* @returns the number of bytes written */
+static size_t finishWriter(SortShared *pShared, SortWriter *pWriter)
+{
+    if (pWriter->used)
+    {
+	const size_t padded = alignUp(pWriter->used, ioAlign);
+	memset(pWriter->pBlock[pWriter->current] + pWriter->used, 0,
+	       padded - pWriter->used);
+	flushBlock(pShared, pWriter, padded);
+    }
+    waitIo(pShared, &pWriter->io[0]);
+    waitIo(pShared, &pWriter->io[1]);
+    return pWriter->total;
+}
+
+static void prefetch(SortShared *pShared, SortReader *pReader, unsigned i)
+{
+    if ((size_t)pReader->nextOffset >= pReader->fileBytes)
+    {
+	pReader->io[i].bytes = 0;
+	pReader->io[i].done = true;
+	return;
+    }
+
+    submit(pShared, &pReader->io[i], pReader->fd, pReader->pBlock[i],
+	   pShared->blockBytes, pReader->nextOffset, false);
+    pReader->nextOffset += pShared->blockBytes;
+}
+
+/*
+  Move to the reader's other block, and start reading ahead into the one
+  just finished with.
+
+  @returns false if there is no more data
+*/
+static bool nextBlock(SortShared *pShared, SortReader *pReader)
+{
+    const unsigned finished = pReader->current;
+    const unsigned current = finished ^ 1;
+    pReader->current = current;
+    SortIo *pIo = &pReader->io[current];
+    waitIo(pShared, pIo);
+    if (!pIo->bytes)
+	return false;
+
+    /* the last block is padded, and may have been read short */
+    size_t bytes = pReader->fileBytes - pIo->offset;
+    if (bytes > pShared->blockBytes)
+	bytes = pShared->blockBytes;
+    if (pIo->transferred < bytes)
+    {
+	setError(pShared, EIO);
+	return false;
+    }
+
+    pReader->pPos = pReader->pBlock[current];
+    pReader->pEnd = pReader->pPos + bytes;
+    prefetch(pShared, pReader, finished);
+    return true;
+}
+
+/* make pRecord the next record, or NULL if there are no more */
+static void advance(SortShared *pShared, SortReader *pReader)
+{
+    const size_t size = pShared->size;
+    for(;;)
+    {
+	const size_t left = pReader->pEnd - pReader->pPos;
+	if (left >= size)
+	{
+	    pReader->pRecord = pReader->pPos;
+	    pReader->pPos += size;
+	    return;
+	}
+
+	if (!left)
+	{
+	    if (!nextBlock(pShared, pReader))
+	    {
+		pReader->pRecord = NULL;
+		return;
+	    }
+	    continue;
+	}
+
+	/* the record is split between blocks */
+	memcpy(pReader->pStraddle, pReader->pPos, left);
+	if (!nextBlock(pShared, pReader) ||
+	    ((size_t)(pReader->pEnd - pReader->pPos) < size - left))
+	{
+	    setError(pShared, EIO);
+	    pReader->pRecord = NULL;
+	    return;
+	}
+	memcpy(pReader->pStraddle + left, pReader->pPos, size - left);
+	pReader->pPos += size - left;
+	pReader->pRecord = pReader->pStraddle;
+	return;
+    }
+}
+
+static void startReader(SortShared *pShared, SortReader *pReader,
+			const SortRun *pRun)
+{
+    Arena *const pArena = pShared->pArena;
+    pReader->fd = pRun->fd;
+    pReader->fileBytes = pRun->bytes;
+    for(unsigned i = 0; i < 2; ++i)
+	pReader->pBlock[i] = (char *)pArena->allocate(
+	    pShared->blockBytes, ioAlign);
+    pReader->pStraddle = (char *)pArena->allocate(pShared->size, 16);
+
+    pReader->nextOffset = 0;
+    prefetch(pShared, pReader, 0);
+    pReader->io[1].done = true;
+
+    /* start as though block 1 has just been finished */
+    pReader->current = 1;
+    pReader->pPos = NULL;
+    pReader->pEnd = NULL;
+    advance(pShared, pReader);
+}
+
+/* merge runs into a writer, and close them */
+static void merge(SortShared *pShared, SortRun *pRun, size_t nRuns,
+		  SortWriter *pWriter)
+{
+    Arena *const pArena = pShared->pArena;
+    ArenaScope scope(pArena);
+
+    SortReader *pReader = pArena->allocateArray<SortReader>(nRuns);
+    for(size_t i = 0; i < nRuns; ++i)
+	startReader(pShared, &pReader[i], &pRun[i]);
+
+    LoserTree tree(nRuns, pShared->keyOffset, pShared->cmp, pArena);
+    for(size_t i = 0; i < nRuns; ++i)
+	tree.set(i, pReader[i].pRecord);
+    tree.start();
+
+    const size_t size = pShared->size;
+    const void *pRecord;
+    while((pRecord = tree.getWinnerRecord()))
+    {
+	SortReader *pWinner = &pReader[tree.getWinner()];
+	put(pShared, pWriter, (const char *)pRecord, size);
+	advance(pShared, pWinner);
+	tree.advance(pWinner->pRecord);
+    }
+
+    for(size_t i = 0; i < nRuns; ++i)
+    {
+	/* in case of errors, don't leave reads in flight */
+	waitIo(pShared, &pReader[i].io[0]);
+	waitIo(pShared, &pReader[i].io[1]);
+	close(pRun[i].fd);
+	pRun[i].fd = -1;
+    }
+}
+
+/* @returns the number of bytes to read for each load */
+static size_t getLoadBytes(const SortShared *pShared)
+{
+    const size_t lead = alignUp(pShared->size, ioAlign);
+    const size_t half = pShared->memoryBytes / 2;
+    size_t loadBytes = half > lead + ioAlign ?
+	(half - lead) & ~(ioAlign - 1) : ioAlign;
+    if (loadBytes < lead)
+	loadBytes = lead;
+    return loadBytes;
+}
+
+/*
+  Read the input a load at a time, sort each load, and write it out as a
+  run.
+
+  @returns the number of runs written, or zero if the input fit in one
+    load and was written straight to the output
+*/
+static size_t makeRuns(SortShared *pShared, int inFd, size_t inBytes,
+		       const char *pOutPath, SortRun *pRun, int *pOutFd)
+{
+    Arena *const pArena = pShared->pArena;
+    ArenaScope scope(pArena);
+    const size_t size = pShared->size;
+
+    /* two loads, each with room in front for a split record */
+    const size_t lead = alignUp(size, ioAlign);
+    const size_t loadBytes = getLoadBytes(pShared);
+    char *pLoad[2];
+    SortIo io[2];
+    for(unsigned i = 0; i < 2; ++i)
+	pLoad[i] = (char *)pArena->allocate(lead + loadBytes, ioAlign);
+    SortWriter writer;
+    initWriter(pShared, &writer);
+
+    size_t nRuns = 0;
+    size_t offset = 0;
+    size_t leftover = 0;
+    unsigned current = 0;
+    submit(pShared, &io[0], inFd, pLoad[0] + lead, loadBytes, 0, false);
+    offset += loadBytes;
+    for(;;)
+    {
+	waitIo(pShared, &io[current]);
+	size_t got = inBytes - io[current].offset;
+	if (got > loadBytes)
+	    got = loadBytes;
+	if (io[current].transferred < got)
+	{
+	    setError(pShared, EIO);
+	    return nRuns;
+	}
+
+	char *pData = pLoad[current] + lead - leftover;
+	const size_t nBytes = leftover + got;
+	const size_t nRecords = nBytes / size;
+	leftover = nBytes - nRecords * size;
+
+	const bool more = offset < inBytes;
+	if (more)
+	{
+	    char *pNext = pLoad[current ^ 1] + lead;
+	    memcpy(pNext - leftover, pData + nRecords * size, leftover);
+	    submit(pShared, &io[current ^ 1], inFd, pNext, loadBytes, offset,
+		   false);
+	    offset += loadBytes;
+	}
+
+	qsort(pData, nRecords, size, pShared->keyOffset, pShared->cmp);
+
+	int fd;
+	if (!nRuns && !more)
+	{
+	    /* it all fit in one load; the input has been read completely */
+	    fd = openFile(pShared, pOutPath, O_WRONLY | O_CREAT | O_TRUNC);
+	    *pOutFd = fd;
+	}
+	else
+	    fd = pRun[nRuns].fd = openTemp(pShared);
+	if (fd < 0)
+	{
+	    if (more)
+		waitIo(pShared, &io[current ^ 1]);
+	    return nRuns;
+	}
+
+	startWriter(&writer, fd);
+	put(pShared, &writer, pData, nRecords * size);
+	const size_t written = finishWriter(pShared, &writer);
+	if (*pOutFd >= 0)
+	    return 0;
+
+	pRun[nRuns++].bytes = written;
+	if (!more)
+	    return nRuns;
+	current ^= 1;
+    }
+}
+
+static int sortFile(SortShared *pShared, const char *pInPath,
+		    const char *pOutPath)
+{
+    int inFd = openFile(pShared, pInPath, O_RDONLY);
+    if (inFd < 0)
+	return getError(pShared);
+
+    struct stat st;
+    if (fstat(inFd, &st))
+    {
+	close(inFd);
+	return errno;
+    }
+    const size_t inBytes = (size_t)st.st_size;
+    const size_t size = pShared->size;
+    if (inBytes % size)
+    {
+	close(inFd);
+	return EINVAL;
+    }
+
+    if (!inBytes)
+    {
+	close(inFd);
+	const int outFd = openFile(pShared, pOutPath,
+				   O_WRONLY | O_CREAT | O_TRUNC);
+	if (outFd >= 0)
+	    close(outFd);
+	return getError(pShared);
+    }
+
+    /* merging adds at most one more run for every two */
+    const size_t maxRuns = 2 * (inBytes / getLoadBytes(pShared) + 2);
+    SortRun *pRun = pShared->pArena->allocateArray<SortRun>(maxRuns);
+    int outFd = -1;
+    size_t nRuns = makeRuns(pShared, inFd, inBytes, pOutPath, pRun, &outFd);
+    close(inFd);
+
+    size_t first = 0;
+    if (nRuns && !getError(pShared))
+    {
+	/* each run being merged, and the output, need two blocks */
+	size_t fanIn = pShared->memoryBytes / pShared->blockBytes / 2;
+	fanIn = fanIn > 3 ? fanIn - 1 : 2;
+	if (fanIn > maxFanIn)
+	    fanIn = maxFanIn;
+
+	SortWriter writer;
+	initWriter(pShared, &writer);
+	while((nRuns - first > fanIn) && !getError(pShared))
+	{
+	    SortRun *pTo = &pRun[nRuns];
+	    if ((pTo->fd = openTemp(pShared)) < 0)
+		break;
+	    startWriter(&writer, pTo->fd);
+	    merge(pShared, &pRun[first], fanIn, &writer);
+	    pTo->bytes = finishWriter(pShared, &writer);
+	    first += fanIn;
+	    ++nRuns;
+	}
+
+	if (!getError(pShared))
+	{
+	    outFd = openFile(pShared, pOutPath, O_WRONLY | O_CREAT | O_TRUNC);
+	    if (outFd >= 0)
+	    {
+		startWriter(&writer, outFd);
+		merge(pShared, &pRun[first], nRuns - first, &writer);
+		finishWriter(pShared, &writer);
+		first = nRuns;
+	    }
+	}
+    }
+
+    for(size_t i = first; i < nRuns; ++i)
+    {
+	if (pRun[i].fd >= 0)
+	    close(pRun[i].fd);
+    }
+
+    if (outFd >= 0)
+    {
+	if (ftruncate(outFd, inBytes))
+	    setError(pShared, errno);
+	if (close(outFd))
+	    setError(pShared, errno);
+    }
+    return getError(pShared);
+}
+
+int externalSort(const char *pInPath, const char *pOutPath,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 const ExternalSortOptions *pOptions)
+{
+    const ExternalSortOptions defaults;
+    if (!pOptions)
+	pOptions = &defaults;
+    if (!size)
+	return EINVAL;
+
+    Arena arena(4 << 20, true);
+    SortShared shared;
+    shared.size = size;
+    shared.keyOffset = keyOffset;
+    shared.cmp = cmp;
+    shared.blockBytes = alignUp(
+	pOptions->blockBytes > size ? pOptions->blockBytes : size, ioAlign);
+    shared.memoryBytes = pOptions->memoryBytes;
+    if (shared.memoryBytes < 4 * shared.blockBytes)
+	shared.memoryBytes = 4 * shared.blockBytes;
+    shared.directIo = pOptions->directIo;
+    shared.pTempDirectory = pOptions->pTempDirectory;
+    shared.pArena = &arena;
+    pthread_mutex_init(&shared.mutex, NULL);
+    pthread_cond_init(&shared.queued, NULL);
+    pthread_cond_init(&shared.finished, NULL);
+    shared.pHead = NULL;
+    shared.pTail = NULL;
+    shared.stopping = false;
+    shared.error = 0;
+
+    for(unsigned i = 0; i < nIoThreads; ++i)
+	pthread_create(&shared.thread[i], NULL, ioThread, &shared);
+
+    const int error = sortFile(&shared, pInPath, pOutPath);
+
+    pthread_mutex_lock(&shared.mutex);
+    shared.stopping = true;
+    pthread_cond_broadcast(&shared.queued);
+    pthread_mutex_unlock(&shared.mutex);
+    for(unsigned i = 0; i < nIoThreads; ++i)
+	pthread_join(shared.thread[i], NULL);
+
+    pthread_cond_destroy(&shared.finished);
+    pthread_cond_destroy(&shared.queued);
+    pthread_mutex_destroy(&shared.mutex);
+    return error;
+}
+
+} // namespace phoenix4cpp
@@ -0,0 +1,472 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HashJoin.cpp - see ../include/HashJoin.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Partitioning is done in two passes over each input.  The first hashes
+    every key, and counts the number of records bound for each partition,
+    with a separate histogram for each thread's share of the input.  The
+    histograms give every thread its own place to start writing in each
+    partition, so the second pass scatters (hash, record pointer) entries
+    into the partitions without any synchronization.  This keeps the
+    records in each partition in their original order.
+
+    A partition's hash table is an array of chain heads, indexed by the low
+    bits of the hash (the top bits chose the partition), and an array of
+    next links parallel to the partition's entries.  Both hold entry numbers
+    plus one, so that zero can mean the end of a chain.  The table has at
+    least twice as many heads as there are entries.  Full hashes are
+    compared before keys are.
+
+    For grouping, the chains link groups rather than entries, and each
+    group has a list of its members, kept in order by appending at a tail.
+
+    All scratch space comes from the thread arenas (see Arena.h):  the
+    partitioned inputs from the calling thread's, for the duration of the
+    call, and each partition's hash table from the arena of the thread
+    processing it, rewound when the partition is done.
+ */
+
+#ifndef PHOENIX4CPP_HASHJOIN_H
+#include "HashJoin.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+/* partitions are sized for about this many entries on the build side */
+static const size_t partitionTarget = 8192;
+
+/* more than this many partitions costs more in the scatter than it saves */
+static const unsigned maxRadixBits = 12;
+
+struct JoinEntry
+{
+    unsigned long long hashValue;
+    const void *pRecord;
+};
+
+struct JoinInput
+{
+    const char *pArray;
+    size_t n;
+    size_t size;
+    size_t keyOffset;
+
+    JoinEntry *pEntry;
+
+    /* where each partition starts in pEntry; there is one extra at the end */
+    size_t *pStart;
+
+    /* work space for partitioning */
+    unsigned long long *pHash;
+    size_t *pOffset;
+};
+
+struct JoinShared
+{
+    void (*hash)(HashValue *pHashValue, const void *pKey);
+    int (*cmp)(const void *pl, const void *pr);
+    void (*emitJoin)(void *pContext, unsigned thread,
+		     const void *pLeft, const void *pRight);
+    void (*emitGroup)(void *pContext, unsigned thread,
+		      const void *const *ppGroup, size_t nGroup);
+    void *pContext;
+
+    unsigned nThreads;
+    unsigned radixBits;
+    size_t nPartitions;
+
+    /* the left and right inputs for a join, or just the one for grouping */
+    JoinInput input[2];
+    JoinInput *pPartitioning;
+
+    /* for joins, which input the tables are built from */
+    unsigned build;
+
+    size_t nextPartition;
+};
+
+struct JoinWorker
+{
+    JoinShared *pShared;
+    unsigned thread;
+    pthread_t pthread;
+};
+
+static void runWorkers(JoinShared *pShared, void *(*pRun)(void *))
+{
+    JoinWorker worker[64];
+    const unsigned nWorkers = pShared->nThreads;
+    for(unsigned i = 0; i < nWorkers; ++i)
+    {
+	worker[i].pShared = pShared;
+	worker[i].thread = i;
+    }
+
+    if (nWorkers == 1)
+    {
+	(*pRun)(&worker[0]);
+	return;
+    }
+
+    for(unsigned i = 0; i < nWorkers; ++i)
+	pthread_create(&worker[i].pthread, NULL, pRun, &worker[i]);
+    for(unsigned i = 0; i < nWorkers; ++i)
+	pthread_join(worker[i].pthread, NULL);
+}
+
+static inline size_t partitionOf(const JoinShared *pShared,
+				 unsigned long long hashValue)
+{
+    return pShared->radixBits ?
+	(size_t)(hashValue >> (64 - pShared->radixBits)) : 0;
+}
+
+static void *hashAndCount(void *pArg)
+{
+    JoinWorker *pWorker = (JoinWorker *)pArg;
+    JoinShared *pShared = pWorker->pShared;
+    JoinInput *pInput = pShared->pPartitioning;
+
+    const size_t begin = pInput->n * pWorker->thread / pShared->nThreads;
+    const size_t end = pInput->n * (pWorker->thread + 1) / pShared->nThreads;
+    size_t *pCount = pInput->pOffset + pWorker->thread * pShared->nPartitions;
+
+    const char *pRecord = pInput->pArray + begin * pInput->size;
+    for(size_t i = begin; i < end; ++i, pRecord += pInput->size)
+    {
+	HashValue hashValue;
+	(*pShared->hash)(&hashValue, pRecord + pInput->keyOffset);
+	pInput->pHash[i] = hashValue.get64();
+	++pCount[partitionOf(pShared, pInput->pHash[i])];
+    }
+
+    return NULL;
+}
+
+static void *scatter(void *pArg)
+{
+    JoinWorker *pWorker = (JoinWorker *)pArg;
+    JoinShared *pShared = pWorker->pShared;
+    JoinInput *pInput = pShared->pPartitioning;
+
+    const size_t begin = pInput->n * pWorker->thread / pShared->nThreads;
+    const size_t end = pInput->n * (pWorker->thread + 1) / pShared->nThreads;
+    size_t *pOffset = pInput->pOffset + pWorker->thread * pShared->nPartitions;
+
+    const char *pRecord = pInput->pArray + begin * pInput->size;
+    for(size_t i = begin; i < end; ++i, pRecord += pInput->size)
+    {
+	const unsigned long long h = pInput->pHash[i];
+	JoinEntry *pE = &pInput->pEntry[pOffset[partitionOf(pShared, h)]++];
+	pE->hashValue = h;
+	pE->pRecord = pRecord;
+    }
+
+    return NULL;
+}
+
+static void partition(JoinShared *pShared, JoinInput *pInput)
+{
+    const size_t nPartitions = pShared->nPartitions;
+    const unsigned nThreads = pShared->nThreads;
+
+    Arena *const pArena = Arena::getThreadArena();
+    pInput->pEntry = pArena->allocateArray<JoinEntry>(pInput->n);
+    pInput->pStart = pArena->allocateArray<size_t>(nPartitions + 1);
+
+    /* the rest is only needed while partitioning */
+    ArenaScope scope(pArena);
+    pInput->pHash = pArena->allocateArray<unsigned long long>(pInput->n);
+    pInput->pOffset = pArena->allocateArray<size_t>(nThreads * nPartitions);
+    memset(pInput->pOffset, 0, nThreads * nPartitions * sizeof(size_t));
+
+    pShared->pPartitioning = pInput;
+    runWorkers(pShared, hashAndCount);
+
+    /* turn the counts into starting offsets, thread by thread */
+    size_t offset = 0;
+    for(size_t p = 0; p < nPartitions; ++p)
+    {
+	pInput->pStart[p] = offset;
+	for(unsigned t = 0; t < nThreads; ++t)
+	{
+	    size_t *pO = &pInput->pOffset[t * nPartitions + p];
+	    const size_t count = *pO;
+	    *pO = offset;
+	    offset += count;
+	}
+    }
+    pInput->pStart[nPartitions] = offset;
+
+    runWorkers(pShared, scatter);
+}
+
+static void setup(JoinShared *pShared, size_t nBuild, unsigned nThreads)
+{
+    if (nThreads < 1)
+	nThreads = 1;
+    if (nThreads > 64)
+	nThreads = 64;
+    pShared->nThreads = nThreads;
+
+    /*
+      Make partitions small enough to fit in cache, and if there are
+      enough records, make enough of them to keep all the threads busy.
+    */
+    unsigned bits = 0;
+    while((bits < maxRadixBits) &&
+	  (((nBuild >> bits) > partitionTarget) ||
+	   (((1U << bits) < nThreads * 4) && ((nBuild >> bits) > 1024))))
+	++bits;
+    pShared->radixBits = bits;
+    pShared->nPartitions = ((size_t)1) << bits;
+    pShared->nextPartition = 0;
+}
+
+static size_t tableSize(size_t n)
+{
+    size_t size = 16;
+    while(size < n * 2)
+	size <<= 1;
+    return size;
+}
+
+static void joinPartition(JoinShared *pShared, size_t p, unsigned thread)
+{
+    const JoinInput *pBuild = &pShared->input[pShared->build];
+    const JoinInput *pProbe = &pShared->input[1 - pShared->build];
+    const JoinEntry *pB = pBuild->pEntry + pBuild->pStart[p];
+    const size_t nB = pBuild->pStart[p + 1] - pBuild->pStart[p];
+    const JoinEntry *pP = pProbe->pEntry + pProbe->pStart[p];
+    const size_t nP = pProbe->pStart[p + 1] - pProbe->pStart[p];
+    if (!nB || !nP)
+	return;
+
+    Arena *const pArena = Arena::getThreadArena();
+    ArenaScope scope(pArena);
+    const size_t mask = tableSize(nB) - 1;
+    unsigned *pHead = pArena->allocateArray<unsigned>(mask + 1);
+    unsigned *pNext = pArena->allocateArray<unsigned>(nB);
+    memset(pHead, 0, (mask + 1) * sizeof(unsigned));
+    for(size_t i = 0; i < nB; ++i)
+    {
+	const size_t bucket = (size_t)pB[i].hashValue & mask;
+	pNext[i] = pHead[bucket];
+	pHead[bucket] = (unsigned)(i + 1);
+    }
+
+    const bool buildLeft = !pShared->build;
+    for(size_t i = 0; i < nP; ++i)
+    {
+	const unsigned long long h = pP[i].hashValue;
+	const char *pProbeKey =
+	    (const char *)pP[i].pRecord + pProbe->keyOffset;
+	for(unsigned j = pHead[(size_t)h & mask]; j; j = pNext[j - 1])
+	{
+	    const JoinEntry *pE = &pB[j - 1];
+	    if (pE->hashValue != h)
+		continue;
+
+	    const char *pBuildKey =
+		(const char *)pE->pRecord + pBuild->keyOffset;
+	    if (buildLeft)
+	    {
+		if (!(*pShared->cmp)(pBuildKey, pProbeKey))
+		    (*pShared->emitJoin)(pShared->pContext, thread,
+					 pE->pRecord, pP[i].pRecord);
+	    }
+	    else if (!(*pShared->cmp)(pProbeKey, pBuildKey))
+		(*pShared->emitJoin)(pShared->pContext, thread,
+				     pP[i].pRecord, pE->pRecord);
+	}
+    }
+}
+
+static void groupPartition(JoinShared *pShared, size_t p, unsigned thread)
+{
+    const JoinInput *pInput = &pShared->input[0];
+    const JoinEntry *pE = pInput->pEntry + pInput->pStart[p];
+    const size_t n = pInput->pStart[p + 1] - pInput->pStart[p];
+    if (!n)
+	return;
+
+    Arena *const pArena = Arena::getThreadArena();
+    ArenaScope scope(pArena);
+    const size_t mask = tableSize(n) - 1;
+    unsigned *pHead = pArena->allocateArray<unsigned>(mask + 1);
+    memset(pHead, 0, (mask + 1) * sizeof(unsigned));
+
+    /* groups, by number, and the members of each */
+    unsigned *pGroupNext = pArena->allocateArray<unsigned>(n);
+    unsigned *pFirst = pArena->allocateArray<unsigned>(n);
+    unsigned *pLast = pArena->allocateArray<unsigned>(n);
+    size_t *pCount = pArena->allocateArray<size_t>(n);
+    unsigned *pMemberNext = pArena->allocateArray<unsigned>(n);
+    size_t nGroups = 0;
+
+    for(size_t i = 0; i < n; ++i)
+    {
+	const size_t bucket = (size_t)pE[i].hashValue & mask;
+	const char *pKey = (const char *)pE[i].pRecord + pInput->keyOffset;
+	pMemberNext[i] = 0;
+
+	unsigned g = pHead[bucket];
+	for(; g; g = pGroupNext[g - 1])
+	{
+	    const JoinEntry *pF = &pE[pFirst[g - 1]];
+	    if ((pF->hashValue == pE[i].hashValue) &&
+		!(*pShared->cmp)(
+		    pKey, (const char *)pF->pRecord + pInput->keyOffset))
+		break;
+	}
+
+	if (g)
+	{
+	    pMemberNext[pLast[g - 1]] = (unsigned)(i + 1);
+	    pLast[g - 1] = (unsigned)i;
+	    ++pCount[g - 1];
+	}
+	else
+	{
+	    pFirst[nGroups] = pLast[nGroups] = (unsigned)i;
+	    pCount[nGroups] = 1;
+	    pGroupNext[nGroups] = pHead[bucket];
+	    pHead[bucket] = (unsigned)++nGroups;
+	}
+    }
+
+    const void **ppGroup = pArena->allocateArray<const void *>(n);
+    for(size_t g = 0; g < nGroups; ++g)
+    {
+	size_t k = 0;
+	for(unsigned m = pFirst[g] + 1; m; m = pMemberNext[m - 1])
+	    ppGroup[k++] = pE[m - 1].pRecord;
+	(*pShared->emitGroup)(pShared->pContext, thread, ppGroup, pCount[g]);
+    }
+}
+
+static void *joinPartitions(void *pArg)
+{
+    JoinWorker *pWorker = (JoinWorker *)pArg;
+    JoinShared *pShared = pWorker->pShared;
+
+    for(;;)
+    {
+	const size_t p = __atomic_fetch_add(
+	    &pShared->nextPartition, 1, __ATOMIC_RELAXED);
+	if (p >= pShared->nPartitions)
+	    return NULL;
+	joinPartition(pShared, p, pWorker->thread);
+    }
+}
+
+static void *groupPartitions(void *pArg)
+{
+    JoinWorker *pWorker = (JoinWorker *)pArg;
+    JoinShared *pShared = pWorker->pShared;
+
+    for(;;)
+    {
+	const size_t p = __atomic_fetch_add(
+	    &pShared->nextPartition, 1, __ATOMIC_RELAXED);
+	if (p >= pShared->nPartitions)
+	    return NULL;
+	groupPartition(pShared, p, pWorker->thread);
+    }
+}
+
+static void setInput(JoinInput *pInput, const void *pArray, size_t n,
+		     size_t size, size_t keyOffset)
+{
+    pInput->pArray = (const char *)pArray;
+    pInput->n = n;
+    pInput->size = size;
+    pInput->keyOffset = keyOffset;
+}
+
+void hashJoin(const void *pLeft, size_t nLeft, size_t leftSize,
+	      size_t leftKeyOffset,
+	      const void *pRight, size_t nRight, size_t rightSize,
+	      size_t rightKeyOffset,
+	      void (*hash)(HashValue *pHashValue, const void *pKey),
+	      int (*cmp)(const void *pl, const void *pr),
+	      void (*emit)(void *pContext, unsigned thread,
+			   const void *pLeft, const void *pRight),
+	      void *pContext, unsigned nThreads)
+{
+    if (!nLeft || !nRight)
+	return;
+
+    ArenaScope scope(Arena::getThreadArena());
+    JoinShared shared;
+    shared.hash = hash;
+    shared.cmp = cmp;
+    shared.emitJoin = emit;
+    shared.emitGroup = NULL;
+    shared.pContext = pContext;
+    shared.build = nLeft <= nRight ? 0 : 1;
+    setup(&shared, nLeft <= nRight ? nLeft : nRight, nThreads);
+
+    setInput(&shared.input[0], pLeft, nLeft, leftSize, leftKeyOffset);
+    setInput(&shared.input[1], pRight, nRight, rightSize, rightKeyOffset);
+    partition(&shared, &shared.input[0]);
+    partition(&shared, &shared.input[1]);
+
+    runWorkers(&shared, joinPartitions);
+}
+
+void hashGroup(const void *pArray, size_t n, size_t size, size_t keyOffset,
+	       void (*hash)(HashValue *pHashValue, const void *pKey),
+	       int (*cmp)(const void *pl, const void *pr),
+	       void (*emit)(void *pContext, unsigned thread,
+			    const void *const *ppGroup, size_t nGroup),
+	       void *pContext, unsigned nThreads)
+{
+    if (!n)
+	return;
+
+    ArenaScope scope(Arena::getThreadArena());
+    JoinShared shared;
+    shared.hash = hash;
+    shared.cmp = cmp;
+    shared.emitJoin = NULL;
+    shared.emitGroup = emit;
+    shared.pContext = pContext;
+    shared.build = 0;
+    setup(&shared, n, nThreads);
+
+    setInput(&shared.input[0], pArray, n, size, keyOffset);
+    partition(&shared, &shared.input[0]);
+
+    runWorkers(&shared, groupPartitions);
+}
+
+} // namespace phoenix4cpp
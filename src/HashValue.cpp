@@ -26,7 +26,7 @@ namespace phoenix4cpp
     inline void HashValue::rotate()
     {
 	/* rotate left 5 bits */
-	value = (value << 5) | (value >> 27);
+	value = (value << 5) | (value >> (sizeof(value) * 8 - 5));
     }
 
     void HashValue::blend(short v)
@@ -44,7 +44,7 @@ namespace phoenix4cpp
 	for(const char *pC = (const char *)p; length; ++pC, --length)
 	{
 	    rotate();
-	    value ^= byteTable[(unsigned)*pC];
+	    value ^= byteTable[(unsigned char)*pC];
 	}
     }
 
@@ -53,7 +53,7 @@ namespace phoenix4cpp
 	for(; *pS; ++pS)
 	{
 	    rotate();
-	    value ^= byteTable[(unsigned)*pS];
+	    value ^= byteTable[(unsigned char)*pS];
 	}
     }
 
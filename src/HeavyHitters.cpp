@@ -0,0 +1,376 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HeavyHitters.cpp - see ../include/HeavyHitters.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The monitored keys live in a fixed array of slots.  Two structures refer
+    to the slots by number:  a binary min-heap ordered by count, so that the
+    key to be replaced is always at the root, and an open addressing index
+    with linear probing, keyed by the top bits of HashValue::get64(), for
+    finding a key's slot.  Removal from the index shifts later entries of
+    the probe sequence back, so no tombstones are needed.
+
+    Counts only ever increase, so after an update the key's slot only ever
+    needs to move down the heap.
+
+    Merging computes the combined count and error for every key monitored
+    by either tracker.  A key missing from one side may have occurred up to
+    that side's minimum count times there, so that much is added to both
+    its count and its error.  The keys with the largest combined counts are
+    kept.
+ */
+
+#ifndef PHOENIX4CPP_HEAVYHITTERS_H
+#include "HeavyHitters.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARATOR_H
+#include "Comparator.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARE_H
+#include "compare.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_QSORT_H
+#include "qsort.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    struct HeavyHittersSlot
+    {
+	unsigned long long hashValue;
+	unsigned long count;
+	unsigned long error;
+	size_t heapPosition;
+    };
+
+    struct HeavyHittersCandidate
+    {
+	unsigned long count;
+	unsigned long error;
+	unsigned long long hashValue;
+	const unsigned char *pKey;
+    };
+
+    HeavyHitters::HeavyHitters(size_t c, size_t k, const Comparator *pC):
+	capacity(c ? c : 1),
+	keySize(k),
+	pComparator(pC),
+	nUsed(0),
+	total(0),
+	pSlot(NULL),
+	pKeys(NULL),
+	pHeap(NULL),
+	pIndex(NULL),
+	indexBits(4)
+    {
+	/* keep the index at most half full */
+	while((((size_t)1) << indexBits) < capacity * 2)
+	    ++indexBits;
+
+	pSlot = new HeavyHittersSlot[capacity];
+	pKeys = new unsigned char[capacity * keySize];
+	pHeap = new size_t[capacity];
+	pIndex = new size_t[((size_t)1) << indexBits];
+	clear();
+    }
+
+    HeavyHitters::~HeavyHitters()
+    {
+	delete[] pSlot;
+	delete[] pKeys;
+	delete[] pHeap;
+	delete[] pIndex;
+    }
+
+    void HeavyHitters::clear()
+    {
+	memset(pIndex, 0, (((size_t)1) << indexBits) * sizeof(size_t));
+	nUsed = 0;
+	total = 0;
+    }
+
+    size_t HeavyHitters::findSlot(
+	unsigned long long hashValue, const void *pKey) const
+    {
+	const size_t mask = (((size_t)1) << indexBits) - 1;
+	for(size_t i = (size_t)(hashValue >> (64 - indexBits));;
+	    i = (i + 1) & mask)
+	{
+	    if (!pIndex[i])
+		return capacity;
+
+	    const size_t slot = pIndex[i] - 1;
+	    if ((pSlot[slot].hashValue == hashValue) &&
+		!pComparator->compare(pKey, pKeys + slot * keySize))
+		return slot;
+	}
+    }
+
+    void HeavyHitters::indexInsert(size_t slot)
+    {
+	const size_t mask = (((size_t)1) << indexBits) - 1;
+	size_t i = (size_t)(pSlot[slot].hashValue >> (64 - indexBits));
+	while(pIndex[i])
+	    i = (i + 1) & mask;
+	pIndex[i] = slot + 1;
+    }
+
+    void HeavyHitters::indexRemove(size_t slot)
+    {
+	const size_t mask = (((size_t)1) << indexBits) - 1;
+	size_t i = (size_t)(pSlot[slot].hashValue >> (64 - indexBits));
+	while(pIndex[i] != slot + 1)
+	    i = (i + 1) & mask;
+
+	/*
+	  Move back any later entry in the run whose home position is not
+	  between the hole and the entry, so that it can still be found.
+	*/
+	for(size_t j = (i + 1) & mask; pIndex[j]; j = (j + 1) & mask)
+	{
+	    const size_t home = (size_t)(
+		pSlot[pIndex[j] - 1].hashValue >> (64 - indexBits));
+	    if (((j - home) & mask) >= ((j - i) & mask))
+	    {
+		pIndex[i] = pIndex[j];
+		i = j;
+	    }
+	}
+
+	pIndex[i] = 0;
+    }
+
+    void HeavyHitters::heapSet(size_t position, size_t slot)
+    {
+	pHeap[position] = slot;
+	pSlot[slot].heapPosition = position;
+    }
+
+    void HeavyHitters::siftUp(size_t position)
+    {
+	const size_t slot = pHeap[position];
+	while(position)
+	{
+	    const size_t parent = (position - 1) / 2;
+	    if (pSlot[pHeap[parent]].count <= pSlot[slot].count)
+		break;
+	    heapSet(position, pHeap[parent]);
+	    position = parent;
+	}
+	heapSet(position, slot);
+    }
+
+    void HeavyHitters::siftDown(size_t position)
+    {
+	const size_t slot = pHeap[position];
+	for(;;)
+	{
+	    size_t child = position * 2 + 1;
+	    if (child >= nUsed)
+		break;
+	    if ((child + 1 < nUsed) &&
+		(pSlot[pHeap[child + 1]].count < pSlot[pHeap[child]].count))
+		++child;
+	    if (pSlot[slot].count <= pSlot[pHeap[child]].count)
+		break;
+	    heapSet(position, pHeap[child]);
+	    position = child;
+	}
+	heapSet(position, slot);
+    }
+
+    unsigned long HeavyHitters::getMinimum() const
+    {
+	return nUsed < capacity ? 0 : pSlot[pHeap[0]].count;
+    }
+
+    void HeavyHitters::add(const Hashable *pKey, unsigned long count)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	const unsigned long long h = hashValue.get64();
+	const void *pRaw = pKey->getRawPointer();
+
+	total += count;
+
+	size_t slot = findSlot(h, pRaw);
+	if (slot != capacity)
+	{
+	    pSlot[slot].count += count;
+	    siftDown(pSlot[slot].heapPosition);
+	    return;
+	}
+
+	if (nUsed < capacity)
+	{
+	    slot = nUsed++;
+	    pSlot[slot].hashValue = h;
+	    pSlot[slot].count = count;
+	    pSlot[slot].error = 0;
+	    memcpy(pKeys + slot * keySize, pRaw, keySize);
+	    heapSet(slot, slot);
+	    siftUp(slot);
+	    indexInsert(slot);
+	    return;
+	}
+
+	/* replace the key with the smallest count */
+	slot = pHeap[0];
+	indexRemove(slot);
+	pSlot[slot].hashValue = h;
+	pSlot[slot].error = pSlot[slot].count;
+	pSlot[slot].count += count;
+	memcpy(pKeys + slot * keySize, pRaw, keySize);
+	indexInsert(slot);
+	siftDown(0);
+    }
+
+    bool HeavyHitters::find(const Hashable *pKey, Entry *pEntry) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+
+	const size_t slot = findSlot(hashValue.get64(), pKey->getRawPointer());
+	if (slot == capacity)
+	    return false;
+
+	pEntry->pKey = pKeys + slot * keySize;
+	pEntry->count = pSlot[slot].count;
+	pEntry->error = pSlot[slot].error;
+	return true;
+    }
+
+    size_t HeavyHitters::getTop(Entry *pEntries, size_t n) const
+    {
+	if (!nUsed)
+	    return 0;
+
+	Entry *pAll = new Entry[nUsed];
+	for(size_t slot = 0; slot < nUsed; ++slot)
+	{
+	    pAll[slot].pKey = pKeys + slot * keySize;
+	    pAll[slot].count = pSlot[slot].count;
+	    pAll[slot].error = pSlot[slot].error;
+	}
+	qsort<Entry, unsigned long, offsetof(Entry, count)>(
+	    pAll, nUsed, compareUnsignedLong);
+
+	if (n > nUsed)
+	    n = nUsed;
+	for(size_t i = 0; i < n; ++i)
+	    pEntries[i] = pAll[nUsed - 1 - i];
+
+	delete[] pAll;
+	return n;
+    }
+
+    bool HeavyHitters::merge(const HeavyHitters *pOther)
+    {
+	if (pOther->keySize != keySize)
+	    return false;
+
+	if (pOther == this)
+	{
+	    for(size_t slot = 0; slot < nUsed; ++slot)
+	    {
+		pSlot[slot].count *= 2;
+		pSlot[slot].error *= 2;
+	    }
+	    total *= 2;
+	    return true;
+	}
+
+	const unsigned long minimum = getMinimum();
+	const unsigned long otherMinimum = pOther->getMinimum();
+
+	HeavyHittersCandidate *pCandidate =
+	    new HeavyHittersCandidate[nUsed + pOther->nUsed];
+	size_t n = 0;
+	for(size_t slot = 0; slot < nUsed; ++slot, ++n)
+	{
+	    HeavyHittersCandidate *pC = &pCandidate[n];
+	    pC->hashValue = pSlot[slot].hashValue;
+	    pC->pKey = pKeys + slot * keySize;
+
+	    const size_t other = pOther->findSlot(pC->hashValue, pC->pKey);
+	    if (other == pOther->capacity)
+	    {
+		pC->count = pSlot[slot].count + otherMinimum;
+		pC->error = pSlot[slot].error + otherMinimum;
+	    }
+	    else
+	    {
+		pC->count = pSlot[slot].count + pOther->pSlot[other].count;
+		pC->error = pSlot[slot].error + pOther->pSlot[other].error;
+	    }
+	}
+	for(size_t other = 0; other < pOther->nUsed; ++other)
+	{
+	    const HeavyHittersSlot *pS = &pOther->pSlot[other];
+	    const unsigned char *pKey = pOther->pKeys + other * keySize;
+	    if (findSlot(pS->hashValue, pKey) != capacity)
+		continue;
+
+	    HeavyHittersCandidate *pC = &pCandidate[n++];
+	    pC->hashValue = pS->hashValue;
+	    pC->pKey = pKey;
+	    pC->count = pS->count + minimum;
+	    pC->error = pS->error + minimum;
+	}
+
+	/*
+	  Keep the candidates with the largest counts.  In ascending order,
+	  they already form a valid heap.
+	*/
+	qsort<HeavyHittersCandidate, unsigned long,
+	    offsetof(HeavyHittersCandidate, count)>(
+		pCandidate, n, compareUnsignedLong);
+	const size_t first = n > capacity ? n - capacity : 0;
+
+	unsigned char *pNewKeys = new unsigned char[capacity * keySize];
+	memset(pIndex, 0, (((size_t)1) << indexBits) * sizeof(size_t));
+	nUsed = 0;
+	for(size_t i = first; i < n; ++i, ++nUsed)
+	{
+	    const HeavyHittersCandidate *pC = &pCandidate[i];
+	    pSlot[nUsed].hashValue = pC->hashValue;
+	    pSlot[nUsed].count = pC->count;
+	    pSlot[nUsed].error = pC->error;
+	    memcpy(pNewKeys + nUsed * keySize, pC->pKey, keySize);
+	    heapSet(nUsed, nUsed);
+	    indexInsert(nUsed);
+	}
+
+	delete[] pCandidate;
+	delete[] pKeys;
+	pKeys = pNewKeys;
+	total += pOther->total;
+	return true;
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,510 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    HyperLogLog.cpp - see ../include/HyperLogLog.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    For a precision p, the top p bits of the hash select one of m = 2^p
+    registers, and the register keeps the largest rank seen, where the rank
+    is one more than the number of leading zeros in the remaining q = 64 - p
+    bits (or q + 1 if they are all zero).
+
+    A sparse entry is a 32-bit value holding a 25-bit index in the top bits,
+    and the rank of the remaining 39 bits in the low 6 bits.  Sorting the
+    entries as integers therefore sorts them by index, with the largest rank
+    for an index last.  When an entry is converted to the dense
+    representation, the extra 25 - p index bits are part of the dense
+    register's rank; if they are all zero, the sparse rank continues the
+    count.
+
+    While sparse, the estimate is linear counting over the 2^25 sparse
+    registers, which is very accurate in the range where the sketch stays
+    sparse.
+ */
+
+#ifndef PHOENIX4CPP_HYPERLOGLOG_H
+#include "HyperLogLog.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARE_H
+#include "compare.h"
+#endif
+
+#ifndef PHOENIX4CPP_QSORT_H
+#include "qsort.h"
+#endif
+
+#ifndef PHOENIX4CPP_CMATH_H
+#include <cmath>
+#define PHOENIX4CPP_CMATH_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const unsigned minPrecision = 4;
+    static const unsigned maxPrecision = 18;
+    static const unsigned sparsePrecision = 25;
+
+    /* the number of sparse entries collected before they are sorted */
+    static const size_t pendingSize = 256;
+
+    /* "P4HL" */
+    static const unsigned char hllMagic[4] = {'P', '4', 'H', 'L'};
+    static const unsigned char hllVersion = 1;
+    static const unsigned char sparseFormat = 0;
+    static const unsigned char denseFormat = 1;
+
+    /* magic, version, precision, format, reserved, and a 32-bit count */
+    static const size_t headerSize = 12;
+
+    static inline unsigned rankOf(unsigned long long bits, unsigned width)
+    {
+	return bits ? __builtin_clzll(bits) + 1 : width + 1;
+    }
+
+    static inline unsigned sparseEntry(unsigned long long h)
+    {
+	const unsigned index = (unsigned)(h >> (64 - sparsePrecision));
+	return (index << 6) |
+	    rankOf(h << sparsePrecision, 64 - sparsePrecision);
+    }
+
+    static inline void decodeSparse(
+	unsigned entry, unsigned precision, size_t *pIndex,
+	unsigned char *pRank)
+    {
+	const unsigned sparseIndex = entry >> 6;
+	const unsigned extra = sparsePrecision - precision;
+	const unsigned extraBits = sparseIndex & ((1U << extra) - 1);
+
+	*pIndex = sparseIndex >> extra;
+	if (extraBits)
+	    *pRank = (unsigned char)(extra - (31 - __builtin_clz(extraBits)));
+	else
+	    *pRank = (unsigned char)(extra + (entry & 0x3f));
+    }
+
+    /*
+      These are the sigma() and tau() functions from Ertl's paper; each is
+      a series that is summed until it stops changing.
+     */
+    static double ertlSigma(double x)
+    {
+	if (x == 1)
+	    return HUGE_VAL;
+
+	double y = 1;
+	double z = x;
+	double zPrevious;
+	do
+	{
+	    x *= x;
+	    zPrevious = z;
+	    z += x * y;
+	    y += y;
+	} while(z != zPrevious);
+
+	return z;
+    }
+
+    static double ertlTau(double x)
+    {
+	if ((x == 0) || (x == 1))
+	    return 0;
+
+	double y = 1;
+	double z = 1 - x;
+	double zPrevious;
+	do
+	{
+	    x = sqrt(x);
+	    zPrevious = z;
+	    y *= 0.5;
+	    z -= (1 - x) * (1 - x) * y;
+	} while(z != zPrevious);
+
+	return z / 3;
+    }
+
+    HyperLogLog::HyperLogLog(unsigned p):
+	precision(p),
+	pRegisters(NULL),
+	pSparse(NULL),
+	nSparse(0),
+	pPending(NULL),
+	nPending(0)
+    {
+	if (precision < minPrecision)
+	    precision = minPrecision;
+	if (precision > maxPrecision)
+	    precision = maxPrecision;
+    }
+
+    HyperLogLog::~HyperLogLog()
+    {
+	clear();
+    }
+
+    void HyperLogLog::clear()
+    {
+	delete[] pRegisters;
+	pRegisters = NULL;
+	delete[] pSparse;
+	pSparse = NULL;
+	nSparse = 0;
+	delete[] pPending;
+	pPending = NULL;
+	nPending = 0;
+    }
+
+    void HyperLogLog::flush() const
+    {
+	if (!nPending)
+	    return;
+
+	qsort<unsigned, unsigned, 0>(pPending, nPending, compareUnsigned);
+
+	/* merge the sorted lists, keeping the largest rank for each index */
+	unsigned *pMerged = new unsigned[nSparse + nPending];
+	size_t n = 0;
+	size_t i = 0;
+	size_t j = 0;
+	while((i < nSparse) || (j < nPending))
+	{
+	    unsigned entry;
+	    if ((j >= nPending) || ((i < nSparse) && (pSparse[i] < pPending[j])))
+		entry = pSparse[i++];
+	    else
+		entry = pPending[j++];
+
+	    if (n && ((pMerged[n - 1] >> 6) == (entry >> 6)))
+		pMerged[n - 1] = entry;
+	    else
+		pMerged[n++] = entry;
+	}
+
+	delete[] pSparse;
+	pSparse = pMerged;
+	nSparse = n;
+	nPending = 0;
+    }
+
+    void HyperLogLog::toDense()
+    {
+	flush();
+
+	const size_t m = ((size_t)1) << precision;
+	unsigned char *pR = new unsigned char[m];
+	memset(pR, 0, m);
+	for(size_t i = 0; i < nSparse; ++i)
+	{
+	    size_t index;
+	    unsigned char rank;
+	    decodeSparse(pSparse[i], precision, &index, &rank);
+	    if (rank > pR[index])
+		pR[index] = rank;
+	}
+
+	clear();
+	pRegisters = pR;
+    }
+
+    void HyperLogLog::addSparse(unsigned entry)
+    {
+	if (!pPending)
+	    pPending = new unsigned[pendingSize];
+
+	pPending[nPending++] = entry;
+	if (nPending < pendingSize)
+	    return;
+
+	/* switch once the sparse list would be bigger than the registers */
+	flush();
+	if (nSparse * sizeof(unsigned) > (((size_t)1) << precision))
+	    toDense();
+    }
+
+    void HyperLogLog::addHash(unsigned long long h)
+    {
+	if (!pRegisters)
+	{
+	    addSparse(sparseEntry(h));
+	    return;
+	}
+
+	const size_t index = (size_t)(h >> (64 - precision));
+	const unsigned char rank =
+	    (unsigned char)rankOf(h << precision, 64 - precision);
+	if (rank > pRegisters[index])
+	    pRegisters[index] = rank;
+    }
+
+    void HyperLogLog::add(const Hashable *pKey)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	addHash(hashValue.get64());
+    }
+
+    double HyperLogLog::estimate() const
+    {
+	if (!pRegisters)
+	{
+	    /* linear counting over the sparse registers */
+	    flush();
+	    const double mSparse = (double)(1UL << sparsePrecision);
+	    return mSparse * log(mSparse / (mSparse - nSparse));
+	}
+
+	const size_t m = ((size_t)1) << precision;
+	const unsigned q = 64 - precision;
+	size_t count[64 + 2];
+	memset(count, 0, sizeof(count));
+	for(size_t i = 0; i < m; ++i)
+	    ++count[pRegisters[i]];
+
+	if (count[0] == m)
+	    return 0;
+
+	double z = m * ertlTau(1 - (double)count[q + 1] / m);
+	for(unsigned k = q; k; --k)
+	    z = 0.5 * (z + count[k]);
+	z += m * ertlSigma((double)count[0] / m);
+
+	/* alpha for m = infinity, 1 / (2 ln 2) */
+	return 0.5 / log(2.0) * m * m / z;
+    }
+
+    void HyperLogLog::mergeSparseEntry(unsigned entry)
+    {
+	if (!pRegisters)
+	{
+	    addSparse(entry);
+	    return;
+	}
+
+	size_t index;
+	unsigned char rank;
+	decodeSparse(entry, precision, &index, &rank);
+	if (rank > pRegisters[index])
+	    pRegisters[index] = rank;
+    }
+
+    bool HyperLogLog::merge(const HyperLogLog *pOther)
+    {
+	if (pOther->precision != precision)
+	    return false;
+	if (pOther == this)
+	    return true;
+
+	if (!pOther->pRegisters)
+	{
+	    for(size_t i = 0; i < pOther->nSparse; ++i)
+		mergeSparseEntry(pOther->pSparse[i]);
+	    for(size_t i = 0; i < pOther->nPending; ++i)
+		mergeSparseEntry(pOther->pPending[i]);
+	    return true;
+	}
+
+	if (!pRegisters)
+	    toDense();
+
+	/* m is at least 16, so this is always a whole number of vectors */
+	const size_t m = ((size_t)1) << precision;
+#ifdef __SSE2__
+	for(size_t i = 0; i < m; i += 16)
+	{
+	    __m128i a = _mm_loadu_si128((const __m128i *)(pRegisters + i));
+	    __m128i b =
+		_mm_loadu_si128((const __m128i *)(pOther->pRegisters + i));
+	    _mm_storeu_si128((__m128i *)(pRegisters + i), _mm_max_epu8(a, b));
+	}
+#else
+	for(size_t i = 0; i < m; ++i)
+	{
+	    if (pOther->pRegisters[i] > pRegisters[i])
+		pRegisters[i] = pOther->pRegisters[i];
+	}
+#endif
+
+	return true;
+    }
+
+    static inline size_t varintSize(unsigned v)
+    {
+	size_t n = 1;
+	for(; v >= 0x80; v >>= 7)
+	    ++n;
+	return n;
+    }
+
+    size_t HyperLogLog::getSerializedSize() const
+    {
+	if (pRegisters)
+	    return headerSize + ((((size_t)1) << precision) * 6) / 8;
+
+	flush();
+	size_t size = headerSize;
+	unsigned previous = 0;
+	for(size_t i = 0; i < nSparse; ++i)
+	{
+	    size += varintSize(pSparse[i] - previous);
+	    previous = pSparse[i];
+	}
+
+	return size;
+    }
+
+    void HyperLogLog::serialize(void *pBuffer) const
+    {
+	flush();
+
+	unsigned char *pB = (unsigned char *)pBuffer;
+	memcpy(pB, hllMagic, sizeof(hllMagic));
+	pB[4] = hllVersion;
+	pB[5] = (unsigned char)precision;
+	pB[6] = pRegisters ? denseFormat : sparseFormat;
+	pB[7] = 0;
+
+	const unsigned count = pRegisters ? 0 : (unsigned)nSparse;
+	for(unsigned i = 0; i < 4; ++i)
+	    pB[8 + i] = (unsigned char)(count >> (i * 8));
+	pB += headerSize;
+
+	if (!pRegisters)
+	{
+	    unsigned previous = 0;
+	    for(size_t i = 0; i < nSparse; ++i)
+	    {
+		unsigned delta = pSparse[i] - previous;
+		previous = pSparse[i];
+		for(; delta >= 0x80; delta >>= 7)
+		    *pB++ = (unsigned char)(delta | 0x80);
+		*pB++ = (unsigned char)delta;
+	    }
+	    return;
+	}
+
+	/* pack four 6-bit registers into each three bytes */
+	const size_t m = ((size_t)1) << precision;
+	for(size_t i = 0; i < m; i += 4, pB += 3)
+	{
+	    const unsigned packed = pRegisters[i] |
+		(pRegisters[i + 1] << 6) | (pRegisters[i + 2] << 12) |
+		(pRegisters[i + 3] << 18);
+	    pB[0] = (unsigned char)packed;
+	    pB[1] = (unsigned char)(packed >> 8);
+	    pB[2] = (unsigned char)(packed >> 16);
+	}
+    }
+
+    bool HyperLogLog::deserialize(const void *pBuffer, size_t length)
+    {
+	clear();
+
+	const unsigned char *pB = (const unsigned char *)pBuffer;
+	if ((length < headerSize) ||
+	    memcmp(pB, hllMagic, sizeof(hllMagic)) ||
+	    (pB[4] != hllVersion) ||
+	    (pB[5] < minPrecision) || (pB[5] > maxPrecision))
+	    return false;
+
+	precision = pB[5];
+	const unsigned char format = pB[6];
+	unsigned count = 0;
+	for(unsigned i = 0; i < 4; ++i)
+	    count |= (unsigned)pB[8 + i] << (i * 8);
+
+	const unsigned char *pEnd = pB + length;
+	pB += headerSize;
+
+	if (format == denseFormat)
+	{
+	    const size_t m = ((size_t)1) << precision;
+	    if ((size_t)(pEnd - pB) < (m * 6) / 8)
+		return false;
+
+	    pRegisters = new unsigned char[m];
+	    for(size_t i = 0; i < m; i += 4, pB += 3)
+	    {
+		const unsigned packed = pB[0] | (pB[1] << 8) | (pB[2] << 16);
+		for(unsigned j = 0; j < 4; ++j)
+		{
+		    pRegisters[i + j] = (unsigned char)((packed >> (j * 6)) & 0x3f);
+		    if (pRegisters[i + j] > 64 - precision + 1)
+		    {
+			clear();
+			return false;
+		    }
+		}
+	    }
+	    return true;
+	}
+
+	if ((format != sparseFormat) ||
+	    (count > (1U << sparsePrecision)) ||
+	    (count > (size_t)(pEnd - pB)))
+	    return false;
+
+	pSparse = new unsigned[count];
+	unsigned previous = 0;
+	for(; nSparse < count; ++nSparse)
+	{
+	    unsigned delta = 0;
+	    for(unsigned shift = 0;; shift += 7)
+	    {
+		if ((pB >= pEnd) || (shift > 28))
+		{
+		    clear();
+		    return false;
+		}
+		delta |= (unsigned)(*pB & 0x7f) << shift;
+		if (!(*pB++ & 0x80))
+		    break;
+	    }
+
+	    /* indexes must be strictly increasing, and ranks in range */
+	    const unsigned entry = previous + delta;
+	    const unsigned rank = entry & 0x3f;
+	    if ((nSparse && ((entry >> 6) <= (previous >> 6))) ||
+		!rank || (rank > 64 - sparsePrecision + 1))
+	    {
+		clear();
+		return false;
+	    }
+
+	    pSparse[nSparse] = entry;
+	    previous = entry;
+	}
+
+	if (nSparse * sizeof(unsigned) > (((size_t)1) << precision))
+	    toDense();
+	return true;
+    }
+
+} // namespace phoenix4cpp
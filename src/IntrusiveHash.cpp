@@ -0,0 +1,244 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    IntrusiveHash.cpp - see ../include/IntrusiveHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Buckets are selected with Fibonacci hashing:  the cached hash value is
+    multiplied by 2^w/phi (for a w-bit unsigned long), and the top bits of the
+    product are used as the bucket index.  That draws on all of the bits of
+    the hash value, rather than just the low ones that a mask would use, so
+    the table doesn't depend on the hash function having well mixed low bits
+    (see benchsrc/benchHashValue.cpp).
+
+    Chains are singly linked to keep the membership small; removal walks the
+    element's chain from its bucket, which is short at the load factors we
+    keep.
+ */
+
+#ifndef PHOENIX4CPP_INTRUSIVEHASH_H
+#include "IntrusiveHash.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const unsigned long fibonacciMultiplier =
+	(sizeof(unsigned long) > 4 ?
+	 (unsigned long)0x9e3779b97f4a7c15ULL : 0x9e3779b9UL);
+
+    static const unsigned bitsPerLong = sizeof(unsigned long) * 8;
+
+    /* the smallest table we'll use, so that the shift is always in range */
+    static const unsigned minBucketBits = 3;
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline size_t IntrusiveHashBase::bucketIndex(unsigned long hashValue) const
+    {
+	return (size_t)((hashValue * fibonacciMultiplier) >> shift);
+    }
+
+    inline IntrusiveHashMembership *IntrusiveHashBase::toMembership(
+	const void *pElement) const
+    {
+	return (IntrusiveHashMembership *)(
+	    ((char *)pElement) + membershipOffset);
+    }
+
+    inline void *IntrusiveHashBase::toElement(
+	const IntrusiveHashMembership *pMembership) const
+    {
+	return (void *)(((char *)pMembership) - membershipOffset);
+    }
+
+    inline void *IntrusiveHashBase::findFrom(
+	const IntrusiveHashMembership *pMembership, unsigned long hashValue,
+	const void *pKey) const
+    {
+	for(; pMembership; pMembership = pMembership->pNext)
+	{
+	    if (pMembership->hashValue != hashValue)
+		continue;
+
+	    void *pElement = toElement(pMembership);
+	    if (!(*cmp)(pKey, ((const char *)pElement) + keyOffset))
+		return pElement;
+	}
+
+	return NULL;
+    }
+
+    inline void *IntrusiveHashBase::firstFrom(size_t bucket) const
+    {
+	for(; bucket < nBuckets; ++bucket)
+	{
+	    if (ppBucket[bucket])
+		return toElement(ppBucket[bucket]);
+	}
+
+	return NULL;
+    }
+
+    IntrusiveHashBase::IntrusiveHashBase(
+	size_t mOffset, size_t kOffset,
+	void (*hashFunction)(HashValue *pHashValue, const void *pKey),
+	int (*cmpFunction)(const void *pl, const void *pr), size_t n):
+	ppBucket(NULL),
+	shift(bitsPerLong),
+	nBuckets(0),
+	count(0),
+	membershipOffset(mOffset),
+	keyOffset(kOffset),
+	hash(hashFunction),
+	cmp(cmpFunction)
+    {
+	resize(n);
+    }
+
+    IntrusiveHashBase::~IntrusiveHashBase()
+    {
+	delete[] ppBucket;
+    }
+
+    void IntrusiveHashBase::resize(size_t n)
+    {
+	/* round up to a power of two */
+	size_t newBuckets = ((size_t)1) << minBucketBits;
+	unsigned newShift = bitsPerLong - minBucketBits;
+	while(newBuckets < n)
+	{
+	    newBuckets <<= 1;
+	    --newShift;
+	}
+
+	if (newBuckets == nBuckets)
+	    return;
+
+	IntrusiveHashMembership **ppOld = ppBucket;
+	const size_t nOld = nBuckets;
+
+	ppBucket = new IntrusiveHashMembership *[newBuckets];
+	for(size_t i = 0; i < newBuckets; ++i)
+	    ppBucket[i] = NULL;
+	nBuckets = newBuckets;
+	shift = newShift;
+
+	/* relink everything using the cached hash values */
+	for(size_t i = 0; i < nOld; ++i)
+	{
+	    IntrusiveHashMembership *pNext;
+	    for(IntrusiveHashMembership *pM = ppOld[i]; pM; pM = pNext)
+	    {
+		pNext = pM->pNext;
+
+		IntrusiveHashMembership **ppHead =
+		    &ppBucket[bucketIndex(pM->hashValue)];
+		pM->pNext = *ppHead;
+		*ppHead = pM;
+	    }
+	}
+
+	delete[] ppOld;
+    }
+
+    void IntrusiveHashBase::add(void *pElement)
+    {
+	HashValue hashValue;
+	(*hash)(&hashValue, ((const char *)pElement) + keyOffset);
+
+	add(pElement, hashValue.get());
+    }
+
+    void IntrusiveHashBase::add(void *pElement, unsigned long hashValue)
+    {
+	if (count >= nBuckets)
+	    resize(nBuckets << 1);
+
+	IntrusiveHashMembership *pM = toMembership(pElement);
+	pM->hashValue = hashValue;
+
+	IntrusiveHashMembership **ppHead =
+	    &ppBucket[bucketIndex(pM->hashValue)];
+	pM->pNext = *ppHead;
+	*ppHead = pM;
+	++count;
+    }
+
+    void IntrusiveHashBase::remove(void *pElement)
+    {
+	IntrusiveHashMembership *pM = toMembership(pElement);
+	if (!pM->isMember())
+	    return;
+
+	for(IntrusiveHashMembership **ppLink =
+		&ppBucket[bucketIndex(pM->hashValue)];
+	    *ppLink; ppLink = &(*ppLink)->pNext)
+	{
+	    if (*ppLink == pM)
+	    {
+		*ppLink = pM->pNext;
+		pM->pNext = pM;
+		--count;
+		return;
+	    }
+	}
+    }
+
+    void *IntrusiveHashBase::find(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return find(hashValue.get(), pKey->getRawPointer());
+    }
+
+    void *IntrusiveHashBase::find(
+	unsigned long hashValue, const void *pKey) const
+    {
+	/* for callers that have already hashed the key for other purposes */
+	return findFrom(ppBucket[bucketIndex(hashValue)], hashValue, pKey);
+    }
+
+    void *IntrusiveHashBase::findNext(
+	const Hashable *pKey, const void *pElement) const
+    {
+	/*
+	  The element matched the key, so its cached hash value is the key's
+	  hash value, and we don't need to compute it again.
+	 */
+	const IntrusiveHashMembership *pM = toMembership(pElement);
+	return findFrom(pM->pNext, pM->hashValue, pKey->getRawPointer());
+    }
+
+    void *IntrusiveHashBase::getFirst() const
+    {
+	return firstFrom(0);
+    }
+
+    void *IntrusiveHashBase::getNext(const void *pElement) const
+    {
+	const IntrusiveHashMembership *pM = toMembership(pElement);
+	if (pM->pNext)
+	    return toElement(pM->pNext);
+
+	return firstFrom(bucketIndex(pM->hashValue) + 1);
+    }
+
+} // namespace phoenix4cpp
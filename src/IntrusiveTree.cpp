@@ -0,0 +1,495 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    IntrusiveTree.cpp - see ../include/IntrusiveTree.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    This is the red-black tree from Cormen, Leiserson, Rivest and Stein,
+    with NULL in place of the sentinel leaf.  Without the sentinel, the
+    removal fixup can't find the parent of an empty subtree through it, so
+    the parent is tracked separately as the fixup goes up the tree.
+
+    Elements with equal keys go to the right of those already there, so an
+    in-order walk sees them in the order they were inserted; rotations
+    don't change the in-order sequence.
+ */
+
+#ifndef PHOENIX4CPP_INTRUSIVETREE_H
+#include "IntrusiveTree.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline bool IntrusiveTreeBase::isRed(const IntrusiveTreeMembership *pM)
+    {
+	return pM && pM->red;
+    }
+
+    inline IntrusiveTreeMembership *IntrusiveTreeBase::leftmost(
+	IntrusiveTreeMembership *pM)
+    {
+	while(pM->pLeft)
+	    pM = pM->pLeft;
+	return pM;
+    }
+
+    inline IntrusiveTreeMembership *IntrusiveTreeBase::rightmost(
+	IntrusiveTreeMembership *pM)
+    {
+	while(pM->pRight)
+	    pM = pM->pRight;
+	return pM;
+    }
+
+    inline IntrusiveTreeMembership *IntrusiveTreeBase::toMembership(
+	const void *pElement) const
+    {
+	return (IntrusiveTreeMembership *)(
+	    ((char *)pElement) + membershipOffset);
+    }
+
+    inline void *IntrusiveTreeBase::toElement(
+	const IntrusiveTreeMembership *pMembership) const
+    {
+	return (void *)(((char *)pMembership) - membershipOffset);
+    }
+
+    inline const void *IntrusiveTreeBase::getKey(
+	const IntrusiveTreeMembership *pMembership) const
+    {
+	return ((const char *)pMembership) - membershipOffset + keyOffset;
+    }
+
+    inline void IntrusiveTreeBase::replaceChild(
+	IntrusiveTreeMembership *pParent, IntrusiveTreeMembership *pOld,
+	IntrusiveTreeMembership *pNew)
+    {
+	if (!pParent)
+	    pRoot = pNew;
+	else if (pParent->pLeft == pOld)
+	    pParent->pLeft = pNew;
+	else
+	    pParent->pRight = pNew;
+    }
+
+    inline void IntrusiveTreeBase::rotateLeft(IntrusiveTreeMembership *pM)
+    {
+	IntrusiveTreeMembership *pR = pM->pRight;
+	pM->pRight = pR->pLeft;
+	if (pR->pLeft)
+	    pR->pLeft->pParent = pM;
+	pR->pParent = pM->pParent;
+	replaceChild(pM->pParent, pM, pR);
+	pR->pLeft = pM;
+	pM->pParent = pR;
+    }
+
+    inline void IntrusiveTreeBase::rotateRight(IntrusiveTreeMembership *pM)
+    {
+	IntrusiveTreeMembership *pL = pM->pLeft;
+	pM->pLeft = pL->pRight;
+	if (pL->pRight)
+	    pL->pRight->pParent = pM;
+	pL->pParent = pM->pParent;
+	replaceChild(pM->pParent, pM, pL);
+	pL->pRight = pM;
+	pM->pParent = pL;
+    }
+
+    inline void IntrusiveTreeBase::insertFixup(IntrusiveTreeMembership *pM)
+    {
+	IntrusiveTreeMembership *pParent;
+	while((pParent = pM->pParent) && pParent->red)
+	{
+	    /* a red parent isn't the root, so there is a grandparent */
+	    IntrusiveTreeMembership *pGrand = pParent->pParent;
+	    if (pParent == pGrand->pLeft)
+	    {
+		IntrusiveTreeMembership *pUncle = pGrand->pRight;
+		if (isRed(pUncle))
+		{
+		    pParent->red = false;
+		    pUncle->red = false;
+		    pGrand->red = true;
+		    pM = pGrand;
+		    continue;
+		}
+
+		if (pM == pParent->pRight)
+		{
+		    rotateLeft(pParent);
+		    pParent = pM;
+		}
+		pParent->red = false;
+		pGrand->red = true;
+		rotateRight(pGrand);
+		break;
+	    }
+	    else
+	    {
+		IntrusiveTreeMembership *pUncle = pGrand->pLeft;
+		if (isRed(pUncle))
+		{
+		    pParent->red = false;
+		    pUncle->red = false;
+		    pGrand->red = true;
+		    pM = pGrand;
+		    continue;
+		}
+
+		if (pM == pParent->pLeft)
+		{
+		    rotateRight(pParent);
+		    pParent = pM;
+		}
+		pParent->red = false;
+		pGrand->red = true;
+		rotateLeft(pGrand);
+		break;
+	    }
+	}
+
+	pRoot->red = false;
+    }
+
+    inline void IntrusiveTreeBase::link(
+	IntrusiveTreeMembership *pM, IntrusiveTreeMembership *pParent,
+	IntrusiveTreeMembership **ppLink)
+    {
+	pM->pParent = pParent;
+	pM->pLeft = NULL;
+	pM->pRight = NULL;
+	pM->red = true;
+	*ppLink = pM;
+	++count;
+
+	insertFixup(pM);
+    }
+
+    /*
+      pM has one less black node on its paths than its sibling's subtree
+      does.  pM may be NULL, which is why its parent is passed in as well.
+    */
+    inline void IntrusiveTreeBase::removeFixup(
+	IntrusiveTreeMembership *pM, IntrusiveTreeMembership *pParent)
+    {
+	while((pM != pRoot) && !isRed(pM))
+	{
+	    /*
+	      The sibling can't be NULL, because its subtree has at least
+	      one black node on every path.  For the same reason, if pM is
+	      NULL, the parent's other child isn't, so this test works.
+	    */
+	    if (pM == pParent->pLeft)
+	    {
+		IntrusiveTreeMembership *pSibling = pParent->pRight;
+		if (pSibling->red)
+		{
+		    pSibling->red = false;
+		    pParent->red = true;
+		    rotateLeft(pParent);
+		    pSibling = pParent->pRight;
+		}
+
+		if (!isRed(pSibling->pLeft) && !isRed(pSibling->pRight))
+		{
+		    pSibling->red = true;
+		    pM = pParent;
+		    pParent = pM->pParent;
+		    continue;
+		}
+
+		if (!isRed(pSibling->pRight))
+		{
+		    pSibling->pLeft->red = false;
+		    pSibling->red = true;
+		    rotateRight(pSibling);
+		    pSibling = pParent->pRight;
+		}
+		pSibling->red = pParent->red;
+		pParent->red = false;
+		pSibling->pRight->red = false;
+		rotateLeft(pParent);
+	    }
+	    else
+	    {
+		IntrusiveTreeMembership *pSibling = pParent->pLeft;
+		if (pSibling->red)
+		{
+		    pSibling->red = false;
+		    pParent->red = true;
+		    rotateRight(pParent);
+		    pSibling = pParent->pLeft;
+		}
+
+		if (!isRed(pSibling->pLeft) && !isRed(pSibling->pRight))
+		{
+		    pSibling->red = true;
+		    pM = pParent;
+		    pParent = pM->pParent;
+		    continue;
+		}
+
+		if (!isRed(pSibling->pLeft))
+		{
+		    pSibling->pRight->red = false;
+		    pSibling->red = true;
+		    rotateLeft(pSibling);
+		    pSibling = pParent->pLeft;
+		}
+		pSibling->red = pParent->red;
+		pParent->red = false;
+		pSibling->pLeft->red = false;
+		rotateRight(pParent);
+	    }
+
+	    pM = pRoot;
+	    break;
+	}
+
+	if (pM)
+	    pM->red = false;
+    }
+
+    IntrusiveTreeBase::IntrusiveTreeBase(
+	size_t mOffset, size_t kOffset,
+	int (*cmpFunction)(const void *pl, const void *pr)):
+	pRoot(NULL),
+	count(0),
+	membershipOffset(mOffset),
+	keyOffset(kOffset),
+	cmp(cmpFunction)
+    {
+    }
+
+    void IntrusiveTreeBase::insert(void *pElement)
+    {
+	const void *pKey = ((const char *)pElement) + keyOffset;
+	IntrusiveTreeMembership *pParent = NULL;
+	IntrusiveTreeMembership **ppLink = &pRoot;
+	while(*ppLink)
+	{
+	    pParent = *ppLink;
+	    if ((*cmp)(pKey, getKey(pParent)) < 0)
+		ppLink = &pParent->pLeft;
+	    else
+		ppLink = &pParent->pRight;
+	}
+
+	link(toMembership(pElement), pParent, ppLink);
+    }
+
+    void *IntrusiveTreeBase::insertUnique(void *pElement)
+    {
+	const void *pKey = ((const char *)pElement) + keyOffset;
+	IntrusiveTreeMembership *pParent = NULL;
+	IntrusiveTreeMembership **ppLink = &pRoot;
+	while(*ppLink)
+	{
+	    pParent = *ppLink;
+	    const int c = (*cmp)(pKey, getKey(pParent));
+	    if (c < 0)
+		ppLink = &pParent->pLeft;
+	    else if (c > 0)
+		ppLink = &pParent->pRight;
+	    else
+		return toElement(pParent);
+	}
+
+	link(toMembership(pElement), pParent, ppLink);
+	return NULL;
+    }
+
+    void IntrusiveTreeBase::remove(void *pElement)
+    {
+	IntrusiveTreeMembership *const pM = toMembership(pElement);
+
+	/*
+	  pChild takes the place of the node that is actually unlinked,
+	  which is pM if it has at most one child, or else its successor,
+	  which then takes pM's place and color.
+	*/
+	IntrusiveTreeMembership *pChild;
+	IntrusiveTreeMembership *pParent;
+	bool removedRed;
+	if (!pM->pLeft || !pM->pRight)
+	{
+	    pChild = (pM->pLeft ? pM->pLeft : pM->pRight);
+	    pParent = pM->pParent;
+	    removedRed = pM->red;
+	    replaceChild(pParent, pM, pChild);
+	    if (pChild)
+		pChild->pParent = pParent;
+	}
+	else
+	{
+	    IntrusiveTreeMembership *pSuccessor = leftmost(pM->pRight);
+	    pChild = pSuccessor->pRight;
+	    removedRed = pSuccessor->red;
+	    if (pSuccessor->pParent == pM)
+		pParent = pSuccessor;
+	    else
+	    {
+		pParent = pSuccessor->pParent;
+		pParent->pLeft = pChild;
+		if (pChild)
+		    pChild->pParent = pParent;
+		pSuccessor->pRight = pM->pRight;
+		pSuccessor->pRight->pParent = pSuccessor;
+	    }
+
+	    replaceChild(pM->pParent, pM, pSuccessor);
+	    pSuccessor->pParent = pM->pParent;
+	    pSuccessor->pLeft = pM->pLeft;
+	    pSuccessor->pLeft->pParent = pSuccessor;
+	    pSuccessor->red = pM->red;
+	}
+
+	--count;
+	pM->pParent = pM;
+	pM->pLeft = NULL;
+	pM->pRight = NULL;
+
+	if (!removedRed)
+	    removeFixup(pChild, pParent);
+    }
+
+    void *IntrusiveTreeBase::find(const void *pKey) const
+    {
+	for(IntrusiveTreeMembership *pM = pRoot; pM;)
+	{
+	    const int c = (*cmp)(pKey, getKey(pM));
+	    if (c < 0)
+		pM = pM->pLeft;
+	    else if (c > 0)
+		pM = pM->pRight;
+	    else
+		return toElement(pM);
+	}
+
+	return NULL;
+    }
+
+    void *IntrusiveTreeBase::lowerBound(const void *pKey) const
+    {
+	IntrusiveTreeMembership *pBound = NULL;
+	for(IntrusiveTreeMembership *pM = pRoot; pM;)
+	{
+	    if ((*cmp)(pKey, getKey(pM)) <= 0)
+	    {
+		pBound = pM;
+		pM = pM->pLeft;
+	    }
+	    else
+		pM = pM->pRight;
+	}
+
+	return (pBound ? toElement(pBound) : NULL);
+    }
+
+    void *IntrusiveTreeBase::upperBound(const void *pKey) const
+    {
+	IntrusiveTreeMembership *pBound = NULL;
+	for(IntrusiveTreeMembership *pM = pRoot; pM;)
+	{
+	    if ((*cmp)(pKey, getKey(pM)) < 0)
+	    {
+		pBound = pM;
+		pM = pM->pLeft;
+	    }
+	    else
+		pM = pM->pRight;
+	}
+
+	return (pBound ? toElement(pBound) : NULL);
+    }
+
+    void *IntrusiveTreeBase::getFirst() const
+    {
+	return (pRoot ? toElement(leftmost(pRoot)) : NULL);
+    }
+
+    void *IntrusiveTreeBase::getLast() const
+    {
+	return (pRoot ? toElement(rightmost(pRoot)) : NULL);
+    }
+
+    void *IntrusiveTreeBase::getNext(const void *pElement) const
+    {
+	IntrusiveTreeMembership *pM = toMembership(pElement);
+	if (pM->pRight)
+	    return toElement(leftmost(pM->pRight));
+
+	while(pM->pParent && (pM == pM->pParent->pRight))
+	    pM = pM->pParent;
+	return (pM->pParent ? toElement(pM->pParent) : NULL);
+    }
+
+    void *IntrusiveTreeBase::getPrevious(const void *pElement) const
+    {
+	IntrusiveTreeMembership *pM = toMembership(pElement);
+	if (pM->pLeft)
+	    return toElement(rightmost(pM->pLeft));
+
+	while(pM->pParent && (pM == pM->pParent->pLeft))
+	    pM = pM->pParent;
+	return (pM->pParent ? toElement(pM->pParent) : NULL);
+    }
+
+    /* returns the black height, or 0 if something is wrong */
+    size_t IntrusiveTreeBase::verifySubtree(
+	const IntrusiveTreeMembership *pM, size_t *pCount) const
+    {
+	if (!pM)
+	    return 1;
+
+	++*pCount;
+	if (pM->red && (isRed(pM->pLeft) || isRed(pM->pRight)))
+	    return 0;
+	if ((pM->pLeft && (pM->pLeft->pParent != pM)) ||
+	    (pM->pRight && (pM->pRight->pParent != pM)))
+	    return 0;
+
+	const size_t left = verifySubtree(pM->pLeft, pCount);
+	const size_t right = verifySubtree(pM->pRight, pCount);
+	if (!left || (left != right))
+	    return 0;
+
+	return left + (pM->red ? 0 : 1);
+    }
+
+    bool IntrusiveTreeBase::verify() const
+    {
+	if (pRoot && (pRoot->red || pRoot->pParent))
+	    return false;
+
+	size_t n = 0;
+	if (!verifySubtree(pRoot, &n) || (n != count))
+	    return false;
+
+	const void *pPrevious = NULL;
+	for(const void *pElement = getFirst(); pElement;
+	    pElement = getNext(pElement))
+	{
+	    const void *pKey = ((const char *)pElement) + keyOffset;
+	    if (pPrevious && ((*cmp)(pPrevious, pKey) > 0))
+		return false;
+	    pPrevious = pKey;
+	}
+
+	return true;
+    }
+
+} // namespace phoenix4cpp
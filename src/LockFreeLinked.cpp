@@ -0,0 +1,172 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    LockFreeLinked.cpp - see ../include/LockFreeLinked.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    MpscQueue follows Vyukov's intrusive MPSC node-based queue.  Producers
+    swap themselves in as the head, and then link the previous head to
+    themselves; the consumer follows the links from the tail.  A stub
+    membership inside the queue keeps the list from ever becoming empty,
+    so that producers never have to touch the consumer's end; whenever the
+    consumer is about to take the last element, it pushes the stub back
+    on behind it.
+
+    Next links are read and written with atomics throughout, because the
+    consumer may be reading a link while a producer writes it, and a
+    LockFreeStack pop() may read the link of an element that another
+    thread is pushing again.  The release store of a link in push() pairs
+    with the acquire load in pop(), which makes the element's contents
+    visible to the consumer.
+
+    The stack's tag is incremented by every successful push and pop, so
+    that a compare and swap can only succeed if nothing has happened in
+    between, even if the same element is back on top.  16 bits of tag
+    wrap after 65536 operations; a pop() could only be fooled if its
+    thread were preempted between its load and its compare and swap for
+    exactly a multiple of that many operations, and found the same element
+    on top afterwards.
+ */
+
+#ifndef PHOENIX4CPP_LOCKFREELINKED_H
+#include "LockFreeLinked.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    MpscQueueBase::MpscQueueBase():
+	pHead(&stub),
+	pTail(&stub)
+    {
+    }
+
+    void MpscQueueBase::push(LockFreeMembership *pM)
+    {
+	__atomic_store_n(&pM->pNext, (LockFreeMembership *)NULL,
+			 __ATOMIC_RELAXED);
+	LockFreeMembership *pPrevious =
+	    __atomic_exchange_n(&pHead, pM, __ATOMIC_ACQ_REL);
+
+	/* until this is done, the consumer can't see past pPrevious */
+	__atomic_store_n(&pPrevious->pNext, pM, __ATOMIC_RELEASE);
+    }
+
+    LockFreeMembership *MpscQueueBase::pop()
+    {
+	LockFreeMembership *pT = pTail;
+	LockFreeMembership *pNext =
+	    __atomic_load_n(&pT->pNext, __ATOMIC_ACQUIRE);
+
+	/* skip over the stub */
+	if (pT == &stub)
+	{
+	    if (!pNext)
+		return NULL;
+	    pTail = pNext;
+	    pT = pNext;
+	    pNext = __atomic_load_n(&pT->pNext, __ATOMIC_ACQUIRE);
+	}
+
+	if (pNext)
+	{
+	    pTail = pNext;
+	    return pT;
+	}
+
+	/*
+	  pT is the last element we can see.  If it isn't the head, a
+	  producer is between its exchange and its link, and we'll have to
+	  wait for it.
+	*/
+	if (pT != __atomic_load_n(&pHead, __ATOMIC_ACQUIRE))
+	    return NULL;
+
+	/* put the stub back behind pT, so that we can take pT */
+	push(&stub);
+	pNext = __atomic_load_n(&pT->pNext, __ATOMIC_ACQUIRE);
+	if (pNext)
+	{
+	    pTail = pNext;
+	    return pT;
+	}
+
+	/* another producer got in before the stub; its link is coming */
+	return NULL;
+    }
+
+    bool MpscQueueBase::isEmpty() const
+    {
+	return (pTail == &stub) &&
+	    !__atomic_load_n(&stub.pNext, __ATOMIC_ACQUIRE);
+    }
+
+
+    static const unsigned tagShift = 48;
+    static const unsigned long long pointerMask = (1ULL << tagShift) - 1;
+
+    static inline LockFreeMembership *untag(unsigned long long tagged)
+    {
+	return (LockFreeMembership *)(tagged & pointerMask);
+    }
+
+    static inline unsigned long long retag(
+	unsigned long long tagged, LockFreeMembership *pM)
+    {
+	/* the tag is incremented, and any carry falls off the top */
+	return (((tagged >> tagShift) + 1) << tagShift) |
+	    (unsigned long long)pM;
+    }
+
+    LockFreeStackBase::LockFreeStackBase():
+	top(0)
+    {
+    }
+
+    void LockFreeStackBase::push(LockFreeMembership *pM)
+    {
+	unsigned long long old = __atomic_load_n(&top, __ATOMIC_RELAXED);
+	do
+	{
+	    __atomic_store_n(&pM->pNext, untag(old), __ATOMIC_RELAXED);
+	} while(!__atomic_compare_exchange_n(
+		    &top, &old, retag(old, pM), true,
+		    __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+
+    LockFreeMembership *LockFreeStackBase::pop()
+    {
+	unsigned long long old = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+	for(;;)
+	{
+	    LockFreeMembership *pM = untag(old);
+	    if (!pM)
+		return NULL;
+
+	    /*
+	      If another thread pops pM first, this may read a link it has
+	      since changed, but then the tag will have changed as well, and
+	      the compare and swap will fail.
+	    */
+	    LockFreeMembership *pNext =
+		__atomic_load_n(&pM->pNext, __ATOMIC_RELAXED);
+	    if (__atomic_compare_exchange_n(
+		    &top, &old, retag(old, pNext), true,
+		    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+		return pM;
+	}
+    }
+
+    bool LockFreeStackBase::isEmpty() const
+    {
+	return !untag(__atomic_load_n(&top, __ATOMIC_RELAXED));
+    }
+
+} // namespace phoenix4cpp
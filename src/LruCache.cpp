@@ -0,0 +1,471 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    LruCache.cpp - see ../include/LruCache.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    LruCacheBase is an IntrusiveHashBase over the hash membership inside
+    each element's LruCacheMembership, and it keeps the memberships
+    themselves on a DoublyLinkedList for the eviction order.  The list never
+    owns anything:  the cache always empties it before it is destroyed.
+
+    The referenced flag is read and written with relaxed atomics, because
+    ShardedLruCache records CLOCK and SIEVE hits on it while holding its
+    shard's lock shared.  It is only written if it isn't already set, so
+    that hits on a popular element don't keep dirtying its cache line.
+
+    ShardedLruCache selects a shard with the top bits of the key's hash
+    value, and passes the same hash value to the shard's table, so that the
+    key is only hashed once.  IntrusiveHashBase selects buckets from the
+    top bits of a Fibonacci scrambling of the hash value, which don't follow
+    the unscrambled top bits, so the buckets within a shard stay evenly
+    used.
+ */
+
+#ifndef PHOENIX4CPP_LRUCACHE_H
+#include "LruCache.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline LruCacheMembership *LruCacheBase::toMembership(
+	const void *pElement) const
+    {
+	return (LruCacheMembership *)(((char *)pElement) + membershipOffset);
+    }
+
+    inline void *LruCacheBase::toElement(
+	const LruCacheMembership *pMembership) const
+    {
+	return (void *)(((char *)pMembership) - membershipOffset);
+    }
+
+    inline void *LruCacheBase::hit(void *pElement)
+    {
+	if (!pElement)
+	    return NULL;
+
+	LruCacheMembership *pM = toMembership(pElement);
+	if (policy == LRU)
+	{
+	    if (list.getFirst() != pM)
+	    {
+		list.remove(pM);
+		list.prepend(pM);
+	    }
+	}
+	else if (!__atomic_load_n(&pM->referenced, __ATOMIC_RELAXED))
+	    __atomic_store_n(&pM->referenced, 1, __ATOMIC_RELAXED);
+
+	return pElement;
+    }
+
+    inline void LruCacheBase::unlink(LruCacheMembership *pM)
+    {
+	/* move the hand off the element first */
+	if (pM == pHand)
+	{
+	    if (policy == CLOCK)
+	    {
+		pHand = list.getNext(pM);
+		if (!pHand)
+		    pHand = list.getFirst();
+		if (pHand == pM)
+		    pHand = NULL;
+	    }
+	    else
+		pHand = list.getPrevious(pM);
+	}
+
+	list.remove(pM);
+	IntrusiveHashBase::remove(toElement(pM));
+	totalCharge -= pM->charge;
+    }
+
+    void LruCacheBase::evictOne()
+    {
+	LruCacheMembership *pVictim;
+
+	switch(policy)
+	{
+	case LRU:
+	    pVictim = list.getLast();
+	    break;
+
+	case CLOCK:
+	    /* clear referenced flags until we find one that isn't set */
+	    if (!pHand)
+		pHand = list.getFirst();
+	    while(pHand->referenced)
+	    {
+		pHand->referenced = 0;
+		pHand = list.getNext(pHand);
+		if (!pHand)
+		    pHand = list.getFirst();
+	    }
+	    pVictim = pHand;
+	    break;
+
+	case SIEVE:
+	default:
+	    /* the same, but moving from the oldest to the newest */
+	    if (!pHand)
+		pHand = list.getLast();
+	    while(pHand->referenced)
+	    {
+		pHand->referenced = 0;
+		pHand = list.getPrevious(pHand);
+		if (!pHand)
+		    pHand = list.getLast();
+	    }
+	    pVictim = pHand;
+	    break;
+	}
+
+	unlink(pVictim);
+	if (evict)
+	    (*evict)(pContext, toElement(pVictim));
+    }
+
+    void LruCacheBase::evictOver(size_t limit)
+    {
+	while((totalCharge > limit) && !list.isEmpty())
+	    evictOne();
+    }
+
+    LruCacheBase::LruCacheBase(
+	size_t mOffset, size_t kOffset,
+	void (*hashFunction)(HashValue *pHashValue, const void *pKey),
+	int (*cmpFunction)(const void *pl, const void *pr),
+	size_t c, Policy p,
+	void (*evictFunction)(void *pContext, void *pElement),
+	void *pC):
+	IntrusiveHashBase(
+	    mOffset + offsetof(LruCacheMembership, hashMembership), kOffset,
+	    hashFunction, cmpFunction, 16),
+	list(),
+	pHand(NULL),
+	membershipOffset(mOffset),
+	keyOffset(kOffset),
+	hash(hashFunction),
+	capacity(c),
+	totalCharge(0),
+	policy(p),
+	evict(evictFunction),
+	pContext(pC)
+    {
+    }
+
+    LruCacheBase::~LruCacheBase()
+    {
+	/*
+	  The typed destructors have already cleared the cache, but make sure,
+	  because the list's destructor would delete the memberships.
+	*/
+	LruCacheMembership *pM;
+	while((pM = list.getFirst()))
+	    list.remove(pM);
+    }
+
+    void LruCacheBase::setCapacity(size_t c)
+    {
+	capacity = c;
+	evictOver(capacity);
+    }
+
+    void LruCacheBase::clear()
+    {
+	while(!list.isEmpty())
+	    evictOne();
+    }
+
+    void *LruCacheBase::find(const Hashable *pKey)
+    {
+	return hit(IntrusiveHashBase::find(pKey));
+    }
+
+    void *LruCacheBase::find(unsigned long hashValue, const void *pKey)
+    {
+	return hit(IntrusiveHashBase::find(hashValue, pKey));
+    }
+
+    void *LruCacheBase::peek(const Hashable *pKey) const
+    {
+	return IntrusiveHashBase::find(pKey);
+    }
+
+    void LruCacheBase::insert(void *pElement, size_t charge)
+    {
+	HashValue hashValue;
+	(*hash)(&hashValue, ((const char *)pElement) + keyOffset);
+
+	insert(pElement, charge, hashValue.get());
+    }
+
+    void LruCacheBase::insert(
+	void *pElement, size_t charge, unsigned long hashValue)
+    {
+	void *pOld = IntrusiveHashBase::find(
+	    hashValue, ((const char *)pElement) + keyOffset);
+	if (pOld)
+	{
+	    /* re-inserting the same element just updates it */
+	    unlink(toMembership(pOld));
+	    if (evict && (pOld != pElement))
+		(*evict)(pContext, pOld);
+	}
+
+	/* an element too big for the whole cache doesn't displace anything */
+	if (charge > capacity)
+	{
+	    if (evict)
+		(*evict)(pContext, pElement);
+	    return;
+	}
+
+	/*
+	  Make room before linking in the new element, so that it can't be
+	  chosen.  This matters for CLOCK and SIEVE, where an element that
+	  hasn't been hit yet is otherwise as good a victim as any.
+	*/
+	while(!list.isEmpty() && (totalCharge + charge > capacity))
+	    evictOne();
+
+	LruCacheMembership *pM = toMembership(pElement);
+	pM->charge = charge;
+	pM->referenced = 0;
+	IntrusiveHashBase::add(pElement, hashValue);
+
+	switch(policy)
+	{
+	case CLOCK:
+	    /* just behind the hand, so it's the last to be considered */
+	    if (pHand)
+		list.addBefore(pM, pHand);
+	    else
+		list.append(pM);
+	    break;
+
+	case LRU:
+	case SIEVE:
+	default:
+	    list.prepend(pM);
+	    break;
+	}
+	totalCharge += charge;
+    }
+
+    void LruCacheBase::remove(void *pElement)
+    {
+	LruCacheMembership *pM = toMembership(pElement);
+	if (pM->isMember())
+	    unlink(pM);
+    }
+
+    void *LruCacheBase::getFirst() const
+    {
+	LruCacheMembership *pM = list.getFirst();
+	return pM ? toElement(pM) : NULL;
+    }
+
+    void *LruCacheBase::getNext(const void *pElement) const
+    {
+	LruCacheMembership *pM = list.getNext(toMembership(pElement));
+	return pM ? toElement(pM) : NULL;
+    }
+
+
+
+    static const unsigned bitsPerLong = sizeof(unsigned long) * 8;
+
+    struct ShardedLruCacheBase::Shard
+    {
+	Shard(size_t membershipOffset, size_t keyOffset,
+	      void (*hash)(HashValue *pHashValue, const void *pKey),
+	      int (*cmp)(const void *pl, const void *pr),
+	      size_t capacity, LruCacheBase::Policy policy,
+	      void (*evict)(void *pContext, void *pElement), void *pContext);
+	~Shard();
+
+	pthread_rwlock_t lock;
+	LruCacheBase cache;
+
+	/* keep neighbouring shards' locks off each other's cache lines */
+	char pad[64];
+    };
+
+    ShardedLruCacheBase::Shard::Shard(
+	size_t membershipOffset, size_t keyOffset,
+	void (*hash)(HashValue *pHashValue, const void *pKey),
+	int (*cmp)(const void *pl, const void *pr),
+	size_t capacity, LruCacheBase::Policy policy,
+	void (*evict)(void *pContext, void *pElement), void *pContext):
+	cache(membershipOffset, keyOffset, hash, cmp, capacity, policy,
+	      evict, pContext)
+    {
+	pthread_rwlock_init(&lock, NULL);
+    }
+
+    ShardedLruCacheBase::Shard::~Shard()
+    {
+	pthread_rwlock_destroy(&lock);
+    }
+
+    inline ShardedLruCacheBase::Shard *ShardedLruCacheBase::getShard(
+	unsigned long hashValue) const
+    {
+	return ppShard[nShards > 1 ? hashValue >> shardShift : 0];
+    }
+
+    ShardedLruCacheBase::ShardedLruCacheBase(
+	size_t membershipOffset, size_t kOffset,
+	void (*hashFunction)(HashValue *pHashValue, const void *pKey),
+	int (*cmp)(const void *pl, const void *pr),
+	size_t capacity, LruCacheBase::Policy policy,
+	void (*evict)(void *pContext, void *pElement), void *pContext,
+	unsigned n):
+	ppShard(NULL),
+	nShards(1),
+	shardShift(bitsPerLong),
+	keyOffset(kOffset),
+	hash(hashFunction)
+    {
+	while(nShards < n)
+	{
+	    nShards <<= 1;
+	    --shardShift;
+	}
+
+	/* each shard gets an equal share of the capacity, rounded up */
+	const size_t shardCapacity = capacity / nShards +
+	    (capacity % nShards ? 1 : 0);
+
+	ppShard = new Shard *[nShards];
+	for(unsigned i = 0; i < nShards; ++i)
+	{
+	    ppShard[i] = new Shard(membershipOffset, keyOffset, hash, cmp,
+				   shardCapacity, policy, evict, pContext);
+	}
+    }
+
+    ShardedLruCacheBase::~ShardedLruCacheBase()
+    {
+	for(unsigned i = 0; i < nShards; ++i)
+	    delete ppShard[i];
+	delete[] ppShard;
+    }
+
+    size_t ShardedLruCacheBase::getCount() const
+    {
+	size_t count = 0;
+	for(unsigned i = 0; i < nShards; ++i)
+	{
+	    pthread_rwlock_rdlock(&ppShard[i]->lock);
+	    count += ppShard[i]->cache.getCount();
+	    pthread_rwlock_unlock(&ppShard[i]->lock);
+	}
+
+	return count;
+    }
+
+    size_t ShardedLruCacheBase::getCharge() const
+    {
+	size_t charge = 0;
+	for(unsigned i = 0; i < nShards; ++i)
+	{
+	    pthread_rwlock_rdlock(&ppShard[i]->lock);
+	    charge += ppShard[i]->cache.getCharge();
+	    pthread_rwlock_unlock(&ppShard[i]->lock);
+	}
+
+	return charge;
+    }
+
+    void ShardedLruCacheBase::clear()
+    {
+	for(unsigned i = 0; i < nShards; ++i)
+	{
+	    pthread_rwlock_wrlock(&ppShard[i]->lock);
+	    ppShard[i]->cache.clear();
+	    pthread_rwlock_unlock(&ppShard[i]->lock);
+	}
+    }
+
+    bool ShardedLruCacheBase::find(
+	const Hashable *pKey, void (*visit)(void *pContext, void *pElement),
+	void *pContext)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	const unsigned long h = hashValue.get();
+	Shard *pShard = getShard(h);
+
+	/* only LRU hits change the list */
+	if (pShard->cache.policy == LruCacheBase::LRU)
+	    pthread_rwlock_wrlock(&pShard->lock);
+	else
+	    pthread_rwlock_rdlock(&pShard->lock);
+
+	void *pElement = pShard->cache.find(h, pKey->getRawPointer());
+	if (pElement)
+	    (*visit)(pContext, pElement);
+
+	pthread_rwlock_unlock(&pShard->lock);
+	return pElement != NULL;
+    }
+
+    void ShardedLruCacheBase::insert(void *pElement, size_t charge)
+    {
+	HashValue hashValue;
+	(*hash)(&hashValue, ((const char *)pElement) + keyOffset);
+	const unsigned long h = hashValue.get();
+	Shard *pShard = getShard(h);
+
+	pthread_rwlock_wrlock(&pShard->lock);
+	pShard->cache.insert(pElement, charge, h);
+	pthread_rwlock_unlock(&pShard->lock);
+    }
+
+    bool ShardedLruCacheBase::erase(const Hashable *pKey)
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	const unsigned long h = hashValue.get();
+	Shard *pShard = getShard(h);
+	LruCacheBase *pCache = &pShard->cache;
+
+	pthread_rwlock_wrlock(&pShard->lock);
+	void *pElement = pCache->IntrusiveHashBase::find(
+	    h, pKey->getRawPointer());
+	if (pElement)
+	{
+	    pCache->unlink(pCache->toMembership(pElement));
+	    if (pCache->evict)
+		(*pCache->evict)(pCache->pContext, pElement);
+	}
+	pthread_rwlock_unlock(&pShard->lock);
+
+	return pElement != NULL;
+    }
+
+} // namespace phoenix4cpp
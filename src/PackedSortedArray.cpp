@@ -0,0 +1,334 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PackedSortedArray.cpp - see ../include/PackedSortedArray.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Within a block, delta j is the difference between values j and j - 1;
+    delta 0 is always zero, because value 0 is in the skip table.  The
+    last block is padded out with zero deltas, so every block decodes to
+    128 values, and the padding just repeats the last one.
+
+    Deltas are packed in two interleaved lanes, so that SSE2 can unpack
+    them two at a time:  deltas 0, 2, 4, ... are packed one after the
+    other, starting at the low bit of each word, in the even words of the
+    block, and deltas 1, 3, 5, ... in the odd words.  The k-th pair of
+    deltas is then at the same bit position of the same pair of words,
+    and a single 128-bit shift and mask extracts both.  Adding the pair
+    shifted up by one lane gives the two running totals within the pair;
+    the total before the pair is added to both afterwards, so that the
+    unpacking iterations don't wait on each other.
+
+    A block with b-bit deltas takes 64 * b bits in each lane, which is b
+    words, so the whole block is 2 * b words, and the width doesn't need to
+    be stored separately; it is half the distance to the next block's
+    offset.  The skip table, the offsets and the packed words are all in
+    one allocation.
+ */
+
+#ifndef PHOENIX4CPP_PACKEDSORTEDARRAY_H
+#include "PackedSortedArray.h"
+#endif
+
+#ifndef PHOENIX4CPP_BSEARCH_H
+#include "bsearch.h"
+#endif
+
+#ifndef PHOENIX4CPP_COMPARE_H
+#include "compare.h"
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace phoenix4cpp
+{
+    /* the number of deltas in each lane of a block */
+    static const size_t laneValues = PackedSortedArray::blockValues / 2;
+
+    /* unpacking reads one pair of words past the end of the last block */
+    static const size_t paddingWords = 2;
+
+    /*
+      These functions are private; we declare them first so that they can be
+      inlined in this file.
+    */
+
+    /* @returns the number of bits needed for the largest delta in a block */
+    static inline unsigned blockWidth(const unsigned long *pValues, size_t n)
+    {
+	unsigned long bits = 0;
+	for(size_t j = 1; j < n; ++j)
+	    bits |= pValues[j] - pValues[j - 1];
+	return bits ? 64 - __builtin_clzl(bits) : 0;
+    }
+
+    static void packBlock(const unsigned long *pValues, size_t n,
+			  unsigned width, unsigned long *pOut)
+    {
+	/* all of the deltas are zero, and take no space */
+	if (!width)
+	    return;
+
+	for(size_t j = 1; j < n; ++j)
+	{
+	    const unsigned long delta = pValues[j] - pValues[j - 1];
+	    const size_t lane = j & 1;
+	    const size_t bit = (j >> 1) * width;
+	    const size_t word = bit >> 6;
+	    const unsigned shift = bit & 63;
+	    pOut[2 * word + lane] |= delta << shift;
+	    if (shift + width > 64)
+		pOut[2 * (word + 1) + lane] |= delta >> (64 - shift);
+	}
+    }
+
+    static void unpackBlock(const unsigned long *pWords, unsigned width,
+			    unsigned long first, unsigned long *pOut)
+    {
+	if (!width)
+	{
+	    for(size_t j = 0; j < PackedSortedArray::blockValues; ++j)
+		pOut[j] = first;
+	    return;
+	}
+
+#ifdef __SSE2__
+	/*
+	  Unpack each pair of deltas, and add the first to the second, in one
+	  pass; the iterations are independent.  The running total is carried
+	  through the pairs in a second pass.
+	*/
+	const __m128i mask = _mm_set1_epi64x(
+	    width == 64 ? ~0ULL : (1ULL << width) - 1);
+	for(size_t k = 0; k < laneValues; ++k)
+	{
+	    const size_t bit = k * width;
+	    const size_t word = bit >> 6;
+	    const unsigned shift = bit & 63;
+
+	    /*
+	      The high part always comes from the next pair of words; a shift
+	      of 64 gives zero, so this doesn't need a branch.
+	    */
+	    const __m128i low = _mm_srl_epi64(
+		_mm_loadu_si128((const __m128i *)(pWords + 2 * word)),
+		_mm_cvtsi32_si128(shift));
+	    const __m128i high = _mm_sll_epi64(
+		_mm_loadu_si128((const __m128i *)(pWords + 2 * word + 2)),
+		_mm_cvtsi32_si128(64 - shift));
+	    __m128i v = _mm_and_si128(_mm_or_si128(low, high), mask);
+	    v = _mm_add_epi64(v, _mm_slli_si128(v, 8));
+	    _mm_storeu_si128((__m128i *)(pOut + 2 * k), v);
+	}
+
+	unsigned long total = first;
+	for(size_t j = 0; j < PackedSortedArray::blockValues; j += 2)
+	{
+	    pOut[j] += total;
+	    total += pOut[j + 1];
+	    pOut[j + 1] = total;
+	}
+#else
+	const unsigned long mask = width == 64 ? ~0UL : (1UL << width) - 1;
+	unsigned long total = first;
+	for(size_t j = 0; j < PackedSortedArray::blockValues; ++j)
+	{
+	    const size_t lane = j & 1;
+	    const size_t bit = (j >> 1) * width;
+	    const size_t word = bit >> 6;
+	    const unsigned shift = bit & 63;
+	    unsigned long delta = pWords[2 * word + lane] >> shift;
+	    if (shift + width > 64)
+		delta |= pWords[2 * (word + 1) + lane] << (64 - shift);
+	    total += delta & mask;
+	    pOut[j] = total;
+	}
+#endif
+    }
+
+    /* @returns the position of the first value not less than value */
+    static inline size_t searchValues(const unsigned long *pValues, size_t n,
+				      unsigned long value)
+    {
+	size_t low = 0;
+	while(n)
+	{
+	    const size_t half = n / 2;
+	    if (pValues[low + half] < value)
+	    {
+		low += half + 1;
+		n -= half + 1;
+	    }
+	    else
+		n = half;
+	}
+	return low;
+    }
+
+
+    PackedSortedArray::PackedSortedArray(const unsigned long *pValues,
+					 size_t n):
+	count(n),
+	nBlocks((n + blockValues - 1) / blockValues),
+	pFirst(NULL),
+	pOffset(NULL),
+	pWords(NULL)
+    {
+	size_t nWords = 0;
+	for(size_t b = 0; b < nBlocks; ++b)
+	{
+	    const size_t first = b * blockValues;
+	    const size_t nb = n - first < blockValues ? n - first : blockValues;
+	    nWords += 2 * blockWidth(pValues + first, nb);
+	}
+
+	/* size_t and unsigned long are the same size, so this is all aligned */
+	unsigned long *pBuffer =
+	    new unsigned long[2 * nBlocks + 1 + nWords + paddingWords];
+	pFirst = pBuffer;
+	pOffset = (size_t *)(pBuffer + nBlocks);
+	pWords = pBuffer + 2 * nBlocks + 1;
+	for(size_t i = 0; i < nWords + paddingWords; ++i)
+	    pWords[i] = 0;
+
+	size_t offset = 0;
+	for(size_t b = 0; b < nBlocks; ++b)
+	{
+	    const size_t first = b * blockValues;
+	    const size_t nb = n - first < blockValues ? n - first : blockValues;
+	    const unsigned width = blockWidth(pValues + first, nb);
+	    pFirst[b] = pValues[first];
+	    pOffset[b] = offset;
+	    packBlock(pValues + first, nb, width, pWords + offset);
+	    offset += 2 * width;
+	}
+	pOffset[nBlocks] = offset;
+    }
+
+    PackedSortedArray::~PackedSortedArray()
+    {
+	delete[] pFirst;
+    }
+
+    size_t PackedSortedArray::getBytes() const
+    {
+	return sizeof(*this) +
+	    (2 * nBlocks + 1 + pOffset[nBlocks] + paddingWords) *
+	    sizeof(unsigned long);
+    }
+
+    size_t PackedSortedArray::decodeBlock(size_t block,
+					  unsigned long *pOut) const
+    {
+	const size_t offset = pOffset[block];
+	const unsigned width = (unsigned)(pOffset[block + 1] - offset) / 2;
+	unpackBlock(pWords + offset, width, pFirst[block], pOut);
+
+	const size_t first = block * blockValues;
+	return count - first < blockValues ? count - first : blockValues;
+    }
+
+    /*
+      @returns the block that the first value not less than value is in, or
+        would be in if the block were long enough; the search starts at
+        firstBlock
+    */
+    size_t PackedSortedArray::findBlock(size_t firstBlock,
+					unsigned long value) const
+    {
+	const unsigned long *pBlock =
+	    phoenix4cpp::lowerBound<unsigned long, unsigned long, 0>(
+		&value, pFirst + firstBlock, nBlocks - firstBlock,
+		compareUnsignedLong);
+
+	/* the block before the first one that starts at or after value */
+	const size_t block = (size_t)(pBlock - pFirst);
+	return block > firstBlock ? block - 1 : firstBlock;
+    }
+
+    unsigned long PackedSortedArray::get(size_t i) const
+    {
+	unsigned long values[blockValues];
+	decodeBlock(i / blockValues, values);
+	return values[i % blockValues];
+    }
+
+    size_t PackedSortedArray::lowerBound(unsigned long value,
+					 unsigned long *pFound) const
+    {
+	if (!count)
+	    return 0;
+
+	const size_t block = findBlock(0, value);
+	unsigned long values[blockValues];
+	const size_t n = decodeBlock(block, values);
+	const size_t i = searchValues(values, n, value);
+	if (i < n)
+	{
+	    if (pFound)
+		*pFound = values[i];
+	    return block * blockValues + i;
+	}
+
+	/* it's past the end of this block, so it's the start of the next */
+	if (block + 1 < nBlocks)
+	{
+	    if (pFound)
+		*pFound = pFirst[block + 1];
+	    return (block + 1) * blockValues;
+	}
+	return count;
+    }
+
+
+    PackedSortedArrayCursor::PackedSortedArrayCursor(
+	const PackedSortedArray *pA):
+	pArray(pA),
+	nextBlock(0),
+	slot(0),
+	nValues(0)
+    {
+    }
+
+    bool PackedSortedArrayCursor::seek(unsigned long value,
+				       unsigned long *pValue)
+    {
+	if ((slot == nValues) || (values[nValues - 1] < value))
+	{
+	    /* it isn't in the buffer, so skip to the block it's in */
+	    if (nextBlock >= pArray->nBlocks)
+	    {
+		slot = nValues;
+		return false;
+	    }
+	    load(pArray->findBlock(nextBlock, value));
+
+	    /* if it's past the end of that block, it's the next one's first */
+	    if (values[nValues - 1] < value)
+	    {
+		if (nextBlock >= pArray->nBlocks)
+		{
+		    slot = nValues;
+		    return false;
+		}
+		load(nextBlock);
+		*pValue = values[slot++];
+		return true;
+	    }
+	}
+
+	slot += searchValues(values + slot, nValues - slot, value);
+	*pValue = values[slot++];
+	return true;
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,212 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PairingHeap.cpp - see ../include/PairingHeap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    This is the two-pass pairing heap of Fredman, Sedgewick, Sleator and
+    Tarjan.  When the top is removed, its children are melded in pairs from
+    left to right, and then the pairs are melded into one tree from right
+    to left.  Both passes are iterative, so a long list of children (which
+    is what a run of pushes builds) can't overflow the stack.  The first
+    pass stacks up the pairs through their next links, which leaves them in
+    the right order for the second pass.
+ */
+
+#ifndef PHOENIX4CPP_PAIRINGHEAP_H
+#include "PairingHeap.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline PairingHeapMembership *PairingHeapBase::toMembership(
+	const void *pElement) const
+    {
+	return (PairingHeapMembership *)(
+	    ((char *)pElement) + membershipOffset);
+    }
+
+    inline void *PairingHeapBase::toElement(
+	const PairingHeapMembership *pMembership) const
+    {
+	return (void *)(((char *)pMembership) - membershipOffset);
+    }
+
+    inline bool PairingHeapBase::isLess(
+	const PairingHeapMembership *pl, const PairingHeapMembership *pr) const
+    {
+	return (*cmp)(((const char *)toElement(pl)) + keyOffset,
+		      ((const char *)toElement(pr)) + keyOffset) < 0;
+    }
+
+    /*
+      Make the root with the larger key the first child of the other.  The
+      root that is returned has stale sibling links, which the caller must
+      take care of.
+    */
+    inline PairingHeapMembership *PairingHeapBase::meld(
+	PairingHeapMembership *pA, PairingHeapMembership *pB) const
+    {
+	if (isLess(pB, pA))
+	{
+	    PairingHeapMembership *const pT = pA;
+	    pA = pB;
+	    pB = pT;
+	}
+
+	pB->pNext = pA->pChild;
+	if (pA->pChild)
+	    pA->pChild->pPrevious = pB;
+	pB->pPrevious = pA;
+	pA->pChild = pB;
+	return pA;
+    }
+
+    inline PairingHeapMembership *PairingHeapBase::mergePairs(
+	PairingHeapMembership *pFirst) const
+    {
+	if (!pFirst)
+	    return NULL;
+
+	/* meld pairs, left to right, stacking the results */
+	PairingHeapMembership *pStack = NULL;
+	while(pFirst)
+	{
+	    PairingHeapMembership *pA = pFirst;
+	    PairingHeapMembership *pB = pA->pNext;
+	    if (!pB)
+	    {
+		pA->pNext = pStack;
+		pStack = pA;
+		break;
+	    }
+
+	    pFirst = pB->pNext;
+	    PairingHeapMembership *pPair = meld(pA, pB);
+	    pPair->pNext = pStack;
+	    pStack = pPair;
+	}
+
+	/* meld the pairs into one, right to left */
+	PairingHeapMembership *pResult = pStack;
+	pStack = pStack->pNext;
+	while(pStack)
+	{
+	    PairingHeapMembership *pNext = pStack->pNext;
+	    pResult = meld(pResult, pStack);
+	    pStack = pNext;
+	}
+
+	pResult->pNext = NULL;
+	pResult->pPrevious = NULL;
+	return pResult;
+    }
+
+    /* unlink a subtree that isn't the whole heap from its parent */
+    inline void PairingHeapBase::detach(PairingHeapMembership *pM)
+    {
+	if (pM->pPrevious->pChild == pM)
+	    pM->pPrevious->pChild = pM->pNext;
+	else
+	    pM->pPrevious->pNext = pM->pNext;
+	if (pM->pNext)
+	    pM->pNext->pPrevious = pM->pPrevious;
+	pM->pNext = NULL;
+	pM->pPrevious = NULL;
+    }
+
+    PairingHeapBase::PairingHeapBase(
+	size_t mOffset, size_t kOffset,
+	int (*cmpFunction)(const void *pl, const void *pr)):
+	pTop(NULL),
+	count(0),
+	membershipOffset(mOffset),
+	keyOffset(kOffset),
+	cmp(cmpFunction)
+    {
+    }
+
+    void PairingHeapBase::push(void *pElement)
+    {
+	PairingHeapMembership *const pM = toMembership(pElement);
+	pM->pChild = NULL;
+	pM->pNext = NULL;
+	pM->pPrevious = NULL;
+	++count;
+
+	if (pTop)
+	{
+	    pTop = meld(pTop, pM);
+	    pTop->pPrevious = NULL;
+	}
+	else
+	    pTop = pM;
+    }
+
+    void *PairingHeapBase::getTop() const
+    {
+	return (pTop ? toElement(pTop) : NULL);
+    }
+
+    void *PairingHeapBase::pop()
+    {
+	if (!pTop)
+	    return NULL;
+
+	PairingHeapMembership *const pM = pTop;
+	pTop = mergePairs(pM->pChild);
+	--count;
+
+	pM->pChild = NULL;
+	pM->pPrevious = pM;
+	return toElement(pM);
+    }
+
+    void PairingHeapBase::decreaseKey(void *pElement)
+    {
+	PairingHeapMembership *const pM = toMembership(pElement);
+	if (pM == pTop)
+	    return;
+
+	/* the subtree under pM is still in order; only its root moved */
+	detach(pM);
+	pTop = meld(pTop, pM);
+	pTop->pNext = NULL;
+	pTop->pPrevious = NULL;
+    }
+
+    void PairingHeapBase::remove(void *pElement)
+    {
+	PairingHeapMembership *const pM = toMembership(pElement);
+	if (pM == pTop)
+	{
+	    pop();
+	    return;
+	}
+
+	detach(pM);
+	PairingHeapMembership *const pChildren = mergePairs(pM->pChild);
+	if (pChildren)
+	{
+	    pTop = meld(pTop, pChildren);
+	    pTop->pPrevious = NULL;
+	}
+	--count;
+
+	pM->pChild = NULL;
+	pM->pPrevious = pM;
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,467 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    PerfectHash.cpp - see ../include/PerfectHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The buffer is laid out as follows, with every section a multiple of 64
+    bytes long:
+      the header
+      the starting bit number of each level, and of the end of the last
+        level, as 64-bit values, padded with zeros
+      the bits for all of the levels, as 64-bit words
+      the number of set bits before each 512-bit block of the above
+
+    Each level is rounded up to a whole number of 512-bit blocks.  A key's
+    rank is the block's count, plus the population counts of at most eight
+    words in the same cache line.
+
+    A key's position in a level is its seeded hash scaled to the size of
+    the level by multiplying and keeping the high half, so that level sizes
+    needn't be powers of two.
+
+    While building a level, each thread takes a contiguous part of the
+    remaining keys.  Bits are set with atomic or, and a key that finds its
+    bit already set marks a second collision array.  Once all keys are in,
+    the colliding bits are cleared from the level, and each thread
+    compacts the keys in its part that collided, to go on to the next
+    level.
+ */
+
+#ifndef PHOENIX4CPP_PERFECTHASH_H
+#include "PerfectHash.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHABLE_H
+#include "Hashable.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const size_t lineBytes = 64;
+    static const size_t lineWords = lineBytes / sizeof(unsigned long long);
+    static const size_t blockBits = lineWords * 64;
+
+    /* far more than is ever needed, unless hashes are duplicated */
+    static const unsigned maxLevels = 64;
+
+    /* don't bother with threads for levels smaller than this */
+    static const size_t minKeysPerThread = 1 << 16;
+
+    struct PerfectHashHeader
+    {
+	unsigned magic;
+	unsigned version;
+	unsigned nLevels;
+	unsigned reserved;
+	unsigned long long nKeys;
+	unsigned long long nWords;
+
+	char pad[lineBytes - 4 * sizeof(unsigned) -
+		 2 * sizeof(unsigned long long)];
+    };
+
+    static const unsigned perfectHashMagic = 0x50345048;  /* "P4PH" */
+    static const unsigned perfectHashVersion = 1;
+
+    static inline size_t roundUp(size_t n, size_t multiple)
+    {
+	return (n + multiple - 1) / multiple * multiple;
+    }
+
+    static inline size_t levelStartWords(unsigned nLevels)
+    {
+	return roundUp(nLevels + 1, lineWords);
+    }
+
+    static inline size_t bufferSize(unsigned nLevels, size_t nWords)
+    {
+	return sizeof(PerfectHashHeader) + sizeof(unsigned long long) *
+	    (levelStartWords(nLevels) + nWords + nWords / lineWords);
+    }
+
+    static inline unsigned long long levelHash(
+	unsigned long long h, unsigned level)
+    {
+	h ^= (level + 1) * 0x9e3779b97f4a7c15ULL;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+    }
+
+    /* scale a hash to [0, n) */
+    static inline unsigned long long reduce(
+	unsigned long long h, unsigned long long n)
+    {
+#ifdef __SIZEOF_INT128__
+	return (unsigned long long)(((unsigned __int128)h * n) >> 64);
+#else
+	return h % n;
+#endif
+    }
+
+    /*
+      The state of a level that is being built, shared by the threads
+      building it.
+    */
+    struct PerfectHashLevel
+    {
+	unsigned long long *pKeys;
+	unsigned long long *pBits;
+	unsigned long long *pCollisions;
+	unsigned long long nBits;
+	unsigned level;
+    };
+
+    struct PerfectHashWorker
+    {
+	PerfectHashLevel *pLevel;
+	size_t begin;
+	size_t end;
+	size_t nKept;
+	pthread_t thread;
+    };
+
+    static void *insertKeys(void *pArg)
+    {
+	PerfectHashWorker *pWorker = (PerfectHashWorker *)pArg;
+	PerfectHashLevel *pLevel = pWorker->pLevel;
+
+	for(size_t i = pWorker->begin; i < pWorker->end; ++i)
+	{
+	    const unsigned long long bit = reduce(
+		levelHash(pLevel->pKeys[i], pLevel->level), pLevel->nBits);
+	    const unsigned long long mask = 1ULL << (bit & 63);
+	    const unsigned long long old = __atomic_fetch_or(
+		&pLevel->pBits[bit >> 6], mask, __ATOMIC_RELAXED);
+	    if (old & mask)
+		__atomic_fetch_or(&pLevel->pCollisions[bit >> 6], mask,
+				  __ATOMIC_RELAXED);
+	}
+
+	return NULL;
+    }
+
+    static void *keepCollisions(void *pArg)
+    {
+	PerfectHashWorker *pWorker = (PerfectHashWorker *)pArg;
+	PerfectHashLevel *pLevel = pWorker->pLevel;
+	unsigned long long *pKeys = pLevel->pKeys;
+
+	size_t nKept = pWorker->begin;
+	for(size_t i = pWorker->begin; i < pWorker->end; ++i)
+	{
+	    const unsigned long long bit = reduce(
+		levelHash(pKeys[i], pLevel->level), pLevel->nBits);
+	    if (pLevel->pCollisions[bit >> 6] & (1ULL << (bit & 63)))
+		pKeys[nKept++] = pKeys[i];
+	}
+
+	pWorker->nKept = nKept - pWorker->begin;
+	return NULL;
+    }
+
+    static void runWorkers(
+	PerfectHashWorker *pWorker, unsigned nWorkers, void *(*pRun)(void *))
+    {
+	if (nWorkers == 1)
+	{
+	    (*pRun)(pWorker);
+	    return;
+	}
+
+	for(unsigned i = 0; i < nWorkers; ++i)
+	    pthread_create(&pWorker[i].thread, NULL, pRun, &pWorker[i]);
+	for(unsigned i = 0; i < nWorkers; ++i)
+	    pthread_join(pWorker[i].thread, NULL);
+    }
+
+    PerfectHash::PerfectHash():
+	pHeader(NULL),
+	owned(false),
+	pLevelStart(NULL),
+	pBits(NULL),
+	pRank(NULL),
+	nLevels(0),
+	nKeys(0)
+    {
+    }
+
+    PerfectHash::~PerfectHash()
+    {
+	release();
+    }
+
+    void PerfectHash::release()
+    {
+	if (owned)
+	    free((void *)pHeader);
+
+	pHeader = NULL;
+	owned = false;
+	pLevelStart = NULL;
+	pBits = NULL;
+	pRank = NULL;
+	nLevels = 0;
+	nKeys = 0;
+    }
+
+    void PerfectHash::setBuffer(const PerfectHashHeader *pH)
+    {
+	pHeader = pH;
+	nLevels = pH->nLevels;
+	nKeys = (size_t)pH->nKeys;
+	pLevelStart = (const unsigned long long *)(pH + 1);
+	pBits = pLevelStart + levelStartWords(nLevels);
+	pRank = pBits + pH->nWords;
+    }
+
+    bool PerfectHash::build(
+	const Hashable *const *ppKeys, size_t n, unsigned nThreads)
+    {
+	unsigned long long *pHashValues = new unsigned long long[n];
+	for(size_t i = 0; i < n; ++i)
+	{
+	    HashValue hashValue;
+	    ppKeys[i]->hash(&hashValue);
+	    pHashValues[i] = hashValue.get64();
+	}
+
+	const bool built = buildHashes(pHashValues, n, nThreads);
+	delete[] pHashValues;
+	return built;
+    }
+
+    bool PerfectHash::buildHashes(
+	const unsigned long long *pHashValues, size_t n, unsigned nThreads)
+    {
+	release();
+
+	if (nThreads < 1)
+	    nThreads = 1;
+
+	PerfectHashLevel level;
+	level.pKeys = new unsigned long long[n];
+	memcpy(level.pKeys, pHashValues, n * sizeof(unsigned long long));
+
+	unsigned long long levelStart[maxLevels + 1];
+	levelStart[0] = 0;
+
+	/* the levels' bits, which grow as levels are added */
+	size_t capacity = roundUp(n + n / 2 + 1, blockBits) / 64;
+	unsigned long long *pAllBits = new unsigned long long[capacity];
+	size_t nWords = 0;
+
+	PerfectHashWorker *pWorker = new PerfectHashWorker[nThreads];
+	unsigned nLevel = 0;
+	size_t nRemaining = n;
+	for(; nRemaining && (nLevel < maxLevels); ++nLevel)
+	{
+	    level.level = nLevel;
+	    level.nBits = roundUp(nRemaining, blockBits);
+	    const size_t levelWords = (size_t)level.nBits / 64;
+
+	    if (nWords + levelWords > capacity)
+	    {
+		capacity = (nWords + levelWords) * 2;
+		unsigned long long *pGrown = new unsigned long long[capacity];
+		memcpy(pGrown, pAllBits, nWords * sizeof(unsigned long long));
+		delete[] pAllBits;
+		pAllBits = pGrown;
+	    }
+
+	    level.pBits = pAllBits + nWords;
+	    memset(level.pBits, 0, levelWords * sizeof(unsigned long long));
+	    level.pCollisions = new unsigned long long[levelWords];
+	    memset(level.pCollisions, 0,
+		   levelWords * sizeof(unsigned long long));
+
+	    unsigned nWorkers = nThreads;
+	    if (nRemaining / nWorkers < minKeysPerThread)
+		nWorkers = (unsigned)(nRemaining / minKeysPerThread) + 1;
+	    if (nWorkers > nThreads)
+		nWorkers = nThreads;
+	    for(unsigned i = 0; i < nWorkers; ++i)
+	    {
+		pWorker[i].pLevel = &level;
+		pWorker[i].begin = nRemaining * i / nWorkers;
+		pWorker[i].end = nRemaining * (i + 1) / nWorkers;
+	    }
+
+	    runWorkers(pWorker, nWorkers, insertKeys);
+	    for(size_t i = 0; i < levelWords; ++i)
+		level.pBits[i] &= ~level.pCollisions[i];
+	    runWorkers(pWorker, nWorkers, keepCollisions);
+
+	    /* gather up the keys that go on to the next level */
+	    size_t nKept = 0;
+	    for(unsigned i = 0; i < nWorkers; ++i)
+	    {
+		memmove(level.pKeys + nKept, level.pKeys + pWorker[i].begin,
+			pWorker[i].nKept * sizeof(unsigned long long));
+		nKept += pWorker[i].nKept;
+	    }
+
+	    delete[] level.pCollisions;
+	    nRemaining = nKept;
+	    nWords += levelWords;
+	    levelStart[nLevel + 1] = nWords * 64;
+	}
+
+	delete[] pWorker;
+	delete[] level.pKeys;
+
+	if (nRemaining)
+	{
+	    delete[] pAllBits;
+	    return false;
+	}
+
+	/* assemble the buffer */
+	void *pBuffer;
+	if (posix_memalign(&pBuffer, lineBytes, bufferSize(nLevel, nWords)))
+	{
+	    delete[] pAllBits;
+	    throw std::bad_alloc();
+	}
+
+	PerfectHashHeader *pH = (PerfectHashHeader *)pBuffer;
+	memset(pH, 0, sizeof(PerfectHashHeader));
+	pH->magic = perfectHashMagic;
+	pH->version = perfectHashVersion;
+	pH->nLevels = nLevel;
+	pH->nKeys = n;
+	pH->nWords = nWords;
+
+	unsigned long long *pStart = (unsigned long long *)(pH + 1);
+	memset(pStart, 0,
+	       levelStartWords(nLevel) * sizeof(unsigned long long));
+	memcpy(pStart, levelStart,
+	       (nLevel + 1) * sizeof(unsigned long long));
+
+	unsigned long long *pB = pStart + levelStartWords(nLevel);
+	memcpy(pB, pAllBits, nWords * sizeof(unsigned long long));
+	delete[] pAllBits;
+
+	unsigned long long *pR = pB + nWords;
+	unsigned long long count = 0;
+	for(size_t i = 0; i < nWords; ++i)
+	{
+	    if (!(i % lineWords))
+		pR[i / lineWords] = count;
+	    count += __builtin_popcountll(pB[i]);
+	}
+
+	setBuffer(pH);
+	owned = true;
+	return true;
+    }
+
+    size_t PerfectHash::lookupHash(unsigned long long h) const
+    {
+	for(unsigned i = 0; i < nLevels; ++i)
+	{
+	    const unsigned long long start = pLevelStart[i];
+	    const unsigned long long bit = start +
+		reduce(levelHash(h, i), pLevelStart[i + 1] - start);
+	    const size_t word = (size_t)(bit >> 6);
+	    const unsigned long long mask = 1ULL << (bit & 63);
+	    if (!(pBits[word] & mask))
+		continue;
+
+	    /* count the set bits before this one */
+	    size_t rank = (size_t)pRank[word / lineWords];
+	    for(size_t w = word & ~(lineWords - 1); w < word; ++w)
+		rank += __builtin_popcountll(pBits[w]);
+	    return rank + __builtin_popcountll(pBits[word] & (mask - 1));
+	}
+
+	return notFound;
+    }
+
+    size_t PerfectHash::lookup(const Hashable *pKey) const
+    {
+	HashValue hashValue;
+	pKey->hash(&hashValue);
+	return lookupHash(hashValue.get64());
+    }
+
+    size_t PerfectHash::getSerializedSize() const
+    {
+	if (!pHeader)
+	    return 0;
+
+	return bufferSize(nLevels, (size_t)pHeader->nWords);
+    }
+
+    void PerfectHash::serialize(void *pBuffer) const
+    {
+	memcpy(pBuffer, pHeader, getSerializedSize());
+    }
+
+    bool PerfectHash::attach(const void *pBuffer, size_t length)
+    {
+	release();
+
+	if (length < sizeof(PerfectHashHeader))
+	    return false;
+
+	const PerfectHashHeader *pH = (const PerfectHashHeader *)pBuffer;
+	if ((pH->magic != perfectHashMagic) ||
+	    (pH->version != perfectHashVersion) ||
+	    (pH->nLevels > maxLevels) ||
+	    (pH->nWords % lineWords) ||
+	    (pH->nWords > length / sizeof(unsigned long long)) ||
+	    (bufferSize(pH->nLevels, (size_t)pH->nWords) > length))
+	    return false;
+
+	/* the levels must cover the bits exactly, with none empty */
+	const unsigned long long *pStart = (const unsigned long long *)(pH + 1);
+	if (pStart[0] || (pStart[pH->nLevels] != pH->nWords * 64))
+	    return false;
+	for(unsigned i = 0; i < pH->nLevels; ++i)
+	{
+	    if (pStart[i + 1] <= pStart[i])
+		return false;
+	}
+
+	setBuffer(pH);
+	return true;
+    }
+
+} // namespace phoenix4cpp
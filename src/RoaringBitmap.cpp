@@ -0,0 +1,1414 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    RoaringBitmap.cpp - see ../include/RoaringBitmap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The containers are kept in an array ordered by key (the high 16 bits of
+    their values).  A container's cardinality decides between an array and
+    a bitmap:  arrays hold at most maxArray values, and bitmaps more.  Run
+    containers can have any cardinality.  Containers are never empty.
+
+    A run is stored as two unsigned shorts, the first value and the length
+    less one, so that a run of all 65536 values fits.
+
+    Binary operations consume the left container, so that a bitmap that is
+    the left operand can be updated in place rather than copied.  Where
+    both containers are small, their values are merged; where the result
+    must be a subset of a small container, its values are tested against
+    the other as a bitmap; otherwise the result is built as a bitmap, and
+    made into an array if it turns out to be small enough.  Run containers
+    are expanded into temporary arrays or bitmaps in the thread's arena.
+
+    The serialized form is a 16 byte header (magic, version, number of
+    containers, and a reserved word), then a 16 byte directory entry for
+    each container (key, type, a reserved byte, the number of values, runs
+    or words, the cardinality, and the offset of the contents), then the
+    contents of the containers, each starting on an 8 byte boundary.  All
+    fields are little-endian.  An attached bitmap's containers point
+    straight into the buffer, and have no capacity, which marks them as
+    not owned.
+ */
+
+#ifndef PHOENIX4CPP_ROARINGBITMAP_H
+#include "RoaringBitmap.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    struct RoaringContainer
+    {
+	void *pData;
+	unsigned cardinality; /* number of values; never zero */
+	unsigned n; /* values in an array, runs, or words in a bitmap */
+	unsigned capacity; /* allocated units of n; zero if not owned */
+	unsigned short key;
+	unsigned char type;
+    };
+
+    static const unsigned maxArray = 4096;
+    static const unsigned bitmapWords = 1024;
+    static const unsigned bitmapBytes =
+	bitmapWords * sizeof(unsigned long long);
+
+    /* container types; these values are also used when serialized */
+    static const unsigned char arrayType = 1;
+    static const unsigned char bitmapType = 2;
+    static const unsigned char runType = 3;
+
+    static const unsigned opAnd = 1;
+    static const unsigned opOr = 2;
+    static const unsigned opXor = 3;
+    static const unsigned opAndNot = 4;
+
+    static const unsigned roaringMagic = 0x50345242; /* "P4RB" */
+    static const unsigned roaringVersion = 1;
+    static const size_t headerBytes = 16;
+    static const size_t entryBytes = 16;
+
+    /*
+      These functions are private; we declare them first so that they can
+      be inlined in this file.
+    */
+
+    static void *allocate(size_t size)
+    {
+	void *p = malloc(size);
+	if (!p)
+	    throw std::bad_alloc();
+	return p;
+    }
+
+    static inline unsigned short *getValues(const RoaringContainer *p)
+    {
+	return (unsigned short *)p->pData;
+    }
+
+    static inline unsigned long long *getWords(const RoaringContainer *p)
+    {
+	return (unsigned long long *)p->pData;
+    }
+
+    static inline size_t getUnitBytes(unsigned char type)
+    {
+	if (type == bitmapType)
+	    return sizeof(unsigned long long);
+	if (type == runType)
+	    return 2 * sizeof(unsigned short);
+	return sizeof(unsigned short);
+    }
+
+    static inline void freeContainer(RoaringContainer *p)
+    {
+	if (p->capacity)
+	    free(p->pData);
+    }
+
+    static inline bool testBit(const unsigned long long *pWords, unsigned v)
+    {
+	return (pWords[v >> 6] >> (v & 63)) & 1;
+    }
+
+    /* @returns the index of the first value that is not less than v */
+    static inline size_t lowerBound16(const unsigned short *pValues, size_t n,
+				      unsigned v)
+    {
+	size_t low = 0;
+	while(n)
+	{
+	    const size_t half = n / 2;
+	    if (pValues[low + half] < v)
+	    {
+		low += half + 1;
+		n -= half + 1;
+	    }
+	    else
+		n = half;
+	}
+	return low;
+    }
+
+    /* @returns the number of runs that start at or before v */
+    static inline size_t countRunsFrom(const unsigned short *pRuns, size_t n,
+				       unsigned v)
+    {
+	size_t low = 0;
+	while(n)
+	{
+	    const size_t half = n / 2;
+	    if (pRuns[2 * (low + half)] <= v)
+	    {
+		low += half + 1;
+		n -= half + 1;
+	    }
+	    else
+		n = half;
+	}
+	return low;
+    }
+
+    /* set the bits for the values from start to end, inclusive */
+    static void setRange(unsigned long long *pWords, unsigned start,
+			 unsigned end)
+    {
+	const size_t first = start >> 6;
+	const size_t last = end >> 6;
+	const unsigned long long firstMask = ~0ULL << (start & 63);
+	const unsigned long long lastMask = ~0ULL >> (63 - (end & 63));
+	if (first == last)
+	{
+	    pWords[first] |= firstMask & lastMask;
+	    return;
+	}
+
+	pWords[first] |= firstMask;
+	for(size_t i = first + 1; i < last; ++i)
+	    pWords[i] = ~0ULL;
+	pWords[last] |= lastMask;
+    }
+
+    static size_t bitmapToValues(const unsigned long long *pWords,
+				 unsigned short *pValues)
+    {
+	size_t n = 0;
+	for(unsigned i = 0; i < bitmapWords; ++i)
+	{
+	    for(unsigned long long w = pWords[i]; w; w &= w - 1)
+		pValues[n++] = (unsigned short)(i * 64 + __builtin_ctzll(w));
+	}
+	return n;
+    }
+
+    static unsigned countBits(const unsigned long long *pWords)
+    {
+	unsigned count = 0;
+	for(unsigned i = 0; i < bitmapWords; ++i)
+	    count += __builtin_popcountll(pWords[i]);
+	return count;
+    }
+
+    /* @returns the number of runs that would hold the container's values */
+    static size_t countRuns(const RoaringContainer *p)
+    {
+	if (p->type == runType)
+	    return p->n;
+
+	size_t runs = 0;
+	if (p->type == arrayType)
+	{
+	    const unsigned short *pValues = getValues(p);
+	    runs = 1;
+	    for(unsigned i = 1; i < p->n; ++i)
+		runs += pValues[i] != pValues[i - 1] + 1;
+	    return runs;
+	}
+
+	/* count the bits that start runs, carrying the top bit across */
+	const unsigned long long *pWords = getWords(p);
+	unsigned long long carry = 0;
+	for(unsigned i = 0; i < bitmapWords; ++i)
+	{
+	    const unsigned long long w = pWords[i];
+	    runs += __builtin_popcountll(w & ~((w << 1) | carry));
+	    carry = w >> 63;
+	}
+	return runs;
+    }
+
+    /*
+      @returns the container's values, expanding them into pTemp if it
+        isn't an array; pTemp must have room for the cardinality
+    */
+    static const unsigned short *asValues(const RoaringContainer *p,
+					  unsigned short *pTemp)
+    {
+	if (p->type == arrayType)
+	    return getValues(p);
+
+	if (p->type == bitmapType)
+	{
+	    bitmapToValues(getWords(p), pTemp);
+	    return pTemp;
+	}
+
+	const unsigned short *pRuns = getValues(p);
+	unsigned short *pOut = pTemp;
+	for(unsigned r = 0; r < p->n; ++r)
+	{
+	    const unsigned start = pRuns[2 * r];
+	    const unsigned end = start + pRuns[2 * r + 1];
+	    for(unsigned v = start; v <= end; ++v)
+		*pOut++ = (unsigned short)v;
+	}
+	return pTemp;
+    }
+
+    /*
+      @returns the container's words, expanding them into pTemp if it isn't
+        a bitmap
+    */
+    static const unsigned long long *asWords(const RoaringContainer *p,
+					     unsigned long long *pTemp)
+    {
+	if (p->type == bitmapType)
+	    return getWords(p);
+
+	memset(pTemp, 0, bitmapBytes);
+	const unsigned short *pValues = getValues(p);
+	if (p->type == arrayType)
+	{
+	    for(unsigned i = 0; i < p->n; ++i)
+		pTemp[pValues[i] >> 6] |= 1ULL << (pValues[i] & 63);
+	}
+	else
+	{
+	    for(unsigned r = 0; r < p->n; ++r)
+		setRange(pTemp, pValues[2 * r],
+			 pValues[2 * r] + pValues[2 * r + 1]);
+	}
+	return pTemp;
+    }
+
+    /* make an owned container from values, or words, in ascending order */
+    static void makeFromValues(RoaringContainer *p, unsigned short key,
+			       const unsigned short *pValues, unsigned n)
+    {
+	p->key = key;
+	p->cardinality = n;
+	if (n > maxArray)
+	{
+	    unsigned long long *pWords =
+		(unsigned long long *)allocate(bitmapBytes);
+	    memset(pWords, 0, bitmapBytes);
+	    for(unsigned i = 0; i < n; ++i)
+		pWords[pValues[i] >> 6] |= 1ULL << (pValues[i] & 63);
+	    p->pData = pWords;
+	    p->type = bitmapType;
+	    p->n = bitmapWords;
+	    p->capacity = bitmapWords;
+	    return;
+	}
+
+	p->pData = allocate(n * sizeof(unsigned short));
+	memcpy(p->pData, pValues, n * sizeof(unsigned short));
+	p->type = arrayType;
+	p->n = n;
+	p->capacity = n;
+    }
+
+    static void makeFromWords(RoaringContainer *p, unsigned short key,
+			      const unsigned long long *pWords,
+			      unsigned cardinality)
+    {
+	p->key = key;
+	p->cardinality = cardinality;
+	if (cardinality <= maxArray)
+	{
+	    p->pData = allocate(cardinality * sizeof(unsigned short));
+	    bitmapToValues(pWords, getValues(p));
+	    p->type = arrayType;
+	    p->n = cardinality;
+	    p->capacity = cardinality;
+	    return;
+	}
+
+	p->pData = allocate(bitmapBytes);
+	memcpy(p->pData, pWords, bitmapBytes);
+	p->type = bitmapType;
+	p->n = bitmapWords;
+	p->capacity = bitmapWords;
+    }
+
+    /* as asValues() and asWords(), expanding into the arena if need be */
+    static inline const unsigned short *expandValues(const RoaringContainer *p,
+						     Arena *pArena)
+    {
+	if (p->type == arrayType)
+	    return getValues(p);
+	return asValues(p,
+			pArena->allocateArray<unsigned short>(p->cardinality));
+    }
+
+    static inline const unsigned long long *expandWords(
+	const RoaringContainer *p, Arena *pArena)
+    {
+	if (p->type == bitmapType)
+	    return getWords(p);
+	return asWords(p, pArena->allocateArray<unsigned long long>(bitmapWords));
+    }
+
+    /*
+      Make a container from n values allocated with room for bound; the
+      values are taken over, or released.
+
+      @returns true if there were any values
+    */
+    static bool adoptValues(RoaringContainer *p, unsigned short key,
+			    unsigned short *pValues, size_t n, size_t bound)
+    {
+	if (!n || (n > maxArray))
+	{
+	    if (n)
+		makeFromValues(p, key, pValues, (unsigned)n);
+	    free(pValues);
+	    return n != 0;
+	}
+
+	if (n < bound / 2)
+	{
+	    unsigned short *pSmaller = (unsigned short *)realloc(
+		pValues, n * sizeof(unsigned short));
+	    if (pSmaller)
+	    {
+		pValues = pSmaller;
+		bound = n;
+	    }
+	}
+
+	p->pData = pValues;
+	p->cardinality = (unsigned)n;
+	p->n = (unsigned)n;
+	p->capacity = (unsigned)bound;
+	p->key = key;
+	p->type = arrayType;
+	return true;
+    }
+
+    static void copyContainer(const RoaringContainer *pFrom,
+			      RoaringContainer *pTo)
+    {
+	const size_t bytes = pFrom->n * getUnitBytes(pFrom->type);
+	*pTo = *pFrom;
+	pTo->pData = allocate(bytes);
+	memcpy(pTo->pData, pFrom->pData, bytes);
+	pTo->capacity = pFrom->n;
+    }
+
+    /* convert an owned container to an array or a bitmap */
+    static void convert(RoaringContainer *p, unsigned char type)
+    {
+	void *pData;
+	if (type == arrayType)
+	{
+	    pData = allocate(p->cardinality * sizeof(unsigned short));
+	    asValues(p, (unsigned short *)pData);
+	    p->n = p->cardinality;
+	}
+	else
+	{
+	    pData = allocate(bitmapBytes);
+	    asWords(p, (unsigned long long *)pData);
+	    p->n = bitmapWords;
+	}
+	freeContainer(p);
+	p->pData = pData;
+	p->type = type;
+	p->capacity = p->n;
+    }
+
+    static inline void convertToNatural(RoaringContainer *p)
+    {
+	convert(p, p->cardinality <= maxArray ? arrayType : bitmapType);
+    }
+
+    static void convertToRuns(RoaringContainer *p, size_t runs)
+    {
+	Arena *const pArena = Arena::getThreadArena();
+	ArenaScope scope(pArena);
+	const unsigned short *pValues = asValues(
+	    p, pArena->allocateArray<unsigned short>(p->cardinality));
+
+	unsigned short *pRuns =
+	    (unsigned short *)allocate(runs * 2 * sizeof(unsigned short));
+	size_t r = 0;
+	for(unsigned i = 0; i < p->cardinality; ++r)
+	{
+	    unsigned j = i + 1;
+	    while((j < p->cardinality) && (pValues[j] == pValues[j - 1] + 1))
+		++j;
+	    pRuns[2 * r] = pValues[i];
+	    pRuns[2 * r + 1] = (unsigned short)(j - i - 1);
+	    i = j;
+	}
+
+	freeContainer(p);
+	p->pData = pRuns;
+	p->type = runType;
+	p->n = (unsigned)runs;
+	p->capacity = (unsigned)runs;
+    }
+
+    static bool containerContains(const RoaringContainer *p, unsigned low)
+    {
+	if (p->type == bitmapType)
+	    return testBit(getWords(p), low);
+
+	const unsigned short *pValues = getValues(p);
+	if (p->type == arrayType)
+	{
+	    const size_t i = lowerBound16(pValues, p->n, low);
+	    return (i < p->n) && (pValues[i] == low);
+	}
+
+	const size_t r = countRunsFrom(pValues, p->n, low);
+	return r && (low <= (unsigned)pValues[2 * r - 2] + pValues[2 * r - 1]);
+    }
+
+    /* @returns the number of the container's values not greater than low */
+    static size_t containerRank(const RoaringContainer *p, unsigned low)
+    {
+	if (p->type == bitmapType)
+	{
+	    const unsigned long long *pWords = getWords(p);
+	    const unsigned last = low >> 6;
+	    size_t count = 0;
+	    for(unsigned i = 0; i < last; ++i)
+		count += __builtin_popcountll(pWords[i]);
+	    return count + __builtin_popcountll(
+		pWords[last] & (~0ULL >> (63 - (low & 63))));
+	}
+
+	const unsigned short *pValues = getValues(p);
+	if (p->type == arrayType)
+	    return lowerBound16(pValues, p->n, low + 1);
+
+	const size_t r = countRunsFrom(pValues, p->n, low);
+	size_t count = 0;
+	for(size_t i = 0; i + 1 < r; ++i)
+	    count += pValues[2 * i + 1] + 1;
+	if (r)
+	{
+	    const unsigned length = pValues[2 * r - 1] + 1;
+	    const unsigned upTo = low - pValues[2 * r - 2] + 1;
+	    count += upTo < length ? upTo : length;
+	}
+	return count;
+    }
+
+    /* @returns the i-th of the container's values; i < cardinality */
+    static unsigned containerSelect(const RoaringContainer *p, size_t i)
+    {
+	if (p->type == arrayType)
+	    return getValues(p)[i];
+
+	if (p->type == bitmapType)
+	{
+	    const unsigned long long *pWords = getWords(p);
+	    for(unsigned j = 0; j < bitmapWords; ++j)
+	    {
+		unsigned long long w = pWords[j];
+		const size_t count = __builtin_popcountll(w);
+		if (i < count)
+		{
+		    for(; i; --i)
+			w &= w - 1;
+		    return j * 64 + __builtin_ctzll(w);
+		}
+		i -= count;
+	    }
+	    return 0;
+	}
+
+	const unsigned short *pRuns = getValues(p);
+	for(unsigned r = 0; r < p->n; ++r)
+	{
+	    const size_t length = pRuns[2 * r + 1] + 1;
+	    if (i < length)
+		return pRuns[2 * r] + (unsigned)i;
+	    i -= length;
+	}
+	return 0;
+    }
+
+    /*
+      Merge two arrays of values.  Arrays are short, so the merge is
+      written without branches that depend on the values, which would be
+      mispredicted about half of the time.
+
+      @returns the number of values written to pOut, which must have room
+        for all of the values in the result; for intersection and
+        difference, it may be the same as pA
+    */
+    template<unsigned op>
+    static size_t mergeValues(const unsigned short *pA, size_t nA,
+			      const unsigned short *pB, size_t nB,
+			      unsigned short *pOut)
+    {
+	size_t i = 0;
+	size_t j = 0;
+	size_t n = 0;
+	while((i < nA) && (j < nB))
+	{
+	    const unsigned a = pA[i];
+	    const unsigned b = pB[j];
+	    /* these only keep values from A, and never write ahead of i */
+	    if ((op == opAnd) || (op == opAndNot))
+		pOut[n] = (unsigned short)a;
+	    else
+		pOut[n] = (unsigned short)(a < b ? a : b);
+	    if (op == opAnd)
+		n += a == b;
+	    else if (op == opOr)
+		++n;
+	    else if (op == opXor)
+		n += a != b;
+	    else
+		n += a < b;
+	    i += a <= b;
+	    j += b <= a;
+	}
+
+	/* what remains of A is only in A, and of B only in B */
+	if (op != opAnd)
+	{
+	    memmove(pOut + n, pA + i, (nA - i) * sizeof(unsigned short));
+	    n += nA - i;
+	}
+	if ((op == opOr) || (op == opXor))
+	{
+	    memcpy(pOut + n, pB + j, (nB - j) * sizeof(unsigned short));
+	    n += nB - j;
+	}
+	return n;
+    }
+
+    static size_t mergeValues(const unsigned short *pA, size_t nA,
+			      const unsigned short *pB, size_t nB,
+			      unsigned short *pOut, unsigned op)
+    {
+	if (op == opAnd)
+	    return mergeValues<opAnd>(pA, nA, pB, nB, pOut);
+	if (op == opOr)
+	    return mergeValues<opOr>(pA, nA, pB, nB, pOut);
+	if (op == opXor)
+	    return mergeValues<opXor>(pA, nA, pB, nB, pOut);
+	return mergeValues<opAndNot>(pA, nA, pB, nB, pOut);
+    }
+
+#ifdef __SSE2__
+    template<unsigned op>
+    static inline __m128i combineWord(__m128i a, __m128i b)
+    {
+	if (op == opAnd)
+	    return _mm_and_si128(a, b);
+	if (op == opOr)
+	    return _mm_or_si128(a, b);
+	if (op == opXor)
+	    return _mm_xor_si128(a, b);
+	return _mm_andnot_si128(b, a);
+    }
+#else
+    template<unsigned op>
+    static inline unsigned long long combineWord(unsigned long long a,
+						 unsigned long long b)
+    {
+	if (op == opAnd)
+	    return a & b;
+	if (op == opOr)
+	    return a | b;
+	if (op == opXor)
+	    return a ^ b;
+	return a & ~b;
+    }
+#endif
+
+    /*
+      Combine two bitmaps; pOut may be the same as pA.
+
+      @returns the number of bits set in the result
+    */
+    template<unsigned op>
+    static unsigned combineWords(unsigned long long *pOut,
+				 const unsigned long long *pA,
+				 const unsigned long long *pB)
+    {
+	unsigned count = 0;
+#ifdef __SSE2__
+	for(unsigned i = 0; i < bitmapWords; i += 2)
+	{
+	    _mm_storeu_si128(
+		(__m128i *)(pOut + i),
+		combineWord<op>(_mm_loadu_si128((const __m128i *)(pA + i)),
+				_mm_loadu_si128((const __m128i *)(pB + i))));
+	    count += __builtin_popcountll(pOut[i]) +
+		__builtin_popcountll(pOut[i + 1]);
+	}
+#else
+	for(unsigned i = 0; i < bitmapWords; ++i)
+	{
+	    pOut[i] = combineWord<op>(pA[i], pB[i]);
+	    count += __builtin_popcountll(pOut[i]);
+	}
+#endif
+	return count;
+    }
+
+    static unsigned combineWords(unsigned long long *pOut,
+				 const unsigned long long *pA,
+				 const unsigned long long *pB, unsigned op)
+    {
+	if (op == opAnd)
+	    return combineWords<opAnd>(pOut, pA, pB);
+	if (op == opOr)
+	    return combineWords<opOr>(pOut, pA, pB);
+	if (op == opXor)
+	    return combineWords<opXor>(pOut, pA, pB);
+	return combineWords<opAndNot>(pOut, pA, pB);
+    }
+
+    /*
+      Combine two containers with the same key.  The first is consumed:  its
+      storage is either reused for the result, or released.
+
+      @returns true if the result has any values, in which case it has been
+        stored in *pOut
+    */
+    static bool combine(RoaringContainer *pA, const RoaringContainer *pB,
+			unsigned op, RoaringContainer *pOut)
+    {
+	Arena *const pArena = Arena::getThreadArena();
+	ArenaScope scope(pArena);
+	const unsigned short key = pA->key;
+	const bool aSmall = pA->cardinality <= maxArray;
+	const bool bSmall = pB->cardinality <= maxArray;
+
+	if (aSmall && bSmall)
+	{
+	    const unsigned short *pValuesA = expandValues(pA, pArena);
+	    const unsigned short *pValuesB = expandValues(pB, pArena);
+	    size_t bound = pA->cardinality;
+	    if (op == opAnd)
+		bound = bound < pB->cardinality ? bound : pB->cardinality;
+	    else if (op != opAndNot)
+		bound += pB->cardinality;
+
+	    const bool inPlace = (pA->type == arrayType) && pA->capacity &&
+		((op == opAnd) || (op == opAndNot));
+	    unsigned short *pValues = inPlace ? getValues(pA) :
+		bound ? (unsigned short *)allocate(
+		    bound * sizeof(unsigned short)) : NULL;
+	    const size_t n = mergeValues(pValuesA, pA->cardinality,
+					 pValuesB, pB->cardinality,
+					 pValues, op);
+	    if (inPlace)
+		bound = pA->capacity;
+	    else
+		freeContainer(pA);
+	    return adoptValues(pOut, key, pValues, n, bound);
+	}
+
+	if (((op == opAnd) && (aSmall || bSmall)) ||
+	    ((op == opAndNot) && aSmall))
+	{
+	    /* the result is a subset of the small container */
+	    const RoaringContainer *pSmall = aSmall ? pA : pB;
+	    const RoaringContainer *pLarge = aSmall ? pB : pA;
+	    const unsigned short *pValues = expandValues(pSmall, pArena);
+	    const unsigned long long *pWords = expandWords(pLarge, pArena);
+	    const bool inPlace = (pSmall == pA) &&
+		(pA->type == arrayType) && pA->capacity;
+	    const size_t count = pSmall->cardinality;
+	    unsigned short *pResult = inPlace ? getValues(pA) :
+		(unsigned short *)allocate(count * sizeof(unsigned short));
+	    const bool want = op == opAnd;
+	    size_t n = 0;
+	    for(unsigned i = 0; i < count; ++i)
+	    {
+		const unsigned short value = pValues[i];
+		pResult[n] = value;
+		n += testBit(pWords, value) == want;
+	    }
+	    if (!inPlace)
+		freeContainer(pA);
+	    return adoptValues(pOut, key, pResult, n,
+			       inPlace ? pA->capacity : count);
+	}
+
+	/*
+	  The result is built as a bitmap.  Only union and symmetric difference
+	  get here with a small left container; they are symmetrical, so start
+	  from the right one instead.
+	*/
+	const RoaringContainer *pBase = aSmall ? pB : pA;
+	const RoaringContainer *pOther = aSmall ? pA : pB;
+	const bool inPlace = (pBase == pA) && (pA->type == bitmapType) &&
+	    pA->capacity;
+	unsigned long long *pWords = inPlace ? getWords(pA) :
+	    pArena->allocateArray<unsigned long long>(bitmapWords);
+	const unsigned long long *pBaseWords = asWords(pBase, pWords);
+	unsigned cardinality;
+	if (pOther->cardinality <= maxArray)
+	{
+	    if (pBaseWords != pWords)
+		memcpy(pWords, pBaseWords, bitmapBytes);
+	    const unsigned short *pValues = expandValues(pOther, pArena);
+	    cardinality = pBase->cardinality;
+	    for(unsigned i = 0; i < pOther->cardinality; ++i)
+	    {
+		unsigned long long *pWord = pWords + (pValues[i] >> 6);
+		const unsigned long long bit = 1ULL << (pValues[i] & 63);
+		const unsigned present = (*pWord & bit) != 0;
+		if (op == opOr)
+		{
+		    cardinality += !present;
+		    *pWord |= bit;
+		}
+		else if (op == opXor)
+		{
+		    cardinality += 1 - 2 * present;
+		    *pWord ^= bit;
+		}
+		else
+		{
+		    cardinality -= present;
+		    *pWord &= ~bit;
+		}
+	    }
+	}
+	else
+	{
+	    const unsigned long long *pOtherWords = expandWords(pOther, pArena);
+	    cardinality = combineWords(pWords, pBaseWords, pOtherWords, op);
+	}
+
+	if (inPlace && (cardinality > maxArray))
+	{
+	    *pOut = *pA;
+	    pOut->cardinality = cardinality;
+	    return true;
+	}
+
+	if (cardinality)
+	    makeFromWords(pOut, key, pWords, cardinality);
+	freeContainer(pA);
+	return cardinality != 0;
+    }
+
+    static inline void put16(unsigned char *p, unsigned v)
+    {
+	p[0] = (unsigned char)v;
+	p[1] = (unsigned char)(v >> 8);
+    }
+
+    static inline void put32(unsigned char *p, unsigned v)
+    {
+	put16(p, v & 0xffff);
+	put16(p + 2, v >> 16);
+    }
+
+    static inline void put64(unsigned char *p, unsigned long long v)
+    {
+	put32(p, (unsigned)v);
+	put32(p + 4, (unsigned)(v >> 32));
+    }
+
+    static inline unsigned get16(const unsigned char *p)
+    {
+	return p[0] | (p[1] << 8);
+    }
+
+    static inline unsigned get32(const unsigned char *p)
+    {
+	return get16(p) | (get16(p + 2) << 16);
+    }
+
+    static inline size_t getContentBytes(const RoaringContainer *p)
+    {
+	return (p->n * getUnitBytes(p->type) + 7) & ~(size_t)7;
+    }
+
+    /*
+      Check that an attached container's contents match its cardinality, and
+      that its runs are in order and in range, so that expanding it can't
+      overrun anything.
+    */
+    static bool isConsistent(const RoaringContainer *p)
+    {
+	if (p->type == arrayType)
+	    return true;
+	if (p->type == bitmapType)
+	    return countBits(getWords(p)) == p->cardinality;
+
+	const unsigned short *pRuns = getValues(p);
+	unsigned next = 0;
+	size_t count = 0;
+	for(unsigned r = 0; r < p->n; ++r)
+	{
+	    const unsigned start = pRuns[2 * r];
+	    const unsigned end = start + pRuns[2 * r + 1];
+	    if ((start < next) || (end > 0xffff))
+		return false;
+	    count += end - start + 1;
+	    next = end + 1;
+	}
+	return count == p->cardinality;
+    }
+
+    RoaringBitmap::RoaringBitmap():
+	pContainers(NULL),
+	nContainers(0),
+	capacity(0)
+    {
+    }
+
+    RoaringBitmap::~RoaringBitmap()
+    {
+	clear();
+    }
+
+    size_t RoaringBitmap::findContainer(unsigned short key) const
+    {
+	size_t low = 0;
+	size_t n = nContainers;
+	while(n)
+	{
+	    const size_t half = n / 2;
+	    if (pContainers[low + half].key < key)
+	    {
+		low += half + 1;
+		n -= half + 1;
+	    }
+	    else
+		n = half;
+	}
+	return low;
+    }
+
+    RoaringContainer *RoaringBitmap::getContainer(unsigned short key,
+						  bool create)
+    {
+	const size_t i = findContainer(key);
+	if ((i < nContainers) && (pContainers[i].key == key))
+	    return &pContainers[i];
+	if (!create)
+	    return NULL;
+
+	if (nContainers == capacity)
+	{
+	    const size_t newCapacity = capacity ? 2 * capacity : 4;
+	    RoaringContainer *pNew = (RoaringContainer *)realloc(
+		pContainers, newCapacity * sizeof(RoaringContainer));
+	    if (!pNew)
+		throw std::bad_alloc();
+	    pContainers = pNew;
+	    capacity = newCapacity;
+	}
+
+	const unsigned initialCapacity = 4;
+	void *pData = allocate(initialCapacity * sizeof(unsigned short));
+	memmove(&pContainers[i + 1], &pContainers[i],
+		(nContainers - i) * sizeof(RoaringContainer));
+	++nContainers;
+
+	RoaringContainer *p = &pContainers[i];
+	p->pData = pData;
+	p->cardinality = 0;
+	p->n = 0;
+	p->capacity = initialCapacity;
+	p->key = key;
+	p->type = arrayType;
+	return p;
+    }
+
+    void RoaringBitmap::removeContainer(size_t i)
+    {
+	freeContainer(&pContainers[i]);
+	--nContainers;
+	memmove(&pContainers[i], &pContainers[i + 1],
+		(nContainers - i) * sizeof(RoaringContainer));
+    }
+
+    bool RoaringBitmap::add(unsigned value)
+    {
+	const unsigned low = value & 0xffff;
+	RoaringContainer *p = getContainer((unsigned short)(value >> 16), true);
+	if (p->type == runType)
+	{
+	    if (containerContains(p, low))
+		return false;
+	    convertToNatural(p);
+	}
+
+	if (p->type == arrayType)
+	{
+	    unsigned short *pValues = getValues(p);
+	    const size_t i = lowerBound16(pValues, p->n, low);
+	    if ((i < p->n) && (pValues[i] == low))
+		return false;
+
+	    if (p->n < maxArray)
+	    {
+		if (p->n == p->capacity)
+		{
+		    const unsigned newCapacity = p->capacity * 2 < maxArray ?
+			p->capacity * 2 : maxArray;
+		    pValues = (unsigned short *)realloc(
+			pValues, newCapacity * sizeof(unsigned short));
+		    if (!pValues)
+			throw std::bad_alloc();
+		    p->pData = pValues;
+		    p->capacity = newCapacity;
+		}
+		memmove(pValues + i + 1, pValues + i,
+			(p->n - i) * sizeof(unsigned short));
+		pValues[i] = (unsigned short)low;
+		++p->n;
+		++p->cardinality;
+		return true;
+	    }
+
+	    /* the array is full, so it becomes a bitmap */
+	    convert(p, bitmapType);
+	}
+
+	unsigned long long *pWord = getWords(p) + (low >> 6);
+	const unsigned long long bit = 1ULL << (low & 63);
+	if (*pWord & bit)
+	    return false;
+	*pWord |= bit;
+	++p->cardinality;
+	return true;
+    }
+
+    void RoaringBitmap::addArray(const unsigned *pValues, size_t n)
+    {
+	Arena *const pArena = Arena::getThreadArena();
+	for(size_t i = 0; i < n;)
+	{
+	    /* find the values for this container */
+	    const unsigned short key = (unsigned short)(pValues[i] >> 16);
+	    size_t end = i + 1;
+	    while((end < n) && ((pValues[end] >> 16) == key))
+		++end;
+
+	    /* make a temporary container of them, and combine it */
+	    ArenaScope scope(pArena);
+	    RoaringContainer chunk;
+	    chunk.key = key;
+	    chunk.capacity = 0;
+	    if (end - i <= maxArray)
+	    {
+		unsigned short *pLow =
+		    pArena->allocateArray<unsigned short>(end - i);
+		unsigned count = 0;
+		for(; i < end; ++i)
+		{
+		    const unsigned short low = (unsigned short)pValues[i];
+		    if (!count || (pLow[count - 1] != low))
+			pLow[count++] = low;
+		}
+		chunk.pData = pLow;
+		chunk.type = arrayType;
+		chunk.n = count;
+		chunk.cardinality = count;
+	    }
+	    else
+	    {
+		unsigned long long *pWords =
+		    pArena->allocateArray<unsigned long long>(bitmapWords);
+		memset(pWords, 0, bitmapBytes);
+		for(; i < end; ++i)
+		{
+		    const unsigned low = pValues[i] & 0xffff;
+		    pWords[low >> 6] |= 1ULL << (low & 63);
+		}
+		chunk.pData = pWords;
+		chunk.type = bitmapType;
+		chunk.n = bitmapWords;
+		chunk.cardinality = countBits(pWords);
+	    }
+
+	    RoaringContainer *p = getContainer(key, true);
+	    RoaringContainer result;
+	    combine(p, &chunk, opOr, &result);
+	    *p = result;
+	}
+    }
+
+    bool RoaringBitmap::remove(unsigned value)
+    {
+	const unsigned low = value & 0xffff;
+	const unsigned short key = (unsigned short)(value >> 16);
+	const size_t i = findContainer(key);
+	if ((i == nContainers) || (pContainers[i].key != key))
+	    return false;
+
+	RoaringContainer *p = &pContainers[i];
+	if (p->type == runType)
+	{
+	    if (!containerContains(p, low))
+		return false;
+	    convertToNatural(p);
+	}
+
+	if (p->type == arrayType)
+	{
+	    unsigned short *pValues = getValues(p);
+	    const size_t j = lowerBound16(pValues, p->n, low);
+	    if ((j == p->n) || (pValues[j] != low))
+		return false;
+	    memmove(pValues + j, pValues + j + 1,
+		    (p->n - j - 1) * sizeof(unsigned short));
+	    --p->n;
+	}
+	else
+	{
+	    unsigned long long *pWord = getWords(p) + (low >> 6);
+	    const unsigned long long bit = 1ULL << (low & 63);
+	    if (!(*pWord & bit))
+		return false;
+	    *pWord &= ~bit;
+	}
+
+	if (!--p->cardinality)
+	    removeContainer(i);
+	else if ((p->type == bitmapType) && (p->cardinality == maxArray))
+	    convertToNatural(p);
+	return true;
+    }
+
+    void RoaringBitmap::clear()
+    {
+	for(size_t i = 0; i < nContainers; ++i)
+	    freeContainer(&pContainers[i]);
+	free(pContainers);
+	pContainers = NULL;
+	nContainers = 0;
+	capacity = 0;
+    }
+
+    void RoaringBitmap::combineWith(const RoaringBitmap *pOther, unsigned op)
+    {
+	if (pOther == this)
+	{
+	    if ((op == opXor) || (op == opAndNot))
+		clear();
+	    return;
+	}
+
+	const bool keepA = op != opAnd;
+	const bool keepB = (op == opOr) || (op == opXor);
+	const size_t nA = nContainers;
+	const size_t nB = pOther->nContainers;
+	const size_t newCapacity = nA + (keepB ? nB : 0);
+	RoaringContainer *pOut = newCapacity ? (RoaringContainer *)allocate(
+	    newCapacity * sizeof(RoaringContainer)) : NULL;
+	const RoaringContainer *pB = pOther->pContainers;
+
+	size_t i = 0;
+	size_t j = 0;
+	size_t n = 0;
+	while((i < nA) || (j < nB))
+	{
+	    if ((j == nB) || ((i < nA) && (pContainers[i].key < pB[j].key)))
+	    {
+		if (keepA)
+		    pOut[n++] = pContainers[i];
+		else
+		    freeContainer(&pContainers[i]);
+		++i;
+	    }
+	    else if ((i == nA) || (pB[j].key < pContainers[i].key))
+	    {
+		if (keepB)
+		    copyContainer(&pB[j], &pOut[n++]);
+		++j;
+	    }
+	    else
+	    {
+		n += combine(&pContainers[i], &pB[j], op, &pOut[n]);
+		++i;
+		++j;
+	    }
+	}
+
+	free(pContainers);
+	pContainers = pOut;
+	nContainers = n;
+	capacity = newCapacity;
+    }
+
+    void RoaringBitmap::andWith(const RoaringBitmap *pOther)
+    {
+	combineWith(pOther, opAnd);
+    }
+
+    void RoaringBitmap::orWith(const RoaringBitmap *pOther)
+    {
+	combineWith(pOther, opOr);
+    }
+
+    void RoaringBitmap::xorWith(const RoaringBitmap *pOther)
+    {
+	combineWith(pOther, opXor);
+    }
+
+    void RoaringBitmap::andNotWith(const RoaringBitmap *pOther)
+    {
+	combineWith(pOther, opAndNot);
+    }
+
+    void RoaringBitmap::optimize()
+    {
+	for(size_t i = 0; i < nContainers; ++i)
+	{
+	    RoaringContainer *p = &pContainers[i];
+	    const size_t runs = countRuns(p);
+	    const size_t naturalBytes = p->cardinality <= maxArray ?
+		p->cardinality * sizeof(unsigned short) : bitmapBytes;
+	    if (runs * getUnitBytes(runType) < naturalBytes)
+	    {
+		if (p->type != runType)
+		    convertToRuns(p, runs);
+	    }
+	    else if (p->type == runType)
+		convertToNatural(p);
+	    else if ((p->type == arrayType) && (p->capacity > p->n))
+	    {
+		void *pData =
+		    realloc(p->pData, p->n * sizeof(unsigned short));
+		if (pData)
+		{
+		    p->pData = pData;
+		    p->capacity = p->n;
+		}
+	    }
+	}
+    }
+
+    bool RoaringBitmap::contains(unsigned value) const
+    {
+	const unsigned short key = (unsigned short)(value >> 16);
+	const size_t i = findContainer(key);
+	return (i < nContainers) && (pContainers[i].key == key) &&
+	    containerContains(&pContainers[i], value & 0xffff);
+    }
+
+    size_t RoaringBitmap::getCount() const
+    {
+	size_t count = 0;
+	for(size_t i = 0; i < nContainers; ++i)
+	    count += pContainers[i].cardinality;
+	return count;
+    }
+
+    size_t RoaringBitmap::rank(unsigned value) const
+    {
+	const unsigned short key = (unsigned short)(value >> 16);
+	size_t count = 0;
+	size_t i = 0;
+	for(; (i < nContainers) && (pContainers[i].key < key); ++i)
+	    count += pContainers[i].cardinality;
+	if ((i < nContainers) && (pContainers[i].key == key))
+	    count += containerRank(&pContainers[i], value & 0xffff);
+	return count;
+    }
+
+    bool RoaringBitmap::select(size_t i, unsigned *pValue) const
+    {
+	for(size_t j = 0; j < nContainers; ++j)
+	{
+	    const RoaringContainer *p = &pContainers[j];
+	    if (i < p->cardinality)
+	    {
+		*pValue = ((unsigned)p->key << 16) | containerSelect(p, i);
+		return true;
+	    }
+	    i -= p->cardinality;
+	}
+	return false;
+    }
+
+    size_t RoaringBitmap::toArray(unsigned *pValues) const
+    {
+	unsigned *pOut = pValues;
+	for(size_t i = 0; i < nContainers; ++i)
+	{
+	    const RoaringContainer *p = &pContainers[i];
+	    const unsigned base = (unsigned)p->key << 16;
+	    if (p->type == arrayType)
+	    {
+		const unsigned short *pLow = getValues(p);
+		for(unsigned j = 0; j < p->n; ++j)
+		    *pOut++ = base | pLow[j];
+	    }
+	    else if (p->type == bitmapType)
+	    {
+		const unsigned long long *pWords = getWords(p);
+		for(unsigned j = 0; j < bitmapWords; ++j)
+		{
+		    for(unsigned long long w = pWords[j]; w; w &= w - 1)
+			*pOut++ = base | (j * 64 + __builtin_ctzll(w));
+		}
+	    }
+	    else
+	    {
+		const unsigned short *pRuns = getValues(p);
+		for(unsigned r = 0; r < p->n; ++r)
+		{
+		    /* count, since the last value may be the largest possible */
+		    const unsigned start = base | pRuns[2 * r];
+		    for(unsigned j = 0; j <= pRuns[2 * r + 1]; ++j)
+			*pOut++ = start + j;
+		}
+	    }
+	}
+	return pOut - pValues;
+    }
+
+    size_t RoaringBitmap::getBytes() const
+    {
+	size_t bytes = capacity * sizeof(RoaringContainer);
+	for(size_t i = 0; i < nContainers; ++i)
+	{
+	    const RoaringContainer *p = &pContainers[i];
+	    bytes += p->capacity * getUnitBytes(p->type);
+	}
+	return bytes;
+    }
+
+    size_t RoaringBitmap::getSerializedSize() const
+    {
+	size_t bytes = headerBytes + nContainers * entryBytes;
+	for(size_t i = 0; i < nContainers; ++i)
+	    bytes += getContentBytes(&pContainers[i]);
+	return bytes;
+    }
+
+    void RoaringBitmap::serialize(void *pBuffer) const
+    {
+	unsigned char *pStart = (unsigned char *)pBuffer;
+	put32(pStart, roaringMagic);
+	put32(pStart + 4, roaringVersion);
+	put32(pStart + 8, (unsigned)nContainers);
+	put32(pStart + 12, 0);
+
+	size_t offset = headerBytes + nContainers * entryBytes;
+	for(size_t i = 0; i < nContainers; ++i)
+	{
+	    const RoaringContainer *p = &pContainers[i];
+	    unsigned char *pEntry = pStart + headerBytes + i * entryBytes;
+	    put16(pEntry, p->key);
+	    pEntry[2] = p->type;
+	    pEntry[3] = 0;
+	    put32(pEntry + 4, p->n);
+	    put32(pEntry + 8, p->cardinality);
+	    put32(pEntry + 12, (unsigned)offset);
+
+	    const size_t bytes = getContentBytes(p);
+	    unsigned char *pContent = pStart + offset;
+	    memset(pContent, 0, bytes);
+	    if (p->type == bitmapType)
+	    {
+		const unsigned long long *pWords = getWords(p);
+		for(unsigned j = 0; j < bitmapWords; ++j)
+		    put64(pContent + 8 * j, pWords[j]);
+	    }
+	    else
+	    {
+		const unsigned short *pValues = getValues(p);
+		const size_t nValues = p->type == runType ? 2 * p->n : p->n;
+		for(size_t j = 0; j < nValues; ++j)
+		    put16(pContent + 2 * j, pValues[j]);
+	    }
+	    offset += bytes;
+	}
+    }
+
+    bool RoaringBitmap::attach(const void *pBuffer, size_t length)
+    {
+	clear();
+
+	/* the containers are used in place, so this must be little-endian */
+	const unsigned one = 1;
+	if (!*(const unsigned char *)&one || ((size_t)pBuffer & 7))
+	    return false;
+
+	const unsigned char *pStart = (const unsigned char *)pBuffer;
+	if ((length < headerBytes) || (get32(pStart) != roaringMagic) ||
+	    (get32(pStart + 4) != roaringVersion))
+	    return false;
+	const size_t n = get32(pStart + 8);
+	if ((n > 65536) || (n > (length - headerBytes) / entryBytes))
+	    return false;
+	if (!n)
+	    return true;
+
+	RoaringContainer *pNew =
+	    (RoaringContainer *)allocate(n * sizeof(RoaringContainer));
+	for(size_t i = 0; i < n; ++i)
+	{
+	    const unsigned char *pEntry = pStart + headerBytes + i * entryBytes;
+	    RoaringContainer *p = &pNew[i];
+	    p->key = (unsigned short)get16(pEntry);
+	    p->type = pEntry[2];
+	    p->n = get32(pEntry + 4);
+	    p->cardinality = get32(pEntry + 8);
+	    p->capacity = 0;
+	    const size_t offset = get32(pEntry + 12);
+
+	    bool valid = (!i || (p->key > pNew[i - 1].key)) &&
+		p->cardinality && (p->cardinality <= 65536) && !(offset & 7);
+	    if (p->type == arrayType)
+		valid = valid && (p->n == p->cardinality) &&
+		    (p->n <= maxArray);
+	    else if (p->type == bitmapType)
+		valid = valid && (p->n == bitmapWords) &&
+		    (p->cardinality > maxArray);
+	    else if (p->type == runType)
+		valid = valid && p->n && (p->n <= 32768);
+	    else
+		valid = false;
+	    if (!valid || (offset > length) ||
+		(p->n * getUnitBytes(p->type) > length - offset))
+	    {
+		free(pNew);
+		return false;
+	    }
+
+	    p->pData = (void *)(pStart + offset);
+	    if (!isConsistent(p))
+	    {
+		free(pNew);
+		return false;
+	    }
+	}
+
+	pContainers = pNew;
+	nContainers = n;
+	capacity = n;
+	return true;
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,236 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    SlabPool.cpp - see ../include/SlabPool.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A batch in the depot is a free list like any other; the depot is a
+    stack of them, linked through the second word of each batch's first
+    object.  Batches put back by flush() or by an exiting thread may be
+    shorter or longer than batchSize (but never more than twice as long),
+    so refill() counts the objects it takes by walking them; that touches
+    objects that are about to be handed out anyway.
+
+    New slabs are carved into batches outside the lock.  The first word of
+    each slab links it onto the list of slabs to free when the pool is
+    destroyed, and objects start after that, at the objects' alignment.
+    The object size is rounded up to the alignment too, so every object in
+    the slab is aligned; slabs are aligned to their own size, which is a
+    power of two at least as large as the alignment.
+
+    The mutex only protects the depot, the slab list and the list of
+    caches; each cache is only touched by its own thread, except when the
+    pool is destroyed.
+ */
+
+#ifndef PHOENIX4CPP_SLABPOOL_H
+#include "SlabPool.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_UNISTD_H
+#include <unistd.h>
+#define PHOENIX4CPP_UNISTD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /* a slab must hold at least this many objects */
+    static const size_t minSlabObjects = 16;
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline void SlabPoolBase::pushBatch(SlabPoolFree *pFirst)
+    {
+	pthread_mutex_lock(&mutex);
+	pFirst->pNextBatch = pDepot;
+	pDepot = pFirst;
+	pthread_mutex_unlock(&mutex);
+    }
+
+    SlabPoolBase::SlabPoolBase(size_t oSize, size_t alignment, size_t bSize):
+	pDepot(NULL),
+	pSlabs(NULL),
+	nSlabs(0),
+	pCaches(NULL),
+	objectSize(oSize < sizeof(SlabPoolFree) ? sizeof(SlabPoolFree) : oSize),
+	batchSize(bSize ? bSize : 1),
+	slabBytes((size_t)sysconf(_SC_PAGESIZE))
+    {
+	if (alignment < sizeof(void *))
+	    alignment = sizeof(void *);
+	objectSize = (objectSize + alignment - 1) & ~(alignment - 1);
+	firstOffset = (sizeof(void *) + alignment - 1) & ~(alignment - 1);
+	while(slabBytes < firstOffset + minSlabObjects * objectSize)
+	    slabBytes <<= 1;
+
+	if (pthread_key_create(&key, threadExit))
+	    throw std::bad_alloc();
+	pthread_mutex_init(&mutex, NULL);
+    }
+
+    SlabPoolBase::~SlabPoolBase()
+    {
+	pthread_key_delete(key);
+
+	while(pCaches)
+	{
+	    SlabPoolCache *pCache = pCaches;
+	    pCaches = pCache->pNextCache;
+	    delete pCache;
+	}
+
+	while(pSlabs)
+	{
+	    void *pSlab = pSlabs;
+	    pSlabs = *(void **)pSlab;
+	    free(pSlab);
+	}
+
+	pthread_mutex_destroy(&mutex);
+    }
+
+    SlabPoolCache *SlabPoolBase::newCache()
+    {
+	SlabPoolCache *pCache = new SlabPoolCache;
+	pCache->pPool = this;
+	pCache->pFree = NULL;
+	pCache->count = 0;
+	pCache->pPreviousCache = NULL;
+
+	pthread_mutex_lock(&mutex);
+	pCache->pNextCache = pCaches;
+	if (pCaches)
+	    pCaches->pPreviousCache = pCache;
+	pCaches = pCache;
+	pthread_mutex_unlock(&mutex);
+
+	pthread_setspecific(key, pCache);
+	return pCache;
+    }
+
+    void SlabPoolBase::refill(SlabPoolCache *pCache)
+    {
+	pthread_mutex_lock(&mutex);
+	SlabPoolFree *pBatch = pDepot;
+	if (pBatch)
+	    pDepot = pBatch->pNextBatch;
+	pthread_mutex_unlock(&mutex);
+
+	if (pBatch)
+	{
+	    size_t n = 0;
+	    for(SlabPoolFree *pFree = pBatch; pFree; pFree = pFree->pNext)
+		++n;
+	    pCache->pFree = pBatch;
+	    pCache->count = n;
+	    return;
+	}
+
+	/*
+	  The depot is empty; carve up a new slab.  The first batch goes to
+	  this thread, and the rest go to the depot.
+	*/
+	void *pSlab;
+	if (posix_memalign(&pSlab, slabBytes, slabBytes))
+	    throw std::bad_alloc();
+
+	char *const pFirst = ((char *)pSlab) + firstOffset;
+	const size_t n = (slabBytes - firstOffset) / objectSize;
+	SlabPoolFree *pBatches = NULL;
+	SlabPoolFree **ppBatch = &pBatches;
+	char *pObject = pFirst;
+	for(size_t i = 0; i < n; ++i, pObject += objectSize)
+	{
+	    SlabPoolFree *pFree = (SlabPoolFree *)pObject;
+	    if (!((i + 1) % batchSize) || (i + 1 == n))
+		pFree->pNext = NULL;
+	    else
+		pFree->pNext = (SlabPoolFree *)(pObject + objectSize);
+
+	    if (!(i % batchSize))
+	    {
+		*ppBatch = pFree;
+		ppBatch = &pFree->pNextBatch;
+	    }
+	}
+	*ppBatch = NULL;
+
+	pCache->pFree = pBatches;
+	pCache->count = (n < batchSize ? n : batchSize);
+
+	pthread_mutex_lock(&mutex);
+	*(void **)pSlab = pSlabs;
+	pSlabs = pSlab;
+	++nSlabs;
+	if (pBatches->pNextBatch)
+	{
+	    *ppBatch = pDepot;
+	    pDepot = pBatches->pNextBatch;
+	}
+	pthread_mutex_unlock(&mutex);
+    }
+
+    void SlabPoolBase::giveBack(SlabPoolCache *pCache, size_t n)
+    {
+	/* keep the most recently released objects, which are still warm */
+	SlabPoolFree *pLastKept = pCache->pFree;
+	for(size_t i = pCache->count - n; i > 1; --i)
+	    pLastKept = pLastKept->pNext;
+
+	SlabPoolFree *const pFirst = pLastKept->pNext;
+	pLastKept->pNext = NULL;
+	pCache->count -= n;
+	pushBatch(pFirst);
+    }
+
+    void SlabPoolBase::flush()
+    {
+	SlabPoolCache *pCache = (SlabPoolCache *)pthread_getspecific(key);
+	if (!pCache || !pCache->pFree)
+	    return;
+
+	pushBatch(pCache->pFree);
+	pCache->pFree = NULL;
+	pCache->count = 0;
+    }
+
+    size_t SlabPoolBase::getSlabCount() const
+    {
+	return __atomic_load_n(&nSlabs, __ATOMIC_RELAXED);
+    }
+
+    void SlabPoolBase::threadExit(void *p)
+    {
+	SlabPoolCache *const pCache = (SlabPoolCache *)p;
+	SlabPoolBase *const pPool = pCache->pPool;
+	if (pCache->pFree)
+	    pPool->pushBatch(pCache->pFree);
+
+	pthread_mutex_lock(&pPool->mutex);
+	if (pCache->pPreviousCache)
+	    pCache->pPreviousCache->pNextCache = pCache->pNextCache;
+	else
+	    pPool->pCaches = pCache->pNextCache;
+	if (pCache->pNextCache)
+	    pCache->pNextCache->pPreviousCache = pCache->pPreviousCache;
+	pthread_mutex_unlock(&pPool->mutex);
+
+	delete pCache;
+    }
+
+} // namespace phoenix4cpp
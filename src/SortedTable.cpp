@@ -0,0 +1,484 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    SortedTable.cpp - see ../include/SortedTable.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The file is laid out as
+
+      header            one page
+      blocks            nBlocks * blockBytes
+      index             nBlocks * indexStride, starting at a page
+      Bloom filter      bloomBytes, starting at a page, if there is one
+
+    Within a block, records are packed from the start, so record i is at
+    block i / recordsPerBlock, slot i % recordsPerBlock.  Index entries
+    are copies of keys, each rounded up to a multiple of eight bytes so
+    that they stay aligned for the comparison function.
+
+    lowerBound() finds the first index entry that is not less than the
+    key, and searches the block before it, because that block is the last
+    one that can start with a key less than the one being sought; if the
+    key belongs after the end of that block, the answer is the first
+    record of the next.  That is also where the search ends up when there
+    are duplicates that straddle a block boundary, so the first of them is
+    found.
+
+    The writer takes its scratch from the calling thread's arena (see
+    Arena.h), checks the order of the records as it goes, and writes
+    everything with plain write()s to a temporary file next to the target,
+    which is fsync()ed and then renamed over it.
+
+    The implementation works in terms of (char *) to avoid casts for
+    bytewise pointer arithmetic.
+ */
+
+#ifndef PHOENIX4CPP_SORTEDTABLE_H
+#include "SortedTable.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_BSEARCH_H
+#include "bsearch.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CERRNO_H
+#include <cerrno>
+#define PHOENIX4CPP_CERRNO_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTDIO_H
+#include <cstdio>
+#define PHOENIX4CPP_CSTDIO_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_FCNTL_H
+#include <fcntl.h>
+#define PHOENIX4CPP_FCNTL_H
+#endif
+
+#ifndef PHOENIX4CPP_SYS_MMAN_H
+#include <sys/mman.h>
+#define PHOENIX4CPP_SYS_MMAN_H
+#endif
+
+#ifndef PHOENIX4CPP_SYS_STAT_H
+#include <sys/stat.h>
+#define PHOENIX4CPP_SYS_STAT_H
+#endif
+
+#ifndef PHOENIX4CPP_UNISTD_H
+#include <unistd.h>
+#define PHOENIX4CPP_UNISTD_H
+#endif
+
+
+namespace phoenix4cpp
+{
+    /* every section of the file starts on one of these */
+    static const size_t tablePage = 4096;
+
+    static const char tableMagic[8] =
+	{ 'P', '4', 'C', 'T', 'A', 'B', 'L', 'E' };
+    static const unsigned tableVersion = 1;
+    static const unsigned tableByteOrder = 0x01020304;
+
+    struct SortedTableHeader
+    {
+	char magic[8];
+	unsigned version;
+	unsigned byteOrder;
+	unsigned long long recordSize;
+	unsigned long long keyOffset;
+	unsigned long long keySize;
+	unsigned long long nRecords;
+	unsigned long long blockBytes;
+	unsigned long long recordsPerBlock;
+	unsigned long long nBlocks;
+	unsigned long long dataOffset;
+	unsigned long long indexOffset;
+	unsigned long long indexStride;
+	unsigned long long bloomOffset;
+	unsigned long long bloomBytes;
+	unsigned long long fileBytes;
+    };
+
+    /*
+      These functions are private; we declare them first so that they can be
+      inlined in this file.
+    */
+
+    static inline size_t alignUp(size_t n, size_t align)
+    {
+	return (n + align - 1) / align * align;
+    }
+
+    /* @returns zero, or an errno value */
+    static int writeAll(int fd, const void *pBuffer, size_t length)
+    {
+	const char *p = (const char *)pBuffer;
+	while(length)
+	{
+	    const ssize_t written = ::write(fd, p, length);
+	    if (written < 0)
+	    {
+		if (errno == EINTR)
+		    continue;
+		return errno;
+	    }
+	    p += written;
+	    length -= (size_t)written;
+	}
+	return 0;
+    }
+
+    /* @returns zero, or an errno value */
+    static int writeZeros(int fd, size_t length)
+    {
+	static const char zeros[tablePage] = { 0 };
+	while(length)
+	{
+	    const size_t n = length < tablePage ? length : tablePage;
+	    const int error = writeAll(fd, zeros, n);
+	    if (error)
+		return error;
+	    length -= n;
+	}
+	return 0;
+    }
+
+
+    SortedTableBase::SortedTableBase(
+	int (*c)(const void *pl, const void *pr),
+	void (*h)(HashValue *pHashValue, const void *pKey)):
+	cmp(c),
+	hash(h),
+	pMap(NULL),
+	mapBytes(0),
+	pData(NULL),
+	pIndex(NULL),
+	indexStride(0),
+	nRecords(0),
+	nBlocks(0),
+	recordsPerBlock(1),
+	blockBytes(0),
+	recordSize(0),
+	recordKeyOffset(0),
+	recordKeySize(0),
+	bloomFilter(),
+	useBloomFilter(false)
+    {
+    }
+
+    SortedTableBase::~SortedTableBase()
+    {
+	close();
+    }
+
+    void SortedTableBase::close()
+    {
+	if (pMap)
+	    munmap(pMap, mapBytes);
+
+	pMap = NULL;
+	mapBytes = 0;
+	pData = NULL;
+	pIndex = NULL;
+	indexStride = 0;
+	nRecords = 0;
+	nBlocks = 0;
+	recordsPerBlock = 1;
+	blockBytes = 0;
+	recordSize = 0;
+	recordKeyOffset = 0;
+	recordKeySize = 0;
+	useBloomFilter = false;
+    }
+
+    int SortedTableBase::write(
+	const char *pPath, const void *pArray, size_t n, size_t size,
+	size_t keyOffset, size_t keySize,
+	int (*cmp)(const void *pl, const void *pr),
+	void (*hash)(HashValue *pHashValue, const void *pKey),
+	unsigned bitsPerKey, size_t blockBytes)
+    {
+	if (!size || !keySize || (keyOffset + keySize > size))
+	    return EINVAL;
+
+	const char *const pRecords = (const char *)pArray;
+	SortedTableHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, tableMagic, sizeof(header.magic));
+	header.version = tableVersion;
+	header.byteOrder = tableByteOrder;
+	header.recordSize = size;
+	header.keyOffset = keyOffset;
+	header.keySize = keySize;
+	header.nRecords = n;
+	header.recordsPerBlock = blockBytes > size ? blockBytes / size : 1;
+	header.blockBytes = alignUp(header.recordsPerBlock * size, tablePage);
+	header.nBlocks =
+	    (n + header.recordsPerBlock - 1) / header.recordsPerBlock;
+	header.dataOffset = tablePage;
+	header.indexOffset =
+	    header.dataOffset + header.nBlocks * header.blockBytes;
+	header.indexStride = alignUp(keySize, sizeof(unsigned long long));
+	header.bloomOffset = alignUp(
+	    header.indexOffset + header.nBlocks * header.indexStride,
+	    tablePage);
+
+	Arena *const pArena = Arena::getThreadArena();
+	ArenaScope scope(pArena);
+
+	/* build the index and the filter while checking the order */
+	char *const pIndex = (char *)pArena->allocate(
+	    header.nBlocks * header.indexStride + 1, sizeof(unsigned long long));
+	memset(pIndex, 0, header.nBlocks * header.indexStride);
+	BloomFilter *pBloomFilter = NULL;
+	if (hash && n)
+	    pBloomFilter = new BloomFilter(n, bitsPerKey);
+	for(size_t i = 0; i < n; ++i)
+	{
+	    const char *const pKey = pRecords + i * size + keyOffset;
+	    if (i && ((*cmp)(pKey - size, pKey) > 0))
+	    {
+		delete pBloomFilter;
+		return EINVAL;
+	    }
+	    if (!(i % header.recordsPerBlock))
+		memcpy(pIndex + (i / header.recordsPerBlock) *
+		       header.indexStride, pKey, keySize);
+	    if (pBloomFilter)
+	    {
+		HashValue hashValue;
+		(*hash)(&hashValue, pKey);
+		pBloomFilter->addHash(hashValue.get64());
+	    }
+	}
+
+	char *pBloom = NULL;
+	if (pBloomFilter)
+	{
+	    header.bloomBytes = pBloomFilter->getSerializedSize();
+	    pBloom = (char *)pArena->allocate(header.bloomBytes, 64);
+	    pBloomFilter->serialize(pBloom);
+	    delete pBloomFilter;
+	    header.fileBytes = header.bloomOffset + header.bloomBytes;
+	}
+	else
+	{
+	    header.bloomOffset = 0;
+	    header.fileBytes =
+		header.indexOffset + header.nBlocks * header.indexStride;
+	}
+
+	const size_t pathLength = strlen(pPath);
+	char *const pTempPath = (char *)pArena->allocate(pathLength + 5, 1);
+	memcpy(pTempPath, pPath, pathLength);
+	memcpy(pTempPath + pathLength, ".tmp", 5);
+
+	const int fd = ::open(pTempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0)
+	    return errno;
+
+	int error = writeAll(fd, &header, sizeof(header));
+	if (!error)
+	    error = writeZeros(fd, tablePage - sizeof(header));
+	for(size_t b = 0; !error && (b < header.nBlocks); ++b)
+	{
+	    const size_t first = b * header.recordsPerBlock;
+	    const size_t count = n - first < header.recordsPerBlock ?
+		n - first : header.recordsPerBlock;
+	    error = writeAll(fd, pRecords + first * size, count * size);
+	    if (!error)
+		error = writeZeros(fd, header.blockBytes - count * size);
+	}
+	if (!error)
+	    error = writeAll(fd, pIndex, header.nBlocks * header.indexStride);
+	if (!error && pBloom)
+	{
+	    error = writeZeros(fd, header.bloomOffset - header.indexOffset -
+			       header.nBlocks * header.indexStride);
+	    if (!error)
+		error = writeAll(fd, pBloom, header.bloomBytes);
+	}
+	if (!error && fsync(fd))
+	    error = errno;
+	if (::close(fd) && !error)
+	    error = errno;
+	if (!error && rename(pTempPath, pPath))
+	    error = errno;
+	if (error)
+	    unlink(pTempPath);
+
+	return error;
+    }
+
+    int SortedTableBase::open(const char *pPath, size_t size,
+			      size_t kOffset, size_t kSize)
+    {
+	close();
+
+	const int fd = ::open(pPath, O_RDONLY);
+	if (fd < 0)
+	    return errno;
+
+	struct stat st;
+	if (fstat(fd, &st))
+	{
+	    const int error = errno;
+	    ::close(fd);
+	    return error;
+	}
+	if ((size_t)st.st_size < tablePage)
+	{
+	    ::close(fd);
+	    return EINVAL;
+	}
+
+	void *const p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+			     fd, 0);
+	const int error = errno;
+	::close(fd);
+	if (p == MAP_FAILED)
+	    return error;
+
+	/* don't trust anything in the header that could lead outside the map */
+	const SortedTableHeader *const pHeader = (const SortedTableHeader *)p;
+	const unsigned long long fileBytes = (unsigned long long)st.st_size;
+	const unsigned long long perBlock = pHeader->recordsPerBlock;
+	if (memcmp(pHeader->magic, tableMagic, sizeof(tableMagic)) ||
+	    (pHeader->version != tableVersion) ||
+	    (pHeader->byteOrder != tableByteOrder) ||
+	    (pHeader->recordSize != size) || (pHeader->keyOffset != kOffset) ||
+	    (pHeader->keySize != kSize) ||
+	    (pHeader->fileBytes != fileBytes) ||
+	    !perBlock || (perBlock > pHeader->blockBytes / size) ||
+	    (pHeader->blockBytes % tablePage) ||
+	    (pHeader->indexStride !=
+	     alignUp(kSize, sizeof(unsigned long long))) ||
+	    (pHeader->dataOffset != tablePage) ||
+	    (pHeader->nBlocks > fileBytes / pHeader->blockBytes) ||
+	    /* nBlocks * perBlock is no more than fileBytes, so can't wrap */
+	    (pHeader->nRecords > pHeader->nBlocks * perBlock) ||
+	    (pHeader->nBlocks &&
+	     (pHeader->nRecords <= (pHeader->nBlocks - 1) * perBlock)) ||
+	    (pHeader->indexOffset != pHeader->dataOffset +
+	     pHeader->nBlocks * pHeader->blockBytes) ||
+	    (pHeader->nBlocks * pHeader->indexStride >
+	     fileBytes - pHeader->indexOffset) ||
+	    (pHeader->bloomBytes &&
+	     ((pHeader->bloomOffset % tablePage) ||
+	      (pHeader->bloomOffset < pHeader->indexOffset +
+	       pHeader->nBlocks * pHeader->indexStride) ||
+	      (pHeader->bloomOffset > fileBytes) ||
+	      (pHeader->bloomBytes > fileBytes - pHeader->bloomOffset))))
+	{
+	    munmap(p, (size_t)st.st_size);
+	    return EINVAL;
+	}
+
+	pMap = p;
+	mapBytes = (size_t)st.st_size;
+	if (pHeader->bloomBytes)
+	{
+	    if (!bloomFilter.attach((const char *)p + pHeader->bloomOffset,
+				    (size_t)pHeader->bloomBytes))
+	    {
+		close();
+		return EINVAL;
+	    }
+	    useBloomFilter = (hash != NULL);
+	}
+
+	pData = (const char *)p + pHeader->dataOffset;
+	pIndex = (const char *)p + pHeader->indexOffset;
+	indexStride = (size_t)pHeader->indexStride;
+	nRecords = (size_t)pHeader->nRecords;
+	nBlocks = (size_t)pHeader->nBlocks;
+	recordsPerBlock = (size_t)perBlock;
+	blockBytes = (size_t)pHeader->blockBytes;
+	recordSize = size;
+	recordKeyOffset = kOffset;
+	recordKeySize = kSize;
+
+	/*
+	  The index and the filter are touched by every lookup, so start
+	  reading them now; the records are paged in as they are used.
+	*/
+	const size_t indexStart = (size_t)pHeader->indexOffset;
+	madvise((char *)p + indexStart, mapBytes - indexStart, MADV_WILLNEED);
+
+	return 0;
+    }
+
+    const void *SortedTableBase::lowerBound(const void *pKey) const
+    {
+	if (!nRecords)
+	    return NULL;
+
+	const char *const pEntry = (const char *)phoenix4cpp::lowerBound(
+	    pKey, pIndex, nBlocks, indexStride, 0, cmp);
+	const size_t entry = (size_t)(pEntry - pIndex) / indexStride;
+	const size_t b = entry ? entry - 1 : 0;
+
+	const char *const pBlock = pData + b * blockBytes;
+	const size_t first = b * recordsPerBlock;
+	const size_t count = nRecords - first < recordsPerBlock ?
+	    nRecords - first : recordsPerBlock;
+	const char *const pRecord = (const char *)phoenix4cpp::lowerBound(
+	    pKey, pBlock, count, recordSize, recordKeyOffset, cmp);
+	if (pRecord < pBlock + count * recordSize)
+	    return pRecord;
+	if (b + 1 < nBlocks)
+	    return pBlock + blockBytes;
+	return NULL;
+    }
+
+    const void *SortedTableBase::find(const void *pKey) const
+    {
+	if (useBloomFilter)
+	{
+	    HashValue hashValue;
+	    (*hash)(&hashValue, pKey);
+	    if (!bloomFilter.mayContainHash(hashValue.get64()))
+		return NULL;
+	}
+
+	const char *const pRecord = (const char *)lowerBound(pKey);
+	if (!pRecord || (*cmp)(pKey, pRecord + recordKeyOffset))
+	    return NULL;
+	return pRecord;
+    }
+
+    const void *SortedTableBase::getNext(const void *pRecord) const
+    {
+	const size_t offset = (size_t)((const char *)pRecord - pData);
+	const size_t b = offset / blockBytes;
+	const size_t slot = (offset % blockBytes) / recordSize;
+	if (b * recordsPerBlock + slot + 1 >= nRecords)
+	    return NULL;
+	if (slot + 1 < recordsPerBlock)
+	    return (const char *)pRecord + recordSize;
+	return pData + (b + 1) * blockBytes;
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,310 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    StringPool.cpp - see ../include/StringPool.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A string's HashValue::get64() picks its shard with the top bits, and its
+    position in the shard's open addressing table with the low bits.  Table
+    entries keep the full hash, so most mismatches are rejected without
+    looking at the characters.  Tables are kept at most half full.
+
+    The characters are copied into the shard's arena, which is a list of
+    large blocks that are carved up in order, and only freed when the pool
+    is destroyed.  Strings too big for a block get a block of their own.
+
+    IDs come from a single counter shared by all shards, incremented
+    atomically while holding the shard's lock.  The string pointer for an
+    ID is published with a release store, into a chunk that is itself
+    published (by whichever thread gets there first) with a compare and
+    swap; getString() reads them with acquire loads.
+
+    Threads in different shards can take IDs in one order and store their
+    strings in another, so the count getCount() returns is a second
+    counter, which each thread advances past its ID only once the count
+    has reached it.  That way every ID below the count has its string
+    stored.  The wait is outside the shard's lock, and only ever for
+    threads with lower IDs, which have nothing left to wait for but
+    threads with still lower IDs.
+ */
+
+#ifndef PHOENIX4CPP_STRINGPOOL_H
+#include "StringPool.h"
+#endif
+
+#ifndef PHOENIX4CPP_HASHVALUE_H
+#include "HashValue.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_PTHREAD_H
+#include <pthread.h>
+#define PHOENIX4CPP_PTHREAD_H
+#endif
+
+#ifndef PHOENIX4CPP_SCHED_H
+#include <sched.h>
+#define PHOENIX4CPP_SCHED_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    static const unsigned firstChunkBits = 10;
+    static const unsigned long firstChunkSize = 1UL << firstChunkBits;
+    static const size_t initialTableSize = 64;
+    static const size_t arenaBlockSize = 64 * 1024;
+
+    struct StringPoolEntry
+    {
+	unsigned long long hashValue;
+	const char *pS;
+	unsigned long id;
+    };
+
+    struct StringPoolBlock
+    {
+	StringPoolBlock *pNext;
+    };
+
+    struct StringPoolShard
+    {
+	pthread_mutex_t mutex;
+
+	StringPoolEntry *pTable;
+	size_t mask;
+	size_t count;
+
+	/* the arena; blocks are linked from the most recent */
+	StringPoolBlock *pBlocks;
+	char *pFree;
+	size_t nFree;
+
+	/* keep shards on separate cache lines */
+	char pad[64];
+    };
+
+    static unsigned long long hashString(const char *pS)
+    {
+	HashValue hashValue;
+	hashValue.blend(pS);
+	return hashValue.get64();
+    }
+
+    static const char *arenaCopy(StringPoolShard *pS, const char *pString)
+    {
+	const size_t length = strlen(pString) + 1;
+	if (length > pS->nFree)
+	{
+	    const size_t size = length > arenaBlockSize ?
+		length : arenaBlockSize;
+	    StringPoolBlock *pBlock = (StringPoolBlock *)
+		new char[sizeof(StringPoolBlock) + size];
+	    pBlock->pNext = pS->pBlocks;
+	    pS->pBlocks = pBlock;
+	    pS->pFree = (char *)(pBlock + 1);
+	    pS->nFree = size;
+	}
+
+	char *pCopy = pS->pFree;
+	memcpy(pCopy, pString, length);
+	pS->pFree += length;
+	pS->nFree -= length;
+	return pCopy;
+    }
+
+    /*
+      Find the entry for a string, or the empty entry where it belongs.
+    */
+    static StringPoolEntry *findEntry(
+	const StringPoolShard *pS, unsigned long long hashValue,
+	const char *pString)
+    {
+	for(size_t i = (size_t)hashValue & pS->mask;; i = (i + 1) & pS->mask)
+	{
+	    StringPoolEntry *pE = &pS->pTable[i];
+	    if (!pE->pS ||
+		((pE->hashValue == hashValue) && !strcmp(pE->pS, pString)))
+		return pE;
+	}
+    }
+
+    static void growTable(StringPoolShard *pS)
+    {
+	const StringPoolEntry *pOld = pS->pTable;
+	const size_t oldSize = pS->mask + 1;
+
+	pS->mask = oldSize * 2 - 1;
+	pS->pTable = new StringPoolEntry[oldSize * 2];
+	memset(pS->pTable, 0, oldSize * 2 * sizeof(StringPoolEntry));
+
+	for(size_t i = 0; i < oldSize; ++i)
+	{
+	    if (!pOld[i].pS)
+		continue;
+
+	    size_t j = (size_t)pOld[i].hashValue & pS->mask;
+	    while(pS->pTable[j].pS)
+		j = (j + 1) & pS->mask;
+	    pS->pTable[j] = pOld[i];
+	}
+
+	delete[] pOld;
+    }
+
+    StringPool::StringPool(unsigned nShards):
+	pShard(NULL),
+	shardBits(0),
+	nextId(0),
+	nPublished(0)
+    {
+	while((1U << shardBits) < nShards)
+	    ++shardBits;
+
+	pShard = new StringPoolShard[1U << shardBits];
+	for(unsigned i = 0; i < (1U << shardBits); ++i)
+	{
+	    StringPoolShard *pS = &pShard[i];
+	    pthread_mutex_init(&pS->mutex, NULL);
+	    pS->pTable = new StringPoolEntry[initialTableSize];
+	    memset(pS->pTable, 0, initialTableSize * sizeof(StringPoolEntry));
+	    pS->mask = initialTableSize - 1;
+	    pS->count = 0;
+	    pS->pBlocks = NULL;
+	    pS->pFree = NULL;
+	    pS->nFree = 0;
+	}
+
+	for(unsigned i = 0; i < maxChunks; ++i)
+	    ppChunk[i] = NULL;
+    }
+
+    StringPool::~StringPool()
+    {
+	for(unsigned i = 0; i < (1U << shardBits); ++i)
+	{
+	    StringPoolShard *pS = &pShard[i];
+	    pthread_mutex_destroy(&pS->mutex);
+	    delete[] pS->pTable;
+
+	    StringPoolBlock *pNext;
+	    for(StringPoolBlock *pBlock = pS->pBlocks; pBlock; pBlock = pNext)
+	    {
+		pNext = pBlock->pNext;
+		delete[] (char *)pBlock;
+	    }
+	}
+	delete[] pShard;
+
+	for(unsigned i = 0; i < maxChunks; ++i)
+	    delete[] ppChunk[i];
+    }
+
+    StringPoolShard *StringPool::getShard(unsigned long long hashValue) const
+    {
+	if (!shardBits)
+	    return pShard;
+
+	return &pShard[hashValue >> (64 - shardBits)];
+    }
+
+    /* work out which chunk an ID is in, and where */
+    static inline unsigned chunkOf(unsigned long id, unsigned long *pOffset)
+    {
+	const unsigned long x = id + firstChunkSize;
+	const unsigned chunk =
+	    (sizeof(unsigned long) * 8 - 1 - __builtin_clzl(x)) -
+	    firstChunkBits;
+	*pOffset = x - (firstChunkSize << chunk);
+	return chunk;
+    }
+
+    const char **StringPool::getSlot(unsigned long id)
+    {
+	unsigned long offset;
+	const unsigned chunk = chunkOf(id, &offset);
+
+	const char **ppC = __atomic_load_n(&ppChunk[chunk], __ATOMIC_ACQUIRE);
+	if (!ppC)
+	{
+	    const char **ppNew = new const char *[firstChunkSize << chunk];
+	    if (__atomic_compare_exchange_n(
+		    &ppChunk[chunk], &ppC, ppNew, false,
+		    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		ppC = ppNew;
+	    else
+		delete[] ppNew;  /* another shard got there first */
+	}
+
+	return &ppC[offset];
+    }
+
+    unsigned long StringPool::intern(const char *pString)
+    {
+	const unsigned long long hashValue = hashString(pString);
+	StringPoolShard *pS = getShard(hashValue);
+
+	pthread_mutex_lock(&pS->mutex);
+	StringPoolEntry *pE = findEntry(pS, hashValue, pString);
+	if (pE->pS)
+	{
+	    const unsigned long id = pE->id;
+	    pthread_mutex_unlock(&pS->mutex);
+	    return id;
+	}
+
+	const char *pCopy = arenaCopy(pS, pString);
+	const unsigned long id =
+	    __atomic_fetch_add(&nextId, 1, __ATOMIC_ACQ_REL);
+	__atomic_store_n(getSlot(id), pCopy, __ATOMIC_RELEASE);
+
+	pE->hashValue = hashValue;
+	pE->pS = pCopy;
+	pE->id = id;
+	if (++pS->count * 2 > pS->mask + 1)
+	    growTable(pS);
+
+	pthread_mutex_unlock(&pS->mutex);
+
+	/* count the string once all those with lower IDs are counted */
+	while(__atomic_load_n(&nPublished, __ATOMIC_ACQUIRE) != id)
+	    sched_yield();
+	__atomic_store_n(&nPublished, id + 1, __ATOMIC_RELEASE);
+	return id;
+    }
+
+    unsigned long StringPool::find(const char *pString) const
+    {
+	const unsigned long long hashValue = hashString(pString);
+	StringPoolShard *pS = getShard(hashValue);
+
+	pthread_mutex_lock(&pS->mutex);
+	const StringPoolEntry *pE = findEntry(pS, hashValue, pString);
+	const unsigned long id = pE->pS ? pE->id : notFound;
+	pthread_mutex_unlock(&pS->mutex);
+
+	return id;
+    }
+
+    const char *StringPool::getString(unsigned long id) const
+    {
+	unsigned long offset;
+	const unsigned chunk = chunkOf(id, &offset);
+
+	const char *const *ppC =
+	    __atomic_load_n(&ppChunk[chunk], __ATOMIC_ACQUIRE);
+	return __atomic_load_n(&ppC[offset], __ATOMIC_ACQUIRE);
+    }
+
+} // namespace phoenix4cpp
@@ -0,0 +1,194 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    TimerWheel.cpp - see ../include/TimerWheel.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Slots hold TimerWheelMemberships directly, at offset zero, and the
+    wheel converts them to client elements with the membership offset it
+    was given, so there is no code instantiated per element type.
+
+    A timer's level is found from the highest set bit of the exclusive or
+    of its expiry time and the current time.  A slot at level L is due to
+    be cascaded on the tick whose low 8 * L bits are zero and whose higher
+    bytes match the slot's timers' expiry times.  Timers cascaded from it
+    are placed relative to that tick, and so they always land on a lower
+    level.  The tick's byte at each level below L is zero, so they can
+    only land in a slot that is due on the same tick if they expire on
+    that very tick, in which case they go in the level 0 slot that is
+    about to fire.  Levels are cascaded before level 0 fires, so they
+    aren't missed.
+
+    Ticks on which nothing happens are skipped by looking for the first
+    occupied slot after the current time's position on each level.  This
+    reads list heads rather than keeping occupancy bitmaps, because
+    cancelling a timer doesn't involve the wheel, so the wheel couldn't
+    clear a bitmap's bits.
+ */
+
+#ifndef PHOENIX4CPP_TIMERWHEEL_H
+#include "TimerWheel.h"
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline TimerWheelMembership *TimerWheelBase::toMembership(
+	const void *pElement) const
+    {
+	return (TimerWheelMembership *)(((char *)pElement) + membershipOffset);
+    }
+
+    inline void *TimerWheelBase::toElement(
+	const TimerWheelMembership *pMembership) const
+    {
+	return (void *)(((char *)pMembership) - membershipOffset);
+    }
+
+    inline void TimerWheelBase::place(TimerWheelMembership *pM)
+    {
+	/* a cascaded timer may be due now, in the slot that is about to fire */
+	const unsigned long long differ = pM->expiry ^ now;
+	if (!differ)
+	{
+	    slot[0][now & (nSlots - 1)].append(pM);
+	    return;
+	}
+
+	const unsigned level = (63 - __builtin_clzll(differ)) / slotBits;
+	const unsigned index =
+	    (unsigned)(pM->expiry >> (level * slotBits)) & (nSlots - 1);
+
+	slot[level][index].append(pM);
+    }
+
+    void TimerWheelBase::cascade(unsigned level)
+    {
+	Slot *pSlot =
+	    &slot[level][(now >> (level * slotBits)) & (nSlots - 1)];
+
+	TimerWheelMembership *pM;
+	while((pM = pSlot->getFirst()))
+	{
+	    pSlot->remove(pM);
+	    place(pM);
+	}
+    }
+
+    TimerWheelBase::TimerWheelBase(size_t mOffset, unsigned long long n):
+	now(n),
+	membershipOffset(mOffset)
+    {
+    }
+
+    TimerWheelBase::~TimerWheelBase()
+    {
+	/* the slots' destructors would otherwise delete the memberships */
+	cancelAll();
+    }
+
+    void TimerWheelBase::cancelAll()
+    {
+	for(unsigned level = 0; level < nLevels; ++level)
+	{
+	    for(unsigned index = 0; index < nSlots; ++index)
+	    {
+		TimerWheelMembership *pM;
+		while((pM = slot[level][index].getFirst()))
+		    pM->remove();
+	    }
+	}
+    }
+
+    void TimerWheelBase::arm(void *pElement, unsigned long long expiry)
+    {
+	TimerWheelMembership *pM = toMembership(pElement);
+	pM->remove();
+
+	/* anything already due fires on the next tick */
+	pM->expiry = (expiry > now ? expiry : now + 1);
+	place(pM);
+    }
+
+    unsigned long long TimerWheelBase::nextEvent() const
+    {
+	/*
+	  Every armed timer is in a slot that comes after the current time's
+	  byte at its level, and all of level L's slots come due before any
+	  of level L + 1's, so the first occupied slot found is the next one
+	  to come due.
+	*/
+	for(unsigned level = 0; level < nLevels; ++level)
+	{
+	    const unsigned shift = level * slotBits;
+	    const unsigned current = (unsigned)(now >> shift) & (nSlots - 1);
+	    for(unsigned index = current + 1; index < nSlots; ++index)
+	    {
+		if (!slot[level][index].isEmpty())
+		{
+		    /* keep the higher bytes, and zero the lower ones */
+		    const unsigned long long high = (shift + slotBits < 64 ?
+			(now >> (shift + slotBits)) << (shift + slotBits) : 0);
+		    return high | ((unsigned long long)index << shift);
+		}
+	    }
+	}
+
+	return 0;
+    }
+
+    size_t TimerWheelBase::advance(
+	unsigned long long newNow, void (*fire)(void *pContext, void *pElement),
+	void *pContext)
+    {
+	size_t nFired = 0;
+
+	while(now < newNow)
+	{
+	    /* skip straight to the next tick that has anything to do */
+	    const unsigned long long next = nextEvent();
+	    if (!next || (next > newNow))
+	    {
+		now = newNow;
+		break;
+	    }
+	    now = next;
+
+	    /* cascade every level whose lower bytes have all rolled over */
+	    for(unsigned level = 1; level < nLevels; ++level)
+	    {
+		if (now & ((1ULL << (level * slotBits)) - 1))
+		    break;
+		cascade(level);
+	    }
+
+	    /*
+	      Take the timers off one at a time, because the callback may
+	      cancel others on the same slot, or arm new ones, which will be
+	      for later ticks.
+	    */
+	    Slot *pSlot = &slot[0][now & (nSlots - 1)];
+	    TimerWheelMembership *pM;
+	    while((pM = pSlot->getFirst()))
+	    {
+		pSlot->remove(pM);
+		++nFired;
+		(*fire)(pContext, toElement(pM));
+	    }
+	}
+
+	return nFired;
+    }
+
+} // namespace phoenix4cpp
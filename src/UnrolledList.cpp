@@ -0,0 +1,195 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    UnrolledList.cpp - see ../include/UnrolledList.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Only the last chunk has free slots at its end, and only the first has
+    unused slots at its beginning, left by removeFirst().  Every chunk in
+    the list has at least one element in it.
+
+    removeIf() makes a single pass with a read position and a write
+    position, both of which go from chunk to chunk; the write position
+    can't get ahead of the read position, so elements are never
+    overwritten before they have been read.  The chunks after the last one
+    written to are freed at the end.
+ */
+
+#ifndef PHOENIX4CPP_UNROLLEDLIST_H
+#include "UnrolledList.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTDLIB_H
+#include <cstdlib>
+#define PHOENIX4CPP_CSTDLIB_H
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifndef PHOENIX4CPP_NEW_H
+#include <new>
+#define PHOENIX4CPP_NEW_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+    /* a chunk must hold at least this many elements */
+    static const size_t minChunkElements = 4;
+
+    /*
+      These methods are private; we declare them first so that they can be
+      inlined in this file.
+     */
+    inline UnrolledListChunk *UnrolledListBase::newChunk()
+    {
+	void *p;
+	if (posix_memalign(&p, chunkBytes, chunkBytes))
+	    throw std::bad_alloc();
+
+	UnrolledListChunk *pChunk = (UnrolledListChunk *)p;
+	pChunk->pNext = NULL;
+	pChunk->pPrevious = pTail;
+	pChunk->begin = 0;
+	pChunk->end = 0;
+
+	if (pTail)
+	    pTail->pNext = pChunk;
+	else
+	    pHead = pChunk;
+	pTail = pChunk;
+	return pChunk;
+    }
+
+    inline void UnrolledListBase::freeChunk(UnrolledListChunk *pChunk)
+    {
+	if (pChunk->pPrevious)
+	    pChunk->pPrevious->pNext = pChunk->pNext;
+	else
+	    pHead = pChunk->pNext;
+	if (pChunk->pNext)
+	    pChunk->pNext->pPrevious = pChunk->pPrevious;
+	else
+	    pTail = pChunk->pPrevious;
+
+	free(pChunk);
+    }
+
+    UnrolledListBase::UnrolledListBase(size_t eSize, size_t cBytes):
+	pHead(NULL),
+	pTail(NULL),
+	count(0),
+	elementSize(eSize),
+	chunkBytes(64),
+	capacity(0)
+    {
+	while((chunkBytes < cBytes) ||
+	      (chunkBytes < sizeof(UnrolledListChunk) +
+	       minChunkElements * elementSize))
+	    chunkBytes <<= 1;
+
+	capacity = (chunkBytes - sizeof(UnrolledListChunk)) / elementSize;
+    }
+
+    UnrolledListBase::~UnrolledListBase()
+    {
+	clear();
+    }
+
+    void UnrolledListBase::clear()
+    {
+	while(pHead)
+	    freeChunk(pHead);
+	count = 0;
+    }
+
+    void *UnrolledListBase::append(const void *pElement)
+    {
+	UnrolledListChunk *pChunk = pTail;
+	if (!pChunk || (pChunk->end == capacity))
+	    pChunk = newChunk();
+
+	char *pSlot = getSlots(pChunk) + pChunk->end * elementSize;
+	memcpy(pSlot, pElement, elementSize);
+	++pChunk->end;
+	++count;
+	return pSlot;
+    }
+
+    void UnrolledListBase::removeFirst(size_t n)
+    {
+	while(n && pHead)
+	{
+	    const size_t inHead = pHead->end - pHead->begin;
+	    if (n < inHead)
+	    {
+		pHead->begin += n;
+		count -= n;
+		return;
+	    }
+
+	    n -= inHead;
+	    count -= inHead;
+	    freeChunk(pHead);
+	}
+    }
+
+    size_t UnrolledListBase::removeIf(
+	bool (*remove)(void *pContext, const void *pElement), void *pContext)
+    {
+	if (!pHead)
+	    return 0;
+
+	UnrolledListChunk *pWrite = pHead;
+	size_t write = pHead->begin;
+	size_t kept = 0;
+	for(UnrolledListChunk *pRead = pHead; pRead; pRead = pRead->pNext)
+	{
+	    const char *pElement = getSlots(pRead) + pRead->begin * elementSize;
+	    for(size_t i = pRead->end - pRead->begin; i;
+		--i, pElement += elementSize)
+	    {
+		if ((*remove)(pContext, pElement))
+		    continue;
+
+		if (write == capacity)
+		{
+		    pWrite->end = capacity;
+		    pWrite = pWrite->pNext;
+		    pWrite->begin = 0;
+		    write = 0;
+		}
+
+		char *pSlot = getSlots(pWrite) + write * elementSize;
+		if (pSlot != pElement)
+		    memcpy(pSlot, pElement, elementSize);
+		++write;
+		++kept;
+	    }
+	}
+
+	const size_t removed = count - kept;
+	if (!kept)
+	{
+	    clear();
+	    return removed;
+	}
+
+	pWrite->end = write;
+	while(pTail != pWrite)
+	    freeChunk(pTail);
+	count = kept;
+	return removed;
+    }
+
+} // namespace phoenix4cpp
@@ -13,6 +13,10 @@
     Classic binary search, with the minor optimization that we take advantage
     of the three-valued return from the comparison function, and stop
     immediately if we get back a zero.
+
+    lowerBound() can't stop early, because it has to find the first of any
+    matching elements; it narrows the range until it is empty, keeping the
+    answer just past the end of the part known to be less than the key.
  */
 
 #ifndef PHOENIX4CPP_BSEARCH_H
@@ -57,4 +61,27 @@ void *bsearch(const void *pKey, const void *pArray, size_t n, size_t size,
     return NULL;
 }
 
+void *lowerBound(const void *pKey, const void *pArray, size_t n, size_t size,
+		 size_t keyOffset, int (*cmp)(const void *pl, const void *pr))
+{
+    size_t mid;       /* the middle array element's index */
+    const char *pMid; /* a pointer to the middle array element */
+
+    while(n)
+    {
+	mid = n / 2;
+	pMid = ((const char *)pArray) + mid * size;
+	if ((*cmp)(pKey, (const void *)(pMid + keyOffset)) <= 0)
+	    n = mid;  /* the answer is at or before the midpoint */
+	else
+	{
+	    /* the answer is after the midpoint */
+	    n -= mid + 1;
+	    pArray = pMid + size;
+	}
+    }
+
+    return (void *)pArray;
+}
+
 } // namespace phoenix4cpp
@@ -30,6 +30,11 @@
 namespace phoenix4cpp
 {
 
+    void hashCharStar(HashValue *pHashValue, const char *const *pps)
+    {
+	pHashValue->blend(*pps);
+    }
+
     void hashUnsignedLong(HashValue *pHashValue, const unsigned long *p)
     {
 	pHashValue->blend(p, sizeof(*p));
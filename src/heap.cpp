@@ -0,0 +1,256 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    heap.cpp - see ../include/heap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The children of element i are elements 4i+1 through 4i+4, and its
+    parent is element (i-1)/4.
+
+    Sifting takes the element being placed out of the array into a
+    temporary, and moves the hole it leaves up or down until the element
+    fits.  Small elements use a buffer on the stack; the union keeps the
+    buffer aligned for whatever the key is, since the comparison function
+    is called on the key inside it.  Large ones use the calling thread's
+    arena (see Arena.h), rather than calling new and delete for every
+    push and pop.
+
+    As in qsort.cpp, the implementation works in terms of (char *) to avoid
+    casts for bytewise pointer arithmetic.
+ */
+
+#ifndef PHOENIX4CPP_HEAP_H
+#include "heap.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+static const size_t heapArity = 4;
+
+/* storage for one element while it is out of the array */
+class HeapTemp
+{
+public:
+    HeapTemp(size_t size);
+    ~HeapTemp();
+
+    char *get();
+
+private:
+    HeapTemp(const HeapTemp &);
+    HeapTemp &operator=(const HeapTemp &);
+
+    union
+    {
+	char c[128];
+	double d;
+	long long ll;
+	void *p;
+    } buffer;
+    char *pHeap;
+
+    /* large elements are held in the thread's arena */
+    Arena *pArena;
+    ArenaMark m;
+};
+
+inline HeapTemp::HeapTemp(size_t size):
+    pHeap(NULL),
+    pArena(NULL)
+{
+    if (size > sizeof(buffer))
+    {
+	pArena = Arena::getThreadArena();
+	m = pArena->mark();
+	pHeap = (char *)pArena->allocate(size, 16);
+    }
+}
+
+inline HeapTemp::~HeapTemp()
+{
+    if (pArena)
+	pArena->rewind(m);
+}
+
+inline char *HeapTemp::get()
+{
+    return (pHeap ? pHeap : buffer.c);
+}
+
+/*
+  Copy one element.  memcpy() with a constant size is inlined as a few
+  moves, so the common sizes are dispatched to those.
+*/
+static inline void heapCopy(char *pDst, const char *pSrc, size_t size)
+{
+    switch(size)
+    {
+    case 4:
+	memcpy(pDst, pSrc, 4);
+	break;
+    case 8:
+	memcpy(pDst, pSrc, 8);
+	break;
+    case 16:
+	memcpy(pDst, pSrc, 16);
+	break;
+    case 24:
+	memcpy(pDst, pSrc, 24);
+	break;
+    case 32:
+	memcpy(pDst, pSrc, 32);
+	break;
+    default:
+	memcpy(pDst, pSrc, size);
+	break;
+    }
+}
+
+/* returns the index of the smallest child of i, which must have one */
+static inline size_t heapLeastChild(
+    const char *pA, size_t n, size_t i, size_t size, size_t keyOffset,
+    int (*cmp)(const void *pl, const void *pr))
+{
+    const size_t first = i * heapArity + 1;
+    const size_t end = (n - first > heapArity ? first + heapArity : n);
+    size_t least = first;
+    const char *pLeast = pA + first * size + keyOffset;
+    for(size_t child = first + 1; child < end; ++child)
+    {
+	const char *const pChild = pA + child * size + keyOffset;
+	if ((*cmp)(pChild, pLeast) < 0)
+	{
+	    least = child;
+	    pLeast = pChild;
+	}
+    }
+
+    return least;
+}
+
+/*
+  Move the hole at i up until the element in pTemp fits, and put it there.
+*/
+static inline void heapSiftUp(
+    char *pA, size_t i, size_t size, size_t keyOffset,
+    int (*cmp)(const void *pl, const void *pr), const char *pTemp)
+{
+    const void *const pKey = pTemp + keyOffset;
+    while(i)
+    {
+	const size_t parent = (i - 1) / heapArity;
+	const char *const pParent = pA + parent * size;
+	if ((*cmp)(pKey, pParent + keyOffset) >= 0)
+	    break;
+
+	heapCopy(pA + i * size, pParent, size);
+	i = parent;
+    }
+
+    heapCopy(pA + i * size, pTemp, size);
+}
+
+/*
+  Move the hole at i down, among the first n elements, until the element in
+  pTemp fits, and put it there.
+*/
+static inline void heapSiftDown(
+    char *pA, size_t n, size_t i, size_t size, size_t keyOffset,
+    int (*cmp)(const void *pl, const void *pr), const char *pTemp)
+{
+    const void *const pKey = pTemp + keyOffset;
+    while(i * heapArity + 1 < n)
+    {
+	const size_t least = heapLeastChild(pA, n, i, size, keyOffset, cmp);
+	const char *const pLeast = pA + least * size;
+	if ((*cmp)(pLeast + keyOffset, pKey) >= 0)
+	    break;
+
+	heapCopy(pA + i * size, pLeast, size);
+	i = least;
+    }
+
+    heapCopy(pA + i * size, pTemp, size);
+}
+
+void makeHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	      int (*cmp)(const void *pl, const void *pr))
+{
+    if (n < 2)
+	return;
+
+    char *const pA = (char *)pArray;
+    HeapTemp temp(size);
+    char *const pTemp = temp.get();
+
+    /* sift down every element that has children, from the last one up */
+    for(size_t i = (n - 2) / heapArity + 1; i--;)
+    {
+	heapCopy(pTemp, pA + i * size, size);
+	heapSiftDown(pA, n, i, size, keyOffset, cmp, pTemp);
+    }
+}
+
+void pushHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	      int (*cmp)(const void *pl, const void *pr))
+{
+    if (n < 2)
+	return;
+
+    char *const pA = (char *)pArray;
+    HeapTemp temp(size);
+    char *const pTemp = temp.get();
+    heapCopy(pTemp, pA + (n - 1) * size, size);
+    heapSiftUp(pA, n - 1, size, keyOffset, cmp, pTemp);
+}
+
+void popHeap(void *pArray, size_t n, size_t size, size_t keyOffset,
+	     int (*cmp)(const void *pl, const void *pr))
+{
+    if (n < 2)
+	return;
+
+    /*
+      The last element comes out, and the smallest takes its place.  The
+      last element almost always belongs near the bottom, so rather than
+      comparing it against the smallest child at each level on the way
+      down, the hole is moved all the way to the bottom first, and the
+      element is sifted up from there.  That saves a comparison per level,
+      and the sift up is usually short.
+    */
+    char *const pA = (char *)pArray;
+    HeapTemp temp(size);
+    char *const pTemp = temp.get();
+    char *const pLast = pA + (n - 1) * size;
+    heapCopy(pTemp, pLast, size);
+    heapCopy(pLast, pA, size);
+
+    --n;
+    size_t i = 0;
+    while(i * heapArity + 1 < n)
+    {
+	const size_t least = heapLeastChild(pA, n, i, size, keyOffset, cmp);
+	heapCopy(pA + i * size, pA + least * size, size);
+	i = least;
+    }
+    heapSiftUp(pA, i, size, keyOffset, cmp, pTemp);
+}
+
+} // namespace phoenix4cpp
@@ -0,0 +1,174 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    merge.cpp - see ../include/merge.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Node 0 of the loser tree holds the winner, and nodes 1 to nLeaves - 1
+    hold the loser of the match played there, with node i's children at
+    2i and 2i + 1.  Leaves are numbered from nLeaves, so source i's leaf
+    is nLeaves + i, and its parent is (nLeaves + i) / 2.  Leaves beyond
+    the number of sources never have a record, so they lose every match.
+
+    kwayMerge() keeps the tree and the ends of the arrays in the calling
+    thread's arena (see Arena.h).  When de-duplicating, the last record
+    kept is remembered, and a winner with the same key is skipped; the
+    inputs don't move, so that pointer stays good.
+
+    As in qsort.cpp, the implementation works in terms of (char *) to avoid
+    casts for bytewise pointer arithmetic.
+ */
+
+#ifndef PHOENIX4CPP_MERGE_H
+#include "merge.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+
+namespace phoenix4cpp
+{
+
+LoserTree::LoserTree(size_t k, size_t kOffset,
+		     int (*c)(const void *pl, const void *pr),
+		     Arena *pArena):
+    nLeaves(1),
+    keyOffset(kOffset),
+    cmp(c),
+    pNode(NULL),
+    ppRecord(NULL),
+    ownMemory(!pArena)
+{
+    while(nLeaves < k)
+	nLeaves <<= 1;
+
+    if (pArena)
+    {
+	pNode = pArena->allocateArray<size_t>(nLeaves);
+	ppRecord = pArena->allocateArray<const char *>(nLeaves);
+    }
+    else
+    {
+	pNode = new size_t[nLeaves];
+	ppRecord = new const char *[nLeaves];
+    }
+
+    for(size_t i = 0; i < nLeaves; ++i)
+    {
+	pNode[i] = 0;
+	ppRecord[i] = NULL;
+    }
+}
+
+LoserTree::~LoserTree()
+{
+    if (ownMemory)
+    {
+	delete[] pNode;
+	delete[] ppRecord;
+    }
+}
+
+/* @returns the winner of the subtree under node */
+size_t LoserTree::play(size_t node)
+{
+    if (node >= nLeaves)
+	return node - nLeaves;
+
+    const size_t l = play(2 * node);
+    const size_t r = play(2 * node + 1);
+    if (beats(r, l))
+    {
+	pNode[node] = l;
+	return r;
+    }
+    pNode[node] = r;
+    return l;
+}
+
+void LoserTree::start()
+{
+    pNode[0] = play(1);
+}
+
+static size_t kwayMergeInto(const void *const *ppArray, const size_t *pN,
+			    size_t k, size_t size, size_t keyOffset,
+			    int (*cmp)(const void *pl, const void *pr),
+			    char *pOut,
+			    void (*emit)(void *pContext, const void *pRecord),
+			    void *pContext, bool unique)
+{
+    if (!k)
+	return 0;
+
+    Arena *const pArena = Arena::getThreadArena();
+    ArenaScope scope(pArena);
+    LoserTree tree(k, keyOffset, cmp, pArena);
+    const char **ppEnd = pArena->allocateArray<const char *>(k);
+    for(size_t i = 0; i < k; ++i)
+    {
+	const char *pArray = (const char *)ppArray[i];
+	ppEnd[i] = pArray + pN[i] * size;
+	tree.set(i, pN[i] ? pArray : NULL);
+    }
+    tree.start();
+
+    size_t nOut = 0;
+    const char *pLast = NULL;
+    const char *pRecord;
+    while((pRecord = (const char *)tree.getWinnerRecord()))
+    {
+	if (!unique || !pLast ||
+	    (*cmp)(pLast + keyOffset, pRecord + keyOffset))
+	{
+	    if (pOut)
+	    {
+		memcpy(pOut, pRecord, size);
+		pOut += size;
+	    }
+	    else
+		(*emit)(pContext, pRecord);
+	    pLast = pRecord;
+	    ++nOut;
+	}
+
+	const char *pNext = pRecord + size;
+	tree.advance(pNext < ppEnd[tree.getWinner()] ? pNext : NULL);
+    }
+
+    return nOut;
+}
+
+size_t kwayMerge(const void *const *ppArray, const size_t *pN, size_t k,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 void *pOut, bool unique)
+{
+    return kwayMergeInto(ppArray, pN, k, size, keyOffset, cmp,
+			 (char *)pOut, NULL, NULL, unique);
+}
+
+size_t kwayMerge(const void *const *ppArray, const size_t *pN, size_t k,
+		 size_t size, size_t keyOffset,
+		 int (*cmp)(const void *pl, const void *pr),
+		 void (*emit)(void *pContext, const void *pRecord),
+		 void *pContext, bool unique)
+{
+    return kwayMergeInto(ppArray, pN, k, size, keyOffset, cmp,
+			 NULL, emit, pContext, unique);
+}
+
+} // namespace phoenix4cpp
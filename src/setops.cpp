@@ -0,0 +1,493 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    setops.cpp - see ../include/setops.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Intersection and difference are the same walk over the first set,
+    keeping either the values that are found in the second set or the
+    ones that aren't, so each algorithm is written once, as a filter with
+    a template flag that says which to keep.  The unsigned and unsigned
+    long versions are instances of the same templates, except for the
+    SSE2 comparison of a pair of blocks.
+
+    The block merge remembers which values of the current block of the
+    first set have been found, across however many blocks of the second
+    set it takes to pass it, and only emits the block when it moves on.
+    When one of the sets runs out of whole blocks, the scalar merge
+    finishes the job, once the current block of the first set has been
+    checked against the rest of the second.
+
+    The results are written in order, never ahead of the value of the
+    first set being read, which is why pOut may be the same as pA.  When
+    galloping, intersection walks the smaller set, whichever that is; a
+    value written then is never ahead of the one it matched in the larger
+    set, and the search never goes back.
+ */
+
+#ifndef PHOENIX4CPP_SETOPS_H
+#include "setops.h"
+#endif
+
+#ifndef PHOENIX4CPP_ARENA_H
+#include "Arena.h"
+#endif
+
+#ifndef PHOENIX4CPP_CSTRING_H
+#include <cstring>
+#define PHOENIX4CPP_CSTRING_H
+#endif
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+namespace phoenix4cpp
+{
+
+/*
+  Gallop when the larger set is at least this many times the size of
+  the smaller; see benchsrc/benchsetops.cpp.
+*/
+static const size_t gallopRatio = 32;
+
+/*
+  These functions are private; we declare them first so that they can be
+  inlined in this file.
+*/
+
+static inline SetAlgorithm chooseAlgorithm(size_t nA, size_t nB)
+{
+    const size_t small = nA < nB ? nA : nB;
+    const size_t large = nA < nB ? nB : nA;
+    if (small * gallopRatio <= large)
+	return SET_GALLOP;
+#ifdef __SSE2__
+    return SET_SIMD;
+#else
+    return SET_MERGE;
+#endif
+}
+
+/* @returns the first position at or after low not less than value */
+template<class V>
+static inline size_t gallop(const V *p, size_t low, size_t n, V value)
+{
+    if ((low >= n) || !(p[low] < value))
+	return low;
+
+    /* p[low] < value all along; the answer is in (low, high] */
+    size_t step = 1;
+    size_t high = low + 1;
+    while((high < n) && (p[high] < value))
+    {
+	low = high;
+	step <<= 1;
+	high = low + step;
+    }
+    if (high > n)
+	high = n;
+
+    ++low;
+    while(low < high)
+    {
+	const size_t middle = low + (high - low) / 2;
+	if (p[middle] < value)
+	    low = middle + 1;
+	else
+	    high = middle;
+    }
+    return low;
+}
+
+/*
+  Merge from pA[i] and pB[j] onwards, keeping the values of A that are
+  (or aren't) in B.
+*/
+template<class V, bool keep>
+static size_t mergeFilter(const V *pA, size_t i, size_t nA,
+			  const V *pB, size_t j, size_t nB,
+			  V *pOut, size_t nOut)
+{
+    while((i < nA) && (j < nB))
+    {
+	const V a = pA[i];
+	const V b = pB[j];
+	if (a < b)
+	{
+	    if (!keep)
+		pOut[nOut++] = a;
+	    ++i;
+	}
+	else if (b < a)
+	    ++j;
+	else
+	{
+	    if (keep)
+		pOut[nOut++] = a;
+	    ++i;
+	    ++j;
+	}
+    }
+
+    if (!keep)
+    {
+	memmove(pOut + nOut, pA + i, (nA - i) * sizeof(V));
+	nOut += nA - i;
+    }
+    return nOut;
+}
+
+/* as above, but galloping through B for each value of A */
+template<class V, bool keep>
+static size_t gallopFilter(const V *pA, size_t nA, const V *pB,
+			   size_t nB, V *pOut)
+{
+    size_t nOut = 0;
+    size_t j = 0;
+    for(size_t i = 0; i < nA; ++i)
+    {
+	const V a = pA[i];
+	j = gallop(pB, j, nB, a);
+	if (((j < nB) && (pB[j] == a)) == keep)
+	    pOut[nOut++] = a;
+    }
+    return nOut;
+}
+
+/*
+  Remove the values of a small set B from a large set A, galloping
+  through A for each value of B, and copying the runs in between.
+*/
+template<class V>
+static size_t gallopRemove(const V *pA, size_t nA, const V *pB,
+			   size_t nB, V *pOut)
+{
+    size_t nOut = 0;
+    size_t i = 0;
+    for(size_t j = 0; (j < nB) && (i < nA); ++j)
+    {
+	const size_t next = gallop(pA, i, nA, pB[j]);
+	memmove(pOut + nOut, pA + i, (next - i) * sizeof(V));
+	nOut += next - i;
+	i = next;
+	if ((i < nA) && (pA[i] == pB[j]))
+	    ++i;
+    }
+    memmove(pOut + nOut, pA + i, (nA - i) * sizeof(V));
+    return nOut + nA - i;
+}
+
+#ifdef __SSE2__
+/* @returns a bit for each of the four values of A that is in B */
+static inline unsigned matchBlock(const unsigned *pA, const unsigned *pB)
+{
+    const __m128i a = _mm_loadu_si128((const __m128i *)pA);
+    const __m128i b = _mm_loadu_si128((const __m128i *)pB);
+    __m128i m = _mm_cmpeq_epi32(a, b);
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(
+			 a, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 1))));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(
+			 a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2))));
+    m = _mm_or_si128(m, _mm_cmpeq_epi32(
+			 a, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 1, 0, 3))));
+    return (unsigned)_mm_movemask_ps(_mm_castsi128_ps(m));
+}
+
+/*
+  @returns a bit for each of the two values of A that is in B
+
+  SSE2 has no 64-bit compare, so the halves are compared separately,
+  and a value matches if both of its halves do.
+*/
+static inline unsigned matchBlock(const unsigned long *pA,
+				  const unsigned long *pB)
+{
+    const __m128i a = _mm_loadu_si128((const __m128i *)pA);
+    const __m128i b = _mm_loadu_si128((const __m128i *)pB);
+    const __m128i e0 = _mm_cmpeq_epi32(a, b);
+    const __m128i e1 = _mm_cmpeq_epi32(
+	a, _mm_shuffle_epi32(b, _MM_SHUFFLE(1, 0, 3, 2)));
+    const __m128i m = _mm_or_si128(
+	_mm_and_si128(e0, _mm_shuffle_epi32(e0, _MM_SHUFFLE(2, 3, 0, 1))),
+	_mm_and_si128(e1, _mm_shuffle_epi32(e1, _MM_SHUFFLE(2, 3, 0, 1))));
+    return (unsigned)_mm_movemask_pd(_mm_castsi128_pd(m));
+}
+#endif
+
+template<class V, bool keep>
+static size_t blockFilter(const V *pA, size_t nA, const V *pB,
+			  size_t nB, V *pOut)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t nOut = 0;
+
+#ifdef __SSE2__
+    /* a block is one vector */
+    const size_t lanes = 16 / sizeof(V);
+    unsigned found = 0;
+    if ((nA >= lanes) && (nB >= lanes))
+    {
+	for(;;)
+	{
+	    found |= matchBlock(pA + i, pB + j);
+	    const V aLast = pA[i + lanes - 1];
+	    const V bLast = pB[j + lanes - 1];
+	    if (!(bLast < aLast))
+	    {
+		for(size_t l = 0; l < lanes; ++l)
+		{
+		    if ((bool)((found >> l) & 1) == keep)
+			pOut[nOut++] = pA[i + l];
+		}
+		found = 0;
+		i += lanes;
+		if (i + lanes > nA)
+		    break;
+	    }
+	    if (!(aLast < bLast))
+	    {
+		j += lanes;
+		if (j + lanes > nB)
+		    break;
+	    }
+	}
+
+	/*
+	  If B ran out of blocks first, some of the current block of A may
+	  already have been found; check the rest against what's left of B.
+	*/
+	if (j + lanes > nB)
+	{
+	    for(const size_t end = i + lanes; i < end; ++i, found >>= 1)
+	    {
+		bool in = found & 1;
+		if (!in)
+		{
+		    j = gallop(pB, j, nB, pA[i]);
+		    in = (j < nB) && (pB[j] == pA[i]);
+		}
+		if (in == keep)
+		    pOut[nOut++] = pA[i];
+	    }
+	}
+    }
+#endif
+
+    return mergeFilter<V, keep>(pA, i, nA, pB, j, nB, pOut, nOut);
+}
+
+template<class V>
+static size_t intersection(const V *pA, size_t nA, const V *pB,
+			   size_t nB, V *pOut, SetAlgorithm algorithm)
+{
+    if (algorithm == SET_AUTO)
+	algorithm = chooseAlgorithm(nA, nB);
+
+    switch(algorithm)
+    {
+    case SET_GALLOP:
+	if (nA <= nB)
+	    return gallopFilter<V, true>(pA, nA, pB, nB, pOut);
+	return gallopFilter<V, true>(pB, nB, pA, nA, pOut);
+
+    case SET_SIMD:
+	return blockFilter<V, true>(pA, nA, pB, nB, pOut);
+
+    default:
+	return mergeFilter<V, true>(pA, 0, nA, pB, 0, nB, pOut, 0);
+    }
+}
+
+template<class V>
+static size_t difference(const V *pA, size_t nA, const V *pB,
+			 size_t nB, V *pOut, SetAlgorithm algorithm)
+{
+    if (algorithm == SET_AUTO)
+	algorithm = chooseAlgorithm(nA, nB);
+
+    switch(algorithm)
+    {
+    case SET_GALLOP:
+	if (nA <= nB)
+	    return gallopFilter<V, false>(pA, nA, pB, nB, pOut);
+	return gallopRemove(pA, nA, pB, nB, pOut);
+
+    case SET_SIMD:
+	return blockFilter<V, false>(pA, nA, pB, nB, pOut);
+
+    default:
+	return mergeFilter<V, false>(pA, 0, nA, pB, 0, nB, pOut, 0);
+    }
+}
+
+template<class V>
+static size_t mergeUnion(const V *pA, size_t nA, const V *pB, size_t nB,
+			 V *pOut)
+{
+    size_t i = 0;
+    size_t j = 0;
+    size_t nOut = 0;
+    while((i < nA) && (j < nB))
+    {
+	const V a = pA[i];
+	const V b = pB[j];
+	if (a < b)
+	{
+	    pOut[nOut++] = a;
+	    ++i;
+	}
+	else if (b < a)
+	{
+	    pOut[nOut++] = b;
+	    ++j;
+	}
+	else
+	{
+	    pOut[nOut++] = a;
+	    ++i;
+	    ++j;
+	}
+    }
+    memcpy(pOut + nOut, pA + i, (nA - i) * sizeof(V));
+    nOut += nA - i;
+    memcpy(pOut + nOut, pB + j, (nB - j) * sizeof(V));
+    return nOut + nB - j;
+}
+
+/* the union of a small set S and a large set L */
+template<class V>
+static size_t gallopUnion(const V *pS, size_t nS, const V *pL, size_t nL,
+			  V *pOut)
+{
+    size_t nOut = 0;
+    size_t i = 0;
+    for(size_t j = 0; j < nS; ++j)
+    {
+	const V s = pS[j];
+	const size_t next = gallop(pL, i, nL, s);
+	memcpy(pOut + nOut, pL + i, (next - i) * sizeof(V));
+	nOut += next - i;
+	i = next;
+	if ((i < nL) && (pL[i] == s))
+	    ++i;
+	pOut[nOut++] = s;
+    }
+    memcpy(pOut + nOut, pL + i, (nL - i) * sizeof(V));
+    return nOut + nL - i;
+}
+
+template<class V>
+static size_t unionOf(const V *pA, size_t nA, const V *pB, size_t nB,
+		      V *pOut, SetAlgorithm algorithm)
+{
+    if (algorithm == SET_AUTO)
+	algorithm = chooseAlgorithm(nA, nB);
+
+    if (algorithm == SET_GALLOP)
+    {
+	if (nA <= nB)
+	    return gallopUnion(pA, nA, pB, nB, pOut);
+	return gallopUnion(pB, nB, pA, nA, pOut);
+    }
+    return mergeUnion(pA, nA, pB, nB, pOut);
+}
+
+template<class V>
+static size_t intersectionN(const V *const *ppSet, const size_t *pN,
+			    size_t k, V *pOut)
+{
+    if (!k)
+	return 0;
+
+    /* order the sets by size, smallest first */
+    Arena *const pArena = Arena::getThreadArena();
+    ArenaScope scope(pArena);
+    size_t *const pOrder = pArena->allocateArray<size_t>(k);
+    for(size_t i = 0; i < k; ++i)
+    {
+	size_t j = i;
+	for(; j && (pN[pOrder[j - 1]] > pN[i]); --j)
+	    pOrder[j] = pOrder[j - 1];
+	pOrder[j] = i;
+    }
+
+    size_t n = pN[pOrder[0]];
+    if (k == 1)
+    {
+	memcpy(pOut, ppSet[pOrder[0]], n * sizeof(V));
+	return n;
+    }
+
+    n = intersection(ppSet[pOrder[0]], n, ppSet[pOrder[1]],
+		     pN[pOrder[1]], pOut, SET_AUTO);
+    for(size_t i = 2; n && (i < k); ++i)
+	n = intersection((const V *)pOut, n, ppSet[pOrder[i]],
+			 pN[pOrder[i]], pOut, SET_AUTO);
+    return n;
+}
+
+
+size_t setIntersection(const unsigned *pA, size_t nA,
+		       const unsigned *pB, size_t nB, unsigned *pOut,
+		       SetAlgorithm algorithm)
+{
+    return intersection(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setIntersection(const unsigned long *pA, size_t nA,
+		       const unsigned long *pB, size_t nB,
+		       unsigned long *pOut, SetAlgorithm algorithm)
+{
+    return intersection(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setDifference(const unsigned *pA, size_t nA,
+		     const unsigned *pB, size_t nB, unsigned *pOut,
+		     SetAlgorithm algorithm)
+{
+    return difference(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setDifference(const unsigned long *pA, size_t nA,
+		     const unsigned long *pB, size_t nB,
+		     unsigned long *pOut, SetAlgorithm algorithm)
+{
+    return difference(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setUnion(const unsigned *pA, size_t nA,
+		const unsigned *pB, size_t nB, unsigned *pOut,
+		SetAlgorithm algorithm)
+{
+    return unionOf(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setUnion(const unsigned long *pA, size_t nA,
+		const unsigned long *pB, size_t nB, unsigned long *pOut,
+		SetAlgorithm algorithm)
+{
+    return unionOf(pA, nA, pB, nB, pOut, algorithm);
+}
+
+size_t setIntersectionN(const unsigned *const *ppSet, const size_t *pN,
+			size_t k, unsigned *pOut)
+{
+    return intersectionN(ppSet, pN, k, pOut);
+}
+
+size_t setIntersectionN(const unsigned long *const *ppSet,
+			const size_t *pN, size_t k, unsigned long *pOut)
+{
+    return intersectionN(ppSet, pN, k, pOut);
+}
+
+} // namespace phoenix4cpp
@@ -0,0 +1,219 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testArena.cpp - test Arena.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Every allocation is filled with a pattern derived from its number, and
+    all of the live ones are checked before anything is rewound, so that
+    overlapping allocations show up as a clobbered pattern.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include "Arena.h"
+
+using namespace phoenix4cpp;
+
+#define N_ALLOCATIONS 5000
+#define N_THREADS 4
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+struct Allocation
+{
+    unsigned char *p;
+    size_t size;
+};
+
+static void fill(const Allocation *pA, unsigned long i)
+{
+    memset(pA->p, (int)(i & 0xff), pA->size);
+}
+
+static void verify(const char *pWhat, const Allocation *pA, size_t n)
+{
+    for(size_t i = 0; i < n; ++i)
+    {
+	for(size_t j = 0; j < pA[i].size; ++j)
+	{
+	    if (pA[i].p[j] != (unsigned char)(i & 0xff))
+		fail(pWhat, i);
+	}
+    }
+}
+
+static size_t randomSize()
+{
+    /* mostly small, with the occasional big one */
+    if (!(rand() % 500))
+	return 1 + rand() % (2 << 20);
+    return 1 + rand() % 200;
+}
+
+static void testBasics()
+{
+    Arena arena(1000);
+    if ((arena.getChunkBytes() < 1000) || (arena.getChunkBytes() % 4096) ||
+	arena.getBytesMapped() || arena.getBytesUsed())
+	fail("empty arena", arena.getChunkBytes());
+
+    /* alignment */
+    for(size_t align = 1; align <= 4096; align <<= 1)
+    {
+	arena.allocate(1, 1);
+	void *p = arena.allocate(3, align);
+	if ((size_t)p % align)
+	    fail("alignment", align);
+    }
+    double *pD = arena.allocateArray<double>(10);
+    if ((size_t)pD % __alignof__(double))
+	fail("allocateArray", 0);
+
+    /* rewinding gives back the same memory */
+    const ArenaMark m = arena.mark();
+    const size_t used = arena.getBytesUsed();
+    void *p = arena.allocate(100);
+    arena.rewind(m);
+    if ((arena.allocate(100) != p) || (arena.getBytesUsed() != used + 100))
+	fail("rewind", arena.getBytesUsed());
+    arena.rewind(m);
+
+    /*
+      A big allocation gets a chunk of its own, which goes again on
+      rewind; rewinding across ordinary chunks keeps one of them.
+    */
+    const size_t mapped = arena.getBytesMapped();
+    unsigned char *pBig = (unsigned char *)arena.allocate(10 << 20);
+    memset(pBig, 1, 10 << 20);
+    if (arena.getBytesMapped() < mapped + (10 << 20))
+	fail("big allocation", arena.getBytesMapped());
+    arena.rewind(m);
+    if (arena.getBytesMapped() != mapped)
+	fail("big rewind", arena.getBytesMapped());
+
+    for(size_t i = 0; i < 10; ++i)
+	memset(arena.allocate(arena.getChunkBytes() / 2), 2,
+	       arena.getChunkBytes() / 2);
+    arena.rewind(m);
+    if (arena.getBytesMapped() != mapped + arena.getChunkBytes())
+	fail("spare chunk", arena.getBytesMapped());
+    if (arena.getBytesUsed() != used)
+	fail("used after rewind", arena.getBytesUsed());
+
+    /* ArenaScope */
+    {
+	ArenaScope scope(&arena);
+	arena.allocate(arena.getChunkBytes());
+    }
+    if (arena.getBytesUsed() != used)
+	fail("scope", arena.getBytesUsed());
+
+    arena.reset();
+    if (arena.getBytesUsed() ||
+	(arena.getBytesMapped() != arena.getChunkBytes()))
+	fail("reset", arena.getBytesMapped());
+}
+
+static void testRandom(Arena *pArena)
+{
+    static Allocation a[N_ALLOCATIONS];
+    static ArenaMark marks[N_ALLOCATIONS];
+    size_t n = 0;
+    for(unsigned round = 0; round < 20; ++round)
+    {
+	/* allocate some, then rewind to a random earlier point */
+	const size_t target = n + rand() % (N_ALLOCATIONS - n);
+	for(; n < target; ++n)
+	{
+	    marks[n] = pArena->mark();
+	    a[n].size = randomSize();
+	    a[n].p = (unsigned char *)pArena->allocate(a[n].size);
+	    fill(&a[n], n);
+	}
+	verify("random", a, n);
+
+	if (n)
+	{
+	    n = rand() % n;
+	    pArena->rewind(marks[n]);
+	}
+    }
+
+    pArena->rewind(marks[0]);
+    if (pArena->getBytesUsed())
+	fail("random rewind", pArena->getBytesUsed());
+}
+
+static void *arenaThread(void *pArg)
+{
+    Arena *pArena = Arena::getThreadArena();
+    if (Arena::getThreadArena() != pArena)
+	fail("thread arena", 0);
+    *(Arena **)pArg = pArena;
+
+    /* each thread's memory is its own */
+    const unsigned char c = (unsigned char)(size_t)pArena;
+    ArenaScope scope(pArena);
+    unsigned char *p = (unsigned char *)pArena->allocate(1 << 20);
+    for(unsigned i = 0; i < 100; ++i)
+    {
+	memset(p, c, 1 << 20);
+	sched_yield();
+	for(size_t j = 0; j < (1 << 20); j += 4093)
+	{
+	    if (p[j] != c)
+		fail("thread memory", j);
+	}
+    }
+
+    return NULL;
+}
+
+static void testThreads()
+{
+    pthread_t thread[N_THREADS];
+    Arena *pArena[N_THREADS];
+    for(unsigned i = 0; i < N_THREADS; ++i)
+	pthread_create(&thread[i], NULL, arenaThread, &pArena[i]);
+    for(unsigned i = 0; i < N_THREADS; ++i)
+	pthread_join(thread[i], NULL);
+
+    for(unsigned i = 0; i < N_THREADS; ++i)
+    {
+	if (pArena[i] == Arena::getThreadArena())
+	    fail("main thread arena", i);
+    }
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testBasics();
+
+    Arena small(4096);
+    testRandom(&small);
+    Arena huge(1 << 20, true);
+    testRandom(&huge);
+    testRandom(Arena::getThreadArena());
+
+    testThreads();
+
+    return 0;
+}
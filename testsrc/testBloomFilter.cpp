@@ -0,0 +1,118 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testBloomFilter.cpp - test BloomFilter.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "BloomFilter.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+#define N_ITEMS 100000
+#define N_PROBES 1000000
+
+/*
+  Check that there are no false negatives, and that the false positive rate
+  is within a reasonable factor of what a classic filter with the same
+  number of bits would give.
+ */
+static bool testRate(const BloomFilter *pFilter, double maxRate)
+{
+    for(unsigned long i = 0; i < N_ITEMS; ++i)
+    {
+	HashableUnsignedLong key(i * 2);
+	if (!pFilter->mayContain(&key))
+	    return false;
+    }
+
+    unsigned long falsePositives = 0;
+    for(unsigned long i = 0; i < N_PROBES; ++i)
+    {
+	HashableUnsignedLong key(i * 2 + 1);
+	if (pFilter->mayContain(&key))
+	    ++falsePositives;
+    }
+
+    return (double)falsePositives / N_PROBES <= maxRate;
+}
+
+int main()
+{
+    static const struct
+    {
+	unsigned bitsPerItem;
+	double maxRate;
+    } rates[] =
+    {
+	{4, 0.20},
+	{10, 0.02},
+	{16, 0.002},
+    };
+
+    for(size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); ++r)
+    {
+	BloomFilter filter(N_ITEMS, rates[r].bitsPerItem);
+	for(unsigned long i = 0; i < N_ITEMS; ++i)
+	{
+	    HashableUnsignedLong key(i * 2);
+	    filter.add(&key);
+	}
+
+	if (!testRate(&filter, rates[r].maxRate))
+	{
+	    fprintf(stderr, "%s failure at %u bits per item\n", __FILE__,
+		    rates[r].bitsPerItem);
+	    exit(1);
+	}
+
+	/* a serialized copy gives the same answers */
+	const size_t length = filter.getSerializedSize();
+	void *pBuffer;
+	if (posix_memalign(&pBuffer, 64, length))
+	    abort();
+	filter.serialize(pBuffer);
+
+	BloomFilter attached;
+	if (!attached.attach(pBuffer, length) ||
+	    (attached.getProbeCount() != filter.getProbeCount()) ||
+	    !testRate(&attached, rates[r].maxRate))
+	{
+	    fprintf(stderr, "%s serialization failure\n", __FILE__);
+	    exit(1);
+	}
+
+	/* truncated or damaged buffers are rejected */
+	assert(!attached.attach(pBuffer, length - 1));
+	((unsigned *)pBuffer)[0] ^= 1;
+	assert(!attached.attach(pBuffer, length));
+
+	free(pBuffer);
+    }
+
+    /* strings work too */
+    BloomFilter filter(3);
+    HashableString alpha("alpha");
+    HashableString bravo("bravo");
+    filter.add(&alpha);
+    assert(filter.mayContain(&alpha));
+
+    /* an empty filter has nothing in it */
+    BloomFilter empty;
+    assert(!empty.mayContain(&bravo));
+
+    return 0;
+}
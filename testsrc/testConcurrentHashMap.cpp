@@ -0,0 +1,268 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testConcurrentHashMap.cpp - test ConcurrentHashMap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The single-threaded test checks the map's semantics, starting from a
+    few buckets and stripes, and from just one of each.  The multi-threaded
+    test runs readers against writers that keep removing and replacing
+    elements, which are reclaimed through retire(); a reader that ever sees
+    an element with the wrong key, or one that has been reclaimed, fails.
+
+    Finally, a thread uses more maps than there are pthread keys, destroys
+    some of them while it is still running, and exits while others are
+    still waiting to reclaim what it retired; every element must be
+    reclaimed exactly once.
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <climits>
+#include <cstdlib>
+#include <pthread.h>
+
+#include "ConcurrentHashMap.h"
+#include "Comparator.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+struct Entry
+{
+    unsigned long key;
+    unsigned long alive;
+};
+
+static const unsigned long ALIVE = 0xa11ea11eUL;
+
+static ComparatorUnsignedLong comparator;
+
+static void reclaimEntry(Entry *pEntry)
+{
+    pEntry->alive = 0;
+    delete pEntry;
+}
+
+#define N_KEYS 20000
+
+static bool testSingle(size_t nBuckets, unsigned nStripes)
+{
+    ConcurrentHashMap<Entry> map(offsetof(Entry, key), &comparator,
+				 nBuckets, nStripes);
+    static Entry entry[N_KEYS];
+    static Entry other[N_KEYS];
+
+    for(unsigned long i = 0; i < N_KEYS; ++i)
+    {
+	entry[i].key = other[i].key = i * 31;
+	HashableUnsignedLong key(i * 31);
+	if (map.insert(&key, &entry[i]))
+	    return false;
+    }
+    if (map.getCount() != N_KEYS)
+	return false;
+
+    for(unsigned long i = 0; i < N_KEYS; ++i)
+    {
+	HashableUnsignedLong key(i * 31);
+	if (map.find(&key) != &entry[i])
+	    return false;
+
+	/* inserting a duplicate returns the existing element */
+	if (map.insert(&key, &other[i]) != &entry[i])
+	    return false;
+    }
+
+    HashableUnsignedLong missing(1);
+    if (map.find(&missing) || map.remove(&missing))
+	return false;
+
+    for(unsigned long i = 0; i < N_KEYS; i += 2)
+    {
+	HashableUnsignedLong key(i * 31);
+	if (map.replace(&key, &other[i]) != &entry[i])
+	    return false;
+	if (map.remove(&key) != &other[i])
+	    return false;
+    }
+    if (map.getCount() != N_KEYS / 2)
+	return false;
+
+    for(unsigned long i = 0; i < N_KEYS; ++i)
+    {
+	HashableUnsignedLong key(i * 31);
+	if (map.find(&key) != ((i & 1) ? &entry[i] : NULL))
+	    return false;
+    }
+
+    return true;
+}
+
+#define N_THREADS 4
+#define N_SHARED 1024
+#define N_ITERATIONS 200000
+
+static ConcurrentHashMap<Entry> *pShared;
+static volatile bool failed;
+
+static void *readerThread(void *)
+{
+    unsigned seed = 17;
+    for(unsigned i = 0; i < N_ITERATIONS; ++i)
+    {
+	unsigned long k = rand_r(&seed) % N_SHARED;
+	HashableUnsignedLong key(k);
+
+	EpochGuard epochGuard(pShared->getEpochManager());
+	Entry *pEntry = pShared->find(&key);
+	if (pEntry && ((pEntry->key != k) || (pEntry->alive != ALIVE)))
+	    failed = true;
+    }
+
+    return NULL;
+}
+
+static void *writerThread(void *pSeed)
+{
+    unsigned seed = (unsigned)(size_t)pSeed;
+    for(unsigned i = 0; i < N_ITERATIONS / 4; ++i)
+    {
+	unsigned long k = rand_r(&seed) % N_SHARED;
+	HashableUnsignedLong key(k);
+
+	Entry *pOld;
+	if (rand_r(&seed) & 1)
+	{
+	    Entry *pEntry = new Entry;
+	    pEntry->key = k;
+	    pEntry->alive = ALIVE;
+	    pOld = pShared->replace(&key, pEntry);
+	}
+	else
+	    pOld = pShared->remove(&key);
+
+	if (pOld)
+	    pShared->retire(pOld, reclaimEntry);
+    }
+
+    return NULL;
+}
+
+static bool testThreads()
+{
+    pShared = new ConcurrentHashMap<Entry>(
+	offsetof(Entry, key), &comparator, 8, 8);
+
+    pthread_t thread[2 * N_THREADS];
+    for(size_t i = 0; i < N_THREADS; ++i)
+    {
+	pthread_create(&thread[i], NULL, readerThread, NULL);
+	pthread_create(&thread[N_THREADS + i], NULL, writerThread,
+		       (void *)(i + 1));
+    }
+    for(size_t i = 0; i < 2 * N_THREADS; ++i)
+	pthread_join(thread[i], NULL);
+
+    /* reclaim what's left */
+    for(unsigned long k = 0; k < N_SHARED; ++k)
+    {
+	HashableUnsignedLong key(k);
+	Entry *pEntry = pShared->remove(&key);
+	if (pEntry)
+	    pShared->retire(pEntry, reclaimEntry);
+    }
+    delete pShared;
+
+    return !failed;
+}
+
+#define N_MAPS (PTHREAD_KEYS_MAX + 100)
+
+static ConcurrentHashMap<Entry> *pMap[N_MAPS];
+static unsigned long nReclaimed;
+
+static void countEntry(Entry *pEntry)
+{
+    __atomic_add_fetch(&nReclaimed, 1, __ATOMIC_RELAXED);
+    reclaimEntry(pEntry);
+}
+
+static void useMap(ConcurrentHashMap<Entry> *pUsed)
+{
+    Entry *pEntry = new Entry;
+    pEntry->key = 1;
+    pEntry->alive = ALIVE;
+    HashableUnsignedLong key(1);
+    pUsed->insert(&key, pEntry);
+    pUsed->retire(pUsed->remove(&key), countEntry);
+}
+
+static void *manyThread(void *)
+{
+    for(size_t i = 0; i < N_MAPS; ++i)
+	useMap(pMap[i]);
+
+    /* leave this thread's records for half of the maps behind */
+    for(size_t i = 0; i < N_MAPS; i += 2)
+    {
+	delete pMap[i];
+	pMap[i] = NULL;
+    }
+
+    /* a new map may reuse an old one's memory */
+    pMap[0] = new ConcurrentHashMap<Entry>(
+	offsetof(Entry, key), &comparator, 1, 1);
+    useMap(pMap[0]);
+
+    return NULL;
+}
+
+static bool testMany()
+{
+    for(size_t i = 0; i < N_MAPS; ++i)
+    {
+	pMap[i] = new ConcurrentHashMap<Entry>(
+	    offsetof(Entry, key), &comparator, 1, 1);
+    }
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, manyThread, NULL);
+    pthread_join(thread, NULL);
+
+    for(size_t i = 0; i < N_MAPS; ++i)
+	delete pMap[i];
+
+    return nReclaimed == N_MAPS + 1;
+}
+
+int main()
+{
+    /* the smallest map possible, too, which has to grow from the start */
+    if (!testSingle(16, 4) || !testSingle(1, 1))
+    {
+	fprintf(stderr, "%s single-threaded failure\n", __FILE__);
+	exit(1);
+    }
+
+    if (!testThreads())
+    {
+	fprintf(stderr, "%s multi-threaded failure\n", __FILE__);
+	exit(1);
+    }
+
+    if (!testMany())
+    {
+	fprintf(stderr, "%s many maps failure\n", __FILE__);
+	exit(1);
+    }
+
+    return 0;
+}
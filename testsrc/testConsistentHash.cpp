@@ -0,0 +1,162 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testConsistentHash.cpp - test ConsistentHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The key property of both schemes is that a change in the shards only
+    moves keys to or from the shard that changed.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "ConsistentHash.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+#define N_KEYS 20000
+#define N_SHARDS 40
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void testJump(const Hashable *const *ppKeys)
+{
+    static unsigned before[N_KEYS];
+    static unsigned after[N_KEYS];
+    static unsigned long load[N_SHARDS];
+
+    jumpHashBatch(ppKeys, N_KEYS, 1, before);
+    for(size_t i = 0; i < N_KEYS; ++i)
+    {
+	if (before[i])
+	    fail("one shard", i);
+    }
+
+    for(unsigned nShards = 2; nShards <= N_SHARDS; ++nShards)
+    {
+	jumpHashBatch(ppKeys, N_KEYS, nShards, after);
+	size_t nMoved = 0;
+	for(size_t i = 0; i < N_KEYS; ++i)
+	{
+	    if (after[i] != jumpHash(ppKeys[i], nShards))
+		fail("batch", nShards);
+	    if (after[i] >= nShards)
+		fail("range", nShards);
+
+	    /* keys only ever move to the new shard */
+	    if (after[i] != before[i])
+	    {
+		if (after[i] != nShards - 1)
+		    fail("movement", nShards);
+		++nMoved;
+	    }
+	    before[i] = after[i];
+	}
+
+	/* about 1/nShards of the keys move */
+	if (nMoved > 2 * N_KEYS / nShards)
+	    fail("too many moved", nShards);
+    }
+
+    for(size_t i = 0; i < N_KEYS; ++i)
+	++load[before[i]];
+    for(unsigned s = 0; s < N_SHARDS; ++s)
+    {
+	if ((load[s] < N_KEYS / N_SHARDS * 3 / 4) ||
+	    (load[s] > N_KEYS / N_SHARDS * 5 / 4))
+	    fail("balance", s);
+    }
+}
+
+static void testRing(const Hashable *const *ppKeys)
+{
+    static unsigned long before[N_KEYS];
+    static unsigned long after[N_KEYS];
+
+    HashRing ring;
+    HashableUnsignedLong key(0);
+    if (ring.route(&key) != HashRing::noNode)
+	fail("empty ring", 0);
+
+    for(unsigned long node = 100; node < 100 + N_SHARDS; ++node)
+    {
+	if (!ring.addNode(node))
+	    fail("add", node);
+    }
+    if (ring.addNode(100) || (ring.getNodeCount() != N_SHARDS) ||
+	(ring.getPointCount() != N_SHARDS * 128))
+	fail("counts", 0);
+
+    ring.routeBatch(ppKeys, N_KEYS, before);
+    for(size_t i = 0; i < N_KEYS; ++i)
+    {
+	if (before[i] != ring.route(ppKeys[i]))
+	    fail("batch", i);
+	if ((before[i] < 100) || (before[i] >= 100 + N_SHARDS))
+	    fail("range", i);
+    }
+
+    /* removing a node only moves its own keys */
+    if (!ring.removeNode(117) || ring.removeNode(117))
+	fail("remove", 117);
+    ring.routeBatch(ppKeys, N_KEYS, after);
+    for(size_t i = 0; i < N_KEYS; ++i)
+    {
+	if ((before[i] != 117) && (after[i] != before[i]))
+	    fail("remove movement", i);
+	if (after[i] == 117)
+	    fail("removed node", i);
+    }
+
+    /* adding a node only moves keys to it, and putting it back restores */
+    if (!ring.addNode(117))
+	fail("re-add", 117);
+    ring.routeBatch(ppKeys, N_KEYS, after);
+    for(size_t i = 0; i < N_KEYS; ++i)
+    {
+	if (after[i] != before[i])
+	    fail("re-add movement", i);
+    }
+
+    /* a node with twice the points gets about twice the keys */
+    HashRing weighted;
+    weighted.addNode(1, 128);
+    weighted.addNode(2, 256);
+    size_t nOne = 0;
+    for(size_t i = 0; i < N_KEYS; ++i)
+    {
+	if (weighted.route(ppKeys[i]) == 1)
+	    ++nOne;
+    }
+    if ((nOne < N_KEYS / 4) || (nOne > N_KEYS * 5 / 12))
+	fail("weight", nOne);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    static HashableUnsignedLong *ppKey[N_KEYS];
+    for(size_t i = 0; i < N_KEYS; ++i)
+	ppKey[i] = new HashableUnsignedLong(((unsigned long)rand() << 16) ^ i);
+
+    testJump((const Hashable *const *)ppKey);
+    testRing((const Hashable *const *)ppKey);
+
+    for(size_t i = 0; i < N_KEYS; ++i)
+	delete ppKey[i];
+    return 0;
+}
@@ -0,0 +1,184 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testCountMinSketch.cpp - test CountMinSketch.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    In the threaded test, each thread counts into its own sketch, attached
+    to a CountMinSketchFolder, while the main thread keeps folding them.
+    A key's folded estimate must never go down, and once every thread has
+    detached, the combined sketch must account for every event.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+
+#include "CountMinSketch.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+#define N_KEYS 10000
+#define N_EVENTS 500000
+#define N_THREADS 4
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static unsigned long skewedKey(unsigned *pSeed)
+{
+    unsigned long a = (unsigned long)rand_r(pSeed) % N_KEYS;
+    unsigned long b = (unsigned long)rand_r(pSeed) % N_KEYS;
+    return a * b / N_KEYS;
+}
+
+/*
+  No estimate may be low, and nearly all must be within the bound.
+ */
+static void check(const CountMinSketch *pSketch, const unsigned long *pTrue)
+{
+    const unsigned long bound = 2 * pSketch->getTotal() / pSketch->getWidth();
+    unsigned long over = 0;
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+    {
+	HashableUnsignedLong key(k);
+	const unsigned long estimate = pSketch->estimate(&key);
+	if (estimate < pTrue[k])
+	    fail("underestimate", k);
+	if (estimate - pTrue[k] > bound)
+	    ++over;
+    }
+
+    if (over > N_KEYS / 100)
+	fail("overestimates", over);
+}
+
+struct Shared
+{
+    CountMinSketchFolder *pFolder;
+    unsigned long nDone;
+    unsigned long counts[N_THREADS][N_KEYS];
+};
+
+struct Worker
+{
+    Shared *pShared;
+    unsigned id;
+};
+
+static void *work(void *pArg)
+{
+    Worker *pWorker = (Worker *)pArg;
+    Shared *pShared = pWorker->pShared;
+    unsigned seed = pWorker->id;
+    CountMinSketch local(pShared->pFolder->getWidth(),
+			 pShared->pFolder->getDepth());
+    if (!pShared->pFolder->attach(&local))
+	fail("attach", pWorker->id);
+
+    for(unsigned long i = 0; i < N_EVENTS / N_THREADS; ++i)
+    {
+	const unsigned long k = skewedKey(&seed);
+	HashableUnsignedLong key(k);
+	local.add(&key);
+	++pShared->counts[pWorker->id][k];
+    }
+
+    pShared->pFolder->detach(&local);
+    __atomic_add_fetch(&pShared->nDone, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+    unsigned seed = (unsigned)rand();
+
+    static unsigned long all[N_KEYS];
+    CountMinSketch sketch(1024, 4);
+    for(unsigned long i = 0; i < N_EVENTS; ++i)
+    {
+	const unsigned long k = skewedKey(&seed);
+	HashableUnsignedLong key(k);
+	const unsigned long estimate = sketch.add(&key);
+	if (estimate != sketch.estimate(&key))
+	    fail("add result", k);
+	++all[k];
+    }
+    if (sketch.getTotal() != N_EVENTS)
+	fail("total", sketch.getTotal());
+    check(&sketch, all);
+
+    CountMinSketch other(512, 4);
+    if (sketch.merge(&other))
+	fail("dimension mismatch", 0);
+
+    CountMinSketchFolder mismatch(512, 4);
+    if (mismatch.attach(&sketch))
+	fail("attach mismatch", 0);
+
+    static Shared shared;
+    CountMinSketchFolder folder(1024, 4);
+    shared.pFolder = &folder;
+
+    pthread_t thread[N_THREADS];
+    Worker worker[N_THREADS];
+    for(unsigned t = 0; t < N_THREADS; ++t)
+    {
+	worker[t].pShared = &shared;
+	worker[t].id = t;
+	pthread_create(&thread[t], NULL, work, &worker[t]);
+    }
+
+    /* fold while the threads count; the hottest key only goes up */
+    HashableUnsignedLong hot(0);
+    unsigned long last = 0;
+    while(__atomic_load_n(&shared.nDone, __ATOMIC_ACQUIRE) < N_THREADS)
+    {
+	folder.fold();
+	const unsigned long estimate = folder.estimate(&hot);
+	if ((estimate < last) || (folder.getTotal() > N_EVENTS))
+	    fail("concurrent fold", estimate);
+	last = estimate;
+    }
+    for(unsigned t = 0; t < N_THREADS; ++t)
+	pthread_join(thread[t], NULL);
+
+    static unsigned long threaded[N_KEYS];
+    for(unsigned t = 0; t < N_THREADS; ++t)
+	for(unsigned long k = 0; k < N_KEYS; ++k)
+	    threaded[k] += shared.counts[t][k];
+    if (folder.getTotal() != N_EVENTS)
+	fail("threaded total", folder.getTotal());
+    const unsigned long bound = 2 * N_EVENTS / folder.getWidth();
+    unsigned long over = 0;
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+    {
+	HashableUnsignedLong key(k);
+	const unsigned long estimate = folder.estimate(&key);
+	if (estimate < threaded[k])
+	    fail("threaded underestimate", k);
+	if (estimate - threaded[k] > bound)
+	    ++over;
+    }
+    if (over > N_KEYS / 100)
+	fail("threaded overestimates", over);
+
+    sketch.clear();
+    HashableUnsignedLong key(0);
+    if (sketch.getTotal() || sketch.estimate(&key))
+	fail("clear", 0);
+
+    return 0;
+}
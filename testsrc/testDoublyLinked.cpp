@@ -0,0 +1,246 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testDoublyLinked.cpp - test DoublyLinked.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Lists are checked by walking them in both directions and comparing the
+    elements' sequence numbers with an expected order.  Sorting uses keys
+    with many duplicates, and checks stability with the sequence numbers.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "DoublyLinked.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+struct Item
+{
+    unsigned long seq;
+    DoublyLinkedMembership link;
+    unsigned long key;
+
+    static unsigned long live;
+
+    Item(unsigned long s, unsigned long k):
+	seq(s),
+	key(k)
+    {
+	++live;
+    }
+
+    ~Item()
+    {
+	--live;
+    }
+};
+
+unsigned long Item::live = 0;
+
+typedef DoublyLinkedList<Item, offsetof(Item, link)> List;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+/* check that a list holds exactly the given sequence numbers, in order */
+static void check(const char *pWhat, const List *pList,
+		  const unsigned long *pSeq, size_t n)
+{
+    size_t i = 0;
+    for(Item *pItem = pList->getFirst(); pItem;
+	pItem = pList->getNext(pItem), ++i)
+    {
+	if ((i >= n) || (pItem->seq != pSeq[i]) || !pItem->link.isMember())
+	    fail(pWhat, i);
+    }
+    if (i != n)
+	fail(pWhat, i);
+
+    for(Item *pItem = pList->getLast(); pItem;
+	pItem = pList->getPrevious(pItem))
+    {
+	if (!i || (pItem->seq != pSeq[--i]))
+	    fail(pWhat, i);
+    }
+    if (pList->isEmpty() != !n)
+	fail(pWhat, n);
+}
+
+static void fill(List *pList, unsigned long first, unsigned long n)
+{
+    for(unsigned long i = 0; i < n; ++i)
+	pList->append(new Item(first + i, 0));
+}
+
+static Item *nth(const List *pList, unsigned long n)
+{
+    Item *pItem = pList->getFirst();
+    while(n--)
+	pItem = pList->getNext(pItem);
+    return pItem;
+}
+
+static void testBasics()
+{
+    List list;
+    check("empty", &list, NULL, 0);
+
+    Item *pItem = new Item(1, 0);
+    if (pItem->link.isMember())
+	fail("not member", 0);
+    list.append(pItem);
+    list.prepend(new Item(0, 0));
+    list.addAfter(new Item(2, 0), pItem);
+    const unsigned long s1[] = {0, 1, 2};
+    check("basics", &list, s1, 3);
+
+    list.remove(pItem);
+    if (pItem->link.isMember())
+	fail("removed member", 0);
+    const unsigned long s2[] = {0, 2};
+    check("remove", &list, s2, 2);
+    delete pItem;
+}
+
+static void testSplice()
+{
+    List a;
+    List b;
+    List empty;
+
+    /* whole lists, at the end and in the middle */
+    fill(&a, 0, 3);
+    fill(&b, 10, 3);
+    a.splice(NULL, &empty);
+    a.splice(NULL, &b);
+    const unsigned long s1[] = {0, 1, 2, 10, 11, 12};
+    check("splice end", &a, s1, 6);
+    check("splice source", &b, NULL, 0);
+
+    fill(&b, 20, 2);
+    a.splice(nth(&a, 1), &b);
+    const unsigned long s2[] = {0, 20, 21, 1, 2, 10, 11, 12};
+    check("splice middle", &a, s2, 8);
+    check("splice middle source", &b, NULL, 0);
+
+    /* into an empty list */
+    b.splice(NULL, &a);
+    check("splice into empty", &b, s2, 8);
+    check("splice from", &a, NULL, 0);
+
+    /* a run from the middle of one list to the front of another */
+    fill(&a, 30, 2);
+    b.splice(NULL, &b, nth(&b, 1), nth(&b, 2));
+    const unsigned long s3[] = {0, 1, 2, 10, 11, 12, 20, 21};
+    check("splice run same list", &b, s3, 8);
+
+    a.splice(a.getFirst(), &b, nth(&b, 3), nth(&b, 5));
+    const unsigned long s4[] = {10, 11, 12, 30, 31};
+    const unsigned long s5[] = {0, 1, 2, 20, 21};
+    check("splice run", &a, s4, 5);
+    check("splice run source", &b, s5, 5);
+
+    /* a single element run, and a whole list as a run */
+    a.splice(NULL, &b, b.getFirst(), b.getFirst());
+    const unsigned long s6[] = {10, 11, 12, 30, 31, 0};
+    check("splice one", &a, s6, 6);
+    a.splice(a.getFirst(), &b, b.getFirst(), b.getLast());
+    const unsigned long s7[] = {1, 2, 20, 21, 10, 11, 12, 30, 31, 0};
+    check("splice all as run", &a, s7, 10);
+    check("splice all as run source", &b, NULL, 0);
+
+    /* swap, with each of the lists empty or not */
+    a.swap(&b);
+    check("swap to empty", &a, NULL, 0);
+    check("swap from empty", &b, s7, 10);
+    b.swap(&a);
+    check("swap back", &a, s7, 10);
+    fill(&b, 40, 1);
+    a.swap(&b);
+    const unsigned long s8[] = {40};
+    check("swap both", &a, s8, 1);
+    check("swap both other", &b, s7, 10);
+    empty.swap(&empty);
+    check("swap self empty", &empty, NULL, 0);
+}
+
+static void testSortOnce(unsigned long n, unsigned long nKeys)
+{
+    List list;
+    for(unsigned long i = 0; i < n; ++i)
+	list.append(new Item(i, (unsigned long)rand() % nKeys));
+
+    list.sort(offsetof(Item, key), compareUnsignedLong);
+
+    unsigned long count = 0;
+    const Item *pPrevious = NULL;
+    for(Item *pItem = list.getFirst(); pItem; pItem = list.getNext(pItem))
+    {
+	if (pPrevious &&
+	    ((pPrevious->key > pItem->key) ||
+	     ((pPrevious->key == pItem->key) && (pPrevious->seq > pItem->seq))))
+	    fail("sort order", n);
+	if (list.getPrevious(pItem) != pPrevious)
+	    fail("sort links", n);
+	pPrevious = pItem;
+	++count;
+    }
+    if ((count != n) || (list.getLast() != pPrevious))
+	fail("sort count", n);
+}
+
+static void testSort()
+{
+    for(unsigned long n = 0; n < 70; ++n)
+    {
+	testSortOnce(n, 1);
+	testSortOnce(n, 4);
+	testSortOnce(n, 1000);
+    }
+    testSortOnce(100000, 100);
+    testSortOnce(100001, 1000000);
+
+    /* already sorted, and reversed */
+    List list;
+    for(unsigned long i = 0; i < 1000; ++i)
+    {
+	list.append(new Item(i, i));
+	list.prepend(new Item(2000 - i, i));
+    }
+    list.sort(offsetof(Item, key), compareUnsignedLong);
+    unsigned long i = 0;
+    for(Item *pItem = list.getFirst(); pItem; pItem = list.getNext(pItem), ++i)
+    {
+	/* for each key, the element from the reversed half was first */
+	if ((pItem->key != i / 2) ||
+	    (pItem->seq != ((i & 1) ? i / 2 : 2000 - i / 2)))
+	    fail("sort presorted", i);
+    }
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testBasics();
+    testSplice();
+    testSort();
+
+    if (Item::live)
+	fail("leak", Item::live);
+
+    return 0;
+}
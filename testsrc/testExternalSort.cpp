@@ -0,0 +1,177 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testExternalSort.cpp - test ExternalSort.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Files of records with random keys are sorted with small memory limits,
+    so that there are many runs, and with the smallest limits, more than
+    can be merged at once.  Records are 36 bytes, so they don't divide
+    blocks evenly, and some are always split between blocks.  Each record
+    carries a sequence number and a check value, so that the output can
+    be checked for being a permutation of the input as well as for being
+    in order.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "ExternalSort.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define N_RECORDS 50000
+
+struct Record
+{
+    unsigned seq;
+    unsigned key;
+    unsigned check;
+    char padding[24];
+};
+
+static char inPath[256];
+static char outPath[256];
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    unlink(inPath);
+    unlink(outPath);
+    exit(1);
+}
+
+static void writeRecords(const char *pPath, size_t n, unsigned keyRange)
+{
+    FILE *pFile = fopen(pPath, "wb");
+    if (!pFile)
+	fail("create input", errno);
+    for(size_t i = 0; i < n; ++i)
+    {
+	Record record;
+	memset(&record, 0, sizeof(record));
+	record.seq = (unsigned)i;
+	record.key = (unsigned)rand() % keyRange;
+	record.check = ~record.seq ^ record.key;
+	if (fwrite(&record, sizeof(record), 1, pFile) != 1)
+	    fail("write input", i);
+    }
+    fclose(pFile);
+}
+
+static void checkRecords(const char *pWhat, const char *pPath, size_t n)
+{
+    FILE *pFile = fopen(pPath, "rb");
+    if (!pFile)
+	fail(pWhat, errno);
+
+    bool *pSeen = new bool[n];
+    memset(pSeen, 0, n);
+    Record record;
+    unsigned lastKey = 0;
+    size_t i = 0;
+    for(; fread(&record, sizeof(record), 1, pFile) == 1; ++i)
+    {
+	if ((i >= n) || (record.seq >= n) || pSeen[record.seq] ||
+	    (record.check != (~record.seq ^ record.key)) ||
+	    (record.key < lastKey))
+	    fail(pWhat, i);
+	pSeen[record.seq] = true;
+	lastKey = record.key;
+    }
+    if (i != n)
+	fail(pWhat, i);
+
+    delete[] pSeen;
+    fclose(pFile);
+}
+
+static void sortOnce(const char *pWhat, size_t n, unsigned keyRange,
+		     size_t memoryBytes, size_t blockBytes, bool directIo,
+		     bool inPlace)
+{
+    writeRecords(inPath, n, keyRange);
+
+    ExternalSortOptions options;
+    options.memoryBytes = memoryBytes;
+    options.blockBytes = blockBytes;
+    options.directIo = directIo;
+    const char *pOut = inPlace ? inPath : outPath;
+    const int error = externalSort<Record, unsigned, offsetof(Record, key)>(
+	inPath, pOut, compareUnsigned, &options);
+    if (error)
+	fail(pWhat, error);
+    checkRecords(pWhat, pOut, n);
+}
+
+static void testErrors()
+{
+    ExternalSortOptions options;
+
+    unlink(inPath);
+    if (externalSort(inPath, outPath, sizeof(Record), offsetof(Record, key),
+		     (int (*)(const void *, const void *))compareUnsigned,
+		     &options) != ENOENT)
+	fail("missing input", 0);
+
+    FILE *pFile = fopen(inPath, "wb");
+    fputs("not a whole record", pFile);
+    fclose(pFile);
+    if (externalSort<Record, unsigned, offsetof(Record, key)>(
+	    inPath, outPath, compareUnsigned) != EINVAL)
+	fail("partial record", 0);
+
+    /* an empty file sorts to an empty file */
+    pFile = fopen(inPath, "wb");
+    fclose(pFile);
+    pFile = fopen(outPath, "wb");
+    fputs("old contents", pFile);
+    fclose(pFile);
+    if (externalSort<Record, unsigned, offsetof(Record, key)>(
+	    inPath, outPath, compareUnsigned))
+	fail("empty input", 0);
+    checkRecords("empty output", outPath, 0);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    const char *pDirectory = getenv("TMPDIR");
+    if (!pDirectory)
+	pDirectory = "/tmp";
+    snprintf(inPath, sizeof(inPath), "%s/testExternalSort-in-%d",
+	     pDirectory, (int)getpid());
+    snprintf(outPath, sizeof(outPath), "%s/testExternalSort-out-%d",
+	     pDirectory, (int)getpid());
+
+    testErrors();
+
+    /* one load, written straight to the output */
+    sortOnce("one load", 1000, 1000000, 1 << 20, 4096, false, false);
+    sortOnce("one record", 1, 10, 1 << 20, 4096, false, false);
+
+    /* many runs, merged at once */
+    sortOnce("one merge", N_RECORDS, 1000000, 1 << 20, 8192, false, false);
+
+    /* more runs than can be merged at once, and lots of duplicates */
+    sortOnce("merge passes", N_RECORDS, 100, 64 << 10, 4096, false, false);
+    sortOnce("in place", N_RECORDS, 1000000, 64 << 10, 4096, false, true);
+    sortOnce("direct", N_RECORDS, 1000000, 64 << 10, 4096, true, false);
+    sortOnce("direct one load", 1000, 10, 1 << 20, 4096, true, false);
+
+    unlink(inPath);
+    unlink(outPath);
+    return 0;
+}
@@ -0,0 +1,197 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testHashJoin.cpp - test HashJoin.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Keys are drawn from a small range, so that there are plenty of
+    duplicates on both sides, and the expected results can be counted per
+    key.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "HashJoin.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+#define N_THREADS 4
+#define MAX_KEYS 5000
+
+struct Left
+{
+    unsigned long value;
+    unsigned long key;
+};
+
+struct Right
+{
+    unsigned long key;
+    char pad[20];
+    unsigned long value;
+};
+
+struct Result
+{
+    unsigned long pairs[N_THREADS];
+    unsigned long checksum[N_THREADS];
+    unsigned long groups[N_THREADS];
+    unsigned long perKey[MAX_KEYS];
+    bool bad;
+};
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void emitPair(Result *pResult, unsigned thread,
+		     const Left *pLeft, const Right *pRight)
+{
+    if ((thread >= N_THREADS) || (pLeft->key != pRight->key))
+	pResult->bad = true;
+    ++pResult->pairs[thread];
+    pResult->checksum[thread] += pLeft->value * 31 + pRight->value;
+}
+
+static void emitGroup(Result *pResult, unsigned thread,
+		      const Left *const *ppGroup, size_t nGroup)
+{
+    const unsigned long key = ppGroup[0]->key;
+    for(size_t i = 0; i < nGroup; ++i)
+    {
+	/* members are all the same key, and in array order */
+	if ((ppGroup[i]->key != key) ||
+	    (i && (ppGroup[i] <= ppGroup[i - 1])))
+	    pResult->bad = true;
+    }
+
+    /* each key is in only one group; keys are partitioned across threads */
+    if (__atomic_fetch_add(&pResult->perKey[key], nGroup, __ATOMIC_RELAXED))
+	pResult->bad = true;
+    ++pResult->groups[thread];
+}
+
+static void testOnce(size_t nLeft, size_t nRight, unsigned long nKeys,
+		     unsigned nThreads)
+{
+    Left *pLeft = new Left[nLeft];
+    Right *pRight = new Right[nRight];
+    static unsigned long leftCount[MAX_KEYS];
+    static unsigned long rightCount[MAX_KEYS];
+    static unsigned long leftSum[MAX_KEYS];
+    static unsigned long rightSum[MAX_KEYS];
+    memset(leftCount, 0, sizeof(leftCount));
+    memset(rightCount, 0, sizeof(rightCount));
+    memset(leftSum, 0, sizeof(leftSum));
+    memset(rightSum, 0, sizeof(rightSum));
+
+    for(size_t i = 0; i < nLeft; ++i)
+    {
+	pLeft[i].key = (unsigned long)rand() % nKeys;
+	pLeft[i].value = (unsigned long)rand();
+	++leftCount[pLeft[i].key];
+	leftSum[pLeft[i].key] += pLeft[i].value;
+    }
+    for(size_t i = 0; i < nRight; ++i)
+    {
+	pRight[i].key = (unsigned long)rand() % nKeys;
+	pRight[i].value = (unsigned long)rand();
+	++rightCount[pRight[i].key];
+	rightSum[pRight[i].key] += pRight[i].value;
+    }
+
+    /*
+      The sum over all matching pairs of (left * 31 + right) for a key is
+      nRight(key) * 31 * sum(left) + nLeft(key) * sum(right).
+    */
+    unsigned long expectedPairs = 0;
+    unsigned long expectedChecksum = 0;
+    unsigned long expectedGroups = 0;
+    for(unsigned long k = 0; k < nKeys; ++k)
+    {
+	expectedPairs += leftCount[k] * rightCount[k];
+	expectedChecksum += rightCount[k] * 31 * leftSum[k] +
+	    leftCount[k] * rightSum[k];
+	if (leftCount[k])
+	    ++expectedGroups;
+    }
+
+    Result result;
+    memset(&result, 0, sizeof(result));
+    hashJoin<Left, Right, unsigned long, Result,
+	offsetof(Left, key), offsetof(Right, key)>(
+	    pLeft, nLeft, pRight, nRight, hashUnsignedLong,
+	    compareUnsignedLong, emitPair, &result, nThreads);
+
+    unsigned long pairs = 0;
+    unsigned long checksum = 0;
+    for(unsigned t = 0; t < N_THREADS; ++t)
+    {
+	pairs += result.pairs[t];
+	checksum += result.checksum[t];
+    }
+    if (result.bad || (pairs != expectedPairs) ||
+	(checksum != expectedChecksum))
+	fail("join", nLeft);
+
+    memset(&result, 0, sizeof(result));
+    hashGroup<Left, unsigned long, Result, offsetof(Left, key)>(
+	pLeft, nLeft, hashUnsignedLong, compareUnsignedLong, emitGroup,
+	&result, nThreads);
+
+    unsigned long groups = 0;
+    for(unsigned t = 0; t < N_THREADS; ++t)
+	groups += result.groups[t];
+    if (result.bad || (groups != expectedGroups))
+	fail("group", nLeft);
+    for(unsigned long k = 0; k < nKeys; ++k)
+    {
+	if (result.perKey[k] != leftCount[k])
+	    fail("group size", k);
+    }
+
+    delete[] pLeft;
+    delete[] pRight;
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    static const struct
+    {
+	size_t nLeft;
+	size_t nRight;
+	unsigned long nKeys;
+    } cases[] =
+    {
+	{0, 10, 10},
+	{10, 0, 10},
+	{1, 1, 1},
+	{100, 1000, 50},
+	{1000, 100, 5000},
+	{50000, 200000, 5000},
+	{300000, 20000, 5000},
+    };
+
+    for(size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c)
+    {
+	testOnce(cases[c].nLeft, cases[c].nRight, cases[c].nKeys, 1);
+	testOnce(cases[c].nLeft, cases[c].nRight, cases[c].nKeys, N_THREADS);
+    }
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testHeavyHitters.cpp - test HeavyHitters.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Keys are drawn from a skewed distribution, and the exact frequencies are
+    kept alongside, so that the space-saving guarantees can be checked.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Comparator.h"
+#include "Hashable.h"
+#include "HeavyHitters.h"
+
+using namespace phoenix4cpp;
+
+#define N_KEYS 10000
+#define N_EVENTS 200000
+#define CAPACITY 100
+
+static ComparatorUnsignedLong comparatorUnsignedLong;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+/*
+  Roughly Zipfian:  key k has probability about 1/((k + 1)(k + 2)).
+ */
+static unsigned long skewedKey()
+{
+    return N_KEYS / (1 + (unsigned long)rand() % N_KEYS) - 1;
+}
+
+static void fill(HeavyHitters *pHh, unsigned long *pTrue, size_t nEvents)
+{
+    for(size_t i = 0; i < nEvents; ++i)
+    {
+	const unsigned long k = skewedKey();
+	HashableUnsignedLong key(k);
+	pHh->add(&key);
+	++pTrue[k];
+    }
+}
+
+static void check(const HeavyHitters *pHh, const unsigned long *pTrue)
+{
+    unsigned long total = 0;
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+	total += pTrue[k];
+    if (pHh->getTotal() != total)
+	fail("total", total);
+
+    for(unsigned long k = 0; k < N_KEYS; ++k)
+    {
+	HashableUnsignedLong key(k);
+	HeavyHitters::Entry entry;
+	if (!pHh->find(&key, &entry))
+	{
+	    /* anything frequent enough must be monitored */
+	    if (pTrue[k] > total / pHh->getCapacity())
+		fail("missing", k);
+	    continue;
+	}
+
+	if ((*(const unsigned long *)entry.pKey != k) ||
+	    (entry.count < pTrue[k]) ||
+	    (entry.count - entry.error > pTrue[k]))
+	    fail("bounds", k);
+    }
+
+    /* the top list is in descending order */
+    HeavyHitters::Entry top[CAPACITY];
+    const size_t n = pHh->getTop(top, CAPACITY);
+    if (n != pHh->getCount())
+	fail("top count", n);
+    for(size_t i = 1; i < n; ++i)
+    {
+	if (top[i].count > top[i - 1].count)
+	    fail("top order", i);
+    }
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    static unsigned long all[N_KEYS];
+    HeavyHitters hh(CAPACITY, sizeof(unsigned long), &comparatorUnsignedLong);
+    fill(&hh, all, N_EVENTS);
+    check(&hh, all);
+
+    /* key 0 is by far the most frequent */
+    HeavyHitters::Entry top;
+    if ((hh.getTop(&top, 1) != 1) || (*(const unsigned long *)top.pKey != 0))
+	fail("top key", 0);
+
+    /* merge shards, and check the guarantees against the combined stream */
+    static unsigned long merged[N_KEYS];
+    HeavyHitters left(CAPACITY, sizeof(unsigned long), &comparatorUnsignedLong);
+    HeavyHitters right(CAPACITY, sizeof(unsigned long),
+		       &comparatorUnsignedLong);
+    fill(&left, merged, N_EVENTS);
+    fill(&right, merged, N_EVENTS / 3);
+    if (!left.merge(&right))
+	fail("merge", 0);
+    check(&left, merged);
+
+    /* a small tracker merged into an empty one is exact */
+    HeavyHitters small(CAPACITY, sizeof(unsigned long),
+		       &comparatorUnsignedLong);
+    HeavyHitters empty(CAPACITY, sizeof(unsigned long),
+		       &comparatorUnsignedLong);
+    for(unsigned long k = 0; k < CAPACITY / 2; ++k)
+    {
+	HashableUnsignedLong key(k);
+	small.add(&key, k + 1);
+    }
+    empty.merge(&small);
+    for(unsigned long k = 0; k < CAPACITY / 2; ++k)
+    {
+	HashableUnsignedLong key(k);
+	HeavyHitters::Entry entry;
+	if (!empty.find(&key, &entry) || (entry.count != k + 1) ||
+	    entry.error)
+	    fail("exact merge", k);
+    }
+
+    HeavyHitters other(CAPACITY, sizeof(unsigned), &comparatorUnsignedLong);
+    if (hh.merge(&other))
+	fail("key size mismatch", 0);
+
+    hh.clear();
+    if (hh.getCount() || hh.getTotal() || hh.getTop(&top, 1))
+	fail("clear", 0);
+
+    return 0;
+}
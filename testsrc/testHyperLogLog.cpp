@@ -0,0 +1,145 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testHyperLogLog.cpp - test HyperLogLog.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+ */
+
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "HyperLogLog.h"
+#include "Hashable.h"
+
+using namespace phoenix4cpp;
+
+static void fail(const char *pWhat, unsigned long n)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, n);
+    exit(1);
+}
+
+static void addRange(HyperLogLog *pHll, unsigned long first,
+		     unsigned long last)
+{
+    for(unsigned long i = first; i < last; ++i)
+    {
+	HashableUnsignedLong key(i);
+	pHll->add(&key);
+    }
+}
+
+/*
+  Check that the estimate is within a given number of standard errors of the
+  true count; duplicates must not change it.
+ */
+static void testAccuracy(unsigned precision, unsigned long n)
+{
+    HyperLogLog hll(precision);
+    addRange(&hll, 0, n);
+    addRange(&hll, 0, n / 2);
+
+    if (!n)
+    {
+	if (hll.estimate() != 0)
+	    fail("empty", n);
+	return;
+    }
+
+    const double error = fabs(hll.estimate() - n) / n;
+    const double limit = hll.isSparse() ? 0.01 :
+	4 * 1.04 / sqrt((double)(1UL << precision));
+    if (error > limit)
+	fail("accuracy", n);
+}
+
+static void testMerge(unsigned long n)
+{
+    /* two overlapping shards, and the whole thing */
+    HyperLogLog left;
+    HyperLogLog right;
+    HyperLogLog all;
+    addRange(&left, 0, n * 2 / 3);
+    addRange(&right, n / 3, n);
+    addRange(&all, 0, n);
+
+    if (!left.merge(&right))
+	fail("merge", n);
+    if (left.isSparse() != all.isSparse())
+	fail("merge representation", n);
+
+    /* merging is the same as adding everything to one sketch */
+    if (!all.isSparse() && (left.estimate() != all.estimate()))
+	fail("merge estimate", n);
+    if (fabs(left.estimate() - n) / n > 0.04)
+	fail("merge accuracy", n);
+
+    /* sparse into dense */
+    HyperLogLog small;
+    addRange(&small, n, n + 10);
+    HyperLogLog big;
+    addRange(&big, 0, 100000);
+    big.merge(&small);
+    small.merge(&big);
+    if (big.estimate() != small.estimate())
+	fail("mixed merge", n);
+
+    HyperLogLog other(10);
+    if (left.merge(&other))
+	fail("precision mismatch", n);
+}
+
+static void testSerialize(unsigned long n)
+{
+    HyperLogLog hll;
+    addRange(&hll, 0, n);
+
+    const size_t size = hll.getSerializedSize();
+    unsigned char *pBuffer = new unsigned char[size];
+    hll.serialize(pBuffer);
+
+    HyperLogLog copy(4);
+    if (!copy.deserialize(pBuffer, size) ||
+	(copy.getPrecision() != hll.getPrecision()) ||
+	(copy.isSparse() != hll.isSparse()) ||
+	(copy.estimate() != hll.estimate()))
+	fail("serialize", n);
+
+    /* truncated and corrupted buffers must be rejected */
+    if (n && copy.deserialize(pBuffer, size - 1))
+	fail("truncated", n);
+    if (!copy.isSparse() || (copy.estimate() != 0))
+	fail("reset", n);
+    pBuffer[0] ^= 1;
+    if (copy.deserialize(pBuffer, size))
+	fail("magic", n);
+
+    delete[] pBuffer;
+}
+
+int main()
+{
+    static const unsigned long counts[] =
+	{0, 1, 10, 1000, 5000, 20000, 100000, 1000000};
+
+    for(size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+	testAccuracy(14, counts[i]);
+	testAccuracy(10, counts[i]);
+	if (counts[i])
+	    testMerge(counts[i]);
+	testSerialize(counts[i]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testIntrusiveHash.cpp - test IntrusiveHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "IntrusiveHash.h"
+#include "Hashable.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+struct Session
+{
+    unsigned long id;
+    const char *pName;
+    IntrusiveHashMembership byId;
+    IntrusiveHashMembership byName;
+
+    static unsigned live;
+
+    Session(unsigned long i, const char *pN):
+	id(i),
+	pName(pN)
+    {
+	++live;
+    }
+
+    ~Session()
+    {
+	--live;
+    }
+};
+
+unsigned Session::live = 0;
+
+typedef IntrusiveHashTable<Session, offsetof(Session, byId)> IdTable;
+typedef IntrusiveHashTable<Session, offsetof(Session, byName)> NameTable;
+
+#define N_SESSIONS 10000
+
+static bool testOnce()
+{
+    IdTable idTable(offsetof(Session, id), hashUnsignedLong,
+		    compareUnsignedLong);
+    static Session *apSession[N_SESSIONS];
+
+    /* load the table, growing it many times */
+    for(unsigned long i = 0; i < N_SESSIONS; ++i)
+    {
+	apSession[i] = new Session(i * 7919, "");
+	idTable.add(apSession[i]);
+	if (!apSession[i]->byId.isMember())
+	    return false;
+    }
+    if (idTable.getCount() != N_SESSIONS)
+	return false;
+
+    /* everything can be found after the resizes */
+    for(unsigned long i = 0; i < N_SESSIONS; ++i)
+    {
+	HashableUnsignedLong key(i * 7919);
+	if (idTable.find(&key) != apSession[i])
+	    return false;
+    }
+
+    /* missing keys are not found */
+    HashableUnsignedLong missing(1);
+    if (idTable.find(&missing))
+	return false;
+
+    /* remove a random half */
+    for(unsigned long i = 0; i < N_SESSIONS; ++i)
+    {
+	if (rand() & 1)
+	{
+	    idTable.remove(apSession[i]);
+	    if (apSession[i]->byId.isMember())
+		return false;
+	    delete apSession[i];
+	    apSession[i] = NULL;
+	}
+    }
+
+    size_t remaining = 0;
+    for(unsigned long i = 0; i < N_SESSIONS; ++i)
+    {
+	HashableUnsignedLong key(i * 7919);
+	if (idTable.find(&key) != apSession[i])
+	    return false;
+	if (apSession[i])
+	    ++remaining;
+    }
+    if (idTable.getCount() != remaining)
+	return false;
+
+    /* iteration visits every element exactly once */
+    size_t visited = 0;
+    for(Session *pS = idTable.getFirst(); pS; pS = idTable.getNext(pS))
+	++visited;
+    if (visited != remaining)
+	return false;
+
+    /* shrinking relinks without losing anything */
+    idTable.resize(16);
+    for(unsigned long i = 0; i < N_SESSIONS; ++i)
+    {
+	HashableUnsignedLong key(i * 7919);
+	if (idTable.find(&key) != apSession[i])
+	    return false;
+    }
+
+    /* the table deletes whatever is left when it goes away */
+    return true;
+}
+
+static bool testDuplicates()
+{
+    NameTable nameTable(offsetof(Session, pName), hashCharStar,
+			compareCharStar, 4);
+    Session a(1, "alpha");
+    Session b(2, "bravo");
+    Session c(3, "alpha");
+
+    nameTable.add(&a);
+    nameTable.add(&b);
+    nameTable.add(&c);
+
+    HashableString key("alpha");
+    unsigned found = 0;
+    for(Session *pS = nameTable.find(&key); pS;
+	pS = nameTable.findNext(&key, pS))
+    {
+	if (pS != &a && pS != &c)
+	    return false;
+	++found;
+    }
+    if (found != 2)
+	return false;
+
+    HashableString bravo("bravo");
+    if (nameTable.find(&bravo) != &b)
+	return false;
+
+    /* these are on the stack, so don't let the table delete them */
+    nameTable.remove(&a);
+    nameTable.remove(&b);
+    nameTable.remove(&c);
+    return nameTable.isEmpty();
+}
+
+int main()
+{
+    /* seed the random number generator so we get repeatable runs */
+    srand(0xdeadbeef);
+
+    for(unsigned i = 0; i < 10; ++i)
+    {
+	if (!testOnce())
+	{
+	    fprintf(stderr, "%s failure iteration %u\n", __FILE__, i);
+	    exit(1);
+	}
+	assert(Session::live == 0);
+    }
+
+    if (!testDuplicates())
+    {
+	fprintf(stderr, "%s duplicate key failure\n", __FILE__);
+	exit(1);
+    }
+
+    return 0;
+}
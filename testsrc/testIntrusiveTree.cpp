@@ -0,0 +1,249 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testIntrusiveTree.cpp - test IntrusiveTree.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Random inserts and removals are checked against a count of the elements
+    with each key.  The tree's own verify() checks the red-black invariants
+    as it goes, and walks in both directions check the order of the keys,
+    and that duplicates stay in the order in which they were inserted.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "IntrusiveTree.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define N_KEYS 1000
+#define N_OPS 200000
+
+struct Item
+{
+    unsigned long seq;
+    unsigned long key;
+    IntrusiveTreeMembership link;
+
+    static unsigned long live;
+
+    Item(unsigned long s, unsigned long k):
+	seq(s),
+	key(k)
+    {
+	++live;
+    }
+
+    ~Item()
+    {
+	--live;
+    }
+};
+
+unsigned long Item::live = 0;
+
+typedef IntrusiveTree<Item, offsetof(Item, link)> Tree;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+/* walk the whole tree both ways, and compare it with the key counts */
+static void check(const char *pWhat, const Tree *pTree,
+		  const unsigned long *pCount, unsigned long total)
+{
+    if (!pTree->verify() || (pTree->getCount() != total) ||
+	(pTree->isEmpty() != !total))
+	fail(pWhat, total);
+
+    unsigned long seen[N_KEYS];
+    memset(seen, 0, sizeof(seen));
+    unsigned long n = 0;
+    const Item *pPrevious = NULL;
+    for(Item *pItem = pTree->getFirst(); pItem;
+	pItem = pTree->getNext(pItem), ++n)
+    {
+	if (pPrevious && (pPrevious->key == pItem->key) &&
+	    (pPrevious->seq > pItem->seq))
+	    fail(pWhat, n);
+	if (pTree->getPrevious(pItem) != pPrevious)
+	    fail(pWhat, n);
+	++seen[pItem->key];
+	pPrevious = pItem;
+    }
+    if ((n != total) || (pTree->getLast() != pPrevious) ||
+	memcmp(seen, pCount, sizeof(seen)))
+	fail(pWhat, n);
+}
+
+static void testEmpty()
+{
+    Tree tree(offsetof(Item, key), compareUnsignedLong);
+    unsigned long key = 5;
+    if (tree.getFirst() || tree.getLast() || tree.find(&key) ||
+	tree.lowerBound(&key) || tree.upperBound(&key) || !tree.verify())
+	fail("empty", 0);
+
+    Item item(0, 5);
+    if (item.link.isMember())
+	fail("not member", 0);
+    tree.insert(&item);
+    if (!item.link.isMember() || (tree.find(&key) != &item) ||
+	(tree.getFirst() != &item) || (tree.getLast() != &item) ||
+	tree.getNext(&item) || tree.getPrevious(&item))
+	fail("one", 0);
+    tree.remove(&item);
+    if (item.link.isMember() || !tree.isEmpty() || !tree.verify())
+	fail("removed", 0);
+}
+
+static void testRandom()
+{
+    Tree tree(offsetof(Item, key), compareUnsignedLong);
+    unsigned long count[N_KEYS];
+    memset(count, 0, sizeof(count));
+
+    /* the elements in the tree, so that random ones can be removed */
+    Item **ppItem = new Item *[N_OPS];
+    unsigned long nItems = 0;
+
+    for(unsigned long op = 0; op < N_OPS; ++op)
+    {
+	const unsigned long key = (unsigned long)rand() % N_KEYS;
+	const unsigned r = (unsigned)rand() % 8;
+	if ((r < 3) || !nItems)
+	{
+	    Item *pItem = new Item(op, key);
+	    tree.insert(pItem);
+	    ppItem[nItems++] = pItem;
+	    ++count[key];
+	}
+	else if (r < 5)
+	{
+	    Item *pItem = new Item(op, key);
+	    Item *pExisting = tree.insertUnique(pItem);
+	    if (pExisting)
+	    {
+		if (!count[key] || (pExisting->key != key) ||
+		    pItem->link.isMember())
+		    fail("insertUnique existing", op);
+		delete pItem;
+	    }
+	    else
+	    {
+		if (count[key])
+		    fail("insertUnique duplicate", op);
+		ppItem[nItems++] = pItem;
+		++count[key];
+	    }
+	}
+	else
+	{
+	    /* removal is done by element, with no search */
+	    const unsigned long i = (unsigned long)rand() % nItems;
+	    Item *pItem = ppItem[i];
+	    ppItem[i] = ppItem[--nItems];
+	    tree.remove(pItem);
+	    --count[pItem->key];
+	    delete pItem;
+	}
+
+	/* searches */
+	Item *pFound = tree.find(&key);
+	if (count[key] ? (!pFound || (pFound->key != key)) : !!pFound)
+	    fail("find", op);
+
+	unsigned long lower = key;
+	while((lower < N_KEYS) && !count[lower])
+	    ++lower;
+	Item *pLower = tree.lowerBound(&key);
+	if ((lower == N_KEYS) ? !!pLower :
+	    (!pLower || (pLower->key != lower) ||
+	     (tree.getPrevious(pLower) && (tree.getPrevious(pLower)->key >= key))))
+	    fail("lowerBound", op);
+
+	unsigned long upper = key + 1;
+	while((upper < N_KEYS) && !count[upper])
+	    ++upper;
+	Item *pUpper = tree.upperBound(&key);
+	if ((upper == N_KEYS) ? !!pUpper :
+	    (!pUpper || (pUpper->key != upper) ||
+	     (tree.getPrevious(pUpper) && (tree.getPrevious(pUpper)->key > key))))
+	    fail("upperBound", op);
+
+	if (!(op % 997))
+	    check("random", &tree, count, nItems);
+    }
+    check("random end", &tree, count, nItems);
+
+    /* remove everything while iterating */
+    Item *pNext;
+    for(Item *pItem = tree.getFirst(); pItem; pItem = pNext)
+    {
+	pNext = tree.getNext(pItem);
+	if (pItem->seq & 1)
+	{
+	    tree.remove(pItem);
+	    --count[pItem->key];
+	    --nItems;
+	    delete pItem;
+	}
+    }
+    check("remove while iterating", &tree, count, nItems);
+
+    /* the tree deletes what is left */
+    delete[] ppItem;
+}
+
+static void testSequential()
+{
+    /* ascending and descending inserts are the worst case for balance */
+    Tree tree(offsetof(Item, key), compareUnsignedLong);
+    unsigned long count[N_KEYS];
+    memset(count, 0, sizeof(count));
+    for(unsigned long i = 0; i < N_KEYS / 2; ++i)
+    {
+	tree.insert(new Item(i, i));
+	tree.insert(new Item(i, N_KEYS - 1 - i));
+	count[i] = 1;
+	count[N_KEYS - 1 - i] = 1;
+    }
+    check("sequential", &tree, count, N_KEYS);
+
+    unsigned long key = 0;
+    for(unsigned long i = 0; i < N_KEYS; i += 2)
+    {
+	key = i;
+	Item *pItem = tree.find(&key);
+	tree.remove(pItem);
+	delete pItem;
+	count[i] = 0;
+    }
+    check("sequential remove", &tree, count, N_KEYS / 2);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testEmpty();
+    testRandom();
+    testSequential();
+
+    if (Item::live)
+	fail("leak", Item::live);
+
+    return 0;
+}
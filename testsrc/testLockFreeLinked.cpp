@@ -0,0 +1,249 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testLockFreeLinked.cpp - test LockFreeLinked.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Several producers push numbered messages onto one queue while a single
+    consumer pops them; every message must arrive exactly once, and each
+    producer's messages must arrive in the order they were sent.
+
+    For the stack, several threads repeatedly pop elements and push them
+    back, which is the pattern that provokes ABA; at the end every element
+    must be on the stack exactly once.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+#include "LockFreeLinked.h"
+
+using namespace phoenix4cpp;
+
+#define N_PRODUCERS 4
+#define N_MESSAGES 200000
+#define N_THREADS 4
+#define N_ELEMENTS 64
+#define N_ROUNDS 200000
+
+struct Message
+{
+    unsigned producer;
+    unsigned long seq;
+    LockFreeMembership link;
+};
+
+typedef MpscQueue<Message, offsetof(Message, link)> Queue;
+
+struct Element
+{
+    unsigned long id;
+    unsigned long owner;   /* written by whichever thread holds it */
+    LockFreeMembership link;
+};
+
+typedef LockFreeStack<Element, offsetof(Element, link)> Stack;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void testQueueSingle()
+{
+    Queue queue;
+    Message message[3];
+    if (!queue.isEmpty() || queue.pop())
+	fail("empty queue", 0);
+
+    for(unsigned long i = 0; i < 3; ++i)
+    {
+	message[i].seq = i;
+	queue.push(&message[i]);
+    }
+    if (queue.isEmpty())
+	fail("not empty", 0);
+
+    /* interleave pushes and pops, including through the stub */
+    if (queue.pop() != &message[0])
+	fail("queue order", 0);
+    queue.push(&message[0]);
+    for(unsigned long i = 1; i < 4; ++i)
+    {
+	if (queue.pop() != &message[i % 3])
+	    fail("queue order", i);
+    }
+    if (!queue.isEmpty() || queue.pop())
+	fail("drained", 0);
+
+    queue.push(&message[2]);
+    if (queue.pop() != &message[2] || queue.pop())
+	fail("reuse", 0);
+}
+
+struct Producer
+{
+    Queue *pQueue;
+    unsigned id;
+    Message *pMessage;
+};
+
+static void *produce(void *pArg)
+{
+    Producer *pProducer = (Producer *)pArg;
+    for(unsigned long i = 0; i < N_MESSAGES; ++i)
+    {
+	Message *pMessage = &pProducer->pMessage[i];
+	pMessage->producer = pProducer->id;
+	pMessage->seq = i;
+	pProducer->pQueue->push(pMessage);
+    }
+
+    return NULL;
+}
+
+static void testQueueThreaded()
+{
+    Queue queue;
+    Producer producer[N_PRODUCERS];
+    pthread_t thread[N_PRODUCERS];
+    for(unsigned p = 0; p < N_PRODUCERS; ++p)
+    {
+	producer[p].pQueue = &queue;
+	producer[p].id = p;
+	producer[p].pMessage = new Message[N_MESSAGES];
+	pthread_create(&thread[p], NULL, produce, &producer[p]);
+    }
+
+    unsigned long next[N_PRODUCERS];
+    memset(next, 0, sizeof(next));
+    for(unsigned long received = 0; received < N_PRODUCERS * N_MESSAGES;)
+    {
+	Message *pMessage = queue.pop();
+	if (!pMessage)
+	    continue;
+
+	if ((pMessage->producer >= N_PRODUCERS) ||
+	    (pMessage->seq != next[pMessage->producer]))
+	    fail("queue threaded order", received);
+	++next[pMessage->producer];
+	++received;
+    }
+
+    for(unsigned p = 0; p < N_PRODUCERS; ++p)
+    {
+	pthread_join(thread[p], NULL);
+	delete[] producer[p].pMessage;
+    }
+    if (queue.pop() || !queue.isEmpty())
+	fail("queue threaded drained", 0);
+}
+
+static void testStackSingle()
+{
+    Stack stack;
+    Element element[3];
+    if (!stack.isEmpty() || stack.pop())
+	fail("empty stack", 0);
+
+    for(unsigned long i = 0; i < 3; ++i)
+	stack.push(&element[i]);
+    for(unsigned long i = 3; i-- > 0;)
+    {
+	if (stack.pop() != &element[i])
+	    fail("stack order", i);
+    }
+    if (!stack.isEmpty() || stack.pop())
+	fail("stack drained", 0);
+}
+
+struct Churner
+{
+    Stack *pStack;
+    unsigned long id;
+};
+
+static void *churn(void *pArg)
+{
+    Churner *pChurner = (Churner *)pArg;
+    for(unsigned long i = 0; i < N_ROUNDS; ++i)
+    {
+	/* hold two at a time, so that the top changes underneath others */
+	Element *pA = pChurner->pStack->pop();
+	Element *pB = pChurner->pStack->pop();
+	if (pA)
+	    pA->owner = pChurner->id;
+	if (pB)
+	    pB->owner = pChurner->id;
+	if (pA)
+	{
+	    if (pA->owner != pChurner->id)
+		fail("stack ownership", i);
+	    pChurner->pStack->push(pA);
+	}
+	if (pB)
+	{
+	    if (pB->owner != pChurner->id)
+		fail("stack ownership", i);
+	    pChurner->pStack->push(pB);
+	}
+    }
+
+    return NULL;
+}
+
+static void testStackThreaded()
+{
+    Stack stack;
+    static Element element[N_ELEMENTS];
+    for(unsigned long i = 0; i < N_ELEMENTS; ++i)
+    {
+	element[i].id = i;
+	stack.push(&element[i]);
+    }
+
+    Churner churner[N_THREADS];
+    pthread_t thread[N_THREADS];
+    for(unsigned t = 0; t < N_THREADS; ++t)
+    {
+	churner[t].pStack = &stack;
+	churner[t].id = t;
+	pthread_create(&thread[t], NULL, churn, &churner[t]);
+    }
+    for(unsigned t = 0; t < N_THREADS; ++t)
+	pthread_join(thread[t], NULL);
+
+    bool seen[N_ELEMENTS];
+    memset(seen, 0, sizeof(seen));
+    unsigned long count = 0;
+    Element *pElement;
+    while((pElement = stack.pop()))
+    {
+	if ((pElement->id >= N_ELEMENTS) || seen[pElement->id])
+	    fail("stack threaded duplicate", count);
+	seen[pElement->id] = true;
+	++count;
+    }
+    if (count != N_ELEMENTS)
+	fail("stack threaded count", count);
+}
+
+int main()
+{
+    testQueueSingle();
+    testQueueThreaded();
+    testStackSingle();
+    testStackThreaded();
+
+    return 0;
+}
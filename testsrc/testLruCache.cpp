@@ -0,0 +1,448 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testLruCache.cpp - test LruCache.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    The LRU policy is checked against a simple array model of the recency
+    order under random operations.  CLOCK and SIEVE are checked for the
+    properties that distinguish them, and the sharded cache is checked for
+    conservation of elements with several threads.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+#include "Hashable.h"
+#include "LruCache.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+struct Entry
+{
+    unsigned long key;
+    unsigned long value;
+    LruCacheMembership membership;
+
+    static unsigned long live;
+
+    Entry(unsigned long k, unsigned long v):
+	key(k),
+	value(v)
+    {
+	__atomic_add_fetch(&live, 1, __ATOMIC_RELAXED);
+    }
+
+    ~Entry()
+    {
+	__atomic_sub_fetch(&live, 1, __ATOMIC_RELAXED);
+    }
+};
+
+unsigned long Entry::live = 0;
+
+typedef LruCache<Entry, offsetof(Entry, membership)> Cache;
+typedef ShardedLruCache<Entry, offsetof(Entry, membership)> Sharded;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+struct Evicted
+{
+    unsigned long count;
+    unsigned long lastKey;
+};
+
+static void evictEntry(Evicted *pEvicted, Entry *pEntry)
+{
+    ++pEvicted->count;
+    pEvicted->lastKey = pEntry->key;
+    delete pEntry;
+}
+
+static bool has(Cache *pCache, unsigned long key)
+{
+    HashableUnsignedLong hKey(key);
+    return pCache->peek(&hKey) != NULL;
+}
+
+static void hit(Cache *pCache, unsigned long key)
+{
+    HashableUnsignedLong hKey(key);
+    if (!pCache->find(&hKey))
+	fail("hit", key);
+}
+
+#define MODEL_CAPACITY 50
+#define MODEL_KEYS 200
+
+static void testLruModel()
+{
+    Evicted evicted = {0, 0};
+    Cache cache(offsetof(Entry, key), hashUnsignedLong, compareUnsignedLong,
+		MODEL_CAPACITY, Cache::LRU, evictEntry, &evicted);
+
+    /* the model keeps keys from the most to the least recently used */
+    unsigned long model[MODEL_CAPACITY + 1];
+    size_t nModel = 0;
+
+    for(unsigned long op = 0; op < 100000; ++op)
+    {
+	const unsigned long key = (unsigned long)rand() % MODEL_KEYS;
+	size_t i;
+	for(i = 0; (i < nModel) && (model[i] != key); ++i)
+	    ;
+
+	HashableUnsignedLong hKey(key);
+	Entry *pEntry = cache.find(&hKey);
+	if ((pEntry != NULL) != (i < nModel))
+	    fail("model find", op);
+
+	if (pEntry)
+	{
+	    if (pEntry->key != key)
+		fail("model key", op);
+	    memmove(model + 1, model, i * sizeof(model[0]));
+	    model[0] = key;
+	}
+	else
+	{
+	    const unsigned long before = evicted.count;
+	    cache.insert(new Entry(key, op));
+	    memmove(model + 1, model, nModel * sizeof(model[0]));
+	    model[0] = key;
+	    if (nModel == MODEL_CAPACITY)
+	    {
+		if ((evicted.count != before + 1) ||
+		    (evicted.lastKey != model[MODEL_CAPACITY]))
+		    fail("model eviction", op);
+	    }
+	    else
+		++nModel;
+	}
+
+	/* iteration follows the recency order */
+	if (!(op % 1000))
+	{
+	    i = 0;
+	    for(Entry *pE = cache.getFirst(); pE; pE = cache.getNext(pE), ++i)
+	    {
+		if ((i >= nModel) || (pE->key != model[i]))
+		    fail("model order", op);
+	    }
+	    if (i != nModel)
+		fail("model count", op);
+	}
+    }
+
+    if ((cache.getCount() != nModel) || (cache.getCharge() != nModel))
+	fail("model size", cache.getCount());
+}
+
+static void testCharges()
+{
+    Evicted evicted = {0, 0};
+    Cache cache(offsetof(Entry, key), hashUnsignedLong, compareUnsignedLong,
+		1000, Cache::LRU, evictEntry, &evicted);
+
+    /* capacity by bytes */
+    for(unsigned long k = 0; k < 10; ++k)
+	cache.insert(new Entry(k, 0), 100);
+    if ((cache.getCharge() != 1000) || evicted.count)
+	fail("charge", cache.getCharge());
+    cache.insert(new Entry(10, 0), 250);
+    if ((cache.getCharge() != 950) || (evicted.count != 3) || has(&cache, 2) ||
+	!has(&cache, 3))
+	fail("charge eviction", cache.getCharge());
+
+    /* replacing a key evicts the old element */
+    hit(&cache, 3);
+    cache.insert(new Entry(3, 1), 50);
+    if ((evicted.count != 4) || (evicted.lastKey != 3) ||
+	(cache.getCharge() != 900) || (cache.getFirst()->value != 1))
+	fail("replace", evicted.count);
+
+    /* an element too big for the cache is evicted straight away, alone */
+    cache.insert(new Entry(99, 0), 1001);
+    if ((cache.getCount() != 8) || (evicted.count != 5) ||
+	(evicted.lastKey != 99) || (cache.getCharge() != 900))
+	fail("too big", cache.getCount());
+
+    /* start the rest from empty */
+    cache.setCapacity(0);
+    cache.setCapacity(1000);
+    if (cache.getCount() || cache.getCharge())
+	fail("empty", cache.getCount());
+
+    /* removal doesn't evict */
+    Entry *pEntry = new Entry(5, 0);
+    cache.insert(pEntry, 10);
+    cache.insert(new Entry(6, 0), 10);
+    const unsigned long before = evicted.count;
+    cache.remove(pEntry);
+    if ((evicted.count != before) || pEntry->membership.isMember() ||
+	(cache.getCount() != 1) || (cache.getCharge() != 10))
+	fail("remove", 0);
+    delete pEntry;
+
+    cache.setCapacity(5);
+    if (cache.getCount() || (evicted.count != before + 1))
+	fail("setCapacity", cache.getCount());
+}
+
+static void testClock()
+{
+    Evicted evicted = {0, 0};
+    Cache cache(offsetof(Entry, key), hashUnsignedLong, compareUnsignedLong,
+		4, Cache::CLOCK, evictEntry, &evicted);
+
+    for(unsigned long k = 0; k < 4; ++k)
+	cache.insert(new Entry(k, 0));
+
+    /* a referenced element gets a second chance */
+    hit(&cache, 0);
+    cache.insert(new Entry(4, 0));
+    if (!has(&cache, 0) || has(&cache, 1) || (evicted.lastKey != 1))
+	fail("clock second chance", evicted.lastKey);
+
+    /* the hand carries on from where it stopped */
+    cache.insert(new Entry(5, 0));
+    if (evicted.lastKey != 2)
+	fail("clock hand", evicted.lastKey);
+
+    /* with everything referenced, the hand goes all the way round */
+    hit(&cache, 0);
+    hit(&cache, 3);
+    hit(&cache, 4);
+    hit(&cache, 5);
+    cache.insert(new Entry(6, 0));
+    if ((evicted.lastKey != 3) || (cache.getCount() != 4))
+	fail("clock wrap", evicted.lastKey);
+}
+
+static void testSieve()
+{
+    Evicted evicted = {0, 0};
+    Cache cache(offsetof(Entry, key), hashUnsignedLong, compareUnsignedLong,
+		4, Cache::SIEVE, evictEntry, &evicted);
+
+    for(unsigned long k = 0; k < 4; ++k)
+	cache.insert(new Entry(k, 0));
+    hit(&cache, 0);
+    hit(&cache, 1);
+
+    /* the oldest unvisited element goes first */
+    cache.insert(new Entry(4, 0));
+    if (evicted.lastKey != 2)
+	fail("sieve first", evicted.lastKey);
+
+    /* survivors stay put, and the hand keeps moving towards the newest */
+    hit(&cache, 4);
+    cache.insert(new Entry(5, 0));
+    if (evicted.lastKey != 3)
+	fail("sieve hand", evicted.lastKey);
+
+    /*
+      The hand is now at the newest end; everything older than 5 has been
+      visited, so the next sweep clears them, and 5 goes, having never been
+      hit.
+    */
+    cache.insert(new Entry(6, 0));
+    if (evicted.lastKey != 5)
+	fail("sieve one hit wonder", evicted.lastKey);
+    if (!has(&cache, 0) || !has(&cache, 1) || !has(&cache, 4) ||
+	!has(&cache, 6))
+	fail("sieve survivors", 0);
+
+    /* a scan of new keys doesn't push out the visited ones */
+    hit(&cache, 0);
+    hit(&cache, 1);
+    for(unsigned long k = 100; k < 120; ++k)
+	cache.insert(new Entry(k, 0));
+    if (!has(&cache, 0) || !has(&cache, 1))
+	fail("sieve scan", 0);
+}
+
+static void testOwnership()
+{
+    const unsigned long live = Entry::live;
+    {
+	Cache cache(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, 10, Cache::SIEVE);
+	for(unsigned long k = 0; k < 100; ++k)
+	    cache.insert(new Entry(k, 0));
+	if (Entry::live != live + 10)
+	    fail("owned eviction", Entry::live);
+    }
+    if (Entry::live != live)
+	fail("owned destruction", Entry::live);
+
+    /* re-inserting an owned element changes its charge, and keeps it */
+    {
+	Cache cache(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, 10, Cache::LRU);
+	Entry *pEntry = new Entry(1, 0);
+	cache.insert(pEntry);
+	cache.insert(new Entry(2, 0));
+	cache.insert(pEntry, 2);
+	if ((Entry::live != live + 2) || (cache.getCount() != 2) ||
+	    (cache.getCharge() != 3) || (cache.getFirst() != pEntry) ||
+	    !has(&cache, 1))
+	    fail("reinsert", cache.getCharge());
+	cache.insert(pEntry, 10);
+	if ((Entry::live != live + 1) || (cache.getCount() != 1) ||
+	    (cache.getCharge() != 10))
+	    fail("reinsert eviction", cache.getCharge());
+    }
+    if (Entry::live != live)
+	fail("reinsert destruction", Entry::live);
+
+    /* an element bigger than the cache is evicted without emptying it */
+    {
+	Cache cache(offsetof(Entry, key), hashUnsignedLong,
+		    compareUnsignedLong, 10, Cache::LRU);
+	for(unsigned long k = 0; k < 5; ++k)
+	    cache.insert(new Entry(k, 0));
+	cache.insert(new Entry(5, 0), 11);
+	if ((Entry::live != live + 5) || (cache.getCount() != 5) ||
+	    (cache.getCharge() != 5) || has(&cache, 5))
+	    fail("oversized", cache.getCount());
+    }
+    if (Entry::live != live)
+	fail("oversized destruction", Entry::live);
+}
+
+#define N_THREADS 4
+#define SHARDED_CAPACITY 1000
+#define SHARDED_KEYS 5000
+
+struct Worker
+{
+    Sharded *pCache;
+    unsigned long inserted;
+    unsigned long hits;
+    unsigned long bad;
+};
+
+struct Counter
+{
+    unsigned long evicted;
+};
+
+static void evictCounted(Counter *pCounter, Entry *pEntry)
+{
+    __atomic_add_fetch(&pCounter->evicted, 1, __ATOMIC_RELAXED);
+    delete pEntry;
+}
+
+static void visit(Worker *pWorker, Entry *pEntry)
+{
+    if (pEntry->value != pEntry->key * 3)
+	++pWorker->bad;
+    ++pWorker->hits;
+}
+
+static void *work(void *pArg)
+{
+    Worker *pWorker = (Worker *)pArg;
+    unsigned long state = (unsigned long)pArg | 1;
+
+    for(unsigned long op = 0; op < 100000; ++op)
+    {
+	state = state * 6364136223846793005UL + 1442695040888963407UL;
+	const unsigned long key = (state >> 33) % SHARDED_KEYS;
+	HashableUnsignedLong hKey(key);
+	if (!pWorker->pCache->find(&hKey, visit, pWorker))
+	{
+	    pWorker->pCache->insert(new Entry(key, key * 3));
+	    ++pWorker->inserted;
+	}
+    }
+
+    return NULL;
+}
+
+static void testSharded(LruCacheBase::Policy policy)
+{
+    const unsigned long live = Entry::live;
+    Counter counter = {0};
+    {
+	Sharded cache(offsetof(Entry, key), hashUnsignedLong,
+		      compareUnsignedLong, SHARDED_CAPACITY, policy,
+		      evictCounted, &counter, 8);
+
+	Worker worker[N_THREADS];
+	pthread_t thread[N_THREADS];
+	for(unsigned t = 0; t < N_THREADS; ++t)
+	{
+	    memset(&worker[t], 0, sizeof(worker[t]));
+	    worker[t].pCache = &cache;
+	    pthread_create(&thread[t], NULL, work, &worker[t]);
+	}
+
+	unsigned long inserted = 0;
+	unsigned long hits = 0;
+	for(unsigned t = 0; t < N_THREADS; ++t)
+	{
+	    pthread_join(thread[t], NULL);
+	    if (worker[t].bad)
+		fail("sharded visit", worker[t].bad);
+	    inserted += worker[t].inserted;
+	    hits += worker[t].hits;
+	}
+
+	/* each shard holds a share of the capacity, rounded up */
+	const size_t count = cache.getCount();
+	if ((count > SHARDED_CAPACITY + 8) || (count != cache.getCharge()))
+	    fail("sharded count", count);
+	if ((inserted != counter.evicted + count) || !hits)
+	    fail("sharded conservation", inserted);
+	if (Entry::live != live + count)
+	    fail("sharded live", Entry::live);
+
+	HashableUnsignedLong missing(SHARDED_KEYS + 1);
+	if (cache.erase(&missing))
+	    fail("sharded erase missing", 0);
+	for(unsigned long k = 0; k < SHARDED_KEYS; ++k)
+	{
+	    HashableUnsignedLong hKey(k);
+	    cache.erase(&hKey);
+	}
+	if (cache.getCount() || (Entry::live != live))
+	    fail("sharded erase", cache.getCount());
+
+	cache.insert(new Entry(1, 3));
+    }
+    if (Entry::live != live)
+	fail("sharded destruction", Entry::live);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testLruModel();
+    testCharges();
+    testClock();
+    testSieve();
+    testOwnership();
+    testSharded(LruCacheBase::LRU);
+    testSharded(LruCacheBase::CLOCK);
+    testSharded(LruCacheBase::SIEVE);
+
+    return 0;
+}
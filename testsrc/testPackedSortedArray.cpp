@@ -0,0 +1,194 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testPackedSortedArray.cpp - test PackedSortedArray.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Arrays are made with gaps of several sizes, from none at all, which
+    gives duplicates and zero-bit blocks, up to the full width of an
+    unsigned long, and with lengths on either side of a block boundary.
+    Every access is checked against the original array.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "PackedSortedArray.h"
+
+using namespace phoenix4cpp;
+
+#define MAX_VALUES 5000
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static unsigned long random64()
+{
+    return (((unsigned long)rand()) << 42) ^
+	(((unsigned long)rand()) << 21) ^ (unsigned long)rand();
+}
+
+/* @returns the position of the first value not less than value */
+static size_t expectedBound(const unsigned long *pValues, size_t n,
+			    unsigned long value)
+{
+    size_t i = 0;
+    while((i < n) && (pValues[i] < value))
+	++i;
+    return i;
+}
+
+static void checkBound(const char *pWhat, const PackedSortedArray *pArray,
+		       const unsigned long *pValues, size_t n,
+		       unsigned long value)
+{
+    const size_t expected = expectedBound(pValues, n, value);
+    unsigned long found = value ^ 1;
+    const size_t i = pArray->lowerBound(value, &found);
+    if (i != expected)
+	fail(pWhat, value);
+    if ((i < n) && (found != pValues[i]))
+	fail(pWhat, value);
+    if (pArray->contains(value) != ((i < n) && (pValues[i] == value)))
+	fail(pWhat, value);
+}
+
+static void testOnce(const char *pWhat, size_t n, unsigned long maxGap,
+		     unsigned long start)
+{
+    static unsigned long values[MAX_VALUES];
+    unsigned long value = start;
+    for(size_t i = 0; i < n; ++i)
+    {
+	values[i] = value;
+	const unsigned long gap = maxGap ? random64() % (maxGap + 1) : 0;
+	if (value + gap < value)
+	{
+	    /* don't wrap around; the rest are duplicates */
+	    maxGap = 0;
+	    continue;
+	}
+	value += gap;
+    }
+
+    PackedSortedArray array(values, n);
+    if (array.getCount() != n)
+	fail(pWhat, array.getCount());
+    if (array.getBlockCount() !=
+	(n + PackedSortedArray::blockValues - 1) /
+	PackedSortedArray::blockValues)
+	fail(pWhat, array.getBlockCount());
+
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (array.get(i) != values[i])
+	    fail(pWhat, i);
+    }
+
+    /* every value, its neighbours, and some values in between */
+    if (n)
+	checkBound(pWhat, &array, values, n, 0);
+    for(size_t i = 0; i < n; ++i)
+    {
+	checkBound(pWhat, &array, values, n, values[i]);
+	if (values[i])
+	    checkBound(pWhat, &array, values, n, values[i] - 1);
+	if (values[i] + 1)
+	    checkBound(pWhat, &array, values, n, values[i] + 1);
+	checkBound(pWhat, &array, values, n,
+		   values[i] + random64() % (maxGap + 1));
+    }
+    if (array.lowerBound(~0UL) > n)
+	fail(pWhat, n);
+
+    /* iterate */
+    PackedSortedArrayCursor cursor(&array);
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (cursor.getPosition() != i)
+	    fail(pWhat, i);
+	unsigned long v;
+	if (!cursor.next(&v) || (v != values[i]))
+	    fail(pWhat, i);
+    }
+    unsigned long v;
+    if (cursor.next(&v) || (cursor.getPosition() != n))
+	fail(pWhat, n);
+
+    /* skip ahead, by varying distances, sometimes not at all */
+    PackedSortedArrayCursor seeker(&array);
+    size_t position = 0;
+    while(position < n)
+    {
+	size_t target = position + rand() % 300;
+	if (target >= n)
+	    target = n - 1;
+	unsigned long seekTo = values[target];
+	if (!(rand() % 4) && seekTo)
+	    --seekTo;
+
+	/* the first value not less than seekTo, at or after position */
+	size_t expected = expectedBound(values, n, seekTo);
+	if (expected < position)
+	    expected = position;
+	if (!seeker.seek(seekTo, &v))
+	{
+	    if (expected < n)
+		fail(pWhat, position);
+	    break;
+	}
+	if ((expected >= n) || (v != values[expected]) ||
+	    (seeker.getPosition() != expected + 1))
+	    fail(pWhat, position);
+	position = expected + 1;
+    }
+    if ((n && (seeker.seek(values[n - 1], &v) ||
+		seeker.seek(~0UL, &v))))
+	fail(pWhat, n);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testOnce("empty", 0, 10, 0);
+    testOnce("one", 1, 10, 12345);
+    testOnce("one block", PackedSortedArray::blockValues, 1000, 0);
+    testOnce("partial block", PackedSortedArray::blockValues + 1, 1000, 7);
+    testOnce("duplicates", MAX_VALUES, 0, 99);
+    testOnce("few duplicates", MAX_VALUES, 1, 0);
+    testOnce("dense", MAX_VALUES, 3, 1);
+    testOnce("ids", MAX_VALUES, 2000, 1000000);
+    testOnce("wide", MAX_VALUES, 1UL << 40, 0);
+    testOnce("full width", 300, ~0UL >> 2, 0);
+    testOnce("top", 1000, 1000, ~0UL - 600000);
+
+    /* a gap that needs all 64 bits */
+    unsigned long extremes[] = { 0, 1, 2, ~0UL - 1, ~0UL };
+    PackedSortedArray array(extremes, 5);
+    for(size_t i = 0; i < 5; ++i)
+    {
+	if ((array.get(i) != extremes[i]) || !array.contains(extremes[i]))
+	    fail("extremes", i);
+    }
+
+    /* compression */
+    static unsigned long ids[MAX_VALUES];
+    for(size_t i = 0; i < MAX_VALUES; ++i)
+	ids[i] = 1000000 + i * 1000 + rand() % 1000;
+    PackedSortedArray packed(ids, MAX_VALUES);
+    if (packed.getBytes() * 4 > MAX_VALUES * sizeof(unsigned long))
+	fail("compression", packed.getBytes());
+
+    return 0;
+}
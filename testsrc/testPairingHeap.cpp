@@ -0,0 +1,152 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testPairingHeap.cpp - test PairingHeap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A fixed set of tasks is pushed, popped, removed and given smaller keys
+    at random.  Each task knows whether it is queued, and every pop is
+    checked against the smallest key among the queued tasks, found by
+    brute force.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "PairingHeap.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define N_TASKS 500
+#define N_OPS 200000
+
+struct Task
+{
+    unsigned long deadline;
+    bool queued;
+    PairingHeapMembership link;
+};
+
+typedef PairingHeap<Task, offsetof(Task, link)> Heap;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static Task *findSmallest(Task *pTask, unsigned long *pCount)
+{
+    Task *pSmallest = NULL;
+    *pCount = 0;
+    for(unsigned i = 0; i < N_TASKS; ++i)
+    {
+	if (!pTask[i].queued)
+	    continue;
+	++*pCount;
+	if (!pSmallest || (pTask[i].deadline < pSmallest->deadline))
+	    pSmallest = &pTask[i];
+    }
+
+    return pSmallest;
+}
+
+static void testEmpty()
+{
+    Heap heap(offsetof(Task, deadline), compareUnsignedLong);
+    if (!heap.isEmpty() || heap.getTop() || heap.pop())
+	fail("empty", 0);
+
+    Task task;
+    task.deadline = 1;
+    if (task.link.isMember())
+	fail("not member", 0);
+    heap.push(&task);
+    if (!task.link.isMember() || (heap.getTop() != &task) ||
+	(heap.getCount() != 1))
+	fail("one", 0);
+    heap.decreaseKey(&task);
+    if ((heap.pop() != &task) || task.link.isMember() || !heap.isEmpty())
+	fail("pop one", 0);
+}
+
+static void testRandom()
+{
+    Heap heap(offsetof(Task, deadline), compareUnsignedLong);
+    static Task task[N_TASKS];
+    for(unsigned i = 0; i < N_TASKS; ++i)
+	task[i].queued = false;
+
+    for(unsigned long op = 0; op < N_OPS; ++op)
+    {
+	Task *pTask = &task[(unsigned)rand() % N_TASKS];
+	const unsigned r = (unsigned)rand() % 8;
+	if (!pTask->queued)
+	{
+	    pTask->deadline = (unsigned long)rand() % 100000;
+	    heap.push(pTask);
+	    pTask->queued = true;
+	}
+	else if (r < 3)
+	{
+	    if (pTask->deadline)
+		pTask->deadline -= (unsigned long)rand() % pTask->deadline + 1;
+	    heap.decreaseKey(pTask);
+	}
+	else if (r < 5)
+	{
+	    heap.remove(pTask);
+	    pTask->queued = false;
+	    if (pTask->link.isMember())
+		fail("removed member", op);
+	}
+	else
+	{
+	    unsigned long count;
+	    Task *pSmallest = findSmallest(task, &count);
+	    Task *pTop = heap.getTop();
+	    Task *pPopped = heap.pop();
+	    if ((pTop != pPopped) || !pPopped ||
+		(pPopped->deadline != pSmallest->deadline))
+		fail("pop", op);
+	    pPopped->queued = false;
+	}
+
+	unsigned long count;
+	findSmallest(task, &count);
+	if (heap.getCount() != count)
+	    fail("count", op);
+    }
+
+    /* drain it */
+    unsigned long last = 0;
+    Task *pTask;
+    while((pTask = heap.pop()))
+    {
+	if (pTask->deadline < last)
+	    fail("drain", pTask->deadline);
+	last = pTask->deadline;
+	pTask->queued = false;
+    }
+    unsigned long count;
+    if (findSmallest(task, &count) || !heap.isEmpty())
+	fail("drained", count);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testEmpty();
+    testRandom();
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testPerfectHash.cpp - test PerfectHash.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "Hashable.h"
+#include "PerfectHash.h"
+
+using namespace phoenix4cpp;
+
+static void fail(const char *pWhat, size_t n)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat,
+	    (unsigned long)n);
+    exit(1);
+}
+
+/*
+  Check that every key gets a distinct number in [0, n).
+ */
+static void checkBijection(const PerfectHash *pPh, const unsigned long *pKey,
+			   size_t n)
+{
+    if (pPh->getCount() != n)
+	fail("count", n);
+
+    char *pSeen = new char[n + 1];
+    memset(pSeen, 0, n + 1);
+    for(size_t i = 0; i < n; ++i)
+    {
+	HashableUnsignedLong key(pKey[i]);
+	const size_t index = pPh->lookup(&key);
+	if ((index >= n) || pSeen[index])
+	    fail("bijection", n);
+	pSeen[index] = 1;
+    }
+    delete[] pSeen;
+
+    /* keys that weren't in the set map to anything, but nowhere else */
+    for(unsigned long i = 0; i < 1000; ++i)
+    {
+	HashableUnsignedLong key(~i);
+	const size_t index = pPh->lookup(&key);
+	if ((index != PerfectHash::notFound) && (index >= n))
+	    fail("non-member", n);
+    }
+}
+
+static void testBuild(size_t n, unsigned nThreads)
+{
+    unsigned long *pKey = new unsigned long[n + 1];
+    HashableUnsignedLong **ppHashable = new HashableUnsignedLong *[n + 1];
+    for(size_t i = 0; i < n; ++i)
+    {
+	pKey[i] = ((unsigned long)rand() << 20) ^ i;
+	ppHashable[i] = new HashableUnsignedLong(pKey[i]);
+    }
+
+    PerfectHash ph;
+    if (!ph.build((const Hashable *const *)ppHashable, n, nThreads))
+	fail("build", n);
+    checkBijection(&ph, pKey, n);
+
+    /* about 3 bits per key, once the fixed overheads are amortized */
+    if ((n >= 100000) && (ph.getSerializedSize() * 8 > n * 4))
+	fail("size", n);
+
+    /* round trip through a buffer */
+    const size_t size = ph.getSerializedSize();
+    void *pBuffer;
+    if (posix_memalign(&pBuffer, 64, size + 1))
+	fail("memory", n);
+    ph.serialize(pBuffer);
+
+    PerfectHash attached;
+    if (!attached.attach(pBuffer, size))
+	fail("attach", n);
+    checkBijection(&attached, pKey, n);
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (ph.lookup(ppHashable[i]) != attached.lookup(ppHashable[i]))
+	    fail("attached lookup", n);
+    }
+
+    if (attached.attach(pBuffer, size - 1))
+	fail("truncated", n);
+    if (attached.getCount())
+	fail("release", n);
+    ((unsigned *)pBuffer)[0] ^= 1;
+    if (attached.attach(pBuffer, size))
+	fail("magic", n);
+    free(pBuffer);
+
+    /* duplicate keys can't be separated */
+    if (n)
+    {
+	ppHashable[n] = ppHashable[0];
+	if (ph.build((const Hashable *const *)ppHashable, n + 1, nThreads))
+	    fail("duplicate", n);
+	if (ph.getCount())
+	    fail("failed build", n);
+    }
+
+    for(size_t i = 0; i < n; ++i)
+	delete ppHashable[i];
+    delete[] ppHashable;
+    delete[] pKey;
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    static const size_t counts[] = {0, 1, 2, 10, 1000, 100000, 500000};
+    for(size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i)
+    {
+	testBuild(counts[i], 1);
+	testBuild(counts[i], 4);
+    }
+
+    return 0;
+}
@@ -0,0 +1,479 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testRoaringBitmap.cpp - test RoaringBitmap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Bitmaps are drawn from a universe of eight chunks:  the first seven,
+    and the last one possible, so that the top key is covered.  Each chunk
+    is filled in one of a number of patterns:  empty, sparse, either side
+    of the array limit, dense, a few long runs, or full, so that every
+    kind of container meets every other.  Membership is also recorded in
+    a table, from which the expected results are worked out.
+
+    Every operation is checked with and without optimize(), which makes
+    run containers, and with a serialized and attached copy as the other
+    operand.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "RoaringBitmap.h"
+#include "compare.h"
+#include "qsort.h"
+
+using namespace phoenix4cpp;
+
+#define CHUNK 65536
+#define N_CHUNKS 8
+#define UNIVERSE (N_CHUNKS * CHUNK)
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static inline unsigned toValue(size_t i)
+{
+    /* the last chunk is the last one possible */
+    if (i >= (N_CHUNKS - 1) * CHUNK)
+	return 0xffff0000 + (unsigned)(i - (N_CHUNKS - 1) * CHUNK);
+    return (unsigned)i;
+}
+
+static void makeSet(bool *pIn)
+{
+    for(size_t c = 0; c < N_CHUNKS; ++c)
+    {
+	bool *pChunk = pIn + c * CHUNK;
+	memset(pChunk, 0, CHUNK);
+	switch(rand() % 7)
+	{
+	case 0: /* empty */
+	    break;
+
+	case 1: /* sparse */
+	    for(size_t i = 0; i < 100; ++i)
+		pChunk[rand() % CHUNK] = true;
+	    break;
+
+	case 2: /* near the array limit, either side */
+	{
+	    const size_t n = 3900 + rand() % 400;
+	    for(size_t i = 0; i < n; ++i)
+		pChunk[i * 15] = true;
+	    break;
+	}
+
+	case 3: /* dense */
+	    for(size_t i = 0; i < CHUNK; ++i)
+		pChunk[i] = rand() % 3 != 0;
+	    break;
+
+	case 4: /* a few long runs */
+	    for(size_t r = 0; r < 10; ++r)
+	    {
+		const size_t start = rand() % CHUNK;
+		const size_t length = 1 + rand() % 5000;
+		for(size_t i = start; (i < start + length) && (i < CHUNK); ++i)
+		    pChunk[i] = true;
+	    }
+	    break;
+
+	case 5: /* full */
+	    memset(pChunk, 1, CHUNK);
+	    break;
+
+	case 6: /* short runs */
+	    for(size_t i = 0; i < CHUNK; i += 10)
+		pChunk[i] = pChunk[i + 1] = pChunk[i + 2] = true;
+	    break;
+	}
+    }
+}
+
+/* build the bitmap, one value at a time or from a sorted array */
+static void build(RoaringBitmap *pBitmap, const bool *pIn, bool fromArray)
+{
+    static unsigned values[UNIVERSE];
+    pBitmap->clear();
+    if (fromArray)
+    {
+	size_t n = 0;
+	for(size_t i = 0; i < UNIVERSE; ++i)
+	{
+	    if (pIn[i])
+		values[n++] = toValue(i);
+	}
+	pBitmap->addArray(values, n);
+	return;
+    }
+
+    /* add each chunk backwards, to exercise insertion */
+    for(size_t i = UNIVERSE; i-- > 0;)
+    {
+	if (pIn[i] && !pBitmap->add(toValue(i)))
+	    fail("add", i);
+    }
+    if (pBitmap->add(toValue(0)) != !pIn[0])
+	fail("add again", 0);
+    if (!pIn[0])
+	pBitmap->remove(toValue(0));
+}
+
+static void check(const char *pWhat, const RoaringBitmap *pBitmap,
+		  const bool *pIn)
+{
+    static unsigned values[UNIVERSE];
+    /* toArray() checks every value; contains() is tried on a sample */
+    size_t count = 0;
+    for(size_t i = 0; i < UNIVERSE; ++i)
+    {
+	if ((i % 7 == 0) && (pBitmap->contains(toValue(i)) != pIn[i]))
+	    fail(pWhat, i);
+	if (pIn[i])
+	    values[count++] = toValue(i);
+    }
+
+    if (pBitmap->getCount() != count)
+	fail(pWhat, count);
+    if (pBitmap->isEmpty() != !count)
+	fail(pWhat, count);
+
+    static unsigned out[UNIVERSE];
+    if (pBitmap->toArray(out) != count)
+	fail(pWhat, count);
+    if (memcmp(out, values, count * sizeof(unsigned)))
+	fail(pWhat, count);
+
+    /* rank and select at a sample of positions */
+    size_t rank = 0;
+    for(size_t i = 0; i < UNIVERSE; ++i)
+    {
+	rank += pIn[i];
+	if ((i % 499 == 0) || (i % CHUNK == CHUNK - 1))
+	{
+	    if (pBitmap->rank(toValue(i)) != rank)
+		fail(pWhat, i);
+	}
+    }
+    for(size_t i = 0; i < count; i += 1 + rand() % 500)
+    {
+	unsigned value;
+	if (!pBitmap->select(i, &value) || (value != values[i]))
+	    fail(pWhat, i);
+    }
+    unsigned value;
+    if (pBitmap->select(count, &value))
+	fail(pWhat, count);
+}
+
+static void testOps(const RoaringBitmap *pA, const bool *pInA,
+		    const RoaringBitmap *pB, const bool *pInB)
+{
+    static bool expected[UNIVERSE];
+    RoaringBitmap result;
+
+    for(int op = 0; op < 4; ++op)
+    {
+	result.clear();
+	result.orWith(pA);
+	if (op == 0)
+	    result.andWith(pB);
+	else if (op == 1)
+	    result.orWith(pB);
+	else if (op == 2)
+	    result.xorWith(pB);
+	else
+	    result.andNotWith(pB);
+
+	for(size_t i = 0; i < UNIVERSE; ++i)
+	{
+	    if (op == 0)
+		expected[i] = pInA[i] && pInB[i];
+	    else if (op == 1)
+		expected[i] = pInA[i] || pInB[i];
+	    else if (op == 2)
+		expected[i] = pInA[i] != pInB[i];
+	    else
+		expected[i] = pInA[i] && !pInB[i];
+	}
+	check("operation", &result, expected);
+
+	/* the result must stay usable */
+	result.optimize();
+	check("optimized result", &result, expected);
+	result.add(toValue(12345));
+	result.remove(toValue(2 * CHUNK + 1));
+	expected[12345] = true;
+	expected[2 * CHUNK + 1] = false;
+	check("modified result", &result, expected);
+    }
+}
+
+static void testOperations()
+{
+    static bool inA[UNIVERSE];
+    static bool inB[UNIVERSE];
+    static bool none[UNIVERSE];
+    RoaringBitmap a;
+    RoaringBitmap b;
+
+    for(unsigned trial = 0; trial < 12; ++trial)
+    {
+	makeSet(inA);
+	makeSet(inB);
+	build(&a, inA, trial & 1);
+	build(&b, inB, trial & 2);
+	check("build", &a, inA);
+	check("build", &b, inB);
+	if (trial & 4)
+	{
+	    a.optimize();
+	    check("optimize", &a, inA);
+	}
+	if (trial & 8)
+	{
+	    b.optimize();
+	    check("optimize", &b, inB);
+	}
+
+	testOps(&a, inA, &b, inB);
+	testOps(&b, inB, &a, inA);
+    }
+
+    /* with itself, and with empty bitmaps */
+    RoaringBitmap empty;
+    a.andWith(&a);
+    check("and self", &a, inA);
+    a.orWith(&a);
+    check("or self", &a, inA);
+    a.orWith(&empty);
+    check("or empty", &a, inA);
+    a.andNotWith(&empty);
+    check("and not empty", &a, inA);
+    a.xorWith(&a);
+    check("xor self", &a, none);
+    b.andWith(&empty);
+    check("and empty", &b, none);
+}
+
+static void testRemove()
+{
+    static bool in[UNIVERSE];
+    RoaringBitmap bitmap;
+
+    for(unsigned trial = 0; trial < 4; ++trial)
+    {
+	makeSet(in);
+	build(&bitmap, in, true);
+	if (trial & 1)
+	    bitmap.optimize();
+
+	for(size_t j = 0; j < 200000; ++j)
+	{
+	    const size_t i = rand() % UNIVERSE;
+	    if (bitmap.remove(toValue(i)) != in[i])
+		fail("remove", i);
+	    in[i] = false;
+	}
+	check("remove", &bitmap, in);
+
+	/* empty a chunk completely, and its container goes */
+	for(size_t i = 0; i < CHUNK; ++i)
+	{
+	    bitmap.remove(toValue(i));
+	    in[i] = false;
+	}
+	if (bitmap.contains(0) || bitmap.rank(CHUNK - 1))
+	    fail("empty chunk", 0);
+	check("remove chunk", &bitmap, in);
+    }
+
+    /* grow a chunk through the array limit and back */
+    bitmap.clear();
+    for(unsigned i = 0; i < 5000; ++i)
+	bitmap.add(i * 13);
+    for(unsigned i = 0; i < 5000; ++i)
+    {
+	if (!bitmap.remove(i * 13) || (bitmap.getCount() != 4999 - i))
+	    fail("shrink", i);
+    }
+    if (!bitmap.isEmpty() || bitmap.getContainerCount())
+	fail("shrink", 0);
+}
+
+static void testRuns()
+{
+    RoaringBitmap bitmap;
+    static bool in[UNIVERSE];
+    memset(in, 0, sizeof(in));
+
+    /* a full chunk takes 8KB as a bitmap, and a single run optimized */
+    for(size_t i = CHUNK; i < 2 * CHUNK; ++i)
+    {
+	bitmap.add((unsigned)i);
+	in[i] = true;
+    }
+    const size_t before = bitmap.getBytes();
+    bitmap.optimize();
+    if (bitmap.getBytes() + 8000 > before)
+	fail("run bytes", bitmap.getBytes());
+    check("full chunk", &bitmap, in);
+
+    /* modifying a run container expands it */
+    if (bitmap.add(CHUNK + 5) || !bitmap.remove(CHUNK + 5))
+	fail("run modify", 0);
+    in[CHUNK + 5] = false;
+    check("run modify", &bitmap, in);
+    bitmap.optimize();
+    if (bitmap.add(CHUNK + 6) || !bitmap.add(CHUNK + 5))
+	fail("run add", 0);
+    in[CHUNK + 5] = true;
+    check("run add", &bitmap, in);
+}
+
+static void testSerialize()
+{
+    static bool inA[UNIVERSE];
+    static bool inB[UNIVERSE];
+    RoaringBitmap a;
+    RoaringBitmap b;
+    RoaringBitmap attached;
+
+    for(unsigned trial = 0; trial < 4; ++trial)
+    {
+	makeSet(inA);
+	makeSet(inB);
+	build(&a, inA, true);
+	build(&b, inB, true);
+	if (trial & 1)
+	    a.optimize();
+
+	const size_t size = a.getSerializedSize();
+	unsigned long long *pBuffer =
+	    (unsigned long long *)malloc(size + sizeof(unsigned long long));
+	a.serialize(pBuffer);
+	if (!attached.attach(pBuffer, size))
+	    fail("attach", trial);
+	check("attached", &attached, inA);
+	if (attached.getBytes() >= a.getBytes() / 2 + 1000)
+	    fail("attached bytes", attached.getBytes());
+
+	/* as the other operand, and as the source of a copy */
+	testOps(&attached, inA, &b, inB);
+	testOps(&b, inB, &attached, inA);
+
+	/* an optimized copy serializes to the same bytes */
+	if (trial & 1)
+	{
+	    RoaringBitmap copy;
+	    copy.orWith(&attached);
+	    copy.optimize();
+	    if (copy.getSerializedSize() != size)
+		fail("reserialize", copy.getSerializedSize());
+	    unsigned long long *pCopy = (unsigned long long *)malloc(size);
+	    copy.serialize(pCopy);
+	    if (memcmp(pCopy, pBuffer, size))
+		fail("reserialize", trial);
+	    free(pCopy);
+	}
+
+	/* damaged buffers */
+	unsigned char *pBytes = (unsigned char *)pBuffer;
+	if ((size > 16) && attached.attach(pBuffer, 24))
+	    fail("truncated", size);
+	if (!attached.isEmpty())
+	    fail("truncated", size);
+	if (attached.attach(pBytes + 8, size) ||
+	    attached.attach(pBytes + 1, size))
+	    fail("misaligned", size);
+	pBytes[0] ^= 1;
+	if (attached.attach(pBuffer, size))
+	    fail("magic", size);
+	pBytes[0] ^= 1;
+	if (size > 16)
+	{
+	    /* the first container's cardinality */
+	    pBytes[16 + 8] ^= 1;
+	    if (attached.attach(pBuffer, size))
+		fail("cardinality", size);
+	    pBytes[16 + 8] ^= 1;
+	}
+	if (!attached.attach(pBuffer, size))
+	    fail("reattach", size);
+	check("reattached", &attached, inA);
+
+	attached.clear();
+	free(pBuffer);
+    }
+
+    /* an empty bitmap */
+    RoaringBitmap empty;
+    unsigned long long buffer[2];
+    if (empty.getSerializedSize() != 16)
+	fail("empty size", empty.getSerializedSize());
+    empty.serialize(buffer);
+    if (!attached.attach(buffer, sizeof(buffer)) || !attached.isEmpty())
+	fail("attach empty", 0);
+}
+
+/* values sorted with qsort() and compareUnsigned() */
+static void testArrays()
+{
+    static unsigned values[200000];
+    static unsigned out[200000];
+    const size_t n = sizeof(values) / sizeof(values[0]);
+
+    for(size_t i = 0; i < n; ++i)
+    {
+	/* duplicates, and clusters */
+	values[i] = (rand() % 4) ? (unsigned)rand() % 100000 :
+	    (unsigned)rand() * 2654435761U;
+    }
+    phoenix4cpp::qsort<unsigned, unsigned, 0>(values, n, compareUnsigned);
+
+    RoaringBitmap bitmap;
+    bitmap.addArray(values, n / 2);
+    bitmap.addArray(values + n / 2, n - n / 2);
+
+    size_t unique = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!unique || (values[unique - 1] != values[i]))
+	    values[unique++] = values[i];
+    }
+    if (bitmap.getCount() != unique)
+	fail("array count", bitmap.getCount());
+    if ((bitmap.toArray(out) != unique) ||
+	memcmp(out, values, unique * sizeof(unsigned)))
+	fail("array", unique);
+    for(size_t i = 0; i < unique; ++i)
+    {
+	if (bitmap.rank(values[i]) != i + 1)
+	    fail("array rank", i);
+    }
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testOperations();
+    testRemove();
+    testRuns();
+    testSerialize();
+    testArrays();
+
+    return 0;
+}
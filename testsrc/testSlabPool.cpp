@@ -0,0 +1,320 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testSlabPool.cpp - test SlabPool.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Every object handed out is stamped with its owner and checked before
+    it is released, so that an object handed out twice at the same time
+    shows up as a clobbered stamp.  Objects are passed between threads so
+    that some are released by a different thread than the one that
+    allocated them.
+
+    Pools are created until there are no pthread keys left, to check that
+    this is reported rather than leaving a pool with an unusable key.
+ */
+
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <pthread.h>
+
+#include "DoublyLinked.h"
+#include "SlabPool.h"
+
+using namespace phoenix4cpp;
+
+#define N_THREADS 4
+#define N_OBJECTS 2000
+#define N_ROUNDS 200
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+struct Stamp
+{
+    unsigned long owner;
+    unsigned long seq;
+    unsigned long check;
+};
+
+static long live;
+
+class Item
+{
+public:
+    Item();
+    ~Item();
+
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
+    static SlabPool<Item> pool;
+
+    unsigned long seq;
+    DoublyLinkedMembership link;
+};
+
+SlabPool<Item> Item::pool(8);
+
+Item::Item():
+    seq(0)
+{
+    __sync_fetch_and_add(&live, 1);
+}
+
+Item::~Item()
+{
+    __sync_fetch_and_sub(&live, 1);
+}
+
+void *Item::operator new(size_t size)
+{
+    if (size != sizeof(Item))
+	fail("operator new size", size);
+    return pool.allocate();
+}
+
+void Item::operator delete(void *p)
+{
+    pool.release(p);
+}
+
+typedef DoublyLinkedList<Item, offsetof(Item, link)> List;
+
+struct Aligned
+{
+    char tag;
+    long double value;
+} __attribute__((aligned(32)));
+
+static void testBasics()
+{
+    SlabPool<Stamp> pool(4);
+    if ((pool.getObjectSize() != sizeof(Stamp)) || pool.getSlabCount())
+	fail("object size", pool.getObjectSize());
+
+    SlabPool<char> tiny;
+    if (tiny.getObjectSize() != 2 * sizeof(void *))
+	fail("tiny object size", tiny.getObjectSize());
+
+    /* a released object is the next one handed out */
+    void *p = pool.allocate();
+    if (((size_t)p % sizeof(void *)) || (pool.getSlabCount() != 1))
+	fail("first allocate", pool.getSlabCount());
+    pool.release(p);
+    if (pool.allocate() != p)
+	fail("reuse", 0);
+    pool.release(p);
+
+    /* a few slabs' worth of distinct objects */
+    const size_t n = 3 * pool.getSlabBytes() / sizeof(Stamp);
+    Stamp **ppStamp = new Stamp *[n];
+    for(size_t i = 0; i < n; ++i)
+    {
+	ppStamp[i] = pool.create();
+	ppStamp[i]->seq = i;
+	ppStamp[i]->check = ~i;
+    }
+    for(size_t i = 0; i < n; ++i)
+    {
+	if ((ppStamp[i]->seq != i) || (ppStamp[i]->check != ~i))
+	    fail("distinct objects", i);
+    }
+    const size_t nSlabs = pool.getSlabCount();
+    if ((nSlabs < 3) || (nSlabs > 4))
+	fail("slab count", nSlabs);
+
+    /* releasing everything and allocating again takes no more slabs */
+    for(size_t i = 0; i < n; ++i)
+	pool.destroy(ppStamp[i]);
+    pool.flush();
+    for(size_t i = 0; i < n; ++i)
+	ppStamp[i] = pool.create();
+    if (pool.getSlabCount() != nSlabs)
+	fail("slab reuse", pool.getSlabCount());
+    for(size_t i = 0; i < n; ++i)
+	pool.destroy(ppStamp[i]);
+
+    delete[] ppStamp;
+
+    /* objects that need more than pointer alignment get it */
+    SlabPool<Aligned> aligned;
+    if (aligned.getObjectSize() % __alignof__(Aligned))
+	fail("aligned object size", aligned.getObjectSize());
+    Aligned *pAligned[100];
+    for(size_t i = 0; i < 100; ++i)
+    {
+	pAligned[i] = aligned.create();
+	if ((size_t)pAligned[i] % __alignof__(Aligned))
+	    fail("aligned object", (size_t)pAligned[i]);
+    }
+    for(size_t i = 0; i < 100; ++i)
+	aligned.destroy(pAligned[i]);
+}
+
+static void testList()
+{
+    {
+	List list;
+	for(unsigned long i = 0; i < N_OBJECTS; ++i)
+	{
+	    Item *pItem = new Item;
+	    pItem->seq = i;
+	    list.append(pItem);
+	}
+	if (live != N_OBJECTS)
+	    fail("live items", live);
+	/* the destructor deletes them, which puts them back in the pool */
+    }
+    if (live)
+	fail("list destructor", live);
+
+    const size_t nSlabs = Item::pool.getSlabCount();
+    List list;
+    for(unsigned long i = 0; i < N_OBJECTS; ++i)
+	list.append(new Item);
+    if (Item::pool.getSlabCount() != nSlabs)
+	fail("list slab reuse", Item::pool.getSlabCount());
+
+    list.clear(SlabPool<Item>::dispose, &Item::pool);
+    if (live || !list.isEmpty())
+	fail("clear", live);
+}
+
+static SlabPool<Stamp> *pShared;
+static Stamp *volatile passed[N_THREADS][N_OBJECTS];
+
+static void *churnThread(void *pArg)
+{
+    const unsigned long me = (unsigned long)pArg;
+    Stamp **ppStamp = new Stamp *[N_OBJECTS];
+    unsigned seed = (unsigned)me;
+
+    for(unsigned round = 0; round < N_ROUNDS; ++round)
+    {
+	const size_t n = 1 + rand_r(&seed) % N_OBJECTS;
+	for(size_t i = 0; i < n; ++i)
+	{
+	    Stamp *pStamp = (Stamp *)pShared->allocate();
+	    pStamp->owner = me;
+	    pStamp->seq = i;
+	    pStamp->check = ~(me ^ i);
+	    ppStamp[i] = pStamp;
+	}
+	for(size_t i = 0; i < n; ++i)
+	{
+	    Stamp *pStamp = ppStamp[i];
+	    if ((pStamp->owner != me) || (pStamp->seq != i) ||
+		(pStamp->check != ~(me ^ i)))
+		fail("churn stamp", i);
+	    pShared->release(pStamp);
+	}
+    }
+
+    /* leave some objects for the next thread to release */
+    for(size_t i = 0; i < N_OBJECTS; ++i)
+    {
+	Stamp *pStamp = (Stamp *)pShared->allocate();
+	pStamp->owner = me;
+	pStamp->seq = i;
+	passed[me][i] = pStamp;
+    }
+
+    delete[] ppStamp;
+    return NULL;
+}
+
+static void *releaseThread(void *pArg)
+{
+    const unsigned long from = ((unsigned long)pArg + 1) % N_THREADS;
+    for(size_t i = 0; i < N_OBJECTS; ++i)
+    {
+	Stamp *pStamp = passed[from][i];
+	if ((pStamp->owner != from) || (pStamp->seq != i))
+	    fail("passed stamp", i);
+	pShared->release(pStamp);
+    }
+    return NULL;
+}
+
+static void testThreads()
+{
+    pShared = new SlabPool<Stamp>(16);
+
+    pthread_t thread[N_THREADS];
+    for(unsigned long i = 0; i < N_THREADS; ++i)
+	pthread_create(&thread[i], NULL, churnThread, (void *)i);
+    for(unsigned long i = 0; i < N_THREADS; ++i)
+	pthread_join(thread[i], NULL);
+
+    for(unsigned long i = 0; i < N_THREADS; ++i)
+	pthread_create(&thread[i], NULL, releaseThread, (void *)i);
+    for(unsigned long i = 0; i < N_THREADS; ++i)
+	pthread_join(thread[i], NULL);
+
+    /*
+      Everything has gone back to the depot as the threads exited, so
+      allocating it all again here doesn't need another slab.
+    */
+    const size_t nSlabs = pShared->getSlabCount();
+    const size_t n = N_THREADS * N_OBJECTS;
+    Stamp **ppStamp = new Stamp *[n];
+    for(size_t i = 0; i < n; ++i)
+	ppStamp[i] = (Stamp *)pShared->allocate();
+    if (pShared->getSlabCount() != nSlabs)
+	fail("depot reuse", pShared->getSlabCount());
+    for(size_t i = 0; i < n; ++i)
+	pShared->release(ppStamp[i]);
+    delete[] ppStamp;
+
+    delete pShared;
+}
+
+static void testKeys()
+{
+    SlabPool<Stamp> *pPool[PTHREAD_KEYS_MAX + 1];
+    size_t n = 0;
+    try
+    {
+	for(; n <= PTHREAD_KEYS_MAX; ++n)
+	    pPool[n] = new SlabPool<Stamp>;
+    }
+    catch(std::bad_alloc &)
+    {
+    }
+    if (n > PTHREAD_KEYS_MAX)
+	fail("out of keys", n);
+
+    /* the pools that got keys still work */
+    for(size_t i = 0; i < n; ++i)
+	pPool[i]->destroy(pPool[i]->create());
+    for(size_t i = 0; i < n; ++i)
+	delete pPool[i];
+
+    SlabPool<Stamp> pool;
+    pool.destroy(pool.create());
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testBasics();
+    testList();
+    testThreads();
+    testKeys();
+
+    return 0;
+}
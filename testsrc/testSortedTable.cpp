@@ -0,0 +1,311 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testSortedTable.cpp - test SortedTable.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Tables are written from arrays of records whose keys climb slowly, so
+    there are runs of duplicates, some of which straddle blocks, and gaps.
+    Every key from below the smallest to above the largest is then looked
+    up, and the answers are checked against the array.  Records carry
+    their position in the array, so it can be checked that lookups find the
+    first of a run of duplicates.
+ */
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+
+#include "SortedTable.h"
+#include "compare.h"
+#include "hash.h"
+
+using namespace phoenix4cpp;
+
+#define MAX_RECORDS 20000
+
+/* 24 bytes doesn't divide the page size, so blocks have padding */
+struct Record
+{
+    unsigned long key;
+    unsigned seq;
+    unsigned check;
+    char padding[8];
+};
+
+typedef SortedTable<Record, unsigned long, offsetof(Record, key)>
+    RecordTable;
+
+/* an odd size, with the key neither first nor aligned */
+struct OddKey
+{
+    char bytes[4];
+};
+
+struct OddRecord
+{
+    char tag;
+    OddKey key;
+    char rest[8];
+};
+
+typedef SortedTable<OddRecord, OddKey, offsetof(OddRecord, key)> OddTable;
+
+static char path[256];
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    unlink(path);
+    exit(1);
+}
+
+static int compareOddKey(const OddKey *pl, const OddKey *pr)
+{
+    return memcmp(pl->bytes, pr->bytes, sizeof(pl->bytes));
+}
+
+static void makeRecords(Record *pRecord, size_t n)
+{
+    unsigned long key = 10;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!(rand() % 3))
+	    key += rand() % 4;
+	pRecord[i].key = key;
+	pRecord[i].seq = (unsigned)i;
+	pRecord[i].check = (unsigned)(key * 7 + i);
+	memset(pRecord[i].padding, 0, sizeof(pRecord[i].padding));
+    }
+}
+
+static void checkTable(const char *pWhat, const RecordTable *pTable,
+		       const Record *pRecord, size_t n)
+{
+    if (pTable->getCount() != n)
+	fail(pWhat, pTable->getCount());
+
+    /* walk it both ways */
+    const Record *p = pTable->getFirst();
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!p || memcmp(p, &pRecord[i], sizeof(Record)))
+	    fail(pWhat, i);
+	if (pTable->getRecord(i) != p)
+	    fail(pWhat, i);
+	p = pTable->getNext(p);
+    }
+    if (p)
+	fail(pWhat, n);
+
+    /* look up every key, and the ones just outside the range */
+    const unsigned long last = n ? pRecord[n - 1].key : 0;
+    size_t expected = 0;
+    for(unsigned long key = 0; key <= last + 2; ++key)
+    {
+	while((expected < n) && (pRecord[expected].key < key))
+	    ++expected;
+
+	const Record *pBound = pTable->lowerBound(&key);
+	if (expected == n)
+	{
+	    if (pBound)
+		fail(pWhat, key);
+	}
+	else if (!pBound || (pBound->seq != expected))
+	    fail(pWhat, key);
+
+	const Record *pFound = pTable->find(&key);
+	if ((expected < n) && (pRecord[expected].key == key))
+	{
+	    if (!pFound || (pFound->seq != expected))
+		fail(pWhat, key);
+	}
+	else if (pFound)
+	    fail(pWhat, key);
+    }
+}
+
+static void testOnce(const char *pWhat, size_t n, size_t blockBytes,
+		     bool bloom)
+{
+    static Record records[MAX_RECORDS];
+    makeRecords(records, n);
+
+    int error = RecordTable::write(path, records, n, compareUnsignedLong,
+				   bloom ? hashUnsignedLong : NULL, 10,
+				   blockBytes);
+    if (error)
+	fail(pWhat, error);
+
+    RecordTable table(compareUnsignedLong, hashUnsignedLong);
+    error = table.open(path);
+    if (error)
+	fail(pWhat, error);
+    if (table.hasBloomFilter() != (bloom && n))
+	fail(pWhat, 0);
+    checkTable(pWhat, &table, records, n);
+
+    /* without a hash function, the filter can't be used */
+    RecordTable plain(compareUnsignedLong);
+    error = plain.open(path);
+    if (error || plain.hasBloomFilter())
+	fail(pWhat, error);
+    checkTable(pWhat, &plain, records, n);
+}
+
+static void testOdd()
+{
+    static OddRecord records[MAX_RECORDS];
+    unsigned key = 0;
+    for(size_t i = 0; i < MAX_RECORDS; ++i)
+    {
+	key += rand() % 3;
+	records[i].tag = (char)i;
+	records[i].key.bytes[0] = (char)(key >> 24);
+	records[i].key.bytes[1] = (char)(key >> 16);
+	records[i].key.bytes[2] = (char)(key >> 8);
+	records[i].key.bytes[3] = (char)key;
+	memset(records[i].rest, (int)(i & 0x7f), sizeof(records[i].rest));
+    }
+
+    int error = OddTable::write(path, records, MAX_RECORDS, compareOddKey);
+    if (error)
+	fail("odd write", error);
+    OddTable table(compareOddKey);
+    error = table.open(path);
+    if (error)
+	fail("odd open", error);
+    if (table.getRecordSize() != 13)
+	fail("odd size", table.getRecordSize());
+
+    for(size_t i = 0; i < MAX_RECORDS; ++i)
+    {
+	const OddRecord *p = table.find(&records[i].key);
+	if (!p || compareOddKey(&p->key, &records[i].key))
+	    fail("odd find", i);
+	if (memcmp(table.getRecord(i), &records[i], sizeof(OddRecord)))
+	    fail("odd record", i);
+    }
+}
+
+static void testErrors()
+{
+    static Record records[1000];
+    makeRecords(records, 1000);
+
+    /* out of order input is refused, and nothing is left behind */
+    Record swap = records[10];
+    records[10] = records[900];
+    records[900] = swap;
+    if (RecordTable::write(path, records, 1000, compareUnsignedLong) !=
+	EINVAL)
+	fail("unsorted", 0);
+    if (!access(path, F_OK))
+	fail("unsorted file", 0);
+    records[900] = records[10];
+    records[10] = swap;
+
+    RecordTable table(compareUnsignedLong);
+    if (table.open(path) != ENOENT)
+	fail("missing", 0);
+
+    if (RecordTable::write(path, records, 1000, compareUnsignedLong))
+	fail("write", 0);
+
+    /* a table of something else */
+    OddTable odd(compareOddKey);
+    if (odd.open(path) != EINVAL)
+	fail("wrong type", 0);
+
+    /* a damaged header */
+    FILE *pFile = fopen(path, "r+b");
+    if (!pFile)
+	fail("reopen", errno);
+    fputc('X', pFile);
+    fclose(pFile);
+    if (table.open(path) != EINVAL)
+	fail("bad magic", 0);
+
+    /* a truncated file */
+    if (RecordTable::write(path, records, 1000, compareUnsignedLong))
+	fail("rewrite", 0);
+    if (truncate(path, 8192))
+	fail("truncate", errno);
+    if (table.open(path) != EINVAL)
+	fail("truncated", 0);
+    if (table.isOpen())
+	fail("still open", 0);
+
+    /*
+      Record counts the blocks can't hold, including one so large that
+      rounding it up to whole blocks wraps around.  The count is 40
+      bytes into the header.
+    */
+    static const unsigned long long badCount[] =
+    {
+	~0ULL, 1001 + 4096 / sizeof(Record)
+    };
+    for(size_t i = 0; i < sizeof(badCount) / sizeof(badCount[0]); ++i)
+    {
+	if (RecordTable::write(path, records, i ? 1000 : 0,
+			       compareUnsignedLong))
+	    fail("rewrite", i);
+	pFile = fopen(path, "r+b");
+	if (!pFile || fseek(pFile, 40, SEEK_SET) ||
+	    (fwrite(&badCount[i], sizeof(badCount[i]), 1, pFile) != 1))
+	    fail("bad count write", errno);
+	fclose(pFile);
+	if ((table.open(path) != EINVAL) || table.isOpen())
+	    fail("bad count", i);
+    }
+
+    /* closing and reopening */
+    if (RecordTable::write(path, records, 1000, compareUnsignedLong))
+	fail("rewrite", 0);
+    if (table.open(path))
+	fail("open", 0);
+    table.close();
+    if (table.isOpen() || table.getCount())
+	fail("close", 0);
+    if (table.open(path) || table.open(path))
+	fail("open twice", 0);
+    checkTable("reopen", &table, records, 1000);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    const char *pDirectory = getenv("TMPDIR");
+    if (!pDirectory)
+	pDirectory = "/tmp";
+    snprintf(path, sizeof(path), "%s/testSortedTable-%d",
+	     pDirectory, (int)getpid());
+    unlink(path);
+
+    testErrors();
+
+    testOnce("empty", 0, 4096, true);
+    testOnce("one", 1, 4096, true);
+    testOnce("one block", 170, 4096, false);
+    testOnce("two blocks", 171, 4096, true);
+    testOnce("small blocks", MAX_RECORDS, 100, true);
+    testOnce("one per block", 500, 1, false);
+    testOnce("large blocks", MAX_RECORDS, 64 << 10, false);
+    testOnce("bloom", MAX_RECORDS, 4096, true);
+
+    testOdd();
+
+    unlink(path);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testStringPool.cpp - test StringPool.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Several threads intern overlapping sets of strings at once, and must all
+    agree on the IDs, while another checks that every ID below getCount()
+    already has its string.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+
+#include "HashValue.h"
+#include "StringPool.h"
+#include "bsearch.h"
+#include "compare.h"
+#include "hash.h"
+#include "qsort.h"
+
+using namespace phoenix4cpp;
+
+#define N_STRINGS 50000
+#define N_THREADS 4
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void makeString(char *pBuf, unsigned long i)
+{
+    /* the occasional long string exercises the arena's big blocks */
+    if (i % 997)
+	sprintf(pBuf, "string-%lu", i);
+    else
+    {
+	memset(pBuf, 'x', 100000);
+	sprintf(pBuf + 100000, "%lu", i);
+    }
+}
+
+struct Worker
+{
+    StringPool *pPool;
+    unsigned id;
+    unsigned long ids[N_STRINGS];
+};
+
+static void *work(void *pArg)
+{
+    Worker *pWorker = (Worker *)pArg;
+    char *pBuf = new char[100100];
+
+    /* each thread goes through the strings in a different order */
+    for(unsigned long n = 0; n < N_STRINGS; ++n)
+    {
+	const unsigned long i = (n * 7919 + pWorker->id * 12345) % N_STRINGS;
+	makeString(pBuf, i);
+	pWorker->ids[i] = pWorker->pPool->intern(pBuf);
+    }
+
+    delete[] pBuf;
+    return NULL;
+}
+
+static void *watch(void *pArg)
+{
+    const StringPool *pPool = (const StringPool *)pArg;
+    unsigned long checked = 0;
+    while(checked < N_STRINGS)
+    {
+	const unsigned long count = pPool->getCount();
+	for(; checked < count; ++checked)
+	{
+	    if (!pPool->getString(checked))
+		fail("published", checked);
+	}
+    }
+
+    return NULL;
+}
+
+struct Record
+{
+    unsigned long id;
+    unsigned long value;
+};
+
+int main()
+{
+    char *pBuf = new char[100100];
+
+    StringPool pool;
+    if ((pool.getCount() != 0) || (pool.find("nothing") != StringPool::notFound))
+	fail("empty", 0);
+
+    /* IDs are dense, and repeated interning gives the same ID */
+    for(unsigned long i = 0; i < N_STRINGS; ++i)
+    {
+	makeString(pBuf, i);
+	if (pool.intern(pBuf) != i)
+	    fail("dense", i);
+    }
+    for(unsigned long i = 0; i < N_STRINGS; ++i)
+    {
+	makeString(pBuf, i);
+	if ((pool.intern(pBuf) != i) || (pool.find(pBuf) != i) ||
+	    strcmp(pool.getString(i), pBuf))
+	    fail("stable", i);
+
+	/* the pointer is unique to the string */
+	if (pool.getString(pool.intern(pBuf)) != pool.getString(i))
+	    fail("pointer", i);
+    }
+    if (pool.getCount() != N_STRINGS)
+	fail("count", pool.getCount());
+    if (pool.intern("") != N_STRINGS)
+	fail("empty string", 0);
+
+    /* IDs work as keys with the unsigned long comparison and hash */
+    Record record[100];
+    for(unsigned long i = 0; i < 100; ++i)
+    {
+	makeString(pBuf, 99 - i);
+	record[i].id = pool.find(pBuf);
+	record[i].value = 99 - i;
+    }
+    qsort<Record, unsigned long, offsetof(Record, id)>(
+	record, 100, compareUnsignedLong);
+    for(unsigned long i = 0; i < 100; ++i)
+    {
+	makeString(pBuf, i);
+	const unsigned long id = pool.find(pBuf);
+	const Record *pR = bsearch<Record, unsigned long, offsetof(Record, id)>(
+	    &id, record, 100, compareUnsignedLong);
+	if (!pR || (pR->value != i))
+	    fail("search", i);
+
+	HashValue h1;
+	HashValue h2;
+	hashUnsignedLong(&h1, &id);
+	hashUnsignedLong(&h2, &pR->id);
+	if (h1.get() != h2.get())
+	    fail("hash", i);
+    }
+
+    /* concurrent interning into a fresh pool */
+    StringPool shared(4);
+    static Worker worker[N_THREADS];
+    pthread_t thread[N_THREADS + 1];
+    pthread_create(&thread[N_THREADS], NULL, watch, &shared);
+    for(unsigned t = 0; t < N_THREADS; ++t)
+    {
+	worker[t].pPool = &shared;
+	worker[t].id = t;
+	pthread_create(&thread[t], NULL, work, &worker[t]);
+    }
+    for(unsigned t = 0; t <= N_THREADS; ++t)
+	pthread_join(thread[t], NULL);
+
+    if (shared.getCount() != N_STRINGS)
+	fail("concurrent count", shared.getCount());
+    for(unsigned long i = 0; i < N_STRINGS; ++i)
+    {
+	for(unsigned t = 1; t < N_THREADS; ++t)
+	{
+	    if (worker[t].ids[i] != worker[0].ids[i])
+		fail("concurrent agreement", i);
+	}
+
+	makeString(pBuf, i);
+	if (strcmp(shared.getString(worker[0].ids[i]), pBuf))
+	    fail("concurrent string", i);
+    }
+
+    delete[] pBuf;
+    return 0;
+}
@@ -0,0 +1,224 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testTimerWheel.cpp - test TimerWheel.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Timers are armed with delays spread over several levels of the wheel,
+    some are cancelled or rearmed, and the wheel is advanced in random
+    steps.  Every timer that is armed must fire exactly once, on the tick
+    it expires, unless it was cancelled.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "TimerWheel.h"
+
+using namespace phoenix4cpp;
+
+struct Connection
+{
+    unsigned long id;
+    unsigned long long due;     /* 0 if not armed */
+    unsigned long fired;
+    TimerWheelMembership timeout;
+};
+
+typedef TimerWheel<Connection, offsetof(Connection, timeout)> Wheel;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+struct Context
+{
+    Wheel *pWheel;
+    unsigned long long lastFired;
+    bool rearm;
+};
+
+static void fire(Context *pContext, Connection *pConnection)
+{
+    const unsigned long long now = pContext->pWheel->getNow();
+    if ((pConnection->due != now) || pConnection->timeout.isMember() ||
+	(now < pContext->lastFired))
+	fail("fire", pConnection->id);
+
+    pContext->lastFired = now;
+    pConnection->due = 0;
+    ++pConnection->fired;
+
+    /* some timers rearm themselves once from the callback */
+    if (pContext->rearm && !(pConnection->id % 3) &&
+	(pConnection->fired == 1))
+    {
+	pConnection->due = now + 1 + pConnection->id % 1000;
+	pContext->pWheel->arm(pConnection, pConnection->due);
+    }
+}
+
+static unsigned long long randomDelay()
+{
+    /* spread the delays over the first four levels */
+    switch(rand() % 4)
+    {
+    case 0:
+	return 1 + rand() % 256;
+    case 1:
+	return 1 + rand() % 65536;
+    case 2:
+	return 1 + ((unsigned long long)rand() << 8) % 16777216;
+    default:
+	return 1 + ((unsigned long long)rand() << 16) % 4294967296ULL;
+    }
+}
+
+#define N_TIMERS 20000
+
+static void testOnce(unsigned long long start, bool rearm)
+{
+    static Connection connection[N_TIMERS];
+    Wheel wheel(start);
+    Context context = {&wheel, start, rearm};
+
+    unsigned long armed = 0;
+    for(unsigned long i = 0; i < N_TIMERS; ++i)
+    {
+	connection[i].id = i;
+	connection[i].fired = 0;
+	connection[i].due = start + randomDelay();
+	wheel.arm(&connection[i], connection[i].due);
+	++armed;
+	if (!connection[i].timeout.isMember() ||
+	    (connection[i].timeout.getExpiry() != connection[i].due))
+	    fail("arm", i);
+    }
+
+    /* cancel some, and rearm others for different times */
+    unsigned long cancelled = 0;
+    for(unsigned long i = 0; i < N_TIMERS; i += 7)
+    {
+	connection[i].timeout.remove();
+	connection[i].due = 0;
+	++cancelled;
+    }
+    for(unsigned long i = 1; i < N_TIMERS; i += 11)
+    {
+	if (!(i % 7))
+	    --cancelled;
+	connection[i].due = start + randomDelay();
+	wheel.arm(&connection[i], connection[i].due);
+    }
+
+    /* advance in steps of varying size, until everything has fired */
+    size_t nFired = 0;
+    unsigned long long latest = start;
+    for(unsigned long i = 0; i < N_TIMERS; ++i)
+    {
+	if (connection[i].due > latest)
+	    latest = connection[i].due;
+    }
+    while(wheel.getNow() < latest + 1000)
+    {
+	unsigned long long step;
+	switch(rand() % 3)
+	{
+	case 0:
+	    step = 1 + rand() % 10;
+	    break;
+	case 1:
+	    step = 1 + rand() % 5000;
+	    break;
+	default:
+	    step = 1 + rand() % 5000000;
+	    break;
+	}
+	nFired += wheel.advance(wheel.getNow() + step, fire, &context);
+    }
+
+    unsigned long total = 0;
+    for(unsigned long i = 0; i < N_TIMERS; ++i)
+    {
+	if (connection[i].timeout.isMember() || connection[i].due)
+	    fail("left armed", i);
+	const bool live = (i % 7) || (i % 11 == 1);
+	if (!rearm && (connection[i].fired != (live ? 1UL : 0UL)))
+	    fail("fired count", i);
+	total += connection[i].fired;
+    }
+    if ((total != nFired) || (!rearm && (nFired != armed - cancelled)))
+	fail("total", total);
+}
+
+static void testEdges()
+{
+    Wheel wheel(1000);
+    Context context = {&wheel, 1000, false};
+
+    /* a timer for the past fires on the next tick */
+    Connection c1;
+    c1.id = 1;
+    c1.fired = 0;
+    wheel.arm(&c1, 5);
+    c1.due = 1001;
+    if (c1.timeout.getExpiry() != 1001)
+	fail("past expiry", c1.timeout.getExpiry());
+    if ((wheel.advance(1000, fire, &context) != 0) || (wheel.getNow() != 1000))
+	fail("no advance", 0);
+    if ((wheel.advance(1001, fire, &context) != 1) || (c1.fired != 1))
+	fail("past fire", 0);
+
+    /* rearming moves the timer */
+    wheel.arm(&c1, 3000);
+    wheel.arm(&c1, 1500);
+    c1.due = 1500;
+    if (wheel.advance(2000, fire, &context) != 1)
+	fail("rearm", 0);
+
+    /* destroying an element cancels its timer */
+    {
+	Connection c2;
+	c2.id = 2;
+	wheel.arm(&c2, 100000);
+    }
+    if (wheel.advance(200000, fire, &context) != 0)
+	fail("destroyed", 0);
+
+    /* timers across the top of the range */
+    Wheel high(0xfffffffffffff000ULL);
+    context.pWheel = &high;
+    context.lastFired = high.getNow();
+    c1.due = 0xffffffffffffff00ULL;
+    high.arm(&c1, c1.due);
+    if ((high.advance(0xfffffffffffffff0ULL, fire, &context) != 1) ||
+	(c1.fired != 3))
+	fail("high", 0);
+
+    /* cancelAll() */
+    high.arm(&c1, 0xfffffffffffffff8ULL);
+    high.cancelAll();
+    if (c1.timeout.isMember())
+	fail("cancelAll", 0);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testEdges();
+    testOnce(0, false);
+    testOnce(0xfffff0, false);
+    testOnce(0x12345678ffULL, true);
+
+    return 0;
+}
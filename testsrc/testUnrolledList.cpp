@@ -0,0 +1,237 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testUnrolledList.cpp - test UnrolledList.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    A plain array of sequence numbers is kept alongside each list as a
+    model.  After every bulk operation the list is walked forwards,
+    backwards, and a chunk at a time, and compared with the model.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "UnrolledList.h"
+
+using namespace phoenix4cpp;
+
+#define N_RECORDS 20000
+
+struct Record
+{
+    unsigned long seq;
+    unsigned long check;
+};
+
+struct Big
+{
+    unsigned long seq;
+    char padding[300];
+};
+
+typedef UnrolledList<Record> List;
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void check(const char *pWhat, const List *pList,
+		  const unsigned long *pSeq, size_t n)
+{
+    if ((pList->getCount() != n) || (pList->isEmpty() != !n))
+	fail(pWhat, n);
+
+    size_t i = 0;
+    for(const Record *pRecord = pList->getFirst(); pRecord;
+	pRecord = pList->getNext(pRecord), ++i)
+    {
+	if ((i >= n) || (pRecord->seq != pSeq[i]) ||
+	    (pRecord->check != ~pSeq[i]))
+	    fail(pWhat, i);
+    }
+    if (i != n)
+	fail(pWhat, i);
+
+    for(const Record *pRecord = pList->getLast(); pRecord;
+	pRecord = pList->getPrevious(pRecord))
+    {
+	if (!i || (pRecord->seq != pSeq[--i]))
+	    fail(pWhat, i);
+    }
+    if (i)
+	fail(pWhat, i);
+
+    for(const UnrolledListChunk *pChunk = pList->getFirstChunk(); pChunk;
+	pChunk = pList->getNextChunk(pChunk))
+    {
+	size_t nRun;
+	const Record *pRun = pList->getRun(pChunk, &nRun);
+	if (!nRun || (nRun > pList->getChunkCapacity()))
+	    fail(pWhat, nRun);
+	for(size_t j = 0; j < nRun; ++j, ++i)
+	{
+	    if ((i >= n) || (pRun[j].seq != pSeq[i]))
+		fail(pWhat, i);
+	}
+    }
+    if (i != n)
+	fail(pWhat, i);
+}
+
+static bool removeOdd(unsigned long *pCount, const Record *pRecord)
+{
+    ++*pCount;
+    return (pRecord->seq & 1) != 0;
+}
+
+static bool removeRandom(unsigned *pPercent, const Record *pRecord)
+{
+    return ((unsigned)rand() % 100) < *pPercent;
+}
+
+static bool removeAll(void *pContext, const Record *pRecord)
+{
+    return true;
+}
+
+static void append(List *pList, unsigned long *pSeq, size_t *pN,
+		   unsigned long seq)
+{
+    Record record;
+    record.seq = seq;
+    record.check = ~seq;
+    Record *pCopy = pList->append(&record);
+    if ((pCopy->seq != seq) || (pList->getLast() != pCopy))
+	fail("append", seq);
+    pSeq[(*pN)++] = seq;
+}
+
+static void testBasics()
+{
+    List list(100);
+    if ((list.getChunkBytes() != 128) ||
+	(list.getChunkCapacity() != (128 - sizeof(UnrolledListChunk)) /
+	 sizeof(Record)))
+	fail("chunk size", list.getChunkBytes());
+    if (list.getFirst() || list.getLast() || list.getFirstChunk())
+	fail("empty", 0);
+
+    UnrolledList<Big> big(64);
+    if (big.getChunkCapacity() < 4)
+	fail("big capacity", big.getChunkCapacity());
+    for(unsigned long i = 0; i < 100; ++i)
+    {
+	Big b;
+	b.seq = i;
+	big.append(&b);
+    }
+    unsigned long i = 0;
+    for(Big *pBig = big.getFirst(); pBig; pBig = big.getNext(pBig), ++i)
+    {
+	if (pBig->seq != i)
+	    fail("big", i);
+    }
+    if (i != 100)
+	fail("big count", i);
+}
+
+static void testBulk(size_t chunkBytes)
+{
+    static unsigned long seq[N_RECORDS];
+    static unsigned long expected[N_RECORDS];
+    size_t n = 0;
+    List list(chunkBytes);
+    for(unsigned long i = 0; i < N_RECORDS; ++i)
+	append(&list, seq, &n, i);
+    check("append", &list, seq, n);
+
+    /* pointers stay good across appends and removals from the front */
+    const Record *pMiddle = list.getFirst();
+    for(size_t i = 0; i < N_RECORDS / 2; ++i)
+	pMiddle = list.getNext(pMiddle);
+
+    list.removeFirst(7);
+    for(size_t i = 7; i < n; ++i)
+	expected[i - 7] = seq[i];
+    n -= 7;
+    check("removeFirst few", &list, expected, n);
+
+    list.removeFirst(list.getChunkCapacity() * 3 + 1);
+    for(size_t i = 0; i < n - list.getChunkCapacity() * 3 - 1; ++i)
+	expected[i] = expected[i + list.getChunkCapacity() * 3 + 1];
+    n -= list.getChunkCapacity() * 3 + 1;
+    check("removeFirst chunks", &list, expected, n);
+    if (pMiddle->seq != N_RECORDS / 2)
+	fail("pointer stability", pMiddle->seq);
+
+    /* bulk removal with compaction */
+    unsigned long visited = 0;
+    const size_t removed = list.removeIf(removeOdd, &visited);
+    size_t kept = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (!(expected[i] & 1))
+	    expected[kept++] = expected[i];
+    }
+    if ((visited != n) || (removed != n - kept))
+	fail("removeIf count", removed);
+    n = kept;
+    check("removeIf", &list, expected, n);
+    size_t nChunks = 0;
+    for(const UnrolledListChunk *pChunk = list.getFirstChunk(); pChunk;
+	pChunk = list.getNextChunk(pChunk))
+	++nChunks;
+    if (nChunks > n / list.getChunkCapacity() + 2)
+	fail("removeIf compaction", nChunks);
+
+    /* appends after compaction, then random removals */
+    for(unsigned long i = N_RECORDS; i < N_RECORDS + 1000; ++i)
+	append(&list, expected, &n, i);
+    check("append after removeIf", &list, expected, n);
+
+    unsigned percent = 30;
+    srand(1);
+    list.removeIf(removeRandom, &percent);
+    srand(1);
+    kept = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+	if (((unsigned)rand() % 100) >= percent)
+	    expected[kept++] = expected[i];
+    }
+    n = kept;
+    check("removeIf random", &list, expected, n);
+
+    list.removeIf(removeAll, (void *)NULL);
+    check("removeIf all", &list, NULL, 0);
+    append(&list, expected, &(n = 0), 5);
+    check("append after empty", &list, expected, 1);
+
+    list.removeFirst(2);
+    check("removeFirst all", &list, NULL, 0);
+    append(&list, expected, &(n = 0), 6);
+    list.clear();
+    check("clear", &list, NULL, 0);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testBasics();
+    testBulk(64);
+    testBulk(1000);
+    testBulk(4096);
+
+    return 0;
+}
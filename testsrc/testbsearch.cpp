@@ -69,6 +69,23 @@ static bool testOnce()
 	    return false;
     }
 
+    /*
+      Check lowerBound() for every value, including ones that aren't in the
+      array, and ones beyond either end.
+    */
+    for(int value = -1; value <= A_SIZE / 2; ++value)
+    {
+	const Foo *pBound =
+	    lowerBound<Foo, int, offsetof(Foo, value)>(
+		&value, a, n, compareInt);
+	if ((pBound < a) || (pBound > a + n))
+	    return false;
+	if ((pBound < a + n) && (pBound->value < value))
+	    return false;
+	if ((pBound > a) && (pBound[-1].value >= value))
+	    return false;
+    }
+
     return true;
 }
 
@@ -109,6 +126,7 @@ int main()
     u[1] = 42;
     u[2] = 2010;
     bsearch<unsigned, unsigned, 0>(&u[1], u, 3, compareUnsigned);
+    lowerBound<unsigned, unsigned, 0>(&u[1], u, 3, compareUnsigned);
 
     unsigned long ul[3];
     ul[0] = 17;
@@ -0,0 +1,144 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testheap.cpp - test heap.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Heaps are built both with makeHeap() and by pushing, and then popped
+    empty; the popped elements, which popHeap() leaves at the end of the
+    array, must come out in order, with the same keys that went in.  An
+    element too large for the sifting functions' stack buffer is used as
+    well, and so are interleaved pushes and pops.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+
+#include "heap.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+struct Foo
+{
+    int dummy;
+    int value;
+};
+
+struct Big
+{
+    char padding[200];
+    unsigned long value;
+};
+
+#define A_SIZE 1000
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static void testFoo(size_t n, bool make)
+{
+    Foo a[A_SIZE];
+    long sum = 0;
+    for(size_t i = 0; i < n; ++i)
+    {
+	a[i].dummy = (int)i;
+	a[i].value = rand() % (A_SIZE / 4);
+	sum += a[i].value;
+	if (!make)
+	    pushHeap<Foo, int, offsetof(Foo, value)>(a, i + 1, compareInt);
+    }
+    if (make)
+	makeHeap<Foo, int, offsetof(Foo, value)>(a, n, compareInt);
+
+    for(size_t i = n; i; --i)
+	popHeap<Foo, int, offsetof(Foo, value)>(a, i, compareInt);
+
+    /* the array is now in descending order */
+    for(size_t i = 0; i < n; ++i)
+    {
+	sum -= a[i].value;
+	if (i && (a[i - 1].value < a[i].value))
+	    fail("order", n);
+    }
+    if (sum)
+	fail("contents", n);
+}
+
+static void testBig()
+{
+    static Big a[A_SIZE];
+    for(size_t i = 0; i < A_SIZE; ++i)
+    {
+	a[i].value = (unsigned long)rand();
+	a[i].padding[0] = (char)a[i].value;
+    }
+    makeHeap<Big, unsigned long, offsetof(Big, value)>(
+	a, A_SIZE, compareUnsignedLong);
+    for(size_t i = A_SIZE; i; --i)
+	popHeap<Big, unsigned long, offsetof(Big, value)>(
+	    a, i, compareUnsignedLong);
+
+    for(size_t i = 0; i < A_SIZE; ++i)
+    {
+	if ((i && (a[i - 1].value < a[i].value)) ||
+	    (a[i].padding[0] != (char)a[i].value))
+	    fail("big", i);
+    }
+}
+
+static void testInterleaved()
+{
+    unsigned long a[A_SIZE];
+    unsigned long n = 0;
+    unsigned long last = 0;
+    for(unsigned long i = 0; i < 100000; ++i)
+    {
+	if ((n < A_SIZE) && (!n || (rand() % 3)))
+	{
+	    /* keys only go up, so pops must never go backwards */
+	    a[n++] = last + (unsigned long)(rand() % 100);
+	    pushHeap(a, n, sizeof(a[0]), 0,
+		     (int (*)(const void *, const void *))compareUnsignedLong);
+	}
+	else
+	{
+	    popHeap(a, n, sizeof(a[0]), 0,
+		    (int (*)(const void *, const void *))compareUnsignedLong);
+	    if (a[--n] < last)
+		fail("interleaved", i);
+	    last = a[n];
+	}
+    }
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    for(size_t n = 0; n < 70; ++n)
+    {
+	testFoo(n, true);
+	testFoo(n, false);
+    }
+    for(unsigned i = 0; i < 200; ++i)
+    {
+	const size_t n = (size_t)rand() % A_SIZE + 1;
+	testFoo(n, true);
+	testFoo(n, false);
+    }
+    testBig();
+    testInterleaved();
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testmerge.cpp - test merge.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Each record is tagged with the array it came from and its position
+    there, so the output can be checked for stability, and for keeping the
+    right record when de-duplicating, as well as for order.  Keys are drawn
+    from a small range so that there are plenty of duplicates, both
+    within arrays and between them.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "merge.h"
+#include "compare.h"
+
+using namespace phoenix4cpp;
+
+#define MAX_ARRAYS 100
+#define MAX_RECORDS 2000
+#define KEY_RANGE 1000
+
+struct Record
+{
+    unsigned key;
+    unsigned array;
+    unsigned pos;
+};
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static int compareRecordKey(const Record *pl, const Record *pr)
+{
+    return compareUnsigned(&pl->key, &pr->key);
+}
+
+struct Collector
+{
+    Record *pOut;
+    size_t n;
+};
+
+static void collect(Collector *pCollector, const Record *pRecord)
+{
+    pCollector->pOut[pCollector->n++] = *pRecord;
+}
+
+/* @returns true if a must come before b */
+static bool before(const Record *pA, const Record *pB)
+{
+    if (pA->key != pB->key)
+	return pA->key < pB->key;
+    if (pA->array != pB->array)
+	return pA->array < pB->array;
+    return pA->pos < pB->pos;
+}
+
+static void check(const char *pWhat, const Record *pOut, size_t n,
+		  size_t expected, bool unique)
+{
+    if (n != expected)
+	fail(pWhat, n);
+    for(size_t i = 1; i < n; ++i)
+    {
+	if (!before(&pOut[i - 1], &pOut[i]) ||
+	    (unique && (pOut[i - 1].key == pOut[i].key)))
+	    fail(pWhat, i);
+    }
+}
+
+static void testOnce(size_t k)
+{
+    static Record records[MAX_ARRAYS][MAX_RECORDS];
+    static Record out[MAX_ARRAYS * MAX_RECORDS];
+    static Record firsts[KEY_RANGE];
+    static bool seen[KEY_RANGE];
+    const Record *ppArray[MAX_ARRAYS];
+    size_t n[MAX_ARRAYS];
+
+    size_t total = 0;
+    memset(seen, 0, sizeof(seen));
+    for(size_t a = 0; a < k; ++a)
+    {
+	/* some arrays are empty */
+	n[a] = rand() % 4 ? rand() % MAX_RECORDS : 0;
+	unsigned key = rand() % 10;
+	for(size_t i = 0; i < n[a]; ++i)
+	{
+	    records[a][i].key = key;
+	    records[a][i].array = (unsigned)a;
+	    records[a][i].pos = (unsigned)i;
+	    if (!seen[key])
+	    {
+		seen[key] = true;
+		firsts[key] = records[a][i];
+	    }
+	    else if (before(&records[a][i], &firsts[key]))
+		firsts[key] = records[a][i];
+	    if (!(rand() % 3))
+		key += rand() % 3;
+	    if (key >= KEY_RANGE)
+		key = KEY_RANGE - 1;
+	}
+	ppArray[a] = records[a];
+	total += n[a];
+    }
+    size_t distinct = 0;
+    for(size_t key = 0; key < KEY_RANGE; ++key)
+	distinct += seen[key];
+
+    size_t nOut = kwayMerge<Record, Record, 0>(
+	ppArray, n, k, compareRecordKey, out);
+    check("merge", out, nOut, total, false);
+
+    Collector collector;
+    collector.pOut = out;
+    collector.n = 0;
+    nOut = kwayMerge<Record, Record, Collector, 0>(
+	ppArray, n, k, compareRecordKey, collect, &collector);
+    if (collector.n != nOut)
+	fail("callback count", collector.n);
+    check("merge callback", out, nOut, total, false);
+
+    nOut = kwayMerge<Record, Record, 0>(
+	ppArray, n, k, compareRecordKey, out, true);
+    check("unique", out, nOut, distinct, true);
+    for(size_t i = 0; i < nOut; ++i)
+    {
+	const Record *pFirst = &firsts[out[i].key];
+	if ((out[i].array != pFirst->array) || (out[i].pos != pFirst->pos))
+	    fail("unique keeps first", i);
+    }
+
+    collector.n = 0;
+    nOut = kwayMerge<Record, Record, Collector, 0>(
+	ppArray, n, k, compareRecordKey, collect, &collector, true);
+    check("unique callback", out, nOut, distinct, true);
+}
+
+static void testLoserTree()
+{
+    /* sources that run out at different times */
+    static const unsigned a[] = { 1, 4, 9 };
+    static const unsigned b[] = { 2, 3 };
+    static const unsigned c[] = { 0, 5, 6, 7, 8 };
+    const unsigned *ppSource[] = { a, b, c };
+    const size_t nSource[] = { 3, 2, 5 };
+    size_t used[3] = { 0, 0, 0 };
+
+    LoserTree tree(3, 0, (int (*)(const void *, const void *))compareUnsigned);
+    for(size_t i = 0; i < 3; ++i)
+	tree.set(i, ppSource[i]);
+    tree.start();
+
+    unsigned expected = 0;
+    const unsigned *pValue;
+    while((pValue = (const unsigned *)tree.getWinnerRecord()))
+    {
+	if (*pValue != expected++)
+	    fail("loser tree", expected);
+	const size_t w = tree.getWinner();
+	++used[w];
+	tree.advance(used[w] < nSource[w] ? ppSource[w] + used[w] : NULL);
+    }
+    if (expected != 10)
+	fail("loser tree count", expected);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testLoserTree();
+
+    Record dummy;
+    if (kwayMerge<Record, Record, 0>(NULL, NULL, 0, compareRecordKey, &dummy))
+	fail("no arrays", 0);
+
+    for(size_t k = 1; k <= 9; ++k)
+	testOnce(k);
+    for(unsigned i = 0; i < 10; ++i)
+	testOnce(1 + rand() % MAX_ARRAYS);
+
+    return 0;
+}
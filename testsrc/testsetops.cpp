@@ -0,0 +1,221 @@
+/* Copyright (c) 2012 Chris Westin.  All Rights Reserved. */
+/*
+  NAME
+    testsetops.cpp - test setops.h
+
+  SOURCE
+    phoenix4cpp - https://github.com/cwestin/phoenix4cpp
+
+  LICENSE
+    See ../LICENSE.txt.
+
+  IMPLEMENTATION
+    Sets are drawn from a small universe of values, so that they overlap
+    a good deal, and membership of each is also recorded in a table, from
+    which the expected results are worked out.  Every operation is tried
+    with every algorithm, over a range of sizes and ratios of sizes, and
+    in place where that is allowed.
+
+    For unsigned longs, each value of the universe is spread into the
+    high half as well as the low, and the universe is chosen so that
+    different values share low halves, to check that a 64-bit value only
+    matches if both of its halves do.
+ */
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "setops.h"
+
+using namespace phoenix4cpp;
+
+#define MAX_UNIVERSE 20000
+
+static void fail(const char *pWhat, unsigned long x)
+{
+    fprintf(stderr, "%s failure: %s at %lu\n", __FILE__, pWhat, x);
+    exit(1);
+}
+
+static const SetAlgorithm algorithms[] =
+{
+    SET_AUTO,
+    SET_MERGE,
+    SET_SIMD,
+    SET_GALLOP
+};
+
+static const size_t nAlgorithms = sizeof(algorithms) / sizeof(algorithms[0]);
+
+static inline unsigned long toValue(unsigned, size_t i)
+{
+    return (unsigned)i * 7 + 3;
+}
+
+static inline unsigned long toValue(unsigned long, size_t i)
+{
+    /* the low half repeats every 256 values */
+    return (((unsigned long)(i >> 8)) << 32) | ((i & 0xff) * 5);
+}
+
+/* choose about n members of the universe */
+static size_t makeSet(bool *pIn, size_t universe, size_t n)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < universe; ++i)
+    {
+	pIn[i] = (size_t)rand() % universe < n;
+	count += pIn[i];
+    }
+    return count;
+}
+
+template<class V>
+static size_t fill(V *pSet, const bool *pIn, size_t universe)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < universe; ++i)
+    {
+	if (pIn[i])
+	    pSet[n++] = (V)toValue((V)0, i);
+    }
+    return n;
+}
+
+template<class V>
+static void check(const char *pWhat, const V *pOut, size_t nOut,
+		  const bool *pA, const bool *pB, size_t universe, int op)
+{
+    size_t n = 0;
+    for(size_t i = 0; i < universe; ++i)
+    {
+	bool expected;
+	if (op == 0)
+	    expected = pA[i] && pB[i];
+	else if (op == 1)
+	    expected = pA[i] && !pB[i];
+	else
+	    expected = pA[i] || pB[i];
+	if (!expected)
+	    continue;
+	if ((n >= nOut) || (pOut[n] != (V)toValue((V)0, i)))
+	    fail(pWhat, i);
+	++n;
+    }
+    if (n != nOut)
+	fail(pWhat, nOut);
+}
+
+template<class V>
+static void testPair(size_t universe, size_t nA, size_t nB)
+{
+    static bool inA[MAX_UNIVERSE];
+    static bool inB[MAX_UNIVERSE];
+    static V a[MAX_UNIVERSE];
+    static V b[MAX_UNIVERSE];
+    static V out[2 * MAX_UNIVERSE];
+
+    makeSet(inA, universe, nA);
+    makeSet(inB, universe, nB);
+    nA = fill(a, inA, universe);
+    nB = fill(b, inB, universe);
+
+    for(size_t i = 0; i < nAlgorithms; ++i)
+    {
+	const SetAlgorithm algorithm = algorithms[i];
+	size_t n = setIntersection(a, nA, b, nB, out, algorithm);
+	check("intersection", out, n, inA, inB, universe, 0);
+	n = setIntersection(b, nB, a, nA, out, algorithm);
+	check("intersection reversed", out, n, inA, inB, universe, 0);
+	n = setDifference(a, nA, b, nB, out, algorithm);
+	check("difference", out, n, inA, inB, universe, 1);
+	n = setDifference(b, nB, a, nA, out, algorithm);
+	check("difference reversed", out, n, inB, inA, universe, 1);
+	n = setUnion(a, nA, b, nB, out, algorithm);
+	check("union", out, n, inA, inB, universe, 2);
+	n = setUnion(b, nB, a, nA, out, algorithm);
+	check("union reversed", out, n, inA, inB, universe, 2);
+
+	/* in place */
+	memcpy(out, a, nA * sizeof(V));
+	n = setIntersection(out, nA, b, nB, out, algorithm);
+	check("intersection in place", out, n, inA, inB, universe, 0);
+	memcpy(out, b, nB * sizeof(V));
+	n = setIntersection(out, nB, a, nA, out, algorithm);
+	check("intersection in place reversed", out, n, inA, inB, universe,
+	      0);
+	memcpy(out, a, nA * sizeof(V));
+	n = setDifference(out, nA, b, nB, out, algorithm);
+	check("difference in place", out, n, inA, inB, universe, 1);
+	memcpy(out, b, nB * sizeof(V));
+	n = setDifference(out, nB, a, nA, out, algorithm);
+	check("difference in place reversed", out, n, inB, inA, universe, 1);
+    }
+}
+
+template<class V>
+static void testN(size_t universe, size_t k)
+{
+    static bool in[8][MAX_UNIVERSE];
+    static bool all[MAX_UNIVERSE];
+    static bool everything[MAX_UNIVERSE];
+    static V sets[8][MAX_UNIVERSE];
+    static V out[MAX_UNIVERSE];
+    const V *ppSet[8];
+    size_t n[8];
+
+    for(size_t s = 0; s < k; ++s)
+    {
+	/* mostly dense, so that something survives */
+	makeSet(in[s], universe, universe - universe / (2 + rand() % 20));
+	n[s] = fill(sets[s], in[s], universe);
+	ppSet[s] = sets[s];
+    }
+    for(size_t i = 0; i < universe; ++i)
+    {
+	all[i] = true;
+	everything[i] = true;
+	for(size_t s = 0; s < k; ++s)
+	    all[i] = all[i] && in[s][i];
+    }
+
+    const size_t nOut = setIntersectionN(ppSet, n, k, out);
+    check("n-way", out, nOut, all, everything, universe, 0);
+}
+
+template<class V>
+static void testAll()
+{
+    testPair<V>(0, 0, 0);
+    testPair<V>(10, 0, 5);
+    testPair<V>(10, 10, 10);
+    testPair<V>(100, 3, 90);
+
+    /* similar sizes, where the block merge is used */
+    for(unsigned i = 0; i < 20; ++i)
+    {
+	const size_t universe = 1 + rand() % MAX_UNIVERSE;
+	testPair<V>(universe, rand() % universe, rand() % universe);
+    }
+
+    /* skewed sizes, where galloping is used */
+    for(size_t ratio = 10; ratio <= 10000; ratio *= 10)
+	testPair<V>(MAX_UNIVERSE, MAX_UNIVERSE / 2, MAX_UNIVERSE / 2 / ratio);
+
+    if (setIntersectionN((const V *const *)NULL, NULL, 0, (V *)NULL))
+	fail("no sets", 0);
+    for(size_t k = 1; k <= 8; ++k)
+	testN<V>(1 + rand() % MAX_UNIVERSE, k);
+}
+
+int main()
+{
+    srand(0xdeadbeef);
+
+    testAll<unsigned>();
+    testAll<unsigned long>();
+
+    return 0;
+}